@@ -1709,7 +1709,7 @@ QString XFACodeGenerator::generateSource() const
                 continue;
             }
 
-            stream << QString("    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<%1>& attribute, QString defaultValue)").arg(type.typeName) << Qt::endl;
+            stream << QString("    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<%1>& attribute, QString defaultValue)").arg(type.typeName) << Qt::endl;
             stream << QString("    {") << Qt::endl;
             stream << QString("        constexpr std::array enumValues = {") << Qt::endl;
             for (const QString& enumValue : type.enumValues)
@@ -1719,7 +1719,7 @@ QString XFACodeGenerator::generateSource() const
                 stream << QString("            std::make_pair(%1::%2, \"%3\"),").arg(type.typeName, getEnumValueName(enumValue), adjustedEnumValue) << Qt::endl;
             }
             stream << QString("        };") << Qt::endl;
-            stream << QString("        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);") << Qt::endl;
+            stream << QString("        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);") << Qt::endl;
             stream << QString("    }") << Qt::endl << Qt::endl;
         }
 
@@ -1795,7 +1795,7 @@ QString XFACodeGenerator::generateSource() const
 
             stream << QString("    virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }") << Qt::endl << Qt::endl;
 
-            stream << QString("    static std::optional<XFA_%1> parse(const QDomElement& element);").arg(myClass.className) << Qt::endl;
+            stream << QString("    static std::optional<XFA_%1> parse(QXmlStreamReader& reader);").arg(myClass.className) << Qt::endl;
 
             stream << Qt::endl;
 
@@ -1824,41 +1824,67 @@ QString XFACodeGenerator::generateSource() const
 
             stream << "};" << Qt::endl << Qt::endl;
 
-            // Class loader
-            stream << QString("std::optional<XFA_%1> XFA_%1::parse(const QDomElement& element)").arg(myClass.className) << Qt::endl;
+            // Class loader - reader is positioned at the start element of the class,
+            // after loading, reader is positioned at the end element of the class.
+            stream << QString("std::optional<XFA_%1> XFA_%1::parse(QXmlStreamReader& reader)").arg(myClass.className) << Qt::endl;
             stream << "{" << Qt::endl;
-            stream << "    if (element.isNull())" << Qt::endl << "    {" << Qt::endl << "        return std::nullopt;" << Qt::endl << "    }" << Qt::endl << Qt::endl;
-            stream << QString("    XFA_%1 myClass;").arg(myClass.className) << Qt::endl << Qt::endl;
+            stream << QString("    XFA_%1 myClass;").arg(myClass.className) << Qt::endl;
+            stream << "    myClass.setOrderFromReader(reader);" << Qt::endl << Qt::endl;
 
             // Load attributes
             stream << "    // load attributes" << Qt::endl;
+            if (!myClass.attributes.empty())
+            {
+                stream << "    const QXmlStreamAttributes attributes = reader.attributes();" << Qt::endl;
+            }
             for (const Attribute& attribute : myClass.attributes)
             {
                 QString attributeFieldName = QString("m_%1").arg(attribute.attributeName);
                 QString adjustedDefaultValue = attribute.defaultValue;
                 adjustedDefaultValue.replace("\\", "\\\\");
-                stream << QString("    parseAttribute(element, \"%1\", myClass.%2, \"%3\");").arg(attribute.attributeName, attributeFieldName, adjustedDefaultValue) << Qt::endl;
+                stream << QString("    parseAttribute(attributes, \"%1\", myClass.%2, \"%3\");").arg(attribute.attributeName, attributeFieldName, adjustedDefaultValue) << Qt::endl;
             }
 
             stream << Qt::endl;
 
-            // Load subitems
-            stream << "    // load items" << Qt::endl;
-            for (const Subnode& subnode : myClass.subnodes)
+            if (myClass.valueType)
             {
-                QString subnodeFieldName = QString("m_%1").arg(subnode.subnodeName);
-                stream << QString("    parseItem(element, \"%1\", myClass.%2);").arg(subnode.subnodeName, subnodeFieldName) << Qt::endl;
+                // Node value (node value contains all content of the element)
+                stream << "    // load node value" << Qt::endl;
+                stream << QString("    parseValue(reader, myClass.m_nodeValue);") << Qt::endl;
             }
+            else if (!myClass.subnodes.empty())
+            {
+                // Load subitems
+                stream << "    // load items" << Qt::endl;
+                stream << "    while (reader.readNextStartElement())" << Qt::endl;
+                stream << "    {" << Qt::endl;
+                stream << "        const QStringView name = reader.qualifiedName();" << Qt::endl << Qt::endl;
+
+                bool isFirst = true;
+                for (const Subnode& subnode : myClass.subnodes)
+                {
+                    QString subnodeFieldName = QString("m_%1").arg(subnode.subnodeName);
+                    stream << QString("        %1 (name == u\"%2\")").arg(isFirst ? "if" : "else if", subnode.subnodeName) << Qt::endl;
+                    stream << "        {" << Qt::endl;
+                    stream << QString("            parseItem(reader, myClass.%1);").arg(subnodeFieldName) << Qt::endl;
+                    stream << "        }" << Qt::endl;
+                    isFirst = false;
+                }
 
-            // Node value
-            if (myClass.valueType)
+                stream << "        else" << Qt::endl;
+                stream << "        {" << Qt::endl;
+                stream << "            reader.skipCurrentElement();" << Qt::endl;
+                stream << "        }" << Qt::endl;
+                stream << "    }" << Qt::endl;
+            }
+            else
             {
-                stream << Qt::endl;
-                stream << "    // load node value" << Qt::endl;
-                stream << QString("    parseValue(element, myClass.m_nodeValue);") << Qt::endl << Qt::endl;
+                stream << "    // load items" << Qt::endl;
+                stream << "    reader.skipCurrentElement();" << Qt::endl;
             }
 
-            stream << "    myClass.setOrderFromElement(element);" << Qt::endl;
+            stream << Qt::endl;
             stream << "    return myClass;" << Qt::endl;
             stream << "}" << Qt::endl;
 
@@ -36,6 +36,7 @@
 #include <QImageReader>
 #include <QPixmapCache>
 #include <QScreen>
+#include <QScrollBar>
 #include <QGuiApplication>
 #include <QDragEnterEvent>
 #include <QDropEvent>
@@ -58,6 +59,12 @@ MainWindow::MainWindow(QWidget* parent) :
     ui->documentItemsView->setItemDelegate(m_delegate);
     connect(ui->documentItemsView, &QListView::customContextMenuRequested, this, &MainWindow::onWorkspaceCustomContextMenuRequested);
 
+    // Thumbnails are rendered asynchronously. When visible area is changed,
+    // pending thumbnails (which might not be visible anymore) are cancelled.
+    connect(m_delegate, &PageItemDelegate::thumbnailReady, ui->documentItemsView->viewport(), QOverload<>::of(&QWidget::update));
+    connect(ui->documentItemsView->verticalScrollBar(), &QScrollBar::valueChanged, m_delegate, &PageItemDelegate::cancelPendingThumbnails);
+    connect(ui->documentItemsView->horizontalScrollBar(), &QScrollBar::valueChanged, m_delegate, &PageItemDelegate::cancelPendingThumbnails);
+
     setMinimumSize(pdf::PDFWidgetUtils::scaleDPI(this, QSize(800, 600)));
 
     ui->actionClear->setData(int(Operation::Clear));
@@ -32,12 +32,14 @@ namespace pdfdocpage
 PageItemDelegate::PageItemDelegate(PageItemModel* model, QObject* parent) :
     BaseClass(parent),
     m_model(model),
-    m_rasterizer(nullptr)
+    m_thumbnailService(new PageThumbnailService(this))
 {
-    m_rasterizer = new pdf::PDFRasterizer(this);
-    QSurfaceFormat format;
-    format.setSamples(16);
-    m_rasterizer->reset(false, format);
+    connect(m_thumbnailService, &PageThumbnailService::thumbnailReady, this, &PageItemDelegate::thumbnailReady);
+    connect(m_model, &PageItemModel::modelReset, this, [this]()
+    {
+        m_thumbnailService->cancelPendingRequests();
+        m_thumbnailService->releaseDocuments();
+    });
 }
 
 PageItemDelegate::~PageItemDelegate()
@@ -79,6 +81,11 @@ void PageItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& opti
         {
             painter->drawPixmap(pageImageRect, pageImagePixmap);
         }
+        else if (item->groups.front().pageType != PT_Empty)
+        {
+            // Placeholder, thumbnail is being rendered
+            painter->fillRect(pageImageRect, QBrush(Qt::lightGray, Qt::Dense6Pattern));
+        }
 
         painter->setPen(QPen(Qt::black));
         painter->setBrush(Qt::NoBrush);
@@ -131,11 +138,17 @@ QSize PageItemDelegate::getPageImageSize() const
     return m_pageImageSize;
 }
 
+void PageItemDelegate::cancelPendingThumbnails()
+{
+    m_thumbnailService->cancelPendingRequests();
+}
+
 void PageItemDelegate::setPageImageSize(QSize pageImageSize)
 {
     if (m_pageImageSize != pageImageSize)
     {
         m_pageImageSize = pageImageSize;
+        m_thumbnailService->cancelPendingRequests();
         Q_EMIT sizeHintChanged(QModelIndex());
     }
 }
@@ -156,46 +169,38 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
         return pixmap;
     }
 
-    // Jakub Melka: generate key and see, if pixmap is not cached
-    QString key = QString("%1#%2#%3#%4#%5@%6x%7").arg(groupItem.documentIndex).arg(groupItem.imageIndex).arg(int(groupItem.pageAdditionalRotation)).arg(groupItem.pageIndex).arg(groupItem.pageType).arg(rect.width()).arg(rect.height());
+    // Jakub Melka: generate key and see, if pixmap is not cached. Document hash
+    // is a part of the key, because document index can be reused.
+    QString documentHash;
+    const pdf::PDFDocument* document = nullptr;
+    if (groupItem.pageType == pdfdocpage::PT_DocumentPage)
+    {
+        const auto& documents = m_model->getDocuments();
+        auto it = documents.find(groupItem.documentIndex);
+        if (it != documents.cend())
+        {
+            document = &it->second.document;
+            documentHash = QString::fromLatin1(document->getSourceDataHash().toHex());
+        }
+    }
+
+    QString key = QString("%1#%2#%3#%4#%5#%6@%7x%8").arg(groupItem.documentIndex).arg(documentHash).arg(groupItem.imageIndex).arg(int(groupItem.pageAdditionalRotation)).arg(groupItem.pageIndex).arg(groupItem.pageType).arg(rect.width()).arg(rect.height());
 
     if (!QPixmapCache::find(key, &pixmap))
     {
-        // We must draw the pixmap
-        pixmap = QPixmap(rect.width(), rect.height());
-        pixmap.fill(Qt::transparent);
+        // Pixmap is not in the cache, take it from the thumbnail service
+        // (or request rendering, if it is not yet rendered)
+        QImage image;
+        QSize imageSize = rect.size() * m_dpiScaleRatio;
 
         switch (groupItem.pageType)
         {
             case pdfdocpage::PT_DocumentPage:
             {
-                const auto& documents = m_model->getDocuments();
-                auto it = documents.find(groupItem.documentIndex);
-                if (it != documents.cend())
+                if (document)
                 {
-                    const pdf::PDFDocument& document = it->second.document;
                     const pdf::PDFInteger pageIndex = groupItem.pageIndex - 1;
-                    if (pageIndex >= 0 && pageIndex < pdf::PDFInteger(document.getCatalog()->getPageCount()))
-                    {
-                        const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
-                        Q_ASSERT(page);
-
-                        pdf::PDFPrecompiledPage compiledPage;
-                        pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-                        pdf::PDFCMSManager cmsManager(nullptr);
-                        pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::View, nullptr);
-
-                        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(&document), &optionalContentActivity));
-                        cmsManager.setDocument(&document);
-
-                        pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
-                        pdf::PDFRenderer renderer(&document, &fontCache, cms.data(), &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
-                        renderer.compile(&compiledPage, pageIndex);
-
-                        QSize imageSize = rect.size() * m_dpiScaleRatio;
-                        QImage pageImage = m_rasterizer->render(pageIndex, page, &compiledPage, imageSize, pdf::PDFRenderer::getDefaultFeatures(), nullptr, groupItem.pageAdditionalRotation);
-                        pixmap = QPixmap::fromImage(qMove(pageImage));
-                    }
+                    image = m_thumbnailService->requestPageThumbnail(key, *document, pageIndex, groupItem.pageAdditionalRotation, imageSize);
                 }
                 break;
             }
@@ -206,20 +211,7 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
                 auto it = images.find(groupItem.imageIndex);
                 if (it != images.cend())
                 {
-                    const QImage& image = it->second.image;
-                    if (!image.isNull())
-                    {
-                        QRect drawRect(QPoint(0, 0), rect.size());
-                        QRect mediaBox(QPoint(0, 0), image.size());
-                        QRectF rotatedMediaBox = pdf::PDFPage::getRotatedBox(mediaBox, groupItem.pageAdditionalRotation);
-                        QTransform matrix = pdf::PDFRenderer::createMediaBoxToDevicePointMatrix(rotatedMediaBox, drawRect, groupItem.pageAdditionalRotation);
-
-                        QPainter painter(&pixmap);
-                        painter.setWorldTransform(QTransform(matrix));
-                        painter.translate(0, image.height());
-                        painter.scale(1.0, -1.0);
-                        painter.drawImage(0, 0, image);
-                    }
+                    image = m_thumbnailService->requestImageThumbnail(key, it->second.image, groupItem.pageAdditionalRotation, imageSize);
                 }
                 break;
             }
@@ -233,7 +225,11 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
                 break;
         }
 
-        QPixmapCache::insert(key, pixmap);
+        if (!image.isNull())
+        {
+            pixmap = QPixmap::fromImage(qMove(image));
+            QPixmapCache::insert(key, pixmap);
+        }
     }
 
     return pixmap;
@@ -20,6 +20,7 @@
 
 #include "pdfrenderer.h"
 #include "pdfcms.h"
+#include "pagethumbnailservice.h"
 
 #include <QAbstractItemDelegate>
 
@@ -46,15 +47,25 @@ public:
     QSize getPageImageSize() const;
     void setPageImageSize(QSize pageImageSize);
 
+    /// Cancels rendering of thumbnails, which has not yet started. Should
+    /// be called, when visible area of the view is changed.
+    void cancelPendingThumbnails();
+
+signals:
+    /// Emitted when thumbnail has been rendered, view should be repainted
+    void thumbnailReady();
+
 private:
     static constexpr int getVerticalSpacing() { return 5; }
     static constexpr int getHorizontalSpacing() { return 5; }
 
+    /// Returns page image pixmap. If pixmap is not yet rendered, then
+    /// it is requested from thumbnail service and null pixmap is returned.
     QPixmap getPageImagePixmap(const PageGroupItem* item, QRect rect) const;
 
     PageItemModel* m_model;
     QSize m_pageImageSize;
-    pdf::PDFRasterizer* m_rasterizer;
+    PageThumbnailService* m_thumbnailService;
     mutable double m_dpiScaleRatio = 1.0;
 };
 
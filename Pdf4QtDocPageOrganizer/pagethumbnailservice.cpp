@@ -0,0 +1,352 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pagethumbnailservice.h"
+#include "pdfconstants.h"
+
+#include <QDir>
+#include <QThread>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QPainter>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <algorithm>
+
+namespace pdfdocpage
+{
+
+PageThumbnailService::DocumentContext::DocumentContext(const pdf::PDFDocument& sourceDocument) :
+    document(sourceDocument),
+    optionalContentActivity(&document, pdf::OCUsage::View, nullptr),
+    fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT)
+{
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(&document);
+    cms = cmsManager.getCurrentCMS();
+}
+
+PageThumbnailService::PageThumbnailService(QObject* parent) :
+    BaseClass(parent),
+    m_diskCacheDirectory(getDefaultDiskCacheDirectory())
+{
+    m_threadPool.setMaxThreadCount(QThread::idealThreadCount());
+
+    if (!m_diskCacheDirectory.isEmpty())
+    {
+        QDir().mkpath(m_diskCacheDirectory);
+        m_threadPool.start([this]() { pruneDiskCache(); });
+    }
+}
+
+PageThumbnailService::~PageThumbnailService()
+{
+    cancelPendingRequests();
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+QImage PageThumbnailService::requestPageThumbnail(const QString& key,
+                                                  const pdf::PDFDocument& document,
+                                                  pdf::PDFInteger pageIndex,
+                                                  pdf::PageRotation rotation,
+                                                  QSize imageSize)
+{
+    QImage image = takeThumbnail(key);
+    if (!image.isNull() || imageSize.isEmpty())
+    {
+        return image;
+    }
+
+    Request request;
+    request.key = key;
+    request.document = getDocumentContext(document);
+    request.pageIndex = pageIndex;
+    request.rotation = rotation;
+    request.imageSize = imageSize;
+
+    // Jakub Melka: Disk cache can be used only, if we know document's hash,
+    // otherwise we can't distinguish between different documents.
+    const QByteArray& documentHash = document.getSourceDataHash();
+    if (!m_diskCacheDirectory.isEmpty() && !documentHash.isEmpty())
+    {
+        QByteArray diskCacheKey = documentHash.toHex() + QString("#%1#%2@%3x%4").arg(pageIndex).arg(int(rotation)).arg(imageSize.width()).arg(imageSize.height()).toLatin1();
+        QByteArray diskCacheKeyHash = QCryptographicHash::hash(diskCacheKey, QCryptographicHash::Sha1).toHex();
+        request.diskCacheFileName = QDir(m_diskCacheDirectory).filePath(QString::fromLatin1(diskCacheKeyHash) + ".png");
+    }
+
+    startRequest(qMove(request));
+    return QImage();
+}
+
+QImage PageThumbnailService::requestImageThumbnail(const QString& key,
+                                                   const QImage& image,
+                                                   pdf::PageRotation rotation,
+                                                   QSize imageSize)
+{
+    QImage thumbnail = takeThumbnail(key);
+    if (!thumbnail.isNull() || imageSize.isEmpty() || image.isNull())
+    {
+        return thumbnail;
+    }
+
+    Request request;
+    request.key = key;
+    request.image = image;
+    request.rotation = rotation;
+    request.imageSize = imageSize;
+    startRequest(qMove(request));
+    return QImage();
+}
+
+void PageThumbnailService::cancelPendingRequests()
+{
+    // Requests, which are not active, are skipped by worker threads. Started
+    // requests are kept, their thumbnails are stored when they are finished.
+    QMutexLocker lock(&m_mutex);
+    for (auto it = m_activeRequests.begin(); it != m_activeRequests.end();)
+    {
+        if (!it->second.started)
+        {
+            it = m_activeRequests.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void PageThumbnailService::releaseDocuments()
+{
+    m_documents.clear();
+    m_finishedThumbnails.clear();
+}
+
+QString PageThumbnailService::getDefaultDiskCacheDirectory()
+{
+    QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheDirectory.isEmpty())
+    {
+        return QString();
+    }
+
+    return QDir(cacheDirectory).filePath("thumbnails");
+}
+
+void PageThumbnailService::startRequest(Request request)
+{
+    quint64 requestId = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_activeRequests.count(request.key))
+        {
+            // Request is already being processed
+            return;
+        }
+
+        requestId = ++m_lastRequestId;
+        m_activeRequests[request.key].requestId = requestId;
+    }
+
+    m_threadPool.start([this, request = qMove(request), requestId]() { performRequest(request, requestId); });
+}
+
+void PageThumbnailService::performRequest(const Request& request, quint64 requestId)
+{
+    // Request can be cancelled, before it was started
+    if (!markRequestStarted(request.key, requestId))
+    {
+        return;
+    }
+
+    QImage image;
+    if (!request.diskCacheFileName.isEmpty())
+    {
+        image.load(request.diskCacheFileName);
+    }
+
+    if (image.isNull())
+    {
+        image = renderThumbnail(request);
+
+        if (!request.diskCacheFileName.isEmpty() && !image.isNull())
+        {
+            QSaveFile file(request.diskCacheFileName);
+            if (file.open(QFile::WriteOnly) && image.save(&file, "PNG"))
+            {
+                file.commit();
+            }
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, key = request.key, requestId, image = qMove(image)]() { onThumbnailFinished(key, requestId, image); }, Qt::QueuedConnection);
+}
+
+QImage PageThumbnailService::renderThumbnail(const Request& request)
+{
+    QImage image;
+
+    if (request.document)
+    {
+        const pdf::PDFDocument& document = request.document->document;
+        const pdf::PDFCatalog* catalog = document.getCatalog();
+        if (request.pageIndex < 0 || request.pageIndex >= pdf::PDFInteger(catalog->getPageCount()))
+        {
+            return image;
+        }
+
+        const pdf::PDFPage* page = catalog->getPage(request.pageIndex);
+        Q_ASSERT(page);
+
+        // Jakub Melka: Thumbnails are small, so we do not use smooth image
+        // transformation. Images are drawn at the thumbnail resolution.
+        pdf::PDFRenderer::Features features = pdf::PDFRenderer::getDefaultFeatures();
+        features.setFlag(pdf::PDFRenderer::SmoothImages, false);
+
+        pdf::PDFPrecompiledPage compiledPage;
+        pdf::PDFRenderer renderer(&document, &request.document->fontCache, request.document->cms.data(), &request.document->optionalContentActivity, features, pdf::PDFMeshQualitySettings());
+        renderer.compile(&compiledPage, request.pageIndex);
+
+        pdf::PDFRasterizer rasterizer(nullptr);
+        rasterizer.reset(false, QSurfaceFormat());
+        image = rasterizer.render(request.pageIndex, page, &compiledPage, request.imageSize, features, nullptr, request.rotation);
+    }
+    else if (!request.image.isNull())
+    {
+        image = QImage(request.imageSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        const QImage& sourceImage = request.image;
+        QRect drawRect(QPoint(0, 0), request.imageSize);
+        QRect mediaBox(QPoint(0, 0), sourceImage.size());
+        QRectF rotatedMediaBox = pdf::PDFPage::getRotatedBox(mediaBox, request.rotation);
+        QTransform matrix = pdf::PDFRenderer::createMediaBoxToDevicePointMatrix(rotatedMediaBox, drawRect, request.rotation);
+
+        QPainter painter(&image);
+        painter.setWorldTransform(QTransform(matrix));
+        painter.translate(0, sourceImage.height());
+        painter.scale(1.0, -1.0);
+        painter.drawImage(0, 0, sourceImage);
+    }
+
+    return image;
+}
+
+QImage PageThumbnailService::takeThumbnail(const QString& key)
+{
+    QImage image;
+
+    auto it = m_finishedThumbnails.find(key);
+    if (it != m_finishedThumbnails.end())
+    {
+        image = qMove(it->second);
+        m_finishedThumbnails.erase(it);
+    }
+
+    return image;
+}
+
+bool PageThumbnailService::markRequestStarted(const QString& key, quint64 requestId)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_activeRequests.find(key);
+    if (it == m_activeRequests.end() || it->second.requestId != requestId)
+    {
+        return false;
+    }
+
+    it->second.started = true;
+    return true;
+}
+
+void PageThumbnailService::onThumbnailFinished(QString key, quint64 requestId, QImage image)
+{
+    {
+        // Started requests are never cancelled, so the request is still active
+        QMutexLocker lock(&m_mutex);
+        auto it = m_activeRequests.find(key);
+        Q_ASSERT(it != m_activeRequests.end() && it->second.requestId == requestId);
+        if (it != m_activeRequests.end() && it->second.requestId == requestId)
+        {
+            m_activeRequests.erase(it);
+        }
+    }
+
+    if (!image.isNull())
+    {
+        m_finishedThumbnails[key] = qMove(image);
+        Q_EMIT thumbnailReady();
+    }
+}
+
+void PageThumbnailService::pruneDiskCache() const
+{
+    QDir directory(m_diskCacheDirectory);
+    QFileInfoList files = directory.entryInfoList(QStringList() << "*.png", QDir::Files);
+
+    qint64 totalSize = 0;
+    for (const QFileInfo& fileInfo : files)
+    {
+        totalSize += fileInfo.size();
+    }
+
+    if (totalSize <= DISK_CACHE_LIMIT)
+    {
+        return;
+    }
+
+    // Remove least recently modified files first
+    std::sort(files.begin(), files.end(), [](const QFileInfo& l, const QFileInfo& r) { return l.lastModified() < r.lastModified(); });
+    for (const QFileInfo& fileInfo : files)
+    {
+        if (totalSize <= DISK_CACHE_LIMIT / 2)
+        {
+            break;
+        }
+
+        if (QFile::remove(fileInfo.absoluteFilePath()))
+        {
+            totalSize -= fileInfo.size();
+        }
+    }
+}
+
+PageThumbnailService::DocumentContextPointer PageThumbnailService::getDocumentContext(const pdf::PDFDocument& document)
+{
+    // Jakub Melka: documents without hash are identified by address
+    QByteArray key = document.getSourceDataHash();
+    if (key.isEmpty())
+    {
+        key = QByteArray::number(quintptr(&document));
+    }
+
+    DocumentContextPointer& context = m_documents[key];
+    if (!context)
+    {
+        context = std::make_shared<DocumentContext>(document);
+    }
+
+    return context;
+}
+
+}   // namespace pdfdocpage
@@ -0,0 +1,166 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFDOCPAGEORGANIZER_PAGETHUMBNAILSERVICE_H
+#define PDFDOCPAGEORGANIZER_PAGETHUMBNAILSERVICE_H
+
+#include "pdfrenderer.h"
+#include "pdfcms.h"
+#include "pdffont.h"
+#include "pdfoptionalcontent.h"
+
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+
+#include <map>
+#include <memory>
+
+namespace pdfdocpage
+{
+
+/// Asynchronous service, which renders page thumbnails using multiple threads.
+/// Rendered thumbnails are stored in the disk cache (keyed by document hash,
+/// page and thumbnail size), so they are not rendered again when the same
+/// document is opened later. Service is used from the GUI thread only, thumbnails
+/// are rendered by worker threads. When thumbnail is finished, signal
+/// \p thumbnailReady is emitted and the thumbnail can be obtained.
+class PageThumbnailService : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    explicit PageThumbnailService(QObject* parent);
+    virtual ~PageThumbnailService() override;
+
+    /// Requests thumbnail of the document page. If thumbnail is ready,
+    /// then it is returned (and removed from the service, caller should
+    /// cache it), otherwise rendering is started (if not already running)
+    /// and null image is returned.
+    /// \param key Key of the thumbnail (must be unique for page and size)
+    /// \param document Document
+    /// \param pageIndex Page index
+    /// \param rotation Additional page rotation
+    /// \param imageSize Thumbnail size in device pixels
+    QImage requestPageThumbnail(const QString& key,
+                                const pdf::PDFDocument& document,
+                                pdf::PDFInteger pageIndex,
+                                pdf::PageRotation rotation,
+                                QSize imageSize);
+
+    /// Requests thumbnail of the image. If thumbnail is ready, then it is
+    /// returned (and removed from the service), otherwise rendering is started
+    /// (if not already running) and null image is returned.
+    /// \param key Key of the thumbnail (must be unique for image and size)
+    /// \param image Image
+    /// \param rotation Additional image rotation
+    /// \param imageSize Thumbnail size in device pixels
+    QImage requestImageThumbnail(const QString& key,
+                                 const QImage& image,
+                                 pdf::PageRotation rotation,
+                                 QSize imageSize);
+
+    /// Cancels all requests, whose rendering has not started yet. Visible
+    /// thumbnails are requested again when they are painted, so this
+    /// function should be called when visible area changes.
+    void cancelPendingRequests();
+
+    /// Releases documents and finished thumbnails held by the service. Running
+    /// rendering tasks keep their documents until they are finished.
+    void releaseDocuments();
+
+    /// Returns default directory of the disk cache
+    static QString getDefaultDiskCacheDirectory();
+
+signals:
+    void thumbnailReady();
+
+private:
+    struct DocumentContext
+    {
+        explicit DocumentContext(const pdf::PDFDocument& sourceDocument);
+
+        pdf::PDFDocument document;
+        pdf::PDFOptionalContentActivity optionalContentActivity;
+        pdf::PDFFontCache fontCache;
+        pdf::PDFCMSPointer cms;
+    };
+
+    using DocumentContextPointer = std::shared_ptr<DocumentContext>;
+
+    struct Request
+    {
+        QString key;
+        QString diskCacheFileName;
+        DocumentContextPointer document;
+        pdf::PDFInteger pageIndex = -1;
+        QImage image;
+        pdf::PageRotation rotation = pdf::PageRotation::None;
+        QSize imageSize;
+    };
+
+    /// Starts rendering of the request, if it is not already running
+    void startRequest(Request request);
+
+    /// Performs request (called from worker thread)
+    /// \param request Request
+    /// \param requestId Request id
+    void performRequest(const Request& request, quint64 requestId);
+
+    /// Renders the thumbnail (called from worker thread)
+    static QImage renderThumbnail(const Request& request);
+
+    /// Takes finished thumbnail, if it exists
+    QImage takeThumbnail(const QString& key);
+
+    /// Marks the request as started. Returns false, if the request was
+    /// cancelled before its rendering has started.
+    bool markRequestStarted(const QString& key, quint64 requestId);
+
+    /// Called when thumbnail is finished (in GUI thread)
+    void onThumbnailFinished(QString key, quint64 requestId, QImage image);
+
+    /// Removes least recently used files from disk cache, if it is too large
+    void pruneDiskCache() const;
+
+    DocumentContextPointer getDocumentContext(const pdf::PDFDocument& document);
+
+    static constexpr qint64 DISK_CACHE_LIMIT = 256 * 1024 * 1024;
+
+    QThreadPool m_threadPool;
+    QString m_diskCacheDirectory;
+    std::map<QByteArray, DocumentContextPointer> m_documents;
+    std::map<QString, QImage> m_finishedThumbnails;
+
+    struct ActiveRequest
+    {
+        quint64 requestId = 0;
+        bool started = false;
+    };
+
+    mutable QMutex m_mutex;
+    std::map<QString, ActiveRequest> m_activeRequests; ///< Queued and started requests (protected by mutex)
+    quint64 m_lastRequestId = 0;
+};
+
+}   // namespace pdfdocpage
+
+#endif // PDFDOCPAGEORGANIZER_PAGETHUMBNAILSERVICE_H
@@ -19,6 +19,7 @@
 #define PDFALGORITHMLCS_H
 
 #include "pdfglobal.h"
+#include "pdfexecutionpolicy.h"
 
 namespace pdf
 {
@@ -94,6 +95,12 @@ public:
 /// of objects, which are implementing operator "==" (equal operator).
 /// Constructor takes bidirectional iterators to the sequence. So, iterators
 /// are requred to be bidirectional.
+///
+/// Implementation uses Myers' O(ND) difference algorithm in linear space
+/// (divide and conquer using the middle snake). Common prefix and suffix
+/// of each subproblem is matched before the middle snake is searched, so long
+/// unchanged runs are cheap. Very long sequences are first divided into
+/// independent subproblems, which are then solved in parallel.
 template<typename Iterator, typename Comparator>
 class PDFAlgorithmLongestCommonSubsequence : public PDFAlgorithmLongestCommonSubsequenceBase
 {
@@ -110,6 +117,54 @@ public:
     const Sequence& getSequence() const { return m_sequence; }
 
 private:
+    /// Minimal size of subproblem (sum of lengths of both sequences),
+    /// for which the subproblem is solved in parallel.
+    static constexpr size_t PARALLEL_SUBPROBLEM_SIZE = 8192;
+
+    /// Part of the sequences, i.e. item ranges [begin1, end1) of the first
+    /// sequence and [begin2, end2) of the second sequence.
+    struct Subproblem
+    {
+        size_t begin1 = 0;
+        size_t end1 = 0;
+        size_t begin2 = 0;
+        size_t end2 = 0;
+        bool solved = false;
+        Sequence sequence;
+
+        size_t size() const { return (end1 - begin1) + (end2 - begin2); }
+    };
+
+    /// Diagonal run of matched items starting at (x, y), which
+    /// lies on some shortest edit path.
+    struct Snake
+    {
+        size_t x = 0;
+        size_t y = 0;
+        size_t length = 0;
+    };
+
+    bool isEqual(size_t index1, size_t index2) const { return m_comparator(*m_items1[index1], *m_items2[index2]); }
+
+    /// Matches common prefix and suffix of the subproblem. Matched prefix is appended
+    /// to the \p sequence, subproblem is shrinked and length of the matched
+    /// suffix is returned.
+    size_t trim(Subproblem& subproblem, Sequence& sequence) const;
+
+    /// Appends remaining items of the subproblem with empty sequence, and matched suffix
+    static void appendTrivial(const Subproblem& subproblem, size_t suffixLength, Sequence& sequence);
+
+    /// Finds middle snake of the subproblem. Subproblem must have both
+    /// sequences nonempty and must not start or end with matching items.
+    Snake findMiddleSnake(const Subproblem& subproblem) const;
+
+    /// Solves the subproblem and appends the result to the sequence
+    void solve(Subproblem subproblem, Sequence& sequence) const;
+
+    /// Divides the subproblem into (at most) three parts - before
+    /// the middle snake, the middle snake and after the middle snake.
+    std::vector<Subproblem> split(Subproblem subproblem) const;
+
     Iterator m_it1;
     Iterator m_it1End;
     Iterator m_it2;
@@ -117,11 +172,11 @@ private:
 
     size_t m_size1;
     size_t m_size2;
-    size_t m_matrixSize;
 
     Comparator m_comparator;
 
-    std::vector<bool> m_backtrackData;
+    std::vector<Iterator> m_items1;
+    std::vector<Iterator> m_items2;
     Sequence m_sequence;
 };
 
@@ -137,122 +192,323 @@ PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::PDFAlgorithmLongestC
     m_it2End(std::move(it2End)),
     m_size1(0),
     m_size2(0),
-    m_matrixSize(0),
     m_comparator(std::move(comparator))
 {
-    m_size1 = std::distance(m_it1, m_it1End) + 1;
-    m_size2 = std::distance(m_it2, m_it2End) + 1;
-    m_matrixSize = m_size1 * m_size2;
+    m_size1 = std::distance(m_it1, m_it1End);
+    m_size2 = std::distance(m_it2, m_it2End);
 }
 
 template<typename Iterator, typename Comparator>
 void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
 {
-    m_backtrackData.resize(m_matrixSize);
     m_sequence.clear();
+    m_sequence.reserve(m_size1 + m_size2);
 
-    std::vector<size_t> rowTop(m_size1, size_t());
-    std::vector<size_t> rowBottom(m_size1, size_t());
+    // Jakub Melka: iterators are only bidirectional, so we store them
+    // to have random access to the items of both sequences.
+    m_items1.clear();
+    m_items2.clear();
+    m_items1.reserve(m_size1);
+    m_items2.reserve(m_size2);
 
-    // Jakub Melka: we will have columns consisting of it1...it1End
-    // and rows consisting of it2...it2End. We iterate trough rows,
-    // and for each row, we update longest common subsequence data.
+    for (auto it = m_it1; it != m_it1End; ++it)
+    {
+        m_items1.push_back(it);
+    }
+
+    for (auto it = m_it2; it != m_it2End; ++it)
+    {
+        m_items2.push_back(it);
+    }
+
+    Subproblem problem;
+    problem.end1 = m_size1;
+    problem.end2 = m_size2;
 
-    auto it2 = m_it2;
-    for (size_t i2 = 1; i2 < m_size2; ++i2, ++it2)
+    const int threadCount = PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Content);
+    if (problem.size() < 2 * PARALLEL_SUBPROBLEM_SIZE || threadCount < 2 || !PDFExecutionPolicy::isParallelizing(PDFExecutionPolicy::Scope::Content))
     {
-        auto it1 = m_it1;
-        for (size_t i1 = 1; i1 < m_size1; ++i1, ++it1)
+        solve(problem, m_sequence);
+        return;
+    }
+
+    // Divide the problem into independent subproblems, split always the largest one,
+    // until we have enough subproblems for all threads.
+    std::vector<Subproblem> subproblems;
+    subproblems.push_back(std::move(problem));
+
+    while (true)
+    {
+        auto largestIt = subproblems.end();
+        size_t unsolvedCount = 0;
+        for (auto it = subproblems.begin(); it != subproblems.end(); ++it)
         {
-            if (m_comparator(*it1, *it2))
-            {
-                // We have match
-                rowBottom[i1] = rowTop[i1 - 1] + 1;
-            }
-            else
+            if (!it->solved)
             {
-                const size_t leftCellValue = rowBottom[i1 - 1];
-                const size_t upperCellValue = rowTop[i1];
-                bool isLeftBigger = leftCellValue > upperCellValue;
-
-                if (isLeftBigger)
-                {
-                    rowBottom[i1] = leftCellValue;
-                    m_backtrackData[i2 * m_size1 + i1] = true;
-                }
-                else
+                ++unsolvedCount;
+                if (largestIt == subproblems.end() || it->size() > largestIt->size())
                 {
-                    rowBottom[i1] = upperCellValue;
-                    m_backtrackData[i2 * m_size1 + i1] = false;
+                    largestIt = it;
                 }
             }
         }
 
-        // Bottom row will become top row
-        std::swap(rowTop, rowBottom);
+        if (largestIt == subproblems.end() || unsolvedCount >= size_t(threadCount) || largestIt->size() < PARALLEL_SUBPROBLEM_SIZE)
+        {
+            break;
+        }
+
+        std::vector<Subproblem> parts = split(std::move(*largestIt));
+        largestIt = subproblems.erase(largestIt);
+        subproblems.insert(largestIt, std::make_move_iterator(parts.begin()), std::make_move_iterator(parts.end()));
+    }
+
+    auto solveSubproblem = [this](Subproblem& subproblem)
+    {
+        if (!subproblem.solved)
+        {
+            solve(subproblem, subproblem.sequence);
+            subproblem.solved = true;
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, subproblems.begin(), subproblems.end(), solveSubproblem);
+
+    for (const Subproblem& subproblem : subproblems)
+    {
+        m_sequence.insert(m_sequence.end(), subproblem.sequence.cbegin(), subproblem.sequence.cend());
+    }
+}
+
+template<typename Iterator, typename Comparator>
+size_t PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::trim(Subproblem& subproblem, Sequence& sequence) const
+{
+    while (subproblem.begin1 < subproblem.end1 && subproblem.begin2 < subproblem.end2 && isEqual(subproblem.begin1, subproblem.begin2))
+    {
+        SequenceItem item;
+        item.index1 = subproblem.begin1++;
+        item.index2 = subproblem.begin2++;
+        sequence.push_back(item);
+    }
+
+    size_t suffixLength = 0;
+    while (subproblem.begin1 < subproblem.end1 && subproblem.begin2 < subproblem.end2 && isEqual(subproblem.end1 - 1, subproblem.end2 - 1))
+    {
+        --subproblem.end1;
+        --subproblem.end2;
+        ++suffixLength;
     }
 
-    size_t i1 = m_size1 - 1;
-    size_t i2 = m_size2 - 1;
+    return suffixLength;
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::appendTrivial(const Subproblem& subproblem, size_t suffixLength, Sequence& sequence)
+{
+    Q_ASSERT(subproblem.begin1 == subproblem.end1 || subproblem.begin2 == subproblem.end2);
 
-    while (i1 > 0 && i2 > 0)
+    for (size_t i = subproblem.begin1; i < subproblem.end1; ++i)
     {
         SequenceItem item;
+        item.index1 = i;
+        sequence.push_back(item);
+    }
 
-        const size_t index1 = i1 - 1;
-        const size_t index2 = i2 - 1;
+    for (size_t i = subproblem.begin2; i < subproblem.end2; ++i)
+    {
+        SequenceItem item;
+        item.index2 = i;
+        sequence.push_back(item);
+    }
 
-        auto cit1 = std::next(m_it1, index1);
-        auto cit2 = std::next(m_it2, index2);
+    for (size_t i = 0; i < suffixLength; ++i)
+    {
+        SequenceItem item;
+        item.index1 = subproblem.end1 + i;
+        item.index2 = subproblem.end2 + i;
+        sequence.push_back(item);
+    }
+}
 
-        if (m_comparator(*cit1, *cit2))
+template<typename Iterator, typename Comparator>
+typename PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::Snake PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::findMiddleSnake(const Subproblem& subproblem) const
+{
+    // Jakub Melka: we are searching for shortest edit paths simultaneously
+    // from the start (forward) and from the end (reverse) of the subproblem,
+    // until they overlap. Arrays contain furthest reaching x coordinate
+    // for each diagonal k = x - y (for reverse search, coordinates are
+    // measured from the end of the subproblem).
+
+    const ptrdiff_t n = subproblem.end1 - subproblem.begin1;
+    const ptrdiff_t m = subproblem.end2 - subproblem.begin2;
+    const ptrdiff_t delta = n - m;
+    const bool isOdd = (delta % 2) != 0;
+    const ptrdiff_t maxD = (n + m + 1) / 2;
+    const ptrdiff_t offset = maxD + 1;
+
+    std::vector<ptrdiff_t> forward(2 * offset + 1, 0);
+    std::vector<ptrdiff_t> reverse(2 * offset + 1, 0);
+
+    auto isEqualForward = [&](ptrdiff_t x, ptrdiff_t y) { return isEqual(subproblem.begin1 + x, subproblem.begin2 + y); };
+    auto isEqualReverse = [&](ptrdiff_t x, ptrdiff_t y) { return isEqual(subproblem.end1 - x - 1, subproblem.end2 - y - 1); };
+
+    for (ptrdiff_t d = 0; d <= maxD; ++d)
+    {
+        for (ptrdiff_t k = -d; k <= d; k += 2)
         {
-            item.index1 = index1;
-            item.index2 = index2;
+            ptrdiff_t x = (k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1])) ? forward[offset + k + 1] : forward[offset + k - 1] + 1;
+            ptrdiff_t y = x - k;
+            const ptrdiff_t startX = x;
+            const ptrdiff_t startY = y;
+
+            while (x < n && y < m && isEqualForward(x, y))
+            {
+                ++x;
+                ++y;
+            }
+
+            forward[offset + k] = x;
 
-            --i1;
-            --i2;
+            const ptrdiff_t reverseK = delta - k;
+            if (isOdd && reverseK >= -(d - 1) && reverseK <= d - 1 && x + reverse[offset + reverseK] >= n)
+            {
+                Snake snake;
+                snake.x = subproblem.begin1 + startX;
+                snake.y = subproblem.begin2 + startY;
+                snake.length = x - startX;
+                return snake;
+            }
         }
-        else
+
+        for (ptrdiff_t k = -d; k <= d; k += 2)
         {
-            if (m_backtrackData[i2 * m_size1 + i1])
+            ptrdiff_t x = (k == -d || (k != d && reverse[offset + k - 1] < reverse[offset + k + 1])) ? reverse[offset + k + 1] : reverse[offset + k - 1] + 1;
+            ptrdiff_t y = x - k;
+            const ptrdiff_t startX = x;
+
+            while (x < n && y < m && isEqualReverse(x, y))
             {
-                item.index1 = index1;
-                --i1;
+                ++x;
+                ++y;
             }
-            else
+
+            reverse[offset + k] = x;
+
+            const ptrdiff_t forwardK = delta - k;
+            if (!isOdd && forwardK >= -d && forwardK <= d && x + forward[offset + forwardK] >= n)
             {
-                item.index2 = index2;
-                --i2;
+                Snake snake;
+                snake.x = subproblem.end1 - x;
+                snake.y = subproblem.end2 - y;
+                snake.length = x - startX;
+                return snake;
             }
         }
-
-        m_sequence.push_back(item);
     }
 
-    while (i1 > 0)
+    // We should never get here, paths always overlap
+    Q_ASSERT(false);
+    return Snake();
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::solve(Subproblem subproblem, Sequence& sequence) const
+{
+    const size_t suffixLength = trim(subproblem, sequence);
+
+    if (subproblem.begin1 == subproblem.end1 || subproblem.begin2 == subproblem.end2)
     {
-        SequenceItem item;
+        appendTrivial(subproblem, suffixLength, sequence);
+        return;
+    }
+
+    const Snake snake = findMiddleSnake(subproblem);
 
-        const size_t index1 = i1 - 1;
-        item.index1 = index1;
-        --i1;
+    Subproblem before;
+    before.begin1 = subproblem.begin1;
+    before.end1 = snake.x;
+    before.begin2 = subproblem.begin2;
+    before.end2 = snake.y;
+    solve(before, sequence);
 
-        m_sequence.push_back(item);
+    for (size_t i = 0; i < snake.length; ++i)
+    {
+        SequenceItem item;
+        item.index1 = snake.x + i;
+        item.index2 = snake.y + i;
+        sequence.push_back(item);
     }
 
-    while (i2 > 0)
+    Subproblem after;
+    after.begin1 = snake.x + snake.length;
+    after.end1 = subproblem.end1;
+    after.begin2 = snake.y + snake.length;
+    after.end2 = subproblem.end2;
+    solve(after, sequence);
+
+    for (size_t i = 0; i < suffixLength; ++i)
     {
         SequenceItem item;
+        item.index1 = subproblem.end1 + i;
+        item.index2 = subproblem.end2 + i;
+        sequence.push_back(item);
+    }
+}
+
+template<typename Iterator, typename Comparator>
+std::vector<typename PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::Subproblem> PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::split(Subproblem subproblem) const
+{
+    std::vector<Subproblem> result;
 
-        const size_t index2 = i2 - 1;
-        item.index2 = index2;
-        --i2;
+    Subproblem prefix;
+    prefix.solved = true;
+    const size_t suffixLength = trim(subproblem, prefix.sequence);
 
-        m_sequence.push_back(item);
+    if (subproblem.begin1 == subproblem.end1 || subproblem.begin2 == subproblem.end2)
+    {
+        appendTrivial(subproblem, suffixLength, prefix.sequence);
+        result.push_back(std::move(prefix));
+        return result;
     }
 
-    std::reverse(m_sequence.begin(), m_sequence.end());
+    const Snake snake = findMiddleSnake(subproblem);
+
+    result.push_back(std::move(prefix));
+
+    Subproblem before;
+    before.begin1 = subproblem.begin1;
+    before.end1 = snake.x;
+    before.begin2 = subproblem.begin2;
+    before.end2 = snake.y;
+    result.push_back(std::move(before));
+
+    Subproblem middle;
+    middle.solved = true;
+    for (size_t i = 0; i < snake.length; ++i)
+    {
+        SequenceItem item;
+        item.index1 = snake.x + i;
+        item.index2 = snake.y + i;
+        middle.sequence.push_back(item);
+    }
+    result.push_back(std::move(middle));
+
+    Subproblem after;
+    after.begin1 = snake.x + snake.length;
+    after.end1 = subproblem.end1;
+    after.begin2 = snake.y + snake.length;
+    after.end2 = subproblem.end2;
+    result.push_back(std::move(after));
+
+    Subproblem suffix;
+    suffix.solved = true;
+    suffix.begin1 = subproblem.end1;
+    suffix.end1 = subproblem.end1;
+    suffix.begin2 = subproblem.end2;
+    suffix.end2 = subproblem.end2;
+    appendTrivial(suffix, suffixLength, suffix.sequence);
+    result.push_back(std::move(suffix));
+
+    return result;
 }
 
 }   // namespace pdf
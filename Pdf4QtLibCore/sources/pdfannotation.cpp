@@ -25,6 +25,7 @@
 #include "pdfform.h"
 #include "pdfpainterutils.h"
 #include "pdfdocumentbuilder.h"
+#include "pdfoptionalcontent.h"
 #include "pdfdbgheap.h"
 
 #include <QIcon>
@@ -1182,7 +1183,12 @@ PDFAnnotationManager::PDFAnnotationManager(PDFFontCache* fontCache,
     m_features(features),
     m_target(target)
 {
+    if (m_cmsManager)
+    {
+        connect(m_cmsManager, &PDFCMSManager::colorManagementSystemChanged, this, &PDFAnnotationManager::invalidatePrecompiledAppearances);
+    }
 
+    updateOptionalActivityConnection();
 }
 
 PDFAnnotationManager::~PDFAnnotationManager()
@@ -1494,10 +1500,6 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     QRectF annotationRectangle = annotation.annotation->getRectangle();
     QRectF formBoundingBox = loader.readRectangle(formDictionary->get("BBox"), QRectF());
     QTransform formMatrix = loader.readMatrixFromDictionary(formDictionary, "Matrix", QTransform());
-    QByteArray content = m_document->getDecodedStream(formStream);
-    PDFObject resources = m_document->getObject(formDictionary->get("Resources"));
-    PDFObject transparencyGroup = m_document->getObject(formDictionary->get("Group"));
-    const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(formDictionary, "StructParent", page->getStructureParentKey());
 
     if (formBoundingBox.isEmpty() || annotationRectangle.isEmpty())
     {
@@ -1531,32 +1533,96 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     // Step 3) - compute final matrix AA
     QTransform AA = formMatrix * A;
 
-    bool isContentVisible = false;
+    // Draw annotation. Appearance stream is compiled only once, then
+    // compiled graphic instructions are just replayed on the painter.
+    PrecompiledAppearance precompiledAppearance = getPrecompiledAppearance(annotation, formStream, formBoundingBox, AA, features, page, cms);
+    if (precompiledAppearance.isContentVisible)
+    {
+        PDFPainterStateGuard guard(painter);
+        precompiledAppearance.compiledPage->draw(painter, page->getCropBox(), userSpaceToDeviceSpace, features, painter->opacity());
+    }
 
-    // Draw annotation
+    // Draw highlighting of fields, but only, if target is View,
+    // we do not want to render form field highlight, when we are
+    // printing to the printer.
+    if (precompiledAppearance.isContentVisible && m_target == Target::View)
     {
         PDFPainterStateGuard guard(painter);
-        PDFPainter pdfPainter(painter, features, userSpaceToDeviceSpace, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
-        pdfPainter.initializeProcessor();
+        painter->resetTransform();
+        drawWidgetAnnotationHighlight(annotationRectangle, annotation.annotation.get(), painter, userSpaceToDeviceSpace);
+    }
+}
+
+PDFAnnotationManager::PrecompiledAppearance PDFAnnotationManager::getPrecompiledAppearance(const PageAnnotation& annotation,
+                                                                                          const PDFStream* formStream,
+                                                                                          const QRectF& formBoundingBox,
+                                                                                          const QTransform& matrix,
+                                                                                          PDFRenderer::Features features,
+                                                                                          const PDFPage* page,
+                                                                                          const PDFCMS* cms) const
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        const PrecompiledAppearance& precompiledAppearance = annotation.precompiledAppearance;
+        if (precompiledAppearance.compiledPage && precompiledAppearance.matrix == matrix && precompiledAppearance.features == features)
+        {
+            return precompiledAppearance;
+        }
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* formDictionary = formStream->getDictionary();
+    QByteArray content = m_document->getDecodedStream(formStream);
+    PDFObject resources = m_document->getObject(formDictionary->get("Resources"));
+    PDFObject transparencyGroup = m_document->getObject(formDictionary->get("Group"));
+    const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(formDictionary, "StructParent", page->getStructureParentKey());
+
+    PrecompiledAppearance precompiledAppearance;
+    precompiledAppearance.matrix = matrix;
+    precompiledAppearance.features = features;
+
+    std::shared_ptr<PDFPrecompiledPage> compiledPage = std::make_shared<PDFPrecompiledPage>();
+    {
+        PDFPrecompiledPageGenerator generator(compiledPage.get(), features, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
+        generator.initializeProcessor();
 
         // Jakub Melka: we must check, that we do not display annotation disabled by optional content
         PDFObjectReference oc = annotation.annotation->getOptionalContent();
-        isContentVisible = !oc.isValid() || !pdfPainter.isContentSuppressedByOC(oc);
+        precompiledAppearance.isContentVisible = !oc.isValid() || !generator.isContentSuppressedByOC(oc);
 
-        if (isContentVisible)
+        if (precompiledAppearance.isContentVisible)
         {
-            pdfPainter.processForm(AA, formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+            generator.processForm(matrix, formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
         }
     }
+    compiledPage->optimize();
+    precompiledAppearance.compiledPage = qMove(compiledPage);
 
-    // Draw highlighting of fields, but only, if target is View,
-    // we do not want to render form field highlight, when we are
-    // printing to the printer.
-    if (isContentVisible && m_target == Target::View)
+    QMutexLocker lock(&m_mutex);
+    annotation.precompiledAppearance = precompiledAppearance;
+    return precompiledAppearance;
+}
+
+void PDFAnnotationManager::invalidatePrecompiledAppearances()
+{
+    QMutexLocker lock(&m_mutex);
+    for (auto& item : m_pageAnnotations)
     {
-        PDFPainterStateGuard guard(painter);
-        painter->resetTransform();
-        drawWidgetAnnotationHighlight(annotationRectangle, annotation.annotation.get(), painter, userSpaceToDeviceSpace);
+        for (PageAnnotation& pageAnnotation : item.second.annotations)
+        {
+            pageAnnotation.precompiledAppearance = PrecompiledAppearance();
+        }
+    }
+}
+
+void PDFAnnotationManager::updateOptionalActivityConnection()
+{
+    disconnect(m_optionalActivityConnection);
+    m_optionalActivityConnection = QMetaObject::Connection();
+
+    if (m_optionalActivity)
+    {
+        m_optionalActivityConnection = connect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::invalidatePrecompiledAppearances);
     }
 }
 
@@ -1565,12 +1631,23 @@ void PDFAnnotationManager::setDocument(const PDFModifiedDocument& document)
     if (m_document != document)
     {
         m_document = document;
-        m_optionalActivity = document.getOptionalContentActivity();
+
+        if (m_optionalActivity != document.getOptionalContentActivity())
+        {
+            m_optionalActivity = document.getOptionalContentActivity();
+            updateOptionalActivityConnection();
+        }
 
         if (document.hasReset() || document.hasFlag(PDFModifiedDocument::Annotation))
         {
             m_pageAnnotations.clear();
         }
+        else
+        {
+            // Jakub Melka: appearance streams (for example, of form fields)
+            // could have been changed, so we must compile them again.
+            invalidatePrecompiledAppearances();
+        }
     }
 }
 
@@ -1680,7 +1757,12 @@ const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() co
 
 void PDFAnnotationManager::setOptionalActivity(const PDFOptionalContentActivity* optionalActivity)
 {
-    m_optionalActivity = optionalActivity;
+    if (m_optionalActivity != optionalActivity)
+    {
+        m_optionalActivity = optionalActivity;
+        updateOptionalActivityConnection();
+        invalidatePrecompiledAppearances();
+    }
 }
 
 PDFAnnotationManager::Target PDFAnnotationManager::getTarget() const
@@ -1487,6 +1487,17 @@ public:
     PDFFormManager* getFormManager() const;
     void setFormManager(PDFFormManager* formManager);
 
+    /// Appearance stream of the annotation compiled into the list of graphic
+    /// instructions. Compiled appearance is valid only for the matrix and
+    /// features, with which it was compiled.
+    struct PrecompiledAppearance
+    {
+        QTransform matrix;                                      ///< Matrix mapping form space to the user space
+        PDFRenderer::Features features = PDFRenderer::None;     ///< Renderer features used for compilation
+        bool isContentVisible = false;                          ///< Is content visible (not suppressed by optional content)?
+        std::shared_ptr<const PDFPrecompiledPage> compiledPage; ///< Compiled graphic instructions
+    };
+
     struct PageAnnotation
     {
         PDFAppeareanceStreams::Appearance appearance = PDFAppeareanceStreams::Appearance::Normal;
@@ -1495,6 +1506,9 @@ public:
 
         /// This mutable appearance stream is protected by main mutex
         mutable PDFCachedItem<PDFObject> appearanceStream;
+
+        /// This mutable precompiled appearance stream is protected by main mutex
+        mutable PrecompiledAppearance precompiledAppearance;
     };
 
     struct PDF4QTLIBCORESHARED_EXPORT PageAnnotations
@@ -1549,6 +1563,10 @@ public:
     /// Returns true, if any page in the given indices has annotation
     bool hasAnyPageAnnotation(const std::vector<PDFInteger>& pageIndices) const;
 
+    /// Invalidates precompiled appearance streams of all annotations,
+    /// appearance streams are compiled again, when annotations are drawn.
+    void invalidatePrecompiledAppearances();
+
 protected:
     void drawWidgetAnnotationHighlight(QRectF annotationRectangle,
                                        const PDFAnnotation* annotation,
@@ -1608,6 +1626,28 @@ protected:
                                              const PDFCMS* cms,
                                              QPainter* painter) const;
 
+    /// Returns precompiled appearance stream of the annotation. If annotation
+    /// has no valid precompiled appearance for given matrix and features,
+    /// then appearance stream is compiled and stored in the page annotation.
+    /// \param pageAnnotation Page annotation
+    /// \param formStream Appearance stream
+    /// \param formBoundingBox Bounding box of the appearance stream
+    /// \param matrix Matrix mapping form space to the user space
+    /// \param features Renderer features
+    /// \param page Page
+    /// \param cms Color management system
+    PrecompiledAppearance getPrecompiledAppearance(const PageAnnotation& annotation,
+                                                   const PDFStream* formStream,
+                                                   const QRectF& formBoundingBox,
+                                                   const QTransform& matrix,
+                                                   PDFRenderer::Features features,
+                                                   const PDFPage* page,
+                                                   const PDFCMS* cms) const;
+
+    /// Updates connection to the optional content activity, so precompiled
+    /// appearance streams are invalidated, when optional content state is changed.
+    void updateOptionalActivityConnection();
+
     const PDFDocument* m_document;
 
     PDFFontCache* m_fontCache;
@@ -1620,6 +1660,7 @@ protected:
     mutable QMutex m_mutex;
     mutable std::map<PDFInteger, PageAnnotations> m_pageAnnotations;
     Target m_target = Target::View;
+    QMetaObject::Connection m_optionalActivityConnection;
 };
 
 }   // namespace pdf
@@ -20,6 +20,8 @@
 #include "pdfexception.h"
 #include "pdfdbgheap.h"
 
+#include <algorithm>
+
 namespace pdf
 {
 
@@ -284,6 +286,100 @@ static constexpr PDFCCITTCode CCITT_BLACK_CODES[] = {
     { 2560,    0b000000011111,     000000011111_bitlength }
 };
 
+/// Entry of the lookup table for decoding of run length codes. Table is indexed
+/// by next MAX_CODE_LOOKUP_BITS bits of the stream. If \p bits is zero, then
+/// no code word starts with the given bit sequence.
+struct PDFCCITTCodeLookupEntry
+{
+    uint16_t length = 0;
+    uint8_t bits = 0;
+};
+
+/// Entry of the lookup table for decoding 2D modes. Table is indexed
+/// by next MAX_2D_MODE_BIT_LENGTH bits of the stream.
+struct PDFCCITT2DModeLookupEntry
+{
+    CCITT_2D_Code_Mode mode = Invalid;
+    uint8_t bits = 0;
+};
+
+static constexpr uint8_t MAX_CODE_LOOKUP_BITS = MAX_CODE_BIT_LENGTH + 1;
+
+struct PDFCCITTLookupTables
+{
+    PDFCCITTLookupTables()
+    {
+        fillCodeTable(whiteCodes, CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES));
+        fillCodeTable(blackCodes, CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES));
+
+        for (const PDFCCITT2DModeInfo& info : CCITT_2D_CODE_MODES)
+        {
+            const uint32_t freeBits = MAX_2D_MODE_BIT_LENGTH - info.bits;
+            const uint32_t first = static_cast<uint32_t>(info.code) << freeBits;
+            const uint32_t last = first + (1 << freeBits);
+
+            for (uint32_t i = first; i < last; ++i)
+            {
+                modes[i].mode = info.mode;
+                modes[i].bits = info.bits;
+            }
+        }
+    }
+
+    /// Fills all table entries, whose index starts with some code word,
+    /// with this code word. Codes are prefix-free, so entries do not overlap.
+    static void fillCodeTable(PDFCCITTCodeLookupEntry* table, const PDFCCITTCode* codes, size_t codeCount)
+    {
+        for (size_t i = 0; i < codeCount; ++i)
+        {
+            const PDFCCITTCode& code = codes[i];
+            const uint32_t freeBits = MAX_CODE_LOOKUP_BITS - code.bits;
+            const uint32_t first = static_cast<uint32_t>(code.code) << freeBits;
+            const uint32_t last = first + (1 << freeBits);
+
+            for (uint32_t j = first; j < last; ++j)
+            {
+                table[j].length = code.length;
+                table[j].bits = code.bits;
+            }
+        }
+    }
+
+    static const PDFCCITTLookupTables& getInstance()
+    {
+        static const PDFCCITTLookupTables tables;
+        return tables;
+    }
+
+    PDFCCITTCodeLookupEntry whiteCodes[1 << MAX_CODE_LOOKUP_BITS];
+    PDFCCITTCodeLookupEntry blackCodes[1 << MAX_CODE_LOOKUP_BITS];
+    PDFCCITT2DModeLookupEntry modes[1 << MAX_2D_MODE_BIT_LENGTH];
+};
+
+/// Sets bits [from, to) of the packed line to one
+static void fillLineBits(uint8_t* line, int from, int to)
+{
+    if (from >= to)
+    {
+        return;
+    }
+
+    const int firstByte = from / 8;
+    const int lastByte = (to - 1) / 8;
+    const uint8_t firstMask = static_cast<uint8_t>(0xFF >> (from % 8));
+    const uint8_t lastMask = static_cast<uint8_t>(0xFF << (7 - (to - 1) % 8));
+
+    if (firstByte == lastByte)
+    {
+        line[firstByte] |= firstMask & lastMask;
+        return;
+    }
+
+    line[firstByte] |= firstMask;
+    std::fill(line + firstByte + 1, line + lastByte, 0xFF);
+    line[lastByte] |= lastMask;
+}
+
 PDFCCITTFaxDecoder::PDFCCITTFaxDecoder(const QByteArray* stream, const PDFCCITTFaxDecoderParameters& parameters) :
     m_reader(stream, 1),
     m_parameters(parameters)
@@ -293,7 +389,15 @@ PDFCCITTFaxDecoder::PDFCCITTFaxDecoder(const QByteArray* stream, const PDFCCITTF
 
 PDFImageData PDFCCITTFaxDecoder::decode()
 {
-    PDFBitWriter writer(1);
+    const int bytesPerLine = static_cast<int>((m_parameters.columns + 7) / 8);
+
+    // Lines are written directly into packed output buffer
+    QByteArray outputData;
+    if (m_parameters.rows > 0)
+    {
+        outputData.reserve(m_parameters.rows * bytesPerLine);
+    }
+
     std::vector<int> codingLine;
     std::vector<int> referenceLine;
 
@@ -453,20 +557,9 @@ PDFImageData PDFCCITTFaxDecoder::decode()
             }
         }
 
-        // Write the line to the output buffer
-        isCurrentPixelBlack = false;
-        int index = 0;
-        for (int i = 0; i < m_parameters.columns; ++i)
-        {
-            if (i == codingLine[index])
-            {
-                isCurrentPixelBlack = !isCurrentPixelBlack;
-                ++index;
-            }
-
-            writer.write(isCurrentPixelBlack ? 0 : 1);
-        }
-        writer.finishLine();
+        // Write the line to the output buffer (white pixels are ones)
+        outputData.append(bytesPerLine, '\0');
+        writeLine(codingLine, reinterpret_cast<uint8_t*>(outputData.data()) + static_cast<qsizetype>(row) * bytesPerLine);
 
         ++row;
 
@@ -556,7 +649,52 @@ PDFImageData PDFCCITTFaxDecoder::decode()
         decode = { m_parameters.decode[0], m_parameters.decode[1] };
     }
 
-    return PDFImageData(1, 1, m_parameters.columns, row, (m_parameters.columns + 7) / 8, m_parameters.maskingType, writer.takeByteArray(), { }, qMove(decode), { });
+    return PDFImageData(1, 1, m_parameters.columns, row, (m_parameters.columns + 7) / 8, m_parameters.maskingType, qMove(outputData), { }, qMove(decode), { });
+}
+
+void PDFCCITTFaxDecoder::writeLine(const std::vector<int>& line, uint8_t* target) const
+{
+    // Changing elements are processed in the same way as if we scanned
+    // pixels from left to right and toggled the color each time pixel index
+    // equals to current changing element (at most one toggle per pixel).
+    const int columns = static_cast<int>(m_parameters.columns);
+    bool isCurrentPixelBlack = false;
+    int position = 0;
+    size_t index = 0;
+
+    while (position < columns)
+    {
+        const int changingElement = line[index];
+
+        if (changingElement < position)
+        {
+            // Changing element is left of the current position, no more toggles
+            if (!isCurrentPixelBlack)
+            {
+                fillLineBits(target, position, columns);
+            }
+            break;
+        }
+
+        const int runEnd = qMin(changingElement, columns);
+        if (!isCurrentPixelBlack)
+        {
+            fillLineBits(target, position, runEnd);
+        }
+        position = runEnd;
+
+        if (position < columns)
+        {
+            isCurrentPixelBlack = !isCurrentPixelBlack;
+            ++index;
+
+            if (!isCurrentPixelBlack)
+            {
+                fillLineBits(target, position, position + 1);
+            }
+            ++position;
+        }
+    }
 }
 
 void PDFCCITTFaxDecoder::skipFill()
@@ -640,57 +778,218 @@ uint32_t PDFCCITTFaxDecoder::getRunLength(bool white)
 
 uint32_t PDFCCITTFaxDecoder::getWhiteCode()
 {
-    return getCode(CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES));
+    return getCode(PDFCCITTLookupTables::getInstance().whiteCodes);
 }
 
 uint32_t PDFCCITTFaxDecoder::getBlackCode()
 {
-    return getCode(CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES));
+    return getCode(PDFCCITTLookupTables::getInstance().blackCodes);
 }
 
-uint32_t PDFCCITTFaxDecoder::getCode(const PDFCCITTCode* codes, size_t codeCount)
+uint32_t PDFCCITTFaxDecoder::getCode(const PDFCCITTCodeLookupEntry* table)
 {
-    uint32_t code = 0;
-    uint8_t bits = 0;
+    const PDFCCITTCodeLookupEntry& entry = table[m_reader.look(MAX_CODE_LOOKUP_BITS)];
 
-    while (bits <= MAX_CODE_BIT_LENGTH)
+    if (entry.bits == 0)
     {
-        code = (code << 1) + m_reader.read(1);
-        ++bits;
+        throw PDFException(PDFTranslationContext::tr("Invalid CCITT run length code word."));
+    }
 
-        for (size_t i = 0; i < codeCount; ++i)
+    m_reader.read(entry.bits);
+    return entry.length;
+}
+
+CCITT_2D_Code_Mode PDFCCITTFaxDecoder::get2DMode()
+{
+    const PDFCCITT2DModeLookupEntry& entry = PDFCCITTLookupTables::getInstance().modes[m_reader.look(MAX_2D_MODE_BIT_LENGTH)];
+
+    if (entry.bits == 0)
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid CCITT 2D mode."));
+    }
+
+    m_reader.read(entry.bits);
+    return entry.mode;
+}
+
+/// Bit writer for variable length code words, bits are
+/// written from the most significant bit of each byte.
+class PDFCCITTCodeWriter
+{
+public:
+    void write(uint32_t code, uint8_t bits)
+    {
+        m_buffer = (m_buffer << bits) | (code & ((1u << bits) - 1));
+        m_bitsInBuffer += bits;
+
+        while (m_bitsInBuffer >= 8)
         {
-            const PDFCCITTCode& currentCode = codes[i];
-            if (currentCode.bits == bits && currentCode.code == code)
-            {
-                return currentCode.length;
-            }
+            m_bitsInBuffer -= 8;
+            m_data.push_back(static_cast<char>(static_cast<uint8_t>(m_buffer >> m_bitsInBuffer)));
         }
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid CCITT run length code word."));
-}
+    void writeRunLength(uint32_t length, const PDFCCITTCode* codes, size_t codeCount)
+    {
+        auto writeCode = [this, codes, codeCount](uint32_t codeLength)
+        {
+            const PDFCCITTCode* code = std::find_if(codes, codes + codeCount, [codeLength](const PDFCCITTCode& item) { return item.length == codeLength; });
+            Q_ASSERT(code != codes + codeCount);
+            write(code->code, code->bits);
+        };
+
+        // Longer runs are written as sequence of make-up codes
+        // followed by single terminating code (which can be zero).
+        constexpr uint32_t MAX_MAKE_UP_LENGTH = 2560;
+        while (length > MAX_MAKE_UP_LENGTH)
+        {
+            writeCode(MAX_MAKE_UP_LENGTH);
+            length -= MAX_MAKE_UP_LENGTH;
+        }
 
-CCITT_2D_Code_Mode PDFCCITTFaxDecoder::get2DMode()
+        if (length >= 64)
+        {
+            writeCode(length - length % 64);
+            length = length % 64;
+        }
+
+        writeCode(length);
+    }
+
+    QByteArray finish()
+    {
+        if (m_bitsInBuffer > 0)
+        {
+            write(0, 8 - m_bitsInBuffer);
+        }
+
+        return qMove(m_data);
+    }
+
+    void reserve(int size) { m_data.reserve(size); }
+
+private:
+    QByteArray m_data;
+    uint64_t m_buffer = 0;
+    uint8_t m_bitsInBuffer = 0;
+};
+
+QByteArray PDFCCITTFaxEncoder::encode(const QByteArray& data, int columns, int rows, int stride)
 {
-    uint32_t code = 0;
-    uint8_t bits = 0;
+    Q_ASSERT(data.size() >= static_cast<qsizetype>(stride) * rows);
+    static_assert(Vertical_0 - Vertical_3L == 3 && Vertical_3R - Vertical_0 == 3, "Vertical modes must be ordered by offset");
+
+    PDFCCITTCodeWriter writer;
+    writer.reserve(data.size() / 8);
+
+    // Lines are represented by changing elements, i.e. positions of pixels,
+    // whose color differs from the color of previous pixel. Pixel before
+    // the line is imaginary white pixel, so changing elements with even index
+    // start black runs. Both lines are terminated by sentinels (column count),
+    // so we can always look at two elements after found element.
+    constexpr size_t SENTINEL_COUNT = 3;
+    std::vector<int> codingLine;
+    std::vector<int> referenceLine(SENTINEL_COUNT, columns);
+    codingLine.reserve(columns + SENTINEL_COUNT);
 
-    while (bits <= MAX_2D_MODE_BIT_LENGTH)
+    auto writeMode = [&writer](CCITT_2D_Code_Mode mode)
     {
-        code = (code << 1) + m_reader.read(1);
-        ++bits;
+        const PDFCCITT2DModeInfo& info = CCITT_2D_CODE_MODES[mode];
+        Q_ASSERT(info.mode == mode);
+        writer.write(info.code, info.bits);
+    };
 
-        for (const PDFCCITT2DModeInfo& info : CCITT_2D_CODE_MODES)
+    auto writeRunLength = [&writer](int length, bool isBlack)
+    {
+        if (isBlack)
+        {
+            writer.writeRunLength(static_cast<uint32_t>(length), CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES));
+        }
+        else
         {
-            if (info.bits == bits && info.code == code)
+            writer.writeRunLength(static_cast<uint32_t>(length), CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES));
+        }
+    };
+
+    for (int row = 0; row < rows; ++row)
+    {
+        const uint8_t* line = reinterpret_cast<const uint8_t*>(data.constData()) + static_cast<qsizetype>(row) * stride;
+
+        codingLine.clear();
+        bool isPreviousPixelBlack = false;
+        for (int column = 0; column < columns; ++column)
+        {
+            const bool isBlack = !(line[column / 8] & (0x80 >> (column % 8)));
+            if (isBlack != isPreviousPixelBlack)
             {
-                return info.mode;
+                codingLine.push_back(column);
+                isPreviousPixelBlack = isBlack;
             }
         }
+        codingLine.insert(codingLine.end(), SENTINEL_COUNT, columns);
+
+        int a0 = -1;
+        bool isA0Black = false;
+        size_t a1_index = 0;
+        size_t b1_index = 0;
+
+        while (a0 < columns)
+        {
+            // Find a1 - next changing element on the coding line right of a0
+            while (codingLine[a1_index] <= a0)
+            {
+                ++a1_index;
+            }
+
+            // Find b1 - first changing element on the reference line right of a0
+            // and of opposite color than a0. Element a0 only moves to the right,
+            // but b1 can be one element left of the previous b1.
+            while (b1_index > 0 && referenceLine[b1_index - 1] > a0)
+            {
+                --b1_index;
+            }
+            while (referenceLine[b1_index] <= a0)
+            {
+                ++b1_index;
+            }
+            if ((b1_index % 2 == 0) == isA0Black)
+            {
+                ++b1_index;
+            }
+
+            const int a1 = codingLine[a1_index];
+            const int b1 = referenceLine[b1_index];
+            const int b2 = referenceLine[b1_index + 1];
+
+            if (b2 < a1)
+            {
+                writeMode(Pass);
+                a0 = b2;
+            }
+            else if (std::abs(a1 - b1) <= 3)
+            {
+                writeMode(static_cast<CCITT_2D_Code_Mode>(Vertical_0 + a1 - b1));
+                a0 = a1;
+                isA0Black = !isA0Black;
+            }
+            else
+            {
+                const int a2 = codingLine[a1_index + 1];
+                writeMode(Horizontal);
+                writeRunLength(a1 - qMax(a0, 0), isA0Black);
+                writeRunLength(a2 - a1, !isA0Black);
+                a0 = a2;
+            }
+        }
+
+        std::swap(codingLine, referenceLine);
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid CCITT 2D mode."));
+    // End of facsimile block, two end of line patterns
+    writer.write(1, 12);
+    writer.write(1, 12);
+
+    return writer.finish();
 }
 
 }   // namespace pdf
@@ -24,7 +24,7 @@
 namespace pdf
 {
 
-struct PDFCCITTCode;
+struct PDFCCITTCodeLookupEntry;
 
 struct PDFCCITTFaxDecoderParameters
 {
@@ -114,6 +114,12 @@ private:
     /// \param isA1LeftOfA0Allowed Allow a1 to be left of a0 (not a0_index, but line[a0_index], which is a0)
     void addPixels(std::vector<int>& line, int& a0_index, int a1, bool isCurrentPixelBlack, bool isA1LeftOfA0Allowed);
 
+    /// Writes line with changing elements into the packed output line
+    /// (one bit per pixel, white pixels are ones). Target line must be zeroed.
+    /// \param line Line with changing element indices
+    /// \param target Target packed line
+    void writeLine(const std::vector<int>& line, uint8_t* target) const;
+
     /// Get 2D mode from the stream
     CCITT_2D_Code_Mode get2DMode();
 
@@ -122,12 +128,31 @@ private:
     uint32_t getWhiteCode();
     uint32_t getBlackCode();
 
-    uint32_t getCode(const PDFCCITTCode* codes, size_t codeCount);
+    /// Decodes run length code using the lookup table
+    /// \param table Lookup table indexed by next code lookup bits
+    uint32_t getCode(const PDFCCITTCodeLookupEntry* table);
 
     PDFBitReader m_reader;
     PDFCCITTFaxDecoderParameters m_parameters;
 };
 
+/// Encoder of bitonal images into CCITT data using pure two dimensional
+/// encoding (Group 4, K < 0). Lines are not byte aligned, end of line patterns
+/// are not written and data are terminated by end of block pattern (EOFB),
+/// so default values of the other CCITT filter parameters can be used.
+class PDFCCITTFaxEncoder
+{
+public:
+    /// Encodes the image. Image lines are packed (one bit per pixel, each line
+    /// starts at byte boundary) and white pixels are ones, i.e. the same format
+    /// as decoder produces, when parameter BlackIs1 is false.
+    /// \param data Packed image lines
+    /// \param columns Pixel width of the image
+    /// \param rows Pixel height of the image
+    /// \param stride Byte length of one packed line
+    static QByteArray encode(const QByteArray& data, int columns, int rows, int stride);
+};
+
 }   // namespace pdf
 
 #endif // PDFCCITTFAXDECODER_H
@@ -56,11 +56,209 @@
 #endif
 #endif
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 
 namespace pdf
 {
 
+std::unique_ptr<PDFColorTransformLUT> PDFColorTransformLUT::build(const Sampler& sampler, uint32_t channels, int gridSize)
+{
+    if (!sampler || (channels != 3 && channels != 4) || gridSize < 2)
+    {
+        return nullptr;
+    }
+
+    size_t nodeCount = 1;
+    for (uint32_t i = 0; i < channels; ++i)
+    {
+        nodeCount *= gridSize;
+    }
+
+    // Last input channel is the slowest varying index, first three channels
+    // form a cube, in which first channel is the slowest varying index.
+    std::vector<float> inputs(nodeCount * channels, 0.0f);
+    const float step = 1.0f / float(gridSize - 1);
+    for (size_t node = 0; node < nodeCount; ++node)
+    {
+        size_t remainder = node;
+        float* nodeInput = inputs.data() + node * channels;
+
+        const int i2 = static_cast<int>(remainder % gridSize);
+        remainder /= gridSize;
+        const int i1 = static_cast<int>(remainder % gridSize);
+        remainder /= gridSize;
+        const int i0 = static_cast<int>(remainder % gridSize);
+        remainder /= gridSize;
+
+        nodeInput[0] = i0 * step;
+        nodeInput[1] = i1 * step;
+        nodeInput[2] = i2 * step;
+
+        if (channels == 4)
+        {
+            nodeInput[3] = static_cast<int>(remainder) * step;
+        }
+    }
+
+    std::unique_ptr<PDFColorTransformLUT> lut(new PDFColorTransformLUT(channels, gridSize));
+    lut->m_table.resize(nodeCount * 3, 0.0f);
+    sampler(inputs.data(), lut->m_table.data(), nodeCount);
+
+    return lut;
+}
+
+int PDFColorTransformLUT::getGridSize(PDFCMSSettings::Accuracy accuracy, uint32_t channels)
+{
+    // Jakub Melka: LUT interpolates on top of the transform of LittleCMS, which
+    // is already precalculated, so it is used only, when low accuracy is requested.
+    switch (accuracy)
+    {
+        case PDFCMSSettings::Accuracy::Low:
+            return channels == 4 ? 17 : 33;
+
+        case PDFCMSSettings::Accuracy::Medium:
+        case PDFCMSSettings::Accuracy::High:
+            return 0;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return 0;
+}
+
+void PDFColorTransformLUT::interpolateTetrahedral(const float* cube, float x, float y, float z, float* output) const
+{
+    const int n = m_gridSize;
+    const float fx = qBound(0.0f, x, 1.0f) * (n - 1);
+    const float fy = qBound(0.0f, y, 1.0f) * (n - 1);
+    const float fz = qBound(0.0f, z, 1.0f) * (n - 1);
+
+    const int x0 = qMin(static_cast<int>(fx), n - 2);
+    const int y0 = qMin(static_cast<int>(fy), n - 2);
+    const int z0 = qMin(static_cast<int>(fz), n - 2);
+
+    const float rx = fx - x0;
+    const float ry = fy - y0;
+    const float rz = fz - z0;
+
+    const size_t X1 = size_t(n) * n * 3;
+    const size_t Y1 = size_t(n) * 3;
+    const size_t Z1 = 3;
+
+    const float* c0 = cube + x0 * X1 + y0 * Y1 + z0 * Z1;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const float v0 = c0[i];
+        float c1 = 0.0f;
+        float c2 = 0.0f;
+        float c3 = 0.0f;
+
+        if (rx >= ry && ry >= rz)
+        {
+            c1 = c0[X1 + i] - v0;
+            c2 = c0[X1 + Y1 + i] - c0[X1 + i];
+            c3 = c0[X1 + Y1 + Z1 + i] - c0[X1 + Y1 + i];
+        }
+        else if (rx >= rz && rz >= ry)
+        {
+            c1 = c0[X1 + i] - v0;
+            c2 = c0[X1 + Y1 + Z1 + i] - c0[X1 + Z1 + i];
+            c3 = c0[X1 + Z1 + i] - c0[X1 + i];
+        }
+        else if (rz >= rx && rx >= ry)
+        {
+            c1 = c0[X1 + Z1 + i] - c0[Z1 + i];
+            c2 = c0[X1 + Y1 + Z1 + i] - c0[X1 + Z1 + i];
+            c3 = c0[Z1 + i] - v0;
+        }
+        else if (ry >= rx && rx >= rz)
+        {
+            c1 = c0[X1 + Y1 + i] - c0[Y1 + i];
+            c2 = c0[Y1 + i] - v0;
+            c3 = c0[X1 + Y1 + Z1 + i] - c0[X1 + Y1 + i];
+        }
+        else if (ry >= rz && rz >= rx)
+        {
+            c1 = c0[X1 + Y1 + Z1 + i] - c0[Y1 + Z1 + i];
+            c2 = c0[Y1 + i] - v0;
+            c3 = c0[Y1 + Z1 + i] - c0[Y1 + i];
+        }
+        else
+        {
+            c1 = c0[X1 + Y1 + Z1 + i] - c0[Y1 + Z1 + i];
+            c2 = c0[Y1 + Z1 + i] - c0[Z1 + i];
+            c3 = c0[Z1 + i] - v0;
+        }
+
+        output[i] = v0 + c1 * rx + c2 * ry + c3 * rz;
+    }
+}
+
+void PDFColorTransformLUT::transform(const float* input, float* output) const
+{
+    if (m_channels == 3)
+    {
+        interpolateTetrahedral(m_table.data(), input[0], input[1], input[2], output);
+        return;
+    }
+
+    // Interpolate linearly between two cubes in the last channel
+    const int n = m_gridSize;
+    const float fk = qBound(0.0f, input[3], 1.0f) * (n - 1);
+    const int k0 = qMin(static_cast<int>(fk), n - 2);
+    const float rk = fk - k0;
+    const size_t cubeSize = size_t(n) * n * n * 3;
+
+    std::array<float, 3> output0 = { };
+    std::array<float, 3> output1 = { };
+    interpolateTetrahedral(m_table.data() + k0 * cubeSize, input[0], input[1], input[2], output0.data());
+    interpolateTetrahedral(m_table.data() + (k0 + 1) * cubeSize, input[0], input[1], input[2], output1.data());
+
+    for (int i = 0; i < 3; ++i)
+    {
+        output[i] = output0[i] + (output1[i] - output0[i]) * rk;
+    }
+}
+
+void PDFColorTransformLUT::transform(const float* input, unsigned char* output, size_t pixelCount) const
+{
+    std::array<float, 3> color = { };
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        transform(input, color.data());
+        input += m_channels;
+
+        for (float value : color)
+        {
+            *output++ = static_cast<unsigned char>(qBound(0.0f, value, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+/// Creates sampler of the transform for building of the LUT. Transform must have
+/// float input and float RGB output format.
+/// \param transform Color transform
+/// \param channels Input channel count
+/// \param inputScale Input values in range [0, 1] are scaled by this factor before transform
+static PDFColorTransformLUT::Sampler createTransformLUTSampler(cmsHTRANSFORM transform, cmsUInt32Number channels, float inputScale)
+{
+    return [transform, channels, inputScale](const float* input, float* output, size_t count)
+    {
+        std::vector<float> scaledInput(input, input + count * channels);
+        for (float& value : scaledInput)
+        {
+            value *= inputScale;
+        }
+
+        cmsDoTransform(transform, scaledInput.data(), output, static_cast<cmsUInt32Number>(count));
+    };
+}
+
 class PDFLittleCMS : public PDFCMS
 {
 public:
@@ -129,7 +327,8 @@ private:
     /// \param iccID Icc profile id
     /// \param renderingIntent Rendering intent
     /// \param isRGB888Buffer If true, 8-bit RGB output buffer is used, otherwise FLOAT RGB output buffer is used
-    cmsHTRANSFORM getTransformFromICCProfile(const QByteArray& iccData, const QByteArray& iccID, RenderingIntent renderingIntent, bool isRGB888Buffer) const;
+    /// \param lut If not null, precomputed transform LUT is stored here (or nullptr, if LUT is not used)
+    cmsHTRANSFORM getTransformFromICCProfile(const QByteArray& iccData, const QByteArray& iccID, RenderingIntent renderingIntent, bool isRGB888Buffer, const PDFColorTransformLUT** lut = nullptr) const;
 
     /// Returns transformation flags according to the current settings
     cmsUInt32Number getTransformationFlags() const;
@@ -161,6 +360,24 @@ private:
 
     cmsHTRANSFORM getTransformBetweenColorSpaces(const ColorSpaceTransformParams& params) const;
 
+    /// Returns precomputed transform LUT for device color profile (RGB or CMYK),
+    /// or nullptr, if LUT is not used. LUT is built on first use, read access
+    /// is lock-free.
+    /// \param profile Color profile
+    /// \param intent Rendering intent
+    const PDFColorTransformLUT* getTransformLUT(Profile profile, RenderingIntent intent) const;
+
+    /// Returns true, if precomputed transform LUTs can be used with current settings
+    bool isTransformLUTAllowed() const;
+
+    struct CustomIccProfileCacheItem
+    {
+        cmsHTRANSFORM transform = cmsHTRANSFORM();
+        std::unique_ptr<PDFColorTransformLUT> lut;
+    };
+
+    static constexpr int RENDERING_INTENT_COUNT = int(RenderingIntent::Unknown) + 1;
+
     const PDFCMSManager* m_manager;
     PDFCMSSettings m_settings;
     QColor m_paperColor;
@@ -170,8 +387,10 @@ private:
     mutable QReadWriteLock m_transformationCacheLock;
     mutable std::unordered_map<int, cmsHTRANSFORM> m_transformationCache;
 
+    mutable std::array<std::atomic<PDFColorTransformLUT*>, RENDERING_INTENT_COUNT * ProfileCount> m_transformLUTs;
+
     mutable QReadWriteLock m_customIccProfileCacheLock;
-    mutable std::map<std::pair<QByteArray, RenderingIntent>, cmsHTRANSFORM> m_customIccProfileCache;
+    mutable std::map<std::pair<QByteArray, RenderingIntent>, CustomIccProfileCacheItem> m_customIccProfileCache;
 
     mutable QReadWriteLock m_transformColorSpaceCacheLock;
     mutable std::map<QByteArray, cmsHTRANSFORM> m_transformColorSpaceCache;
@@ -206,6 +425,13 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceGray(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    const PDFColorTransformLUT* lut = getTransformLUT(RGB, getEffectiveRenderingIntent(intent));
+    if (lut && colors.size() % lut->getChannels() == 0)
+    {
+        lut->transform(colors.data(), outputBuffer, colors.size() / lut->getChannels());
+        return true;
+    }
+
     cmsHTRANSFORM transform = getTransform(RGB, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -231,6 +457,14 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    // LUT takes colors in range [0, 1], so we can avoid copying the colors
+    const PDFColorTransformLUT* lut = getTransformLUT(CMYK, getEffectiveRenderingIntent(intent));
+    if (lut && colors.size() % lut->getChannels() == 0)
+    {
+        lut->transform(colors.data(), outputBuffer, colors.size() / lut->getChannels());
+        return true;
+    }
+
     cmsHTRANSFORM transform = getTransform(CMYK, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -303,6 +537,19 @@ bool PDFLittleCMS::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::
 
 bool PDFLittleCMS::fillRGBBufferFromICC(const std::vector<float>& colors, RenderingIntent renderingIntent, unsigned char* outputBuffer, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
 {
+    if (isTransformLUTAllowed())
+    {
+        // LUT is built from float transform
+        const PDFColorTransformLUT* lut = nullptr;
+        getTransformFromICCProfile(iccData, iccID, renderingIntent, false, &lut);
+
+        if (lut && colors.size() % lut->getChannels() == 0)
+        {
+            lut->transform(colors.data(), outputBuffer, colors.size() / lut->getChannels());
+            return true;
+        }
+    }
+
     cmsHTRANSFORM transform = getTransformFromICCProfile(iccData, iccID, renderingIntent, true);
 
     if (!transform)
@@ -482,7 +729,7 @@ PDFLittleCMS::~PDFLittleCMS()
 
     for (const auto& transformItem : m_customIccProfileCache)
     {
-        cmsHTRANSFORM transform = transformItem.second;
+        cmsHTRANSFORM transform = transformItem.second.transform;
         if (transform)
         {
             cmsDeleteTransform(transform);
@@ -498,6 +745,11 @@ PDFLittleCMS::~PDFLittleCMS()
         }
     }
 
+    for (std::atomic<PDFColorTransformLUT*>& lut : m_transformLUTs)
+    {
+        delete lut.load();
+    }
+
     for (cmsHPROFILE profile : m_profiles)
     {
         if (profile)
@@ -546,6 +798,15 @@ QColor PDFLittleCMS::getColorFromDeviceGray(const PDFColor& color, RenderingInte
 
 QColor PDFLittleCMS::getColorFromDeviceRGB(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
+    const PDFColorTransformLUT* lut = getTransformLUT(RGB, getEffectiveRenderingIntent(intent));
+    if (lut && color.size() == 3)
+    {
+        std::array<float, 3> rgbInputColor = { color[0], color[1], color[2] };
+        std::array<float, 3> rgbOutputColor = { };
+        lut->transform(rgbInputColor.data(), rgbOutputColor.data());
+        return getColorFromOutputColor(rgbOutputColor);
+    }
+
     cmsHTRANSFORM transform = getTransform(RGB, getEffectiveRenderingIntent(intent), false);
 
     if (!transform)
@@ -573,6 +834,15 @@ QColor PDFLittleCMS::getColorFromDeviceRGB(const PDFColor& color, RenderingInten
 
 QColor PDFLittleCMS::getColorFromDeviceCMYK(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
+    const PDFColorTransformLUT* lut = getTransformLUT(CMYK, getEffectiveRenderingIntent(intent));
+    if (lut && color.size() == 4)
+    {
+        std::array<float, 4> cmykInputColor = { color[0], color[1], color[2], color[3] };
+        std::array<float, 3> rgbOutputColor = { };
+        lut->transform(cmykInputColor.data(), rgbOutputColor.data());
+        return getColorFromOutputColor(rgbOutputColor);
+    }
+
     cmsHTRANSFORM transform = getTransform(CMYK, getEffectiveRenderingIntent(intent), false);
 
     if (!transform)
@@ -626,8 +896,13 @@ QColor PDFLittleCMS::getColorFromXYZ(const PDFColor3& whitePoint, const PDFColor
     return QColor();
 }
 
-cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData, const QByteArray& iccID, RenderingIntent renderingIntent, bool isRGB888Buffer) const
+cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData, const QByteArray& iccID, RenderingIntent renderingIntent, bool isRGB888Buffer, const PDFColorTransformLUT** lut) const
 {
+    if (lut)
+    {
+        *lut = nullptr;
+    }
+
     RenderingIntent effectiveRenderingIntent = getEffectiveRenderingIntent(renderingIntent);
     const auto key = std::make_pair(iccID + (isRGB888Buffer ? "RGB_888" : "FLT"), effectiveRenderingIntent);
     QReadLocker lock(&m_customIccProfileCacheLock);
@@ -670,14 +945,38 @@ cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData
                 cmsCloseProfile(profile);
             }
 
-            it = m_customIccProfileCache.insert(std::make_pair(key, transform)).first;
+            CustomIccProfileCacheItem item;
+            item.transform = transform;
+
+            if (transform && !isRGB888Buffer && isTransformLUTAllowed())
+            {
+                const cmsUInt32Number format = cmsGetTransformInputFormat(transform);
+                const cmsUInt32Number colorSpace = T_COLORSPACE(format);
+                if (colorSpace == PT_RGB || colorSpace == PT_CMYK)
+                {
+                    const cmsUInt32Number channels = T_CHANNELS(format);
+                    item.lut = PDFColorTransformLUT::build(createTransformLUTSampler(transform, channels, colorSpace == PT_CMYK ? 100.0f : 1.0f), channels, PDFColorTransformLUT::getGridSize(m_settings.accuracy, channels));
+                }
+            }
+
+            it = m_customIccProfileCache.insert(std::make_pair(key, std::move(item))).first;
         }
 
-        return it->second;
+        if (lut)
+        {
+            *lut = it->second.lut.get();
+        }
+
+        return it->second.transform;
     }
     else
     {
-        return it->second;
+        if (lut)
+        {
+            *lut = it->second.lut.get();
+        }
+
+        return it->second.transform;
     }
 
     return cmsHTRANSFORM();
@@ -685,7 +984,21 @@ cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData
 
 QColor PDFLittleCMS::getColorFromICC(const PDFColor& color, RenderingIntent renderingIntent, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
 {
-    cmsHTRANSFORM transform = getTransformFromICCProfile(iccData, iccID, renderingIntent, false);
+    const PDFColorTransformLUT* lut = nullptr;
+    cmsHTRANSFORM transform = getTransformFromICCProfile(iccData, iccID, renderingIntent, false, &lut);
+
+    if (lut && lut->getChannels() == color.size())
+    {
+        std::array<float, 4> inputBuffer = { };
+        for (size_t i = 0; i < color.size(); ++i)
+        {
+            inputBuffer[i] = color[i];
+        }
+
+        std::array<float, 3> rgbOutputColor = { };
+        lut->transform(inputBuffer.data(), rgbOutputColor.data());
+        return getColorFromOutputColor(rgbOutputColor);
+    }
 
     if (!transform)
     {
@@ -719,6 +1032,11 @@ QColor PDFLittleCMS::getColorFromICC(const PDFColor& color, RenderingIntent rend
 
 void PDFLittleCMS::init()
 {
+    for (std::atomic<PDFColorTransformLUT*>& lut : m_transformLUTs)
+    {
+        lut.store(nullptr);
+    }
+
     // Jakub Melka: initialize all color profiles
     m_profiles[Output] = createProfile(m_settings.outputCS, m_manager->getOutputProfiles(), false);
     m_profiles[Gray] = createProfile(m_settings.deviceGray, m_manager->getGrayProfiles(), m_settings.isConsiderOutputIntent);
@@ -1031,6 +1349,61 @@ cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent
     return it->second;
 }
 
+bool PDFLittleCMS::isTransformLUTAllowed() const
+{
+    // Gamut checking marks out-of-gamut colors by alarm color, which
+    // can't be interpolated.
+    return !m_settings.isGamutChecking && PDFColorTransformLUT::getGridSize(m_settings.accuracy, 3) > 0;
+}
+
+const PDFColorTransformLUT* PDFLittleCMS::getTransformLUT(Profile profile, RenderingIntent intent) const
+{
+    if (!isTransformLUTAllowed())
+    {
+        return nullptr;
+    }
+
+    std::atomic<PDFColorTransformLUT*>& lutSlot = m_transformLUTs[int(intent) * ProfileCount + profile];
+    PDFColorTransformLUT* lut = lutSlot.load(std::memory_order_acquire);
+
+    if (!lut)
+    {
+        cmsHTRANSFORM transform = getTransform(profile, intent, false);
+        if (!transform)
+        {
+            return nullptr;
+        }
+
+        const cmsUInt32Number format = cmsGetTransformInputFormat(transform);
+        const cmsUInt32Number colorSpace = T_COLORSPACE(format);
+        if (colorSpace != PT_RGB && colorSpace != PT_CMYK)
+        {
+            return nullptr;
+        }
+
+        const cmsUInt32Number channels = T_CHANNELS(format);
+        std::unique_ptr<PDFColorTransformLUT> newLut = PDFColorTransformLUT::build(createTransformLUTSampler(transform, channels, colorSpace == PT_CMYK ? 100.0f : 1.0f), channels, PDFColorTransformLUT::getGridSize(m_settings.accuracy, channels));
+        if (!newLut)
+        {
+            return nullptr;
+        }
+
+        // Another thread may have built the LUT in the meantime, in this case,
+        // we use its LUT and our LUT is destroyed.
+        PDFColorTransformLUT* expected = nullptr;
+        if (lutSlot.compare_exchange_strong(expected, newLut.get(), std::memory_order_acq_rel))
+        {
+            lut = newLut.release();
+        }
+        else
+        {
+            lut = expected;
+        }
+    }
+
+    return lut;
+}
+
 cmsUInt32Number PDFLittleCMS::getTransformationFlags() const
 {
     // Flag cmsFLAGS_NONEGATIVES is used here to avoid invalid transformation
@@ -28,6 +28,8 @@
 #include <QSharedPointer>
 
 #include <compare>
+#include <memory>
+#include <functional>
 
 namespace pdf
 {
@@ -49,6 +51,9 @@ struct PDFCMSSettings
     /// Controls accuracy of the color transformations. High accuracy
     /// could mean high memory consumption, but better color accuracy,
     /// low accuracy means low memory consumption and low color accuracy.
+    /// For low accuracy, RGB and CMYK transformations are additionally
+    /// precomputed into interpolated lookup tables (33^3 RGB / 17^4 CMYK grid),
+    /// for medium and high accuracy, transformations of LittleCMS are used directly.
     enum class Accuracy
     {
         Low,
@@ -92,6 +97,58 @@ struct PDFCMSSettings
     double sigmoidSlopeFactor = 10.0;
 };
 
+/// Precomputed color transform from 3 or 4 channel input color space to RGB
+/// output color space. Transform is sampled on a regular grid, and colors are
+/// then computed by tetrahedral interpolation (4 channel input is interpolated
+/// linearly between two tetrahedral interpolations in the last channel).
+/// Object is immutable after it is built, so it can be used from multiple
+/// threads without locking.
+class PDF4QTLIBCORESHARED_EXPORT PDFColorTransformLUT
+{
+public:
+    /// Samples transform at given input colors. Input colors are in range [0, 1],
+    /// output colors are RGB colors in range [0, 1].
+    /// \param input Input colors (count * channels values)
+    /// \param output Output colors (count * 3 values)
+    /// \param count Color count
+    using Sampler = std::function<void(const float* input, float* output, size_t count)>;
+
+    /// Builds LUT by sampling the transform. Returns nullptr, if LUT can't be built.
+    /// \param sampler Sampler of the transform
+    /// \param channels Input channel count (3 or 4)
+    /// \param gridSize Number of grid points per input channel
+    static std::unique_ptr<PDFColorTransformLUT> build(const Sampler& sampler, uint32_t channels, int gridSize);
+
+    /// Returns grid size for given accuracy and input channel count,
+    /// or zero, if LUT should not be used (transformation is computed exactly).
+    static int getGridSize(PDFCMSSettings::Accuracy accuracy, uint32_t channels);
+
+    uint32_t getChannels() const { return m_channels; }
+
+    /// Transforms single color, input values are in range [0, 1]
+    void transform(const float* input, float* output) const;
+
+    /// Transforms buffer of colors to 8-bit RGB buffer
+    /// \param input Input colors (pixelCount * channels values in range [0, 1])
+    /// \param output Output buffer in format RGB_888
+    /// \param pixelCount Pixel count
+    void transform(const float* input, unsigned char* output, size_t pixelCount) const;
+
+private:
+    explicit PDFColorTransformLUT(uint32_t channels, int gridSize) :
+        m_channels(channels),
+        m_gridSize(gridSize)
+    {
+
+    }
+
+    void interpolateTetrahedral(const float* cube, float x, float y, float z, float* output) const;
+
+    uint32_t m_channels;
+    int m_gridSize;
+    std::vector<float> m_table;
+};
+
 /// Color management system base class. It contains functions to transform
 /// colors from various color system to device color system. If color management
 /// system can't handle color transform, it should return invalid color.
@@ -0,0 +1,228 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfcontentprocessorprofiler.h"
+#include "pdfdbgheap.h"
+
+#include <QJsonObject>
+
+#include <chrono>
+#include <algorithm>
+
+namespace pdf
+{
+
+PDFContentProcessorProfiler::PDFContentProcessorProfiler() :
+    m_operatorEventThreshold(100000)
+{
+    m_openEvents.reserve(32);
+}
+
+void PDFContentProcessorProfiler::beginEvent(Category category, QByteArray name)
+{
+    Event event;
+    event.category = category;
+    event.name = std::move(name);
+    event.depth = int(m_openEvents.size());
+    event.start = getCurrentTime();
+    m_openEvents.emplace_back(std::move(event));
+}
+
+void PDFContentProcessorProfiler::endEvent()
+{
+    Q_ASSERT(!m_openEvents.empty());
+
+    Event event = std::move(m_openEvents.back());
+    m_openEvents.pop_back();
+    event.duration = getCurrentTime() - event.start;
+
+    if (event.category == Category::Operator)
+    {
+        OperatorStatistics& statistics = m_operatorStatistics[event.name];
+        ++statistics.count;
+        statistics.time += event.duration;
+
+        if (event.duration < m_operatorEventThreshold)
+        {
+            // Jakub Melka: content streams can contain millions of operators,
+            // we store only the slow ones, otherwise the trace would be huge.
+            return;
+        }
+    }
+
+    m_events.emplace_back(std::move(event));
+}
+
+void PDFContentProcessorProfiler::addEvent(Category category, QByteArray name, qint64 start)
+{
+    Event event;
+    event.category = category;
+    event.name = std::move(name);
+    event.depth = int(m_openEvents.size());
+    event.start = start;
+    event.duration = getCurrentTime() - start;
+    m_events.emplace_back(std::move(event));
+}
+
+void PDFContentProcessorProfiler::addCacheAccess(Cache cache, bool hit)
+{
+    CacheStatistics& statistics = m_cacheStatistics[size_t(cache)];
+    if (hit)
+    {
+        ++statistics.hits;
+    }
+    else
+    {
+        ++statistics.misses;
+    }
+}
+
+QList<PDFRenderError> PDFContentProcessorProfiler::getSummary(int maxItems) const
+{
+    QList<PDFRenderError> summary;
+
+    auto toMilliseconds = [](qint64 time) { return QString::number(PDFReal(time) / 1000000.0, 'f', 3); };
+
+    qint64 operatorCount = 0;
+    qint64 operatorTime = 0;
+    std::vector<std::pair<QByteArray, OperatorStatistics>> operators(m_operatorStatistics.cbegin(), m_operatorStatistics.cend());
+    for (const auto& item : operators)
+    {
+        operatorCount += item.second.count;
+
+        // Nested operators (in forms, patterns...) are counted in outer operators too
+        // so we sum only time of operators, which doesn't invoke other content.
+        if (item.first != "Do" && item.first != "sh")
+        {
+            operatorTime += item.second.time;
+        }
+    }
+
+    summary.append(PDFRenderError(RenderErrorType::Information, PDFTranslationContext::tr("Profiling: %1 operators processed, %2 ms spent in operators (without nested content).").arg(operatorCount).arg(toMilliseconds(operatorTime))));
+
+    std::sort(operators.begin(), operators.end(), [](const auto& l, const auto& r) { return l.second.time > r.second.time; });
+    for (int i = 0; i < std::min(maxItems, int(operators.size())); ++i)
+    {
+        const auto& item = operators[i];
+        summary.append(PDFRenderError(RenderErrorType::Information, PDFTranslationContext::tr("Profiling: operator '%1' - %2 calls, %3 ms.").arg(QString::fromLatin1(item.first)).arg(item.second.count).arg(toMilliseconds(item.second.time))));
+    }
+
+    std::vector<const Event*> events;
+    for (const Event& event : m_events)
+    {
+        if (event.category != Category::Operator && event.category != Category::Page && event.category != Category::ContentStream)
+        {
+            events.push_back(&event);
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event* l, const Event* r) { return l->duration > r->duration; });
+    for (int i = 0; i < std::min(maxItems, int(events.size())); ++i)
+    {
+        const Event* event = events[i];
+        summary.append(PDFRenderError(RenderErrorType::Information, PDFTranslationContext::tr("Profiling: %1 '%2' - %3 ms.").arg(QString::fromLatin1(getCategoryName(event->category)), QString::fromLatin1(event->name), toMilliseconds(event->duration))));
+    }
+
+    const CacheStatistics& fontCache = getCacheStatistics(Cache::Font);
+    const CacheStatistics& realizedFontCache = getCacheStatistics(Cache::RealizedFont);
+    summary.append(PDFRenderError(RenderErrorType::Information, PDFTranslationContext::tr("Profiling: font cache - %1 hits, %2 misses, realized font cache - %3 hits, %4 misses.").arg(fontCache.hits).arg(fontCache.misses).arg(realizedFontCache.hits).arg(realizedFontCache.misses)));
+
+    return summary;
+}
+
+void PDFContentProcessorProfiler::writeChromeTraceEvents(QJsonArray& traceEvents, qint64 threadId, const QString& threadName, qint64 timeOrigin) const
+{
+    QJsonObject threadNameEvent;
+    threadNameEvent["name"] = "thread_name";
+    threadNameEvent["ph"] = "M";
+    threadNameEvent["pid"] = 1;
+    threadNameEvent["tid"] = threadId;
+    threadNameEvent["args"] = QJsonObject{ { "name", threadName } };
+    traceEvents.append(threadNameEvent);
+
+    for (const Event& event : m_events)
+    {
+        // Complete event, times are in microseconds
+        QJsonObject traceEvent;
+        traceEvent["name"] = QString::fromLatin1(event.name);
+        traceEvent["cat"] = getCategoryName(event.category);
+        traceEvent["ph"] = "X";
+        traceEvent["pid"] = 1;
+        traceEvent["tid"] = threadId;
+        traceEvent["ts"] = PDFReal(event.start - timeOrigin) / 1000.0;
+        traceEvent["dur"] = PDFReal(event.duration) / 1000.0;
+
+        if (event.category == Category::Page)
+        {
+            // Attach operator and cache statistics to the page event
+            QJsonObject operators;
+            for (const auto& item : m_operatorStatistics)
+            {
+                operators[QString::fromLatin1(item.first)] = QJsonObject{ { "count", item.second.count }, { "time", PDFReal(item.second.time) / 1000.0 } };
+            }
+
+            const CacheStatistics& fontCache = getCacheStatistics(Cache::Font);
+            const CacheStatistics& realizedFontCache = getCacheStatistics(Cache::RealizedFont);
+
+            QJsonObject args;
+            args["operators"] = operators;
+            args["fontCache"] = QJsonObject{ { "hits", fontCache.hits }, { "misses", fontCache.misses } };
+            args["realizedFontCache"] = QJsonObject{ { "hits", realizedFontCache.hits }, { "misses", realizedFontCache.misses } };
+            traceEvent["args"] = args;
+        }
+
+        traceEvents.append(traceEvent);
+    }
+}
+
+qint64 PDFContentProcessorProfiler::getCurrentTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* PDFContentProcessorProfiler::getCategoryName(Category category)
+{
+    switch (category)
+    {
+        case Category::Page:
+            return "page";
+        case Category::ContentStream:
+            return "content-stream";
+        case Category::Operator:
+            return "operator";
+        case Category::Form:
+            return "form";
+        case Category::TransparencyGroup:
+            return "transparency-group";
+        case Category::Image:
+            return "image";
+        case Category::Pattern:
+            return "pattern";
+        case Category::Shading:
+            return "shading";
+        case Category::Font:
+            return "font";
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return "";
+}
+
+}   // namespace pdf
@@ -0,0 +1,178 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFCONTENTPROCESSORPROFILER_H
+#define PDFCONTENTPROCESSORPROFILER_H
+
+#include "pdfglobal.h"
+#include "pdfexception.h"
+
+#include <QByteArray>
+#include <QJsonArray>
+
+#include <map>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace pdf
+{
+
+/// Profiler of the content stream processing. It measures cumulative time and
+/// call count of each operator, and time spent in content streams, forms,
+/// transparency groups, images, patterns and shadings (events are nested, so
+/// they form a hierarchy). Also, font cache hits and misses are counted.
+/// Profiler is not thread safe, each content processor must have its own profiler.
+/// Results can be exported as a summary (list of information messages)
+/// or as events in Chrome trace event format.
+class PDF4QTLIBCORESHARED_EXPORT PDFContentProcessorProfiler
+{
+public:
+    explicit PDFContentProcessorProfiler();
+
+    enum class Category
+    {
+        Page,
+        ContentStream,
+        Operator,
+        Form,
+        TransparencyGroup,
+        Image,
+        Pattern,
+        Shading,
+        Font,
+        LastCategory
+    };
+
+    enum class Cache
+    {
+        Font,
+        RealizedFont,
+        LastCache
+    };
+
+    struct Event
+    {
+        Category category = Category::Operator;
+        QByteArray name;
+        qint64 start = 0;       ///< Start time in nanoseconds (monotonic clock)
+        qint64 duration = 0;    ///< Duration in nanoseconds
+        int depth = 0;          ///< Nesting level of the event
+    };
+
+    struct OperatorStatistics
+    {
+        qint64 count = 0;
+        qint64 time = 0;        ///< Cumulative time in nanoseconds (including nested events)
+    };
+
+    struct CacheStatistics
+    {
+        qint64 hits = 0;
+        qint64 misses = 0;
+    };
+
+    /// Guard, which measures event for the lifetime of the guard object.
+    /// Profiler can be nullptr, then nothing is measured.
+    class Scope
+    {
+    public:
+        inline explicit Scope(PDFContentProcessorProfiler* profiler, Category category, QByteArray name) :
+            m_profiler(profiler)
+        {
+            if (m_profiler)
+            {
+                m_profiler->beginEvent(category, std::move(name));
+            }
+        }
+
+        inline ~Scope()
+        {
+            if (m_profiler)
+            {
+                m_profiler->endEvent();
+            }
+        }
+
+    private:
+        PDFContentProcessorProfiler* m_profiler;
+    };
+
+    /// Starts a new event. Each call must be accompanied
+    /// with matching call of \p endEvent function.
+    /// \param category Category
+    /// \param name Name of the event (operator name, resource name...)
+    void beginEvent(Category category, QByteArray name);
+
+    /// Ends current event. Operator events are accumulated into operator
+    /// statistics and stored as events only, if they are slower than the threshold.
+    void endEvent();
+
+    /// Adds finished event, which has started at \p start and ends now.
+    /// It can be used, when it is known after the operation, whether
+    /// it should be recorded (for example, on cache miss).
+    /// \param category Category
+    /// \param name Name of the event
+    /// \param start Start time (see \p getCurrentTime)
+    void addEvent(Category category, QByteArray name, qint64 start);
+
+    /// Counts access into the cache
+    /// \param cache Cache
+    /// \param hit Was item found in the cache?
+    void addCacheAccess(Cache cache, bool hit);
+
+    /// Sets threshold, above which operators are stored as events
+    /// \param threshold Threshold in nanoseconds
+    void setOperatorEventThreshold(qint64 threshold) { m_operatorEventThreshold = threshold; }
+
+    const std::vector<Event>& getEvents() const { return m_events; }
+    const std::map<QByteArray, OperatorStatistics>& getOperatorStatistics() const { return m_operatorStatistics; }
+    const CacheStatistics& getCacheStatistics(Cache cache) const { return m_cacheStatistics[size_t(cache)]; }
+
+    /// Returns summary of the profile as list of information messages
+    /// (slowest operators and events, cache statistics).
+    /// \param maxItems Maximal number of reported operators and events
+    QList<PDFRenderError> getSummary(int maxItems) const;
+
+    /// Appends events in Chrome trace event format to the \p traceEvents. Thread is
+    /// named by \p threadName (for example, page number). Times are relative
+    /// to \p timeOrigin (in nanoseconds, see \p getCurrentTime).
+    /// \param traceEvents Trace event array
+    /// \param threadId Thread id
+    /// \param threadName Thread name
+    /// \param timeOrigin Time origin
+    void writeChromeTraceEvents(QJsonArray& traceEvents, qint64 threadId, const QString& threadName, qint64 timeOrigin) const;
+
+    /// Returns current time of the clock used by profiler in nanoseconds
+    static qint64 getCurrentTime();
+
+    /// Returns name of the category
+    static const char* getCategoryName(Category category);
+
+private:
+    std::vector<Event> m_events;
+    std::vector<Event> m_openEvents;
+    std::map<QByteArray, OperatorStatistics> m_operatorStatistics;
+    std::array<CacheStatistics, size_t(Cache::LastCache)> m_cacheStatistics = { };
+    qint64 m_operatorEventThreshold;
+};
+
+using PDFContentProcessorProfilerPointer = std::shared_ptr<const PDFContentProcessorProfiler>;
+
+}   // namespace pdf
+
+#endif // PDFCONTENTPROCESSORPROFILER_H
@@ -24,10 +24,13 @@
 #include "pdfconstants.h"
 #include "pdfalgorithmlcs.h"
 #include "pdfpainter.h"
+#include "pdftextlayout.h"
 #include "pdfdbgheap.h"
 
 #include <QtConcurrent/QtConcurrent>
 
+#include <optional>
+
 namespace pdf
 {
 
@@ -71,6 +74,38 @@ public:
                                                                 bool isWordsComparingMode,
                                                                 bool isLeft);
     static void refineTextRectangles(PDFDiffResult::RectInfos& items);
+
+    using Fingerprint = std::array<uint8_t, 64>;
+
+    /// Cache of hashes of referenced objects. Fonts, images and forms
+    /// are often shared between pages, so they are hashed only once.
+    struct ObjectHashCache
+    {
+        QMutex mutex;
+        std::map<PDFObjectReference, QByteArray> hashes;
+    };
+
+    /// Calculates fingerprint of the page from its content streams, resources,
+    /// page boxes and rotation. Fingerprint doesn't depend on rendering, pages
+    /// with the same fingerprint have the same content.
+    /// \param document Document
+    /// \param page Page
+    /// \param cache Cache of referenced objects hashes
+    static Fingerprint calculatePageFingerprint(const PDFDocument* document, const PDFPage* page, ObjectHashCache& cache);
+
+    /// Adds object to the hash. Referenced objects are hashed recursively.
+    /// Returns false, if reference cycle was cut off during hashing
+    /// (such hash is not stored in the cache).
+    /// \param hasher Hasher
+    /// \param document Document
+    /// \param object Object
+    /// \param cache Cache of referenced objects hashes
+    /// \param activeReferences References being currently hashed
+    static bool addObjectToHash(QCryptographicHash& hasher,
+                                const PDFDocument* document,
+                                const PDFObject& object,
+                                ObjectHashCache& cache,
+                                std::set<PDFObjectReference>& activeReferences);
 };
 
 PDFDiff::PDFDiff(QObject* parent) :
@@ -219,7 +254,11 @@ struct PDFDiffPageContext
 {
     PDFInteger pageIndex = 0;
     std::array<uint8_t, 64> pageHash = { };
+    std::array<uint8_t, 64> fingerprint = { };  ///< Hash of page content streams and resources
+    bool hasFingerprintMatch = false;           ///< Page with the same fingerprint exists in the other document
+    bool isContentExtracted = false;            ///< Graphic pieces of the page were extracted
     PDFPrecompiledPage::GraphicPieceInfos graphicPieces;
+    PDFTextLayout textLayout;                   ///< Text layout created together with graphic pieces (layout text algorithm only)
     PDFDocumentTextFlow text;
 };
 
@@ -276,6 +315,18 @@ void PDFDiff::performPageMatching(const std::vector<PDFDiffPageContext>& leftPre
         for (const size_t rightIndex : rightUnmatched)
         {
             const PDFDiffPageContext& rightPageContext = rightPreparedPages[rightIndex];
+            if (leftPageContext.hasFingerprintMatch || rightPageContext.hasFingerprintMatch)
+            {
+                // Content of the page was not extracted, because page has the
+                // same fingerprint as some page in the other document. Such page
+                // can be matched only by fingerprint.
+                if (leftPageContext.fingerprint == rightPageContext.fingerprint)
+                {
+                    matchedPages[leftIndex].push_back(rightIndex);
+                }
+                continue;
+            }
+
             if (leftPageContext.graphicPieces.size() != rightPageContext.graphicPieces.size())
             {
                 // Match cannot exist, graphic pieces have different size
@@ -347,105 +398,142 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
     std::transform(leftPages.cbegin(), leftPages.cend(), std::back_inserter(leftPreparedPages), createDiffPageContext);
     std::transform(rightPages.cbegin(), rightPages.cend(), std::back_inserter(rightPreparedPages), createDiffPageContext);
 
-    // StepExtractContentLeftDocument
+    // StepCalculateFingerprints
     if (!m_cancelled)
     {
-        PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-        PDFOptionalContentActivity optionalContentActivity(m_leftDocument, pdf::OCUsage::View, nullptr);
-        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(m_leftDocument), &optionalContentActivity));
+        // Jakub Melka: pages with the same fingerprint in both documents have the same
+        // content, so we do not need to extract their content (unless they are
+        // compared to some different page, which is resolved after page matching).
+        calculateFingerprints(m_leftDocument, leftPreparedPages);
+        calculateFingerprints(m_rightDocument, rightPreparedPages);
 
-        PDFCMSManager cmsManager(nullptr);
-        cmsManager.setDocument(m_leftDocument);
-        PDFCMSPointer cms = cmsManager.getCurrentCMS();
+        std::set<std::array<uint8_t, 64>> leftFingerprints;
+        std::set<std::array<uint8_t, 64>> rightFingerprints;
 
-        auto fillPageContext = [&, this](PDFDiffPageContext& context)
+        for (const PDFDiffPageContext& context : leftPreparedPages)
         {
-            PDFPrecompiledPage compiledPage;
-            constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
-            PDFRenderer renderer(m_leftDocument, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
-            renderer.compile(&compiledPage, context.pageIndex);
+            leftFingerprints.insert(context.fingerprint);
+        }
 
-            auto page = m_leftDocument->getCatalog()->getPage(context.pageIndex);
-            PDFReal epsilon = calculateEpsilonForPage(page);
-            context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
+        for (const PDFDiffPageContext& context : rightPreparedPages)
+        {
+            rightFingerprints.insert(context.fingerprint);
+        }
 
-            finalizeGraphicsPieces(context);
+        auto markFingerprintMatch = [](PDFDiffPageContext& context, const std::set<std::array<uint8_t, 64>>& otherFingerprints)
+        {
+            context.hasFingerprintMatch = otherFingerprints.count(context.fingerprint);
+            if (context.hasFingerprintMatch)
+            {
+                context.pageHash = context.fingerprint;
+            }
         };
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, leftPreparedPages.begin(), leftPreparedPages.end(), fillPageContext);
-        stepProgress();
-    }
-
-    // StepExtractContentRightDocument
-    if (!m_cancelled)
-    {
-        PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-        PDFOptionalContentActivity optionalContentActivity(m_rightDocument, pdf::OCUsage::View, nullptr);
-        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(m_rightDocument), &optionalContentActivity));
 
-        PDFCMSManager cmsManager(nullptr);
-        cmsManager.setDocument(m_rightDocument);
-        PDFCMSPointer cms = cmsManager.getCurrentCMS();
+        for (PDFDiffPageContext& context : leftPreparedPages)
+        {
+            markFingerprintMatch(context, rightFingerprints);
+        }
 
-        auto fillPageContext = [&, this](PDFDiffPageContext& context)
+        for (PDFDiffPageContext& context : rightPreparedPages)
         {
-            PDFPrecompiledPage compiledPage;
-            constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
-            PDFRenderer renderer(m_rightDocument, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
-            renderer.compile(&compiledPage, context.pageIndex);
+            markFingerprintMatch(context, leftFingerprints);
+        }
 
-            const PDFPage* page = m_rightDocument->getCatalog()->getPage(context.pageIndex);
-            PDFReal epsilon = calculateEpsilonForPage(page);
-            context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
+        stepProgress();
+    }
 
-            finalizeGraphicsPieces(context);
-        };
+    auto getPagesWithoutFingerprintMatch = [](std::vector<PDFDiffPageContext>& preparedPages)
+    {
+        std::vector<PDFDiffPageContext*> result;
+        for (PDFDiffPageContext& context : preparedPages)
+        {
+            if (!context.hasFingerprintMatch)
+            {
+                result.push_back(&context);
+            }
+        }
+        return result;
+    };
 
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, rightPreparedPages.begin(), rightPreparedPages.end(), fillPageContext);
+    // StepExtractContentLeftDocument
+    if (!m_cancelled)
+    {
+        performExtractContent(m_leftDocument, getPagesWithoutFingerprintMatch(leftPreparedPages));
         stepProgress();
     }
 
-    // StepMatchPages
+    // StepExtractContentRightDocument
     if (!m_cancelled)
     {
-        performPageMatching(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches);
+        performExtractContent(m_rightDocument, getPagesWithoutFingerprintMatch(rightPreparedPages));
         stepProgress();
     }
 
-    // StepExtractTextLeftDocument
+    // Pages, which are replaced by other pages. Only for these pages,
+    // text is compared, so we extract text only for these pages.
+    std::vector<PDFInteger> leftReplacedPages;
+    std::vector<PDFInteger> rightReplacedPages;
+
+    // StepMatchPages
     if (!m_cancelled)
     {
-        pdf::PDFDocumentTextFlowFactory factoryLeftDocumentTextFlow;
-        factoryLeftDocumentTextFlow.setCalculateBoundingBoxes(true);
-        PDFDocumentTextFlow leftTextFlow = factoryLeftDocumentTextFlow.create(m_leftDocument, leftPages, m_textAnalysisAlgorithm);
-        std::map<PDFInteger, PDFDocumentTextFlow> splittedText = leftTextFlow.split(PDFDocumentTextFlow::Text);
-        for (PDFDiffPageContext& leftContext : leftPreparedPages)
+        performPageMatching(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches);
+
+        // Replaced pages are compared using their content, so we must extract
+        // content of replaced pages, which were skipped due to fingerprint match.
+        std::vector<PDFDiffPageContext*> leftPagesToExtract;
+        std::vector<PDFDiffPageContext*> rightPagesToExtract;
+
+        for (const PDFDiffHelper::PageSequence::value_type& item : pageSequence)
         {
-            auto it = splittedText.find(leftContext.pageIndex);
-            if (it != splittedText.cend())
+            if (!item.isReplaced())
             {
-                leftContext.text = std::move(it->second);
-                splittedText.erase(it);
+                continue;
+            }
+
+            if (item.isLeftValid())
+            {
+                PDFDiffPageContext& context = leftPreparedPages[item.index1];
+                leftReplacedPages.push_back(context.pageIndex);
+
+                if (!context.isContentExtracted)
+                {
+                    leftPagesToExtract.push_back(&context);
+                }
+            }
+
+            if (item.isRightValid())
+            {
+                PDFDiffPageContext& context = rightPreparedPages[item.index2];
+                rightReplacedPages.push_back(context.pageIndex);
+
+                if (!context.isContentExtracted)
+                {
+                    rightPagesToExtract.push_back(&context);
+                }
             }
         }
+
+        performExtractContent(m_leftDocument, leftPagesToExtract);
+        performExtractContent(m_rightDocument, rightPagesToExtract);
+
+        std::sort(leftReplacedPages.begin(), leftReplacedPages.end());
+        std::sort(rightReplacedPages.begin(), rightReplacedPages.end());
+
+        stepProgress();
+    }
+
+    // StepExtractTextLeftDocument
+    if (!m_cancelled)
+    {
+        performExtractText(m_leftDocument, leftReplacedPages, leftPreparedPages);
         stepProgress();
     }
 
     // StepExtractTextRightDocument
     if (!m_cancelled)
     {
-        pdf::PDFDocumentTextFlowFactory factoryRightDocumentTextFlow;
-        factoryRightDocumentTextFlow.setCalculateBoundingBoxes(true);
-        PDFDocumentTextFlow rightTextFlow = factoryRightDocumentTextFlow.create(m_rightDocument, rightPages, m_textAnalysisAlgorithm);
-        std::map<PDFInteger, PDFDocumentTextFlow> splittedText = rightTextFlow.split(PDFDocumentTextFlow::Text);
-        for (PDFDiffPageContext& rightContext : rightPreparedPages)
-        {
-            auto it = splittedText.find(rightContext.pageIndex);
-            if (it != splittedText.cend())
-            {
-                rightContext.text = std::move(it->second);
-                splittedText.erase(it);
-            }
-        }
+        performExtractText(m_rightDocument, rightReplacedPages, rightPreparedPages);
         stepProgress();
     }
 
@@ -455,6 +543,108 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
         performCompare(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches, result);
         stepProgress();
     }
+
+    auto isContentExtracted = [](const PDFDiffPageContext& context) { return context.isContentExtracted; };
+    result.m_extractedPageCount = std::count_if(leftPreparedPages.cbegin(), leftPreparedPages.cend(), isContentExtracted) +
+                                  std::count_if(rightPreparedPages.cbegin(), rightPreparedPages.cend(), isContentExtracted);
+}
+
+void PDFDiff::calculateFingerprints(const PDFDocument* document, std::vector<PDFDiffPageContext>& preparedPages)
+{
+    PDFDiffHelper::ObjectHashCache cache;
+
+    auto calculateFingerprint = [&](PDFDiffPageContext& context)
+    {
+        const PDFPage* page = document->getCatalog()->getPage(context.pageIndex);
+        context.fingerprint = PDFDiffHelper::calculatePageFingerprint(document, page, cache);
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, preparedPages.begin(), preparedPages.end(), calculateFingerprint);
+}
+
+void PDFDiff::performExtractContent(const PDFDocument* document, const std::vector<PDFDiffPageContext*>& contexts)
+{
+    if (contexts.empty())
+    {
+        return;
+    }
+
+    PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    PDFOptionalContentActivity optionalContentActivity(document, pdf::OCUsage::View, nullptr);
+    fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(document), &optionalContentActivity));
+
+    PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(document);
+    PDFCMSPointer cms = cmsManager.getCurrentCMS();
+
+    // Jakub Melka: layout text algorithm needs text layouts of the pages, so we create
+    // them in the same pass over the content streams, in which the page is compiled.
+    const bool isTextLayoutNeeded = m_textAnalysisAlgorithm == PDFDocumentTextFlowFactory::Algorithm::Layout;
+
+    auto fillPageContext = [&, this](PDFDiffPageContext* context)
+    {
+        PDFPrecompiledPage compiledPage;
+        constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
+        PDFRenderer renderer(document, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
+        renderer.compile(&compiledPage, context->pageIndex, isTextLayoutNeeded ? &context->textLayout : nullptr);
+
+        const PDFPage* page = document->getCatalog()->getPage(context->pageIndex);
+        PDFReal epsilon = calculateEpsilonForPage(page);
+        context->graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
+        context->isContentExtracted = true;
+
+        finalizeGraphicsPieces(*context);
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, contexts.begin(), contexts.end(), fillPageContext);
+}
+
+void PDFDiff::performExtractText(const PDFDocument* document,
+                                 const std::vector<PDFInteger>& pages,
+                                 std::vector<PDFDiffPageContext>& preparedPages)
+{
+    if (pages.empty())
+    {
+        return;
+    }
+
+    pdf::PDFDocumentTextFlowFactory factoryDocumentTextFlow;
+    factoryDocumentTextFlow.setCalculateBoundingBoxes(true);
+
+    // Text layouts of the replaced pages were created during content extraction,
+    // they are used, if they are available for all pages (pages are sorted).
+    std::optional<PDFTextLayoutStorage> textLayoutStorage;
+    if (m_textAnalysisAlgorithm == PDFDocumentTextFlowFactory::Algorithm::Layout)
+    {
+        textLayoutStorage.emplace(document->getCatalog()->getPageCount());
+        size_t textLayoutCount = 0;
+        for (PDFDiffPageContext& context : preparedPages)
+        {
+            if (context.isContentExtracted && std::binary_search(pages.cbegin(), pages.cend(), context.pageIndex))
+            {
+                textLayoutStorage->setTextLayout(context.pageIndex, context.textLayout, nullptr);
+                context.textLayout = PDFTextLayout();
+                ++textLayoutCount;
+            }
+        }
+
+        if (textLayoutCount == pages.size())
+        {
+            factoryDocumentTextFlow.setTextLayoutStorage(&*textLayoutStorage, PDFRenderer::IgnoreOptionalContent);
+        }
+    }
+
+    PDFDocumentTextFlow textFlow = factoryDocumentTextFlow.create(document, pages, m_textAnalysisAlgorithm);
+    std::map<PDFInteger, PDFDocumentTextFlow> splittedText = textFlow.split(PDFDocumentTextFlow::Text);
+    for (PDFDiffPageContext& context : preparedPages)
+    {
+        auto it = splittedText.find(context.pageIndex);
+        if (it != splittedText.cend())
+        {
+            context.text = std::move(it->second);
+            splittedText.erase(it);
+        }
+    }
 }
 
 void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPreparedPages,
@@ -1539,6 +1729,164 @@ void PDFDiffResult::saveToXML(QString* string) const
     saveToStream(&stream);
 }
 
+PDFDiffHelper::Fingerprint PDFDiffHelper::calculatePageFingerprint(const PDFDocument* document, const PDFPage* page, ObjectHashCache& cache)
+{
+    QCryptographicHash hasher(QCryptographicHash::Sha512);
+    std::set<PDFObjectReference> activeReferences;
+
+    auto addRect = [&hasher](const QRectF& rect)
+    {
+        const PDFReal values[] = { rect.left(), rect.top(), rect.width(), rect.height() };
+        hasher.addData(QByteArrayView(reinterpret_cast<const char*>(values), sizeof(values)));
+    };
+
+    addRect(page->getMediaBox());
+    addRect(page->getCropBox());
+
+    const int rotation = static_cast<int>(page->getPageRotation());
+    hasher.addData(QByteArrayView(reinterpret_cast<const char*>(&rotation), sizeof(rotation)));
+
+    addObjectToHash(hasher, document, page->getContents(), cache, activeReferences);
+    addObjectToHash(hasher, document, page->getResources(), cache, activeReferences);
+    addObjectToHash(hasher, document, page->getTransparencyGroup(&document->getStorage()), cache, activeReferences);
+
+    QByteArray hash = hasher.result();
+    Q_ASSERT(QCryptographicHash::hashLength(QCryptographicHash::Sha512) == 64);
+
+    Fingerprint fingerprint = { };
+    const size_t size = qMin<size_t>(hash.length(), fingerprint.size());
+    std::copy(hash.data(), hash.data() + size, fingerprint.data());
+    return fingerprint;
+}
+
+bool PDFDiffHelper::addObjectToHash(QCryptographicHash& hasher,
+                                    const PDFDocument* document,
+                                    const PDFObject& object,
+                                    ObjectHashCache& cache,
+                                    std::set<PDFObjectReference>& activeReferences)
+{
+    auto addType = [&hasher](PDFObject::Type type)
+    {
+        const char typeChar = static_cast<char>(type);
+        hasher.addData(QByteArrayView(&typeChar, 1));
+    };
+
+    auto addValue = [&hasher](const auto& value)
+    {
+        hasher.addData(QByteArrayView(reinterpret_cast<const char*>(&value), sizeof(value)));
+    };
+
+    auto addByteArray = [&hasher, &addValue](const QByteArray& byteArray)
+    {
+        addValue(byteArray.size());
+        hasher.addData(byteArray);
+    };
+
+    addType(object.getType());
+
+    switch (object.getType())
+    {
+        case PDFObject::Type::Null:
+            return true;
+
+        case PDFObject::Type::Bool:
+            addValue(object.getBool());
+            return true;
+
+        case PDFObject::Type::Int:
+            addValue(object.getInteger());
+            return true;
+
+        case PDFObject::Type::Real:
+            addValue(object.getReal());
+            return true;
+
+        case PDFObject::Type::String:
+        case PDFObject::Type::Name:
+            addByteArray(object.getString());
+            return true;
+
+        case PDFObject::Type::Array:
+        {
+            bool isComplete = true;
+            const PDFArray* array = object.getArray();
+            addValue(array->getCount());
+            for (size_t i = 0; i < array->getCount(); ++i)
+            {
+                isComplete = addObjectToHash(hasher, document, array->getItem(i), cache, activeReferences) && isComplete;
+            }
+            return isComplete;
+        }
+
+        case PDFObject::Type::Dictionary:
+        case PDFObject::Type::Stream:
+        {
+            bool isComplete = true;
+            const PDFDictionary* dictionary = object.isStream() ? object.getStream()->getDictionary() : object.getDictionary();
+            addValue(dictionary->getCount());
+            for (size_t i = 0; i < dictionary->getCount(); ++i)
+            {
+                addByteArray(dictionary->getKey(i).getString());
+                isComplete = addObjectToHash(hasher, document, dictionary->getValue(i), cache, activeReferences) && isComplete;
+            }
+
+            if (object.isStream())
+            {
+                // Stream dictionary contains filters, so undecoded data
+                // identify decoded data as well.
+                addByteArray(*object.getStream()->getContent());
+            }
+            return isComplete;
+        }
+
+        case PDFObject::Type::Reference:
+        {
+            // Referenced object is hashed separately, and its hash
+            // is added to the hash, so we can cache it.
+            const PDFObjectReference reference = object.getReference();
+
+            {
+                QMutexLocker lock(&cache.mutex);
+                auto it = cache.hashes.find(reference);
+                if (it != cache.hashes.cend())
+                {
+                    hasher.addData(it->second);
+                    return true;
+                }
+            }
+
+            if (activeReferences.count(reference))
+            {
+                // Reference cycle, hash of the referenced object is being computed
+                // and it contains the content of the object.
+                return false;
+            }
+
+            activeReferences.insert(reference);
+            QCryptographicHash referencedObjectHasher(QCryptographicHash::Sha512);
+            const bool isComplete = addObjectToHash(referencedObjectHasher, document, document->getObjectByReference(reference), cache, activeReferences);
+            activeReferences.erase(reference);
+
+            QByteArray referencedObjectHash = referencedObjectHasher.result();
+            hasher.addData(referencedObjectHash);
+
+            if (isComplete)
+            {
+                QMutexLocker lock(&cache.mutex);
+                cache.hashes[reference] = std::move(referencedObjectHash);
+            }
+
+            return isComplete;
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return true;
+}
+
 PDFDiffHelper::Differences PDFDiffHelper::calculateDifferences(const GraphicPieceInfos& left,
                                                                const GraphicPieceInfos& right,
                                                                PDFReal epsilon)
@@ -146,6 +146,11 @@ public:
     const PageSequence& getPageSequence() const;
     void setPageSequence(PageSequence pageSequence);
 
+    /// Returns number of pages (of both documents), whose content was extracted.
+    /// Pages having the same fingerprint as some page of the other document
+    /// are matched without content extraction.
+    size_t getExtractedPageCount() const { return m_extractedPageCount; }
+
     /// Saves all differences to a XML stream
     /// represented by device
     /// \param device Output device
@@ -233,6 +238,7 @@ private:
     QStringList m_strings;
     uint32_t m_typeFlags = 0;
     PageSequence m_pageSequence;
+    size_t m_extractedPageCount = 0;
 };
 
 /// Class for result navigation, can go to next, or previous result.
@@ -355,6 +361,7 @@ private:
 
     enum Steps
     {
+        StepCalculateFingerprints,
         StepExtractContentLeftDocument,
         StepExtractContentRightDocument,
         StepMatchPages,
@@ -380,6 +387,24 @@ private:
                         PDFDiffResult& result);
     void finalizeGraphicsPieces(PDFDiffPageContext& context);
 
+    /// Calculates fingerprints of the pages (hash of content streams and resources)
+    /// \param document Document
+    /// \param preparedPages Page contexts
+    void calculateFingerprints(const PDFDocument* document, std::vector<PDFDiffPageContext>& preparedPages);
+
+    /// Extracts graphic pieces of given pages and calculates page hashes
+    /// \param document Document
+    /// \param contexts Page contexts
+    void performExtractContent(const PDFDocument* document, const std::vector<PDFDiffPageContext*>& contexts);
+
+    /// Extracts text of given pages
+    /// \param document Document
+    /// \param pages Page indices
+    /// \param preparedPages Page contexts
+    void performExtractText(const PDFDocument* document,
+                            const std::vector<PDFInteger>& pages,
+                            std::vector<PDFDiffPageContext>& preparedPages);
+
     void onComparationPerformed();
 
     /// Calculates real epsilon for a page. Epsilon is used in page
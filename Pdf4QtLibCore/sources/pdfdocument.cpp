@@ -21,6 +21,7 @@
 #include "pdfexception.h"
 #include "pdfstreamfilters.h"
 #include "pdfconstants.h"
+#include "pdfobjectutils.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -144,21 +145,107 @@ const PDFObject& PDFObjectStorage::getObject(PDFObjectReference reference) const
     }
 }
 
+void PDFObjectStorage::setObjects(PDFObjects&& objects)
+{
+    m_objects = qMove(objects);
+    m_referenceGraphCache = std::make_shared<ReferenceGraphCache>();
+}
+
 PDFObjectReference PDFObjectStorage::addObject(PDFObject object)
 {
     PDFObjectReference reference(m_objects.size(), 0);
+
+    if (PDFObjectReferenceGraph* referenceGraph = getReferenceGraphForUpdate())
+    {
+        referenceGraph->updateObject(reference, object);
+    }
+
     m_objects.emplace_back(0, qMove(object));
     return reference;
 }
 
 void PDFObjectStorage::setObject(PDFObjectReference reference, PDFObject object)
 {
+    if (PDFObjectReferenceGraph* referenceGraph = getReferenceGraphForUpdate())
+    {
+        referenceGraph->updateObject(reference, object);
+    }
+
     m_objects[reference.objectNumber] = Entry(reference.generation, qMove(object));
 }
 
 void PDFObjectStorage::updateTrailerDictionary(PDFObject trailerDictionary)
 {
     m_trailerDictionary = PDFObjectManipulator::merge(m_trailerDictionary, trailerDictionary, PDFObjectManipulator::RemoveNullObjects);
+
+    if (PDFObjectReferenceGraph* referenceGraph = getReferenceGraphForUpdate())
+    {
+        referenceGraph->updateTrailerDictionary(m_trailerDictionary);
+    }
+}
+
+void PDFObjectStorage::setTrailerDictionary(const PDFObject& object)
+{
+    m_trailerDictionary = object;
+
+    if (PDFObjectReferenceGraph* referenceGraph = getReferenceGraphForUpdate())
+    {
+        referenceGraph->updateTrailerDictionary(m_trailerDictionary);
+    }
+}
+
+std::shared_ptr<const PDFObjectReferenceGraph> PDFObjectStorage::getReferenceGraph() const
+{
+    if (!m_referenceGraphCache)
+    {
+        // Storage was moved from, graph can't be cached
+        return std::make_shared<const PDFObjectReferenceGraph>(*this);
+    }
+
+    QMutexLocker lock(&m_referenceGraphCache->mutex);
+    if (!m_referenceGraphCache->graph)
+    {
+        m_referenceGraphCache->graph = std::make_shared<PDFObjectReferenceGraph>(*this);
+    }
+
+    return m_referenceGraphCache->graph;
+}
+
+PDFObjectReferenceGraph* PDFObjectStorage::getReferenceGraphForUpdate()
+{
+    if (!m_referenceGraphCache)
+    {
+        m_referenceGraphCache = std::make_shared<ReferenceGraphCache>();
+        return nullptr;
+    }
+
+    std::shared_ptr<PDFObjectReferenceGraph> referenceGraph;
+    {
+        QMutexLocker lock(&m_referenceGraphCache->mutex);
+        referenceGraph = m_referenceGraphCache->graph;
+    }
+
+    const bool isCacheShared = m_referenceGraphCache.use_count() > 1;
+    if (referenceGraph && referenceGraph->isRebuildRecommended())
+    {
+        // Jakub Melka: too many updates, graph will be rebuilt, when it is requested
+        m_referenceGraphCache = std::make_shared<ReferenceGraphCache>();
+        return nullptr;
+    }
+
+    // Graph is referenced by the cache and by local variable. If it is referenced
+    // elsewhere, or cache is shared with a copy of this storage, we must detach it.
+    if (isCacheShared || (referenceGraph && referenceGraph.use_count() > 2))
+    {
+        std::shared_ptr<ReferenceGraphCache> referenceGraphCache = std::make_shared<ReferenceGraphCache>();
+        if (referenceGraph)
+        {
+            referenceGraphCache->graph = std::make_shared<PDFObjectReferenceGraph>(*referenceGraph);
+        }
+        m_referenceGraphCache = qMove(referenceGraphCache);
+    }
+
+    return m_referenceGraphCache->graph.get();
 }
 
 PDFDocumentDataLoaderDecorator::PDFDocumentDataLoaderDecorator(const PDFDocument* document)
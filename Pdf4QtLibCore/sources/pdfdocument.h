@@ -22,6 +22,7 @@
 #include "pdfobject.h"
 #include "pdfcatalog.h"
 #include "pdfsecurityhandler.h"
+#include "pdfutils.h"
 
 #include <QtCore>
 #include <QColor>
@@ -34,9 +35,12 @@ namespace pdf
 {
 class PDFDocument;
 class PDFDocumentBuilder;
+class PDFObjectReferenceGraph;
 
 /// Storage for objects. This class is not thread safe for writing (calling non-const functions). Caller must ensure
 /// locking, if this object is used from multiple threads. Calling const functions should be thread safe.
+/// Objects are stored in chunks, which are shared between copies of the storage (copy-on-write),
+/// so copy of the storage is cheap, and modified copy takes only memory of the modified chunks.
 class PDF4QTLIBCORESHARED_EXPORT PDFObjectStorage
 {
 public:
@@ -63,7 +67,8 @@ public:
         PDFObject object;
     };
 
-    using PDFObjects = std::vector<Entry>;
+    /// Array of objects, copies of the array share unmodified chunks
+    using PDFObjects = PDFChunkedVector<Entry>;
 
     explicit PDFObjectStorage(PDFObjects&& objects, PDFObject&& trailerDictionary, PDFSecurityHandlerPointer&& securityHandler) :
         m_objects(std::move(objects)),
@@ -94,11 +99,8 @@ public:
     /// Returns array of objects stored in this storage
     const PDFObjects& getObjects() const { return m_objects; }
 
-    /// Returns array of objects stored in this storage
-    PDFObjects& getObjects() { return m_objects; }
-
     /// Sets array of objects
-    void setObjects(PDFObjects&& objects) { m_objects = qMove(objects); }
+    void setObjects(PDFObjects&& objects);
 
     /// Returns trailer dictionary
     const PDFObject& getTrailerDictionary() const { return m_trailerDictionary; }
@@ -133,12 +135,30 @@ public:
 
     /// Set trailer dictionary
     /// \param object Object defining trailer dictionary
-    void setTrailerDictionary(const PDFObject& object) { m_trailerDictionary = object; }
+    void setTrailerDictionary(const PDFObject& object);
+
+    /// Returns reference graph of the objects. Graph is built when it is
+    /// requested for the first time, and then it is updated incrementally,
+    /// when objects of this storage are changed. Copies of the storage share
+    /// the graph, until one of them is changed. This function is thread safe.
+    std::shared_ptr<const PDFObjectReferenceGraph> getReferenceGraph() const;
 
 private:
+    struct ReferenceGraphCache
+    {
+        QMutex mutex;
+        std::shared_ptr<PDFObjectReferenceGraph> graph;
+    };
+
+    /// Returns reference graph, which can be updated, when objects are changed,
+    /// or nullptr, if graph was not built yet. If graph is shared with other
+    /// storage (or used elsewhere), then it is copied before update.
+    PDFObjectReferenceGraph* getReferenceGraphForUpdate();
+
     PDFObjects m_objects;
     PDFObject m_trailerDictionary;
     PDFSecurityHandlerPointer m_securityHandler;
+    mutable std::shared_ptr<ReferenceGraphCache> m_referenceGraphCache = std::make_shared<ReferenceGraphCache>();
 };
 
 /// Loads data from the object contained in the PDF document, such as integers,
@@ -24,6 +24,7 @@
 #include "pdfdbgheap.h"
 #include "pdfparser.h"
 #include "pdfstreamfilters.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QBuffer>
 #include <QPainter>
@@ -1772,44 +1773,94 @@ void PDFDocumentBuilder::setOutline(const PDFOutlineItem* root)
 
 std::vector<PDFObject> PDFDocumentBuilder::copyFrom(const std::vector<PDFObject>& objects, const PDFObjectStorage& storage, bool createReferences)
 {
+    std::vector<std::vector<PDFObject>> result = copyFrom({ CopySource{ objects, &storage } }, createReferences);
+    return qMove(result.front());
+}
+
+std::vector<std::vector<PDFObject>> PDFDocumentBuilder::copyFrom(const std::vector<CopySource>& sources, bool createReferences)
+{
+    // Jakub Melka: collecting of the referenced objects and replacing of the references
+    // is done in parallel for each source. Only allocation of the new objects
+    // is sequential, and it is done in the order of the sources, so the result
+    // doesn't depend on the order, in which sources were processed.
+    const size_t sourceCount = sources.size();
+    PDFIntegerRange<size_t> range(0, sourceCount);
+
     // 1) Collect all references, which we must copy. If object is referenced, then
     //    we must also collect references of referenced object.
-    std::set<PDFObjectReference> references = PDFObjectUtils::getReferences(objects, storage);
+    std::vector<std::vector<PDFObjectReference>> references(sourceCount);
+    auto collectReferences = [&sources, &references](size_t sourceIndex)
+    {
+        const CopySource& source = sources[sourceIndex];
+        std::set<PDFObjectReference> sourceReferences = PDFObjectUtils::getReferences(source.objects, *source.storage);
+        references[sourceIndex].assign(sourceReferences.cbegin(), sourceReferences.cend());
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), collectReferences);
 
     // 2) Make room for new objects, together with mapping
-    std::map<PDFObjectReference, PDFObjectReference> referenceMapping;
-    for (const PDFObjectReference& reference : references)
+    std::vector<std::map<PDFObjectReference, PDFObjectReference>> referenceMappings(sourceCount);
+    for (size_t sourceIndex = 0; sourceIndex < sourceCount; ++sourceIndex)
     {
-        referenceMapping[reference] = addObject(PDFObject::createNull());
+        std::map<PDFObjectReference, PDFObjectReference>& referenceMapping = referenceMappings[sourceIndex];
+        for (const PDFObjectReference& reference : references[sourceIndex])
+        {
+            referenceMapping[reference] = addObject(PDFObject::createNull());
+        }
     }
 
     // 3) Copy objects from other object to this one
-    for (const PDFObjectReference& sourceReference : references)
+    std::vector<std::vector<PDFObject>> copiedObjects(sourceCount);
+    auto copyObjects = [&sources, &references, &referenceMappings, &copiedObjects](size_t sourceIndex)
     {
-        const PDFObjectReference targetReference = referenceMapping.at(sourceReference);
-        m_storage.setObject(targetReference, PDFObjectUtils::replaceReferences(storage.getObject(sourceReference), referenceMapping));
-    }
+        const PDFObjectStorage* storage = sources[sourceIndex].storage;
+        const std::map<PDFObjectReference, PDFObjectReference>& referenceMapping = referenceMappings[sourceIndex];
 
-    std::vector<PDFObject> result;
-    result.reserve(objects.size());
+        std::vector<PDFObject>& objects = copiedObjects[sourceIndex];
+        objects.reserve(references[sourceIndex].size());
+        for (const PDFObjectReference& sourceReference : references[sourceIndex])
+        {
+            objects.emplace_back(PDFObjectUtils::replaceReferences(storage->getObject(sourceReference), referenceMapping));
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), copyObjects);
 
-    for (const PDFObject& object : objects)
+    for (size_t sourceIndex = 0; sourceIndex < sourceCount; ++sourceIndex)
     {
-        if (object.isReference())
+        const std::map<PDFObjectReference, PDFObjectReference>& referenceMapping = referenceMappings[sourceIndex];
+        const std::vector<PDFObjectReference>& sourceReferences = references[sourceIndex];
+        std::vector<PDFObject>& objects = copiedObjects[sourceIndex];
+
+        for (size_t i = 0; i < sourceReferences.size(); ++i)
         {
-            result.push_back(PDFObject::createReference(referenceMapping.at(object.getReference())));
+            m_storage.setObject(referenceMapping.at(sourceReferences[i]), qMove(objects[i]));
         }
-        else
-        {
-            PDFObject replacedObject = PDFObjectUtils::replaceReferences(object, referenceMapping);
+    }
 
-            if (createReferences)
+    std::vector<std::vector<PDFObject>> result(sourceCount);
+    for (size_t sourceIndex = 0; sourceIndex < sourceCount; ++sourceIndex)
+    {
+        const std::map<PDFObjectReference, PDFObjectReference>& referenceMapping = referenceMappings[sourceIndex];
+        std::vector<PDFObject>& sourceResult = result[sourceIndex];
+        sourceResult.reserve(sources[sourceIndex].objects.size());
+
+        for (const PDFObject& object : sources[sourceIndex].objects)
+        {
+            if (object.isReference())
             {
-                result.push_back(PDFObject::createReference(addObject(qMove(replacedObject))));
+                sourceResult.push_back(PDFObject::createReference(referenceMapping.at(object.getReference())));
             }
             else
             {
-                result.emplace_back(qMove(replacedObject));
+                PDFObject replacedObject = PDFObjectUtils::replaceReferences(object, referenceMapping);
+
+                if (createReferences)
+                {
+                    sourceResult.push_back(PDFObject::createReference(addObject(qMove(replacedObject))));
+                }
+                else
+                {
+                    sourceResult.emplace_back(qMove(replacedObject));
+                }
             }
         }
     }
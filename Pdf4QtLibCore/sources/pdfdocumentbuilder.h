@@ -403,6 +403,22 @@ public:
     /// \param createReferences Create references from \p objects
     std::vector<PDFObject> copyFrom(const std::vector<PDFObject>& objects, const PDFObjectStorage& storage, bool createReferences);
 
+    /// Source of the objects for the copy of multiple storages at once
+    struct CopySource
+    {
+        std::vector<PDFObject> objects; ///< Objects, which we want to copy
+        const PDFObjectStorage* storage = nullptr; ///< Storage, from which we are copying from
+    };
+
+    /// Copies objects from multiple storages at once. Referenced objects are collected
+    /// and remapped in parallel, new objects are added after the last objects of active
+    /// storage in the order of the sources, so result doesn't depend on the order
+    /// of the parallel processing.
+    /// \param sources Sources of the objects
+    /// \param createReferences Create references from direct objects of the sources
+    /// \return Copied objects for each source
+    std::vector<std::vector<PDFObject>> copyFrom(const std::vector<CopySource>& sources, bool createReferences);
+
     /// Creates object list from reference list (objects are references)
     /// \param references References
     static std::vector<PDFObject> createObjectsFromReferences(const std::vector<PDFObjectReference>& references);
@@ -18,8 +18,12 @@
 #include "pdfdocumentmanipulator.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfoptimizer.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfobjectutils.h"
 #include "pdfdbgheap.h"
 
+#include <QThread>
+
 namespace pdf
 {
 
@@ -249,6 +253,20 @@ PDFDocumentManipulator::ProcessedPages PDFDocumentManipulator::collectObjectsAnd
         }
     }
 
+    // Jakub Melka: documents are prepared and their objects are copied in parallel,
+    // merged objects (forms, names, optional content properties and outlines)
+    // are then processed sequentially in the order of documents.
+    struct DocumentPart
+    {
+        PDFInteger documentIndex = -1;
+        std::map<std::pair<int, int>, PDFObjectReference>::iterator it;
+        std::map<std::pair<int, int>, PDFObjectReference>::iterator itEnd;
+        std::unique_ptr<PDFDocumentBuilder> temporaryBuilder;
+        std::vector<PDFObjectReference> objectsToMerge;
+        QString errorMessage;
+    };
+
+    std::vector<DocumentPart> documentParts;
     for (auto it = documentPages.begin(); it != documentPages.end();)
     {
         const int documentIndex = it->first.first;
@@ -267,24 +285,36 @@ PDFDocumentManipulator::ProcessedPages PDFDocumentManipulator::collectObjectsAnd
             {
                 throw PDFException(tr("Invalid document."));
             }
-            const PDFDocument* document = m_documents.at(documentIndex);
 
-            // Copy the pages into the target document builder
-            std::vector<PDFInteger> pageIndices;
-            for (auto currentIt = it; currentIt != itEnd; ++currentIt)
-            {
-                pageIndices.push_back(currentIt->first.second);
-            }
+            DocumentPart documentPart;
+            documentPart.documentIndex = documentIndex;
+            documentPart.it = it;
+            documentPart.itEnd = itEnd;
+            documentParts.emplace_back(qMove(documentPart));
+        }
+
+        // Advance the index
+        it = itEnd;
+    }
+
+    auto prepareDocumentPart = [this](DocumentPart& documentPart)
+    {
+        try
+        {
+            const PDFDocument* document = m_documents.at(documentPart.documentIndex);
 
-            pdf::PDFDocumentBuilder temporaryBuilder(document);
+            documentPart.temporaryBuilder = std::make_unique<PDFDocumentBuilder>(document);
+            PDFDocumentBuilder& temporaryBuilder = *documentPart.temporaryBuilder;
             temporaryBuilder.flattenPageTree();
 
             std::vector<pdf::PDFObjectReference> currentPages = temporaryBuilder.getPages();
-            std::vector<pdf::PDFObjectReference> objectsToMerge;
-            objectsToMerge.reserve(std::distance(it, itEnd));
+            std::vector<pdf::PDFObjectReference>& objectsToMerge = documentPart.objectsToMerge;
+            objectsToMerge.reserve(std::distance(documentPart.it, documentPart.itEnd) + 4);
 
-            for (int pageIndex : pageIndices)
+            // Copy the pages into the target document builder
+            for (auto currentIt = documentPart.it; currentIt != documentPart.itEnd; ++currentIt)
             {
+                const int pageIndex = currentIt->first.second;
                 if (pageIndex < 0 || pageIndex >= currentPages.size())
                 {
                     throw PDFException(tr("Missing page (%1) in a document.").arg(pageIndex));
@@ -345,35 +375,68 @@ PDFDocumentManipulator::ProcessedPages PDFDocumentManipulator::collectObjectsAnd
             }
 
             objectsToMerge.insert(objectsToMerge.end(), { acroFormReference, namesReference, ocPropertiesReference, outlineReference });
+        }
+        catch (const PDFException& exception)
+        {
+            documentPart.errorMessage = exception.getMessage();
+        }
+    };
+    // Jakub Melka: documents are processed in batches, so only a bounded number
+    // of temporary builders is alive at once. Each batch is copied into the target
+    // builder, and temporary builders of the batch are released before the next one.
+    const size_t batchSize = qMax(QThread::idealThreadCount(), 1);
+    for (size_t batchBegin = 0; batchBegin < documentParts.size(); batchBegin += batchSize)
+    {
+        const size_t batchEnd = qMin(batchBegin + batchSize, documentParts.size());
+        auto itBatchBegin = std::next(documentParts.begin(), batchBegin);
+        auto itBatchEnd = std::next(documentParts.begin(), batchEnd);
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, itBatchBegin, itBatchEnd, prepareDocumentPart);
+
+        std::vector<PDFDocumentBuilder::CopySource> copySources;
+        copySources.reserve(batchEnd - batchBegin);
+        for (auto it = itBatchBegin; it != itBatchEnd; ++it)
+        {
+            if (!it->errorMessage.isEmpty())
+            {
+                throw PDFException(it->errorMessage);
+            }
+
+            copySources.push_back(PDFDocumentBuilder::CopySource{ PDFDocumentBuilder::createObjectsFromReferences(it->objectsToMerge), it->temporaryBuilder->getStorage() });
+        }
+
+        // Now, we are ready to merge objects into target document builder
+        std::vector<std::vector<PDFObject>> copiedObjects = documentBuilder.copyFrom(copySources, true);
+        copySources.clear();
+
+        for (size_t i = batchBegin; i < batchEnd; ++i)
+        {
+            DocumentPart& documentPart = documentParts[i];
+            documentPart.temporaryBuilder.reset();
 
-            // Now, we are ready to merge objects into target document builder
-            std::vector<pdf::PDFObjectReference> references = pdf::PDFDocumentBuilder::createReferencesFromObjects(documentBuilder.copyFrom(pdf::PDFDocumentBuilder::createObjectsFromReferences(objectsToMerge), *temporaryBuilder.getStorage(), true));
+            std::vector<pdf::PDFObjectReference> references = pdf::PDFDocumentBuilder::createReferencesFromObjects(copiedObjects[i - batchBegin]);
 
-            outlineReference = references.back();
+            pdf::PDFObjectReference outlineReference = references.back();
             references.pop_back();
-            ocPropertiesReference = references.back();
+            pdf::PDFObjectReference ocPropertiesReference = references.back();
             references.pop_back();
-            namesReference = references.back();
+            pdf::PDFObjectReference namesReference = references.back();
             references.pop_back();
-            acroFormReference = references.back();
+            pdf::PDFObjectReference acroFormReference = references.back();
             references.pop_back();
 
             documentBuilder.appendTo(m_mergedObjects[MOT_OCProperties], documentBuilder.getObjectByReference(ocPropertiesReference));
             documentBuilder.appendTo(m_mergedObjects[MOT_Form], documentBuilder.getObjectByReference(acroFormReference));
             documentBuilder.mergeNames(m_mergedObjects[MOT_Names], namesReference);
-            m_outlines[documentIndex] = outlineReference;
+            m_outlines[documentPart.documentIndex] = outlineReference;
 
-            Q_ASSERT(references.size() == size_t(std::distance(it, itEnd)));
+            Q_ASSERT(references.size() == size_t(std::distance(documentPart.it, documentPart.itEnd)));
 
             auto referenceIt = references.begin();
-            for (auto currentIt = it; currentIt != itEnd; ++currentIt, ++referenceIt)
+            for (auto currentIt = documentPart.it; currentIt != documentPart.itEnd; ++currentIt, ++referenceIt)
             {
                 currentIt->second = *referenceIt;
             }
         }
-
-        // Advance the index
-        it = itEnd;
     }
 
     std::set<PDFObjectReference> usedReferences;
@@ -626,4 +689,135 @@ void PDFDocumentManipulator::setOutlineMode(OutlineMode outlineMode)
     m_outlineMode = outlineMode;
 }
 
+PDFDocumentPageSplitter::PDFDocumentPageSplitter(const PDFDocument* document)
+{
+    PDFDocumentBuilder documentBuilder(document);
+    documentBuilder.flattenPageTree();
+    documentBuilder.removeOutline();
+    documentBuilder.removeThreads();
+    documentBuilder.removeDocumentActions();
+    documentBuilder.removeStructureTree();
+    m_pages = documentBuilder.getPages();
+    m_document = documentBuilder.build();
+
+    const PDFObjectStorage& storage = m_document.getStorage();
+    PDFDocumentDataLoaderDecorator loader(&storage);
+    if (const PDFDictionary* trailerDictionary = storage.getDictionaryFromObject(storage.getTrailerDictionary()))
+    {
+        const PDFObjectReference catalogReference = loader.readReferenceFromDictionary(trailerDictionary, "Root");
+        if (const PDFDictionary* catalogDictionary = storage.getDictionaryFromObject(storage.getObjectByReference(catalogReference)))
+        {
+            m_pageTreeRoot = loader.readReferenceFromDictionary(catalogDictionary, "Pages");
+        }
+    }
+
+    if (!m_pageTreeRoot.isValid())
+    {
+        throw PDFException(tr("Invalid page tree."));
+    }
+
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    m_references.resize(objects.size());
+
+    PDFIntegerRange<size_t> range(0, objects.size());
+    auto collectReferences = [this, &objects](size_t index)
+    {
+        std::set<PDFObjectReference> references = PDFObjectUtils::getDirectReferences(objects[index].object);
+        m_references[index].assign(references.cbegin(), references.cend());
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), collectReferences);
+}
+
+PDFDocument PDFDocumentPageSplitter::createPageDocument(size_t pageIndex) const
+{
+    if (pageIndex >= m_pages.size())
+    {
+        throw PDFException(tr("Missing page (%1) in a document.").arg(pageIndex));
+    }
+
+    const PDFObjectStorage& storage = m_document.getStorage();
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+
+    // Page tree of the single page document contains only the page
+    PDFObjectFactory objectFactory;
+    objectFactory.beginDictionary();
+    objectFactory.beginDictionaryItem("Kids");
+    objectFactory.beginArray();
+    objectFactory << m_pages[pageIndex];
+    objectFactory.endArray();
+    objectFactory.endDictionaryItem();
+    objectFactory.beginDictionaryItem("Count");
+    objectFactory << PDFInteger(1);
+    objectFactory.endDictionaryItem();
+    objectFactory.endDictionary();
+
+    PDFObject pageTreeRoot = PDFObjectManipulator::merge(storage.getObject(m_pageTreeRoot), objectFactory.takeObject(), PDFObjectManipulator::RemoveNullObjects);
+    std::set<PDFObjectReference> pageTreeRootReferences = PDFObjectUtils::getDirectReferences(pageTreeRoot);
+
+    // Collect objects reachable from the trailer dictionary
+    std::vector<bool> visited(objects.size(), false);
+    std::vector<PDFObjectReference> closure;
+    std::set<PDFObjectReference> trailerReferences = PDFObjectUtils::getDirectReferences(storage.getTrailerDictionary());
+    std::vector<PDFObjectReference> stack(trailerReferences.cbegin(), trailerReferences.cend());
+
+    while (!stack.empty())
+    {
+        const PDFObjectReference reference = stack.back();
+        stack.pop_back();
+
+        if (reference.objectNumber < 0 ||
+            reference.objectNumber >= PDFInteger(objects.size()) ||
+            visited[reference.objectNumber])
+        {
+            continue;
+        }
+
+        const PDFObjectStorage::Entry& entry = objects[reference.objectNumber];
+        if (entry.generation != reference.generation || entry.object.isNull())
+        {
+            continue;
+        }
+
+        visited[reference.objectNumber] = true;
+        closure.push_back(reference);
+
+        if (reference == m_pageTreeRoot)
+        {
+            stack.insert(stack.end(), pageTreeRootReferences.cbegin(), pageTreeRootReferences.cend());
+        }
+        else
+        {
+            const std::vector<PDFObjectReference>& references = m_references[reference.objectNumber];
+            stack.insert(stack.end(), references.cbegin(), references.cend());
+        }
+    }
+
+    // Renumber objects, so the storage of the single page document is compact
+    std::sort(closure.begin(), closure.end());
+
+    std::map<PDFObjectReference, PDFObjectReference> referenceMapping;
+    for (size_t i = 0; i < closure.size(); ++i)
+    {
+        referenceMapping[closure[i]] = PDFObjectReference(PDFInteger(i + 1), 0);
+    }
+
+    PDFObjectStorage::PDFObjects pageObjects(closure.size() + 1);
+    for (size_t i = 0; i < closure.size(); ++i)
+    {
+        const PDFObjectReference reference = closure[i];
+        const PDFObject& object = (reference == m_pageTreeRoot) ? pageTreeRoot : objects[reference.objectNumber].object;
+        pageObjects[i + 1] = PDFObjectStorage::Entry(0, PDFObjectUtils::replaceReferences(object, referenceMapping));
+    }
+
+    objectFactory.beginDictionary();
+    objectFactory.beginDictionaryItem("Size");
+    objectFactory << PDFInteger(pageObjects.size());
+    objectFactory.endDictionaryItem();
+    objectFactory.endDictionary();
+    PDFObject trailerDictionary = PDFObjectManipulator::merge(PDFObjectUtils::replaceReferences(storage.getTrailerDictionary(), referenceMapping), objectFactory.takeObject(), PDFObjectManipulator::RemoveNullObjects);
+
+    PDFSecurityHandlerPointer securityHandler(storage.getSecurityHandler()->clone());
+    return PDFDocument(PDFObjectStorage(qMove(pageObjects), qMove(trailerDictionary), qMove(securityHandler)), m_document.getInfo()->version, QByteArray());
+}
+
 }   // namespace pdf
@@ -155,6 +155,39 @@ private:
     std::map<PDFInteger, PDFObjectReference> m_outlines;
 };
 
+/// Splits document into single page documents. Document is prepared and its
+/// reference graph is computed only once. Each single page document is then
+/// created from objects reachable from the page, without copying and optimizing
+/// of the whole object storage. Single page documents can be created in parallel.
+class PDF4QTLIBCORESHARED_EXPORT PDFDocumentPageSplitter
+{
+    Q_DECLARE_TR_FUNCTIONS(pdf::PDFDocumentPageSplitter)
+
+public:
+    /// Prepares the document for splitting. Outline, threads, document actions
+    /// and structure tree are removed, as they refer to the pages of the whole
+    /// document. Throws exception, if document can't be prepared.
+    /// \param document Document
+    explicit PDFDocumentPageSplitter(const PDFDocument* document);
+
+    /// Returns page count of the document
+    size_t getPageCount() const { return m_pages.size(); }
+
+    /// Creates single page document containing page with given index. This
+    /// function is thread safe and can be called from multiple threads.
+    /// Throws exception, if page doesn't exist.
+    /// \param pageIndex Page index
+    PDFDocument createPageDocument(size_t pageIndex) const;
+
+private:
+    PDFDocument m_document;
+    PDFObjectReference m_pageTreeRoot;
+    std::vector<PDFObjectReference> m_pages;
+
+    /// Directly referenced objects of each object of the document
+    std::vector<std::vector<PDFObjectReference>> m_references;
+};
+
 }   // namespace pdf
 
 #endif // PDFDOCUMENTMANIPULATOR_H
@@ -414,7 +414,14 @@ PDFDocumentReader::Result PDFDocumentReader::processSecurityHandler(const PDFObj
                 return;
             }
 
-            objects[entry.reference.objectNumber].object = m_securityHandler->decryptObject(objects[entry.reference.objectNumber].object, entry.reference);
+            if (m_decryptStreamsOnDemand)
+            {
+                objects[entry.reference.objectNumber].object = PDFSecurityHandler::decryptObjectStreamsOnDemand(m_securityHandler, objects[entry.reference.objectNumber].object, entry.reference);
+            }
+            else
+            {
+                objects[entry.reference.objectNumber].object = m_securityHandler->decryptObject(objects[entry.reference.objectNumber].object, entry.reference);
+            }
         };
 
         progressStart(occupiedEntries.size(), PDFTranslationContext::tr("Decrypting encrypted contents of document..."));
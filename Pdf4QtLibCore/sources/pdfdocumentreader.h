@@ -78,6 +78,12 @@ public:
     /// Get source data of the document
     const QByteArray& getSource() const { return m_source; }
 
+    /// Enables/disables on demand decryption of streams in encrypted documents. If enabled,
+    /// strings are decrypted when document is read, but stream data are decrypted
+    /// on first access to the stream content (and then cached). Default is disabled.
+    /// \param decryptStreamsOnDemand Decrypt streams on demand
+    void setDecryptStreamsOnDemand(bool decryptStreamsOnDemand) { m_decryptStreamsOnDemand = decryptStreamsOnDemand; }
+
     /// Returns warning messages
     const QStringList& getWarnings() const { return m_warnings; }
 
@@ -172,6 +178,9 @@ private:
     /// reading fails)
     bool m_authorizeOwnerOnly;
 
+    /// Decrypt streams on first access to their content
+    bool m_decryptStreamsOnDemand = false;
+
     /// Warnings
     QStringList m_warnings;
 };
@@ -20,6 +20,7 @@
 #include "pdfexecutionpolicy.h"
 #include "pdfoptimizer.h"
 #include "pdfdocumentbuilder.h"
+#include "pdfobjectutils.h"
 
 namespace pdf
 {
@@ -295,6 +296,7 @@ void PDFDocumentSanitizer::removeAnnotations(const std::function<bool (const PDF
     builder.flattenPageTree();
     std::vector<PDFObjectReference> pageReferences = builder.getPages();
     std::vector<std::pair<PDFObjectReference, PDFObjectReference>> annotationsToBeRemoved;
+    std::map<PDFObjectReference, PDFObjectReference> annotationPages;
 
     PDFDocumentDataLoaderDecorator loader(&m_storage);
     for (const PDFObjectReference pageReference : pageReferences)
@@ -310,6 +312,8 @@ void PDFDocumentSanitizer::removeAnnotations(const std::function<bool (const PDF
         std::vector<PDFObjectReference> annotationReferences = loader.readReferenceArrayFromDictionary(pageDictionary, "Annots");
         for (const PDFObjectReference& annotationReference : annotationReferences)
         {
+            annotationPages[annotationReference] = pageReference;
+
             PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_storage, annotationReference);
             if (filter(annotation.get()))
             {
@@ -318,6 +322,47 @@ void PDFDocumentSanitizer::removeAnnotations(const std::function<bool (const PDF
         }
     }
 
+    // Jakub Melka: popup annotations of removed annotations must be removed too,
+    // otherwise removed annotations remain reachable through the popup's parent.
+    // Popups are found using reverse edges of the reference graph (popup refers
+    // to its parent annotation by /Parent entry, even if the parent has no /Popup
+    // entry). Popup can be placed on other page than its parent annotation, so we
+    // find its page from the pages' annotation arrays, or from its /P entry.
+    const size_t removedAnnotationCount = annotationsToBeRemoved.size();
+    if (removedAnnotationCount > 0)
+    {
+        std::shared_ptr<const PDFObjectReferenceGraph> referenceGraph = m_storage.getReferenceGraph();
+        std::set<PDFObjectReference> removedAnnotations;
+        for (const auto& item : annotationsToBeRemoved)
+        {
+            removedAnnotations.insert(item.second);
+        }
+
+        for (size_t i = 0; i < removedAnnotationCount; ++i)
+        {
+            const PDFObjectReference annotationReference = annotationsToBeRemoved[i].second;
+
+            for (const PDFObjectReference& reference : referenceGraph->getReferencedBy(annotationReference))
+            {
+                if (removedAnnotations.count(reference))
+                {
+                    continue;
+                }
+
+                const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(m_storage.getObjectByReference(reference));
+                if (dictionary &&
+                    loader.readNameFromDictionary(dictionary, "Subtype") == "Popup" &&
+                    loader.readReferenceFromDictionary(dictionary, "Parent") == annotationReference)
+                {
+                    auto it = annotationPages.find(reference);
+                    const PDFObjectReference popupPageReference = it != annotationPages.cend() ? it->second : loader.readReferenceFromDictionary(dictionary, "P");
+                    annotationsToBeRemoved.emplace_back(popupPageReference, reference);
+                    removedAnnotations.insert(reference);
+                }
+            }
+        }
+    }
+
     if (!annotationsToBeRemoved.empty())
     {
         for (const auto& item : annotationsToBeRemoved)
@@ -329,7 +374,7 @@ void PDFDocumentSanitizer::removeAnnotations(const std::function<bool (const PDF
 
         PDFDocument document = builder.build();
         m_storage = document.getStorage();
-        Q_EMIT sanitizationProgress(message.arg(annotationsToBeRemoved.size()));
+        Q_EMIT sanitizationProgress(message.arg(removedAnnotationCount));
     }
 }
 
@@ -429,7 +429,6 @@ void PDFStructureTreeTextExtractor::perform(const std::vector<PDFInteger>& pageI
 
     PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
 
-    QMutex mutex;
     PDFCMSGeneric cms;
     PDFMeshQualitySettings mqs;
     PDFOptionalContentActivity oca(m_document, OCUsage::Export, nullptr);
@@ -437,8 +436,21 @@ void PDFStructureTreeTextExtractor::perform(const std::vector<PDFInteger>& pageI
     fontCache.setDocument(md);
     fontCache.setCacheShrinkEnabled(nullptr, false);
 
-    auto generateTextLayout = [&, this](PDFInteger pageIndex)
+    // Jakub Melka: each page writes its result to its own slot, so pages can be
+    // processed concurrently without locking. Results are then merged in the order
+    // of page indices, so the result doesn't depend on the thread scheduling.
+    struct PageResult
     {
+        bool isValid = false;
+        PDFStructureTreeTextSequence sequence;
+        QStringList unmatchedTexts;
+        QList<PDFRenderError> errors;
+    };
+
+    std::vector<PageResult> pageResults(pageIndices.size());
+    auto generateTextLayout = [&, this](size_t index)
+    {
+        const PDFInteger pageIndex = pageIndices[index];
         const PDFCatalog* catalog = m_document->getCatalog();
         if (!catalog->getPage(pageIndex))
         {
@@ -450,18 +462,32 @@ void PDFStructureTreeTextExtractor::perform(const std::vector<PDFInteger>& pageI
         Q_ASSERT(page);
 
         PDFStructureTreeTextContentProcessor processor(PDFRenderer::IgnoreOptionalContent, page, m_document, &fontCache, &cms, &oca, QTransform(), mqs, m_tree, &mapping, m_options);
-        QList<PDFRenderError> errors = processor.processContents();
 
-        QMutexLocker lock(&mutex);
-        m_textSequences[pageIndex] = qMove(processor.takeSequence());
-        m_unmatchedText << qMove(processor.takeUnmatchedTexts());
-        m_errors.append(qMove(errors));
+        PageResult& pageResult = pageResults[index];
+        pageResult.errors = processor.processContents();
+        pageResult.sequence = qMove(processor.takeSequence());
+        pageResult.unmatchedTexts = qMove(processor.takeUnmatchedTexts());
+        pageResult.isValid = true;
     };
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageIndices.begin(), pageIndices.end(), generateTextLayout);
+    auto range = PDFIntegerRange<size_t>(0, pageIndices.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), generateTextLayout);
 
     fontCache.setCacheShrinkEnabled(nullptr, true);
 
+    for (size_t i = 0; i < pageResults.size(); ++i)
+    {
+        PageResult& pageResult = pageResults[i];
+        if (!pageResult.isValid)
+        {
+            continue;
+        }
+
+        m_textSequences[pageIndices[i]] = qMove(pageResult.sequence);
+        m_unmatchedText << qMove(pageResult.unmatchedTexts);
+        m_errors.append(qMove(pageResult.errors));
+    }
+
     if (m_options.testFlag(CreateTreeMapping))
     {
         for (const auto& sequence : m_textSequences)
@@ -685,7 +711,13 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
             fontCache.setDocument(md);
             fontCache.setCacheShrinkEnabled(nullptr, false);
 
-            auto generateTextLayout = [this, &items, &mutex, &fontCache, &cms, &mqs, &oca, document, catalog](PDFInteger pageIndex)
+            // Jakub Melka: stored text layouts can be reused only if they contain the same
+            // text as layouts created here, i.e. optional content must not affect them.
+            const bool isTextLayoutStorageUsable = m_textLayoutStorage &&
+                                                   (m_textLayoutStorageFeatures.testFlag(PDFRenderer::IgnoreOptionalContent) ||
+                                                    !catalog->getOptionalContentProperties()->isValid());
+
+            auto generateTextLayout = [this, &items, &mutex, &fontCache, &cms, &mqs, &oca, document, catalog, isTextLayoutStorageUsable](PDFInteger pageIndex)
             {
                 if (!catalog->getPage(pageIndex))
                 {
@@ -696,9 +728,21 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
                 const PDFPage* page = catalog->getPage(pageIndex);
                 Q_ASSERT(page);
 
-                PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, document, &fontCache, &cms, &oca, QTransform(), mqs);
-                QList<PDFRenderError> errors = generator.processContents();
-                PDFTextLayout textLayout = generator.createTextLayout();
+                QList<PDFRenderError> errors;
+                PDFTextLayout textLayout;
+
+                if (isTextLayoutStorageUsable && pageIndex < PDFInteger(m_textLayoutStorage->getCount()))
+                {
+                    // Jakub Melka: reuse already computed text layout
+                    textLayout = m_textLayoutStorage->getTextLayout(pageIndex);
+                }
+                else
+                {
+                    PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, document, &fontCache, &cms, &oca, QTransform(), mqs);
+                    errors = generator.processContents();
+                    textLayout = generator.createTextLayout();
+                }
+
                 PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, PDFTextFlow::FlowFlags(PDFTextFlow::SeparateBlocks) | PDFTextFlow::RemoveSoftHyphen, pageIndex);
 
                 PDFDocumentTextFlow::Items flowItems;
@@ -798,6 +842,12 @@ void PDFDocumentTextFlowFactory::setCalculateBoundingBoxes(bool calculateBoundin
     m_calculateBoundingBoxes = calculateBoundingBoxes;
 }
 
+void PDFDocumentTextFlowFactory::setTextLayoutStorage(const PDFTextLayoutStorage* textLayoutStorage, PDFRenderer::Features features)
+{
+    m_textLayoutStorage = textLayoutStorage;
+    m_textLayoutStorageFeatures = features;
+}
+
 void PDFDocumentTextFlowEditor::setTextFlow(PDFDocumentTextFlow textFlow)
 {
     m_originalTextFlow = std::move(textFlow);
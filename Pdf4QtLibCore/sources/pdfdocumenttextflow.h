@@ -21,10 +21,12 @@
 #include "pdfglobal.h"
 #include "pdfexception.h"
 #include "pdfutils.h"
+#include "pdfrenderer.h"
 
 namespace pdf
 {
 class PDFDocument;
+class PDFTextLayoutStorage;
 
 /// Text flow extracted from document. Text flow can be created \p PDFDocumentTextFlowFactory.
 /// Flow can contain various items, not just text ones. Also, some manipulation functions
@@ -142,9 +144,21 @@ public:
     /// \param calculateBoundingBoxes Perform bounding box calculation?
     void setCalculateBoundingBoxes(bool calculateBoundingBoxes);
 
+    /// Sets already computed text layouts of the document (for example, from
+    /// asynchronous text layout compiler). If they are set, layout algorithm
+    /// uses them instead of creating text layouts again. Layout algorithm ignores
+    /// optional content, so layouts are used only if they were also created
+    /// ignoring optional content, or if document doesn't have optional content.
+    /// Storage must exist during text flow creation.
+    /// \param textLayoutStorage Text layout storage (can be nullptr)
+    /// \param features Renderer features used when text layouts were created
+    void setTextLayoutStorage(const PDFTextLayoutStorage* textLayoutStorage, PDFRenderer::Features features);
+
 private:
     QList<PDFRenderError> m_errors;
     bool m_calculateBoundingBoxes = false;
+    const PDFTextLayoutStorage* m_textLayoutStorage = nullptr;
+    PDFRenderer::Features m_textLayoutStorageFeatures;
 };
 
 /// Editor which can edit document text flow, modify user text,
@@ -31,6 +31,7 @@
 #include <freetype/t1tables.h>
 
 #include <QMutex>
+#include <QWaitCondition>
 #include <QReadWriteLock>
 #include <QPainterPath>
 #include <QDataStream>
@@ -604,12 +605,46 @@ private:
     static constexpr const PDFReal FORMAT_26_6_MULTIPLIER = 1 / 64.0;
     static constexpr const PDFReal FONT_MULTIPLIER = FORMAT_26_6_MULTIPLIER / PIXEL_SIZE_MULTIPLIER;
 
+    /// Maximal number of glyphs of the font, for which flat glyph table is used
+    static constexpr const FT_Long MAX_FLAT_GLYPH_TABLE_SIZE = 4096;
+
+    /// Maximal number of faces of the font. Each face has its own library
+    /// instance and parsed font, so number of faces is limited. Glyphs are
+    /// cached, so faces are needed only when glyph is loaded for the first time.
+    static constexpr const size_t MAX_FACE_COUNT = 4;
+
     struct Glyph
     {
         QPainterPath glyph;
         PDFReal advance = 0.0;
     };
 
+    /// FreeType face together with its own library instance. FreeType faces
+    /// are not thread safe, so each thread loading glyphs uses its own face.
+    struct Face
+    {
+        FT_Library library = nullptr;
+        FT_Face face = nullptr;
+    };
+
+    /// Face leased from the face pool of the font. Face is returned
+    /// to the pool, when lease is destroyed.
+    class FaceLease
+    {
+    public:
+        explicit inline FaceLease(const PDFRealizedFontImpl* font) : m_font(font), m_face(font->acquireFace()) { }
+        inline ~FaceLease() { m_font->releaseFace(m_face); }
+
+        FaceLease(const FaceLease&) = delete;
+        FaceLease& operator=(const FaceLease&) = delete;
+
+        FT_Face get() const { return m_face.face; }
+
+    private:
+        const PDFRealizedFontImpl* m_font;
+        Face m_face;
+    };
+
     static int outlineMoveTo(const FT_Vector* to, void* user);
     static int outlineLineTo(const FT_Vector* to, void* user);
     static int outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user);
@@ -618,27 +653,71 @@ private:
     /// Get glyph for glyph index
     const Glyph& getGlyph(unsigned int glyphIndex);
 
+    /// Loads glyph outline using face from the face pool
+    /// \param glyphIndex Glyph index
+    Glyph loadGlyph(unsigned int glyphIndex) const;
+
+    /// Initializes the font from its first face and puts the face into the face pool
+    /// \param face First face of the font
+    void initializeFace(Face face);
+
+    /// Creates flat glyph table, if font has small number of glyphs
+    /// \param face Face of the font
+    void initializeGlyphTable(FT_Face face);
+
+    /// Returns font data (embedded or system font data)
+    const QByteArray& getFontData() const { return m_isEmbedded ? m_embeddedFontData : m_systemFontData; }
+
+    /// Takes face from the face pool. If pool is empty, then new face is created,
+    /// or, if maximal number of faces is reached, waits until face is released.
+    Face acquireFace() const;
+
+    /// Returns face to the face pool
+    void releaseFace(Face face) const;
+
+    /// Creates face from font data with given pixel size
+    /// \param fontData Font data
+    /// \param pixelSize Pixel size
+    static Face createFace(const QByteArray& fontData, PDFReal pixelSize);
+
+    /// Destroys face and its library
+    static void destroyFace(Face& face);
+
     /// Function checks, if error occured, and if yes, then exception is thrown
     static void checkFreeTypeError(FT_Error error);
 
+    /// Flat glyph table indexed by glyph index, it is used for fonts with small
+    /// number of glyphs. Glyphs are published atomically and never removed,
+    /// so glyphs from this table are read without locking.
+    std::unique_ptr<std::atomic<Glyph*>[]> m_glyphTable;
+
+    /// Size of the flat glyph table
+    size_t m_glyphTableSize = 0;
+
     /// Read/write lock for accessing the glyph data
     QReadWriteLock m_readWriteLock;
 
-    /// Glyph cache, must be protected by the mutex above
+    /// Glyph cache (glyphs not stored in flat glyph table), must be protected by the lock above
     std::unordered_map<unsigned int, Glyph> m_glyphCache;
 
+    /// Mutex protecting the face pool
+    mutable QMutex m_facePoolMutex;
+
+    /// Wait condition signalled, when face is returned to the face pool
+    mutable QWaitCondition m_facePoolCondition;
+
+    /// Faces, which are currently not used by any thread
+    mutable std::vector<Face> m_facePool;
+
+    /// Number of faces created for this font (protected by face pool mutex)
+    mutable size_t m_faceCount = 0;
+
     /// For embedded fonts, this byte array contains embedded font data
     QByteArray m_embeddedFontData;
 
     /// For system fonts, this byte array contains system font data
     QByteArray m_systemFontData;
 
-    /// Instance of FreeType library assigned to this font
-    FT_Library m_library;
-
-    /// Face of the font
-    FT_Face m_face;
-
     /// Pixel size of the font
     PDFReal m_pixelSize;
 
@@ -651,33 +730,33 @@ private:
     /// True, if font has vertical writing system
     bool m_isVertical;
 
+    /// True, if unicode character map of the font is selected
+    bool m_hasUnicodeCharMap;
+
     /// Postscript name of the font
     QString m_postScriptName;
 };
 
 PDFRealizedFontImpl::PDFRealizedFontImpl() :
-    m_library(nullptr),
-    m_face(nullptr),
     m_pixelSize(0.0),
     m_parentFont(nullptr),
     m_isEmbedded(false),
-    m_isVertical(false)
+    m_isVertical(false),
+    m_hasUnicodeCharMap(false)
 {
 
 }
 
 PDFRealizedFontImpl::~PDFRealizedFontImpl()
 {
-    if (m_face)
+    for (size_t i = 0; i < m_glyphTableSize; ++i)
     {
-        FT_Done_Face(m_face);
-        m_face = nullptr;
+        delete m_glyphTable[i].load(std::memory_order_relaxed);
     }
 
-    if (m_library)
+    for (Face& face : m_facePool)
     {
-        FT_Done_FreeType(m_library);
-        m_library = nullptr;
+        destroyFace(face);
     }
 }
 
@@ -700,13 +779,13 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
             {
                 GID glyphIndex = (*glyphIndices)[static_cast<uint8_t>(byteArray[i])];
 
-                if (!glyphIndex)
+                if (!glyphIndex && m_hasUnicodeCharMap)
                 {
-                    // Try to obtain glyph index from unicode
-                    if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
-                    {
-                        glyphIndex = FT_Get_Char_Index(m_face, (*encoding)[static_cast<uint8_t>(byteArray[i])].unicode());
-                    }
+                    // Try to obtain glyph index from unicode. Face is released
+                    // before the glyph is loaded, because glyph loading also
+                    // needs a face from the face pool.
+                    FaceLease faceLease(this);
+                    glyphIndex = FT_Get_Char_Index(faceLease.get(), (*encoding)[static_cast<uint8_t>(byteArray[i])].unicode());
                 }
 
                 const PDFReal glyphWidth = font->getGlyphAdvance(static_cast<uint8_t>(byteArray[i]));
@@ -785,6 +864,11 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
 {
     CharacterInfos result;
 
+    // Character map iteration and glyph loading modifies the face,
+    // so we use face from the face pool.
+    FaceLease faceLease(this);
+    FT_Face face = faceLease.get();
+
     switch (m_parentFont->getFontType())
     {
         case FontType::Type1:
@@ -805,9 +889,9 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                 if (!glyphIndex)
                 {
                     // Try to obtain glyph index from unicode
-                    if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
+                    if (face->charmap && face->charmap->encoding == FT_ENCODING_UNICODE)
                     {
-                        glyphIndex = FT_Get_Char_Index(m_face, character.unicode());
+                        glyphIndex = FT_Get_Char_Index(face, character.unicode());
                     }
                 }
 
@@ -832,7 +916,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
             const PDFCIDtoGIDMapper* CIDtoGIDmapper = font->getCIDtoGIDMapper();
 
             FT_UInt index = 0;
-            FT_ULong character = FT_Get_First_Char(m_face, &index);
+            FT_ULong character = FT_Get_First_Char(face, &index);
             while (index != 0)
             {
                 const GID gid = index;
@@ -843,7 +927,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                 info.character = toUnicode->getToUnicode(cid);
                 result.emplace_back(qMove(info));
 
-                character = FT_Get_Next_Char(m_face, character, &index);
+                character = FT_Get_Next_Char(face, character, &index);
             }
 
             if (result.empty())
@@ -858,7 +942,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                         continue;
                     }
 
-                    if (!FT_Load_Glyph(m_face, gid, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING))
+                    if (!FT_Load_Glyph(face, gid, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING))
                     {
                         CharacterInfo info;
                         info.gid = gid;
@@ -884,34 +968,37 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
 
 void PDFRealizedFontImpl::dumpFontToTreeItem(ITreeFactory* treeFactory) const
 {
+    FaceLease faceLease(this);
+    FT_Face face = faceLease.get();
+
     treeFactory->pushItem({ PDFTranslationContext::tr("Details") });
 
-    if (m_face->family_name)
+    if (face->family_name)
     {
-        treeFactory->addItem({ PDFTranslationContext::tr("Font"), QString::fromLatin1(m_face->family_name) });
+        treeFactory->addItem({ PDFTranslationContext::tr("Font"), QString::fromLatin1(face->family_name) });
     }
-    if (m_face->style_name)
+    if (face->style_name)
     {
-        treeFactory->addItem({ PDFTranslationContext::tr("Style"), QString::fromLatin1(m_face->style_name) });
+        treeFactory->addItem({ PDFTranslationContext::tr("Style"), QString::fromLatin1(face->style_name) });
     }
 
     QString yesString = PDFTranslationContext::tr("Yes");
     QString noString = PDFTranslationContext::tr("No");
 
-    treeFactory->addItem( { PDFTranslationContext::tr("Glyph count"), QString::number(m_face->num_glyphs) });
-    treeFactory->addItem( { PDFTranslationContext::tr("Is CID keyed"), (m_face->face_flags & FT_FACE_FLAG_CID_KEYED) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Is bold"), (m_face->style_flags & FT_STYLE_FLAG_BOLD) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Is italics"), (m_face->style_flags & FT_STYLE_FLAG_ITALIC) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Has vertical writing system"), (m_face->face_flags & FT_FACE_FLAG_VERTICAL) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Has SFNT storage scheme"), (m_face->face_flags & FT_FACE_FLAG_SFNT) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Has glyph names"), (m_face->face_flags & FT_FACE_FLAG_GLYPH_NAMES) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Glyph count"), QString::number(face->num_glyphs) });
+    treeFactory->addItem( { PDFTranslationContext::tr("Is CID keyed"), (face->face_flags & FT_FACE_FLAG_CID_KEYED) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Is bold"), (face->style_flags & FT_STYLE_FLAG_BOLD) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Is italics"), (face->style_flags & FT_STYLE_FLAG_ITALIC) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Has vertical writing system"), (face->face_flags & FT_FACE_FLAG_VERTICAL) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Has SFNT storage scheme"), (face->face_flags & FT_FACE_FLAG_SFNT) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Has glyph names"), (face->face_flags & FT_FACE_FLAG_GLYPH_NAMES) ? yesString : noString });
 
-    if (m_face->num_charmaps > 0)
+    if (face->num_charmaps > 0)
     {
         treeFactory->pushItem({ PDFTranslationContext::tr("Encoding") });
-        for (FT_Int i = 0; i < m_face->num_charmaps; ++i)
+        for (FT_Int i = 0; i < face->num_charmaps; ++i)
         {
-            FT_CharMap charMap = m_face->charmaps[i];
+            FT_CharMap charMap = face->charmaps[i];
 
             const FT_Encoding encoding = charMap->encoding;
             QString encodingName;
@@ -1018,6 +1105,26 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
 {
     if (glyphIndex)
     {
+        if (glyphIndex < m_glyphTableSize)
+        {
+            // Lock-free path for fonts with flat glyph table
+            std::atomic<Glyph*>& glyphSlot = m_glyphTable[glyphIndex];
+            if (Glyph* glyph = glyphSlot.load(std::memory_order_acquire))
+            {
+                return *glyph;
+            }
+
+            std::unique_ptr<Glyph> glyph = std::make_unique<Glyph>(loadGlyph(glyphIndex));
+            Glyph* expected = nullptr;
+            if (glyphSlot.compare_exchange_strong(expected, glyph.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                return *glyph.release();
+            }
+
+            // Another thread was faster and loaded the glyph
+            return *expected;
+        }
+
         {
             QReadLocker readLock(&m_readWriteLock);
 
@@ -1029,23 +1136,10 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
             }
         }
 
-        QWriteLocker writeLock(&m_readWriteLock);
-        Glyph glyph;
-
-        FT_Outline_Funcs glyphOutlineInterface;
-        glyphOutlineInterface.delta = 0;
-        glyphOutlineInterface.shift = 0;
-        glyphOutlineInterface.move_to = PDFRealizedFontImpl::outlineMoveTo;
-        glyphOutlineInterface.line_to = PDFRealizedFontImpl::outlineLineTo;
-        glyphOutlineInterface.conic_to = PDFRealizedFontImpl::outlineConicTo;
-        glyphOutlineInterface.cubic_to = PDFRealizedFontImpl::outlineCubicTo;
-
-        checkFreeTypeError(FT_Load_Glyph(m_face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
-        checkFreeTypeError(FT_Outline_Decompose(&m_face->glyph->outline, &glyphOutlineInterface, &glyph));
-        glyph.glyph.closeSubpath();
-        glyph.advance = !m_isVertical ? m_face->glyph->advance.x : m_face->glyph->advance.y;
-        glyph.advance *= FONT_MULTIPLIER;
+        // Glyph is loaded outside of the lock, so other threads are not blocked
+        Glyph glyph = loadGlyph(glyphIndex);
 
+        QWriteLocker writeLock(&m_readWriteLock);
         auto it = m_glyphCache.find(glyphIndex);
         if (it == m_glyphCache.cend())
         {
@@ -1058,6 +1152,137 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
     return dummy;
 }
 
+PDFRealizedFontImpl::Glyph PDFRealizedFontImpl::loadGlyph(unsigned int glyphIndex) const
+{
+    Glyph glyph;
+
+    FT_Outline_Funcs glyphOutlineInterface;
+    glyphOutlineInterface.delta = 0;
+    glyphOutlineInterface.shift = 0;
+    glyphOutlineInterface.move_to = PDFRealizedFontImpl::outlineMoveTo;
+    glyphOutlineInterface.line_to = PDFRealizedFontImpl::outlineLineTo;
+    glyphOutlineInterface.conic_to = PDFRealizedFontImpl::outlineConicTo;
+    glyphOutlineInterface.cubic_to = PDFRealizedFontImpl::outlineCubicTo;
+
+    FaceLease faceLease(this);
+    FT_Face face = faceLease.get();
+
+    checkFreeTypeError(FT_Load_Glyph(face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
+    checkFreeTypeError(FT_Outline_Decompose(&face->glyph->outline, &glyphOutlineInterface, &glyph));
+    glyph.glyph.closeSubpath();
+    glyph.advance = !m_isVertical ? face->glyph->advance.x : face->glyph->advance.y;
+    glyph.advance *= FONT_MULTIPLIER;
+
+    return glyph;
+}
+
+void PDFRealizedFontImpl::initializeFace(Face face)
+{
+    Q_ASSERT(face.face);
+
+    m_hasUnicodeCharMap = face.face->charmap && face.face->charmap->encoding == FT_ENCODING_UNICODE;
+    initializeGlyphTable(face.face);
+
+    // Jakub Melka: first face is not kept aside for metadata, it is the first
+    // face of the face pool, so single threaded glyph loading never creates
+    // another face.
+    QMutexLocker lock(&m_facePoolMutex);
+    m_facePool.push_back(face);
+    m_faceCount = 1;
+}
+
+void PDFRealizedFontImpl::initializeGlyphTable(FT_Face face)
+{
+    Q_ASSERT(face);
+
+    if (face->num_glyphs > 0 && face->num_glyphs <= MAX_FLAT_GLYPH_TABLE_SIZE)
+    {
+        m_glyphTableSize = static_cast<size_t>(face->num_glyphs);
+        m_glyphTable = std::make_unique<std::atomic<Glyph*>[]>(m_glyphTableSize);
+
+        for (size_t i = 0; i < m_glyphTableSize; ++i)
+        {
+            m_glyphTable[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+}
+
+PDFRealizedFontImpl::Face PDFRealizedFontImpl::acquireFace() const
+{
+    {
+        QMutexLocker lock(&m_facePoolMutex);
+        while (m_facePool.empty() && m_faceCount >= MAX_FACE_COUNT)
+        {
+            m_facePoolCondition.wait(&m_facePoolMutex);
+        }
+
+        if (!m_facePool.empty())
+        {
+            Face face = m_facePool.back();
+            m_facePool.pop_back();
+            return face;
+        }
+
+        ++m_faceCount;
+    }
+
+    // Pool is empty, so all faces are used by other threads. Create a new
+    // face, it will be returned to the pool after it is used.
+    try
+    {
+        return createFace(getFontData(), m_pixelSize);
+    }
+    catch (const PDFException&)
+    {
+        QMutexLocker lock(&m_facePoolMutex);
+        --m_faceCount;
+        m_facePoolCondition.wakeOne();
+        throw;
+    }
+}
+
+void PDFRealizedFontImpl::releaseFace(Face face) const
+{
+    QMutexLocker lock(&m_facePoolMutex);
+    m_facePool.push_back(face);
+    m_facePoolCondition.wakeOne();
+}
+
+PDFRealizedFontImpl::Face PDFRealizedFontImpl::createFace(const QByteArray& fontData, PDFReal pixelSize)
+{
+    Face face;
+
+    try
+    {
+        checkFreeTypeError(FT_Init_FreeType(&face.library));
+        checkFreeTypeError(FT_New_Memory_Face(face.library, reinterpret_cast<const FT_Byte*>(fontData.constData()), fontData.size(), 0, &face.face));
+        FT_Select_Charmap(face.face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
+        checkFreeTypeError(FT_Set_Pixel_Sizes(face.face, 0, qRound(pixelSize * PIXEL_SIZE_MULTIPLIER)));
+    }
+    catch (const PDFException&)
+    {
+        destroyFace(face);
+        throw;
+    }
+
+    return face;
+}
+
+void PDFRealizedFontImpl::destroyFace(Face& face)
+{
+    if (face.face)
+    {
+        FT_Done_Face(face.face);
+        face.face = nullptr;
+    }
+
+    if (face.library)
+    {
+        FT_Done_FreeType(face.library);
+        face.library = nullptr;
+    }
+}
+
 void PDFRealizedFontImpl::checkFreeTypeError(FT_Error error)
 {
     if (error)
@@ -1127,7 +1352,6 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
         const FontDescriptor* descriptor = font->getFontDescriptor();
         if (descriptor->isEmbedded())
         {
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
             const QByteArray* embeddedFontData = descriptor->getEmbeddedFontData();
             Q_ASSERT(embeddedFontData);
             impl->m_embeddedFontData = *embeddedFontData;
@@ -1135,9 +1359,7 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
             // At this time, embedded font data should not be empty!
             Q_ASSERT(!impl->m_embeddedFontData.isEmpty());
 
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_embeddedFontData.constData()), impl->m_embeddedFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
+            impl->initializeFace(PDFRealizedFontImpl::createFace(impl->m_embeddedFontData, pixelSize));
             impl->m_isVertical = cmap ? cmap->isVertical() : false;
             impl->m_isEmbedded = true;
             result.reset(new PDFRealizedFont(implPtr.release()));
@@ -1160,15 +1382,16 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
                 throw PDFException(PDFTranslationContext::tr("Can't load system font '%1'.").arg(QString::fromLatin1(descriptor->fontName)));
             }
 
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_systemFontData.constData()), impl->m_systemFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
+            impl->initializeFace(PDFRealizedFontImpl::createFace(impl->m_systemFontData, pixelSize));
             impl->m_isVertical = cmap ? cmap->isVertical() : false;
             impl->m_isEmbedded = false;
-            if (const char* postScriptName = FT_Get_Postscript_Name(impl->m_face))
+
             {
-                impl->m_postScriptName = QString::fromLatin1(postScriptName);
+                PDFRealizedFontImpl::FaceLease faceLease(impl);
+                if (const char* postScriptName = FT_Get_Postscript_Name(faceLease.get()))
+                {
+                    impl->m_postScriptName = QString::fromLatin1(postScriptName);
+                }
             }
             result.reset(new PDFRealizedFont(implPtr.release()));
         }
@@ -2019,72 +2242,132 @@ FontType PDFTrueTypeFont::getFontType() const
 void PDFFontCache::setDocument(const PDFModifiedDocument& document)
 {
     QMutexLocker lock(&m_mutex);
-    if (m_document != document)
+    if (m_document.load(std::memory_order_acquire) != document.getDocument())
     {
-        m_document = document;
+        // Document must be set before the cache is cleared, because threads, which
+        // are creating fonts for old document, check the document before they insert
+        // the font into the cache.
+        m_document.store(document.getDocument(), std::memory_order_release);
 
         // Jakub Melka: If document has not reset flag, then fonts of the
         // document remains the same. So it is not needed to clear font cache.
         if (document.hasReset() || document.hasPageContentsChanged())
         {
-            m_fontCache.clear();
-            m_realizedFontCache.clear();
+            clearFontCache(false);
+            clearRealizedFontCache(false);
         }
     }
 }
 
-PDFFontPointer PDFFontCache::getFont(const PDFObject& fontObject) const
+PDFFontPointer PDFFontCache::getFont(const PDFObject& fontObject, bool* isCacheHit) const
 {
+    const PDFDocument* document = m_document.load(std::memory_order_acquire);
+
+    if (isCacheHit)
+    {
+        *isCacheHit = false;
+    }
+
     if (fontObject.isReference())
     {
         // Font is object reference. Look in the cache, if we have it, then return it.
+        const PDFObjectReference reference = fontObject.getReference();
+        FontCacheShard& shard = m_fontCache[getShardIndex(reference)];
 
-        QMutexLocker lock(&m_mutex);
-        PDFObjectReference reference = fontObject.getReference();
-
-        auto it = m_fontCache.find(reference);
-        if (it == m_fontCache.cend())
         {
-            // We must create the font
-            PDFFontPointer font = PDFFont::createFont(fontObject, m_document);
-
-            if (m_fontCacheShrinkDisabledObjects.empty() && m_fontCache.size() >= m_fontCacheLimit)
+            QReadLocker lock(&shard.lock);
+            auto it = shard.fonts.find(reference);
+            if (it != shard.fonts.cend())
             {
-                // We have exceeded the cache limit. Clear the cache.
-                m_fontCache.clear();
+                shard.hits.fetch_add(1, std::memory_order_relaxed);
+                if (isCacheHit)
+                {
+                    *isCacheHit = true;
+                }
+                return it->second;
             }
+        }
+
+        // We must create the font. We do it outside of the lock, so other
+        // threads are not blocked, when font is being created.
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        PDFFontPointer font = PDFFont::createFont(fontObject, document);
 
-            it = m_fontCache.insert(std::make_pair(reference, qMove(font))).first;
+        if (isShrinkEnabled() && m_fontCacheSize.load(std::memory_order_relaxed) >= m_fontCacheLimit)
+        {
+            // We have exceeded the cache limit. Clear the cache.
+            clearFontCache(true);
         }
-        return it->second;
+
+        QWriteLocker lock(&shard.lock);
+        auto it = shard.fonts.find(reference);
+        if (it != shard.fonts.cend())
+        {
+            // Another thread was faster and created the font
+            return it->second;
+        }
+
+        if (m_document.load(std::memory_order_acquire) == document)
+        {
+            shard.fonts.emplace(reference, font);
+            m_fontCacheSize.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return font;
     }
     else
     {
         // Object is not a reference. Create font directly and return it.
-        return PDFFont::createFont(fontObject, m_document);
+        return PDFFont::createFont(fontObject, document);
     }
 }
 
-PDFRealizedFontPointer PDFFontCache::getRealizedFont(const PDFFontPointer& font, PDFReal size, PDFRenderErrorReporter* reporter) const
+PDFRealizedFontPointer PDFFontCache::getRealizedFont(const PDFFontPointer& font, PDFReal size, PDFRenderErrorReporter* reporter, bool* isCacheHit) const
 {
     Q_ASSERT(font);
 
-    QMutexLocker lock(&m_mutex);
-    auto it = m_realizedFontCache.find(std::make_pair(font, size));
-    if (it == m_realizedFontCache.cend())
+    if (isCacheHit)
     {
-        // We must create the realized font
-        PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, size, reporter);
+        *isCacheHit = false;
+    }
+
+    const RealizedFontKey key(font, getRealizedFontCacheSize(font, size));
+    RealizedFontCacheShard& shard = m_realizedFontCache[getShardIndex(key)];
 
-        if (m_fontCacheShrinkDisabledObjects.empty() && m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+    {
+        QReadLocker lock(&shard.lock);
+        auto it = shard.fonts.find(key);
+        if (it != shard.fonts.cend())
         {
-            m_realizedFontCache.clear();
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            if (isCacheHit)
+            {
+                *isCacheHit = true;
+            }
+            return it->second;
         }
+    }
+
+    // We must create the realized font
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, key.second, reporter);
 
-        it = m_realizedFontCache.insert(std::make_pair(std::make_pair(font, size), qMove(realizedFont))).first;
+    if (isShrinkEnabled() && m_realizedFontCacheSize.load(std::memory_order_relaxed) >= m_realizedFontCacheLimit)
+    {
+        clearRealizedFontCache(true);
+    }
+
+    QWriteLocker lock(&shard.lock);
+    auto it = shard.fonts.find(key);
+    if (it != shard.fonts.cend())
+    {
+        // Another thread was faster and created the realized font
+        return it->second;
     }
 
-    return it->second;
+    shard.fonts.emplace(key, realizedFont);
+    m_realizedFontCacheSize.fetch_add(1, std::memory_order_relaxed);
+    return realizedFont;
 }
 
 void PDFFontCache::setCacheShrinkEnabled(const void* source, bool enabled)
@@ -2093,12 +2376,14 @@ void PDFFontCache::setCacheShrinkEnabled(const void* source, bool enabled)
     if (enabled)
     {
         m_fontCacheShrinkDisabledObjects.erase(source);
+        m_shrinkDisabledCount.store(m_fontCacheShrinkDisabledObjects.size(), std::memory_order_release);
         lock.unlock();
         shrink();
     }
     else
     {
         m_fontCacheShrinkDisabledObjects.insert(source);
+        m_shrinkDisabledCount.store(m_fontCacheShrinkDisabledObjects.size(), std::memory_order_release);
     }
 }
 
@@ -2115,15 +2400,90 @@ void PDFFontCache::setCacheLimits(int fontCacheLimit, int instancedFontCacheLimi
 void PDFFontCache::shrink()
 {
     QMutexLocker lock(&m_mutex);
-    if (m_fontCacheShrinkDisabledObjects.empty())
+    if (isShrinkEnabled())
+    {
+        if (m_fontCacheSize.load(std::memory_order_relaxed) >= m_fontCacheLimit)
+        {
+            clearFontCache(true);
+        }
+        if (m_realizedFontCacheSize.load(std::memory_order_relaxed) >= m_realizedFontCacheLimit)
+        {
+            clearRealizedFontCache(true);
+        }
+    }
+}
+
+PDFFontCacheStatistics PDFFontCache::getStatistics() const
+{
+    PDFFontCacheStatistics statistics;
+
+    for (const FontCacheShard& shard : m_fontCache)
+    {
+        statistics.fontHits += shard.hits.load(std::memory_order_relaxed);
+        statistics.fontMisses += shard.misses.load(std::memory_order_relaxed);
+        statistics.fontEvictions += shard.evictions.load(std::memory_order_relaxed);
+    }
+
+    for (const RealizedFontCacheShard& shard : m_realizedFontCache)
+    {
+        statistics.realizedFontHits += shard.hits.load(std::memory_order_relaxed);
+        statistics.realizedFontMisses += shard.misses.load(std::memory_order_relaxed);
+        statistics.realizedFontEvictions += shard.evictions.load(std::memory_order_relaxed);
+    }
+
+    return statistics;
+}
+
+PDFReal PDFFontCache::getRealizedFontCacheSize(const PDFFontPointer& font, PDFReal size)
+{
+    // Type 3 fonts are scaled by exact pixel size, other fonts are rasterized
+    // by FreeType with pixel size rounded to 1 / PIXEL_SIZE_MULTIPLIER.
+    if (font->getFontType() == FontType::Type3)
+    {
+        return size;
+    }
+
+    return std::round(size * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER) / PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER;
+}
+
+size_t PDFFontCache::getShardIndex(PDFObjectReference reference)
+{
+    return static_cast<size_t>(qHashMulti(0, reference.objectNumber, reference.generation)) % SHARD_COUNT;
+}
+
+size_t PDFFontCache::getShardIndex(const RealizedFontKey& key)
+{
+    return static_cast<size_t>(qHashMulti(0, key.first.get(), key.second)) % SHARD_COUNT;
+}
+
+void PDFFontCache::clearFontCache(bool isEviction) const
+{
+    for (FontCacheShard& shard : m_fontCache)
     {
-        if (m_fontCache.size() >= m_fontCacheLimit)
+        QWriteLocker lock(&shard.lock);
+        const size_t count = shard.fonts.size();
+        shard.fonts.clear();
+        m_fontCacheSize.fetch_sub(count, std::memory_order_relaxed);
+
+        if (isEviction)
         {
-            m_fontCache.clear();
+            shard.evictions.fetch_add(count, std::memory_order_relaxed);
         }
-        if (m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+    }
+}
+
+void PDFFontCache::clearRealizedFontCache(bool isEviction) const
+{
+    for (RealizedFontCacheShard& shard : m_realizedFontCache)
+    {
+        QWriteLocker lock(&shard.lock);
+        const size_t count = shard.fonts.size();
+        shard.fonts.clear();
+        m_realizedFontCacheSize.fetch_sub(count, std::memory_order_relaxed);
+
+        if (isEviction)
         {
-            m_realizedFontCache.clear();
+            shard.evictions.fetch_add(count, std::memory_order_relaxed);
         }
     }
 }
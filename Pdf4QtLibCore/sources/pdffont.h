@@ -25,8 +25,12 @@
 #include <QFont>
 #include <QTransform>
 #include <QSharedPointer>
+#include <QReadWriteLock>
+#include <QMutex>
 
 #include <set>
+#include <array>
+#include <atomic>
 #include <unordered_map>
 
 class QPainterPath;
@@ -411,8 +415,26 @@ public:
     virtual FontType getFontType() const override;
 };
 
+/// Statistics of the font cache. Hits and misses are counted for each lookup,
+/// evictions are counted for each cached item, which was removed from the cache,
+/// because cache limit has been exceeded (items removed due to document change
+/// are not counted).
+struct PDFFontCacheStatistics
+{
+    size_t fontHits = 0;
+    size_t fontMisses = 0;
+    size_t fontEvictions = 0;
+    size_t realizedFontHits = 0;
+    size_t realizedFontMisses = 0;
+    size_t realizedFontEvictions = 0;
+};
+
 /// Font cache which caches both fonts, and realized fonts. Cache has individual limit
-/// for fonts, and realized fonts.
+/// for fonts, and realized fonts. Cache is divided into shards, each shard has its own
+/// read/write lock, so lookups from multiple threads (for example, when rendering pages
+/// in parallel) take only a shared lock of a single shard. Fonts are created outside
+/// of any lock. Realized fonts are cached by size rounded to the resolution of the
+/// font rasterizer, so sizes which differ only by rounding noise share one realized font.
 class PDF4QTLIBCORESHARED_EXPORT PDFFontCache
 {
 public:
@@ -432,14 +454,17 @@ public:
     /// Retrieves font from the cache. If font can't be accessed or created,
     /// then exception is thrown.
     /// \param fontObject Font object
-    PDFFontPointer getFont(const PDFObject& fontObject) const;
+    /// \param[out] isCacheHit Optional, is set to true, if font was found in the cache
+    PDFFontPointer getFont(const PDFObject& fontObject, bool* isCacheHit = nullptr) const;
 
     /// Retrieves realized font from the cache. If realized font can't be accessed or created,
-    /// then exception is thrown.
+    /// then exception is thrown. Size is rounded to the resolution of the font rasterizer
+    /// (except for Type 3 fonts, which are cached by exact size).
     /// \param font Font, which should be realized
     /// \param size Size of the font (in pixels)
     /// \param reporter Error reporter
-    PDFRealizedFontPointer getRealizedFont(const PDFFontPointer& font, PDFReal size, PDFRenderErrorReporter* reporter) const;
+    /// \param[out] isCacheHit Optional, is set to true, if realized font was found in the cache
+    PDFRealizedFontPointer getRealizedFont(const PDFFontPointer& font, PDFReal size, PDFRenderErrorReporter* reporter, bool* isCacheHit = nullptr) const;
 
     /// Sets or unsets font shrinking (i.e. font can be deleted from the cache). In multithreading environment,
     /// font deletion is not thread safe. For this reason, disable font deletion by calling this function.
@@ -456,14 +481,62 @@ public:
     /// If shrinking is enabled, then erase font, if cache limit is exceeded.
     void shrink();
 
+    /// Returns statistics of cache hits, misses and evictions
+    PDFFontCacheStatistics getStatistics() const;
+
+    /// Returns size used as a key for realized font cache. Font is realized
+    /// with this size.
+    /// \param font Font
+    /// \param size Requested size of the font (in pixels)
+    static PDFReal getRealizedFontCacheSize(const PDFFontPointer& font, PDFReal size);
+
 private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    using RealizedFontKey = std::pair<PDFFontPointer, PDFReal>;
+
+    struct FontCacheShard
+    {
+        mutable QReadWriteLock lock;
+        std::map<PDFObjectReference, PDFFontPointer> fonts;
+        std::atomic<size_t> hits = 0;
+        std::atomic<size_t> misses = 0;
+        std::atomic<size_t> evictions = 0;
+    };
+
+    struct RealizedFontCacheShard
+    {
+        mutable QReadWriteLock lock;
+        std::map<RealizedFontKey, PDFRealizedFontPointer> fonts;
+        std::atomic<size_t> hits = 0;
+        std::atomic<size_t> misses = 0;
+        std::atomic<size_t> evictions = 0;
+    };
+
+    static size_t getShardIndex(PDFObjectReference reference);
+    static size_t getShardIndex(const RealizedFontKey& key);
+
+    /// Returns true, if cache can be shrinked (no object has disabled shrinking)
+    bool isShrinkEnabled() const { return m_shrinkDisabledCount.load(std::memory_order_acquire) == 0; }
+
+    /// Clears font cache (all shards). If \p isEviction is true, then
+    /// removed items are counted as evictions.
+    void clearFontCache(bool isEviction) const;
+
+    /// Clears realized font cache (all shards). If \p isEviction is true, then
+    /// removed items are counted as evictions.
+    void clearRealizedFontCache(bool isEviction) const;
+
     size_t m_fontCacheLimit;
     size_t m_realizedFontCacheLimit;
+    std::atomic<const PDFDocument*> m_document;
+    mutable std::array<FontCacheShard, SHARD_COUNT> m_fontCache;
+    mutable std::array<RealizedFontCacheShard, SHARD_COUNT> m_realizedFontCache;
+    mutable std::atomic<size_t> m_fontCacheSize = 0;
+    mutable std::atomic<size_t> m_realizedFontCacheSize = 0;
     mutable QMutex m_mutex;
-    const PDFDocument* m_document;
-    mutable std::map<PDFObjectReference, PDFFontPointer> m_fontCache;
-    mutable std::map<std::pair<PDFFontPointer, PDFReal>, PDFRealizedFontPointer> m_realizedFontCache;
-    mutable std::set<const void*> m_fontCacheShrinkDisabledObjects;
+    std::set<const void*> m_fontCacheShrinkDisabledObjects;
+    std::atomic<size_t> m_shrinkDisabledCount = 0;
 };
 
 /// Performs mapping from CID to GID (even identity mapping, if byte array is empty)
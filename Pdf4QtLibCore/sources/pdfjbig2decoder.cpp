@@ -1119,21 +1119,35 @@ PDFImageData PDFJBIG2Decoder::decode(PDFImageData::MaskingType maskingType)
 
     if (m_pageBitmap.isValid())
     {
-        PDFBitWriter writer(1);
-
         const int columns = m_pageBitmap.getWidth();
         const int rows = m_pageBitmap.getHeight();
+        const int bytesPerLine = (columns + 7) / 8;
+
+        // Output pixels are inverted (1 is white), padding bits in the last byte
+        // of each line must stay zero.
+        const int lastByteBits = columns % 8;
+        const uint8_t lastByteMask = lastByteBits ? static_cast<uint8_t>(0xFF << (8 - lastByteBits)) : 0xFF;
+
+        QByteArray data(bytesPerLine * rows, '\0');
+        uint8_t* target = reinterpret_cast<uint8_t*>(data.data());
 
         for (int row = 0; row < rows; ++row)
         {
-            for (int column = 0; column < columns; ++column)
+            const PDFJBIG2Bitmap::Word* sourceRow = m_pageBitmap.getRow(row);
+            uint8_t* targetLine = target + static_cast<size_t>(row) * bytesPerLine;
+
+            for (int byteIndex = 0; byteIndex < bytesPerLine; ++byteIndex)
             {
-                writer.write(!m_pageBitmap.getPixel(column, row));
+                const int wordIndex = byteIndex / 8;
+                const int shift = (7 - byteIndex % 8) * 8;
+                Q_ASSERT(wordIndex < m_pageBitmap.getStride());
+                targetLine[byteIndex] = static_cast<uint8_t>(~(sourceRow[wordIndex] >> shift));
             }
-            writer.finishLine();
+
+            targetLine[bytesPerLine - 1] &= lastByteMask;
         }
 
-        return PDFImageData(1, 1, static_cast<uint32_t>(columns), static_cast<uint32_t>(rows), static_cast<uint32_t>((columns + 7) / 8), maskingType, writer.takeByteArray(), { }, { }, { });
+        return PDFImageData(1, 1, static_cast<uint32_t>(columns), static_cast<uint32_t>(rows), static_cast<uint32_t>(bytesPerLine), maskingType, qMove(data), { }, { }, { });
     }
 
     return PDFImageData();
@@ -2381,7 +2395,8 @@ void PDFJBIG2Decoder::processHalftoneRegion(const PDFJBIG2SegmentHeader& header)
     parameters.arithmeticDecoderState = &genericState;
     parameters.data = qMove(mmrData);
 
-    PDFJBIG2Bitmap GI(HGW, HGH, 0x00);
+    // Grayscale image values can have more than one bit, so we can't use packed bitmap
+    std::vector<uint32_t> GI(static_cast<size_t>(HGW) * HGH, 0);
     for (int J = HBPP - 1; J >= 0; --J)
     {
         PDFJBIG2Bitmap PLANE = readBitmap(parameters);
@@ -2418,9 +2433,9 @@ void PDFJBIG2Decoder::processHalftoneRegion(const PDFJBIG2SegmentHeader& header)
             for (int y = 0; y < static_cast<int>(HGH); ++y)
             {
                 // Old bit is in the first position of grayscale image
-                const uint8_t oldPixel = GI.getPixel(x, y);
-                const uint8_t bit = (oldPixel ^ PLANE.getPixel(x, y)) & 0x01;
-                GI.setPixel(x, y, (oldPixel << 1) | bit);
+                uint32_t& grayValue = GI[static_cast<size_t>(y) * HGW + x];
+                const uint32_t bit = (grayValue ^ PLANE.getPixel(x, y)) & 0x01;
+                grayValue = (grayValue << 1) | bit;
             }
         }
     }
@@ -2435,7 +2450,7 @@ void PDFJBIG2Decoder::processHalftoneRegion(const PDFJBIG2SegmentHeader& header)
             const int y = (static_cast<int>(HGY) + MG * static_cast<int>(HRX) - NG * static_cast<int>(HRY)) / 256;
 
             /* 6.6.5.1 1) a) ii) */
-            const uint8_t index = GI.getPixel(NG, MG);
+            const uint32_t index = GI[static_cast<size_t>(MG) * HGW + NG];
             if (Q_UNLIKELY(index >= HNUMPATS))
             {
                 throw PDFException(PDFTranslationContext::tr("JBIG2 halftoning pattern index %1 out of bounds [0, %2]").arg(index).arg(HNUMPATS));
@@ -2862,18 +2877,34 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
         PDFImageData data = decoder.decode();
         parameters.dataEndPosition = decoder.getReader()->getPosition();
 
-        PDFJBIG2Bitmap bitmap(data.getWidth(), data.getHeight(), m_pageDefaultPixelValue);
+        const int width = static_cast<int>(data.getWidth());
+        const int height = static_cast<int>(data.getHeight());
+        PDFJBIG2Bitmap bitmap(width, height, 0x00);
+
+        // Copy the data. Decoder produces packed lines with white pixels as ones,
+        // so we invert the bytes and pack them into bitmap rows. Padding bits
+        // of the last byte in the line must be kept zero.
+        const int bytesPerLine = (width + 7) / 8;
+        const int lastByteBits = width % 8;
+        const uint8_t lastByteMask = lastByteBits ? static_cast<uint8_t>(0xFF << (8 - lastByteBits)) : 0xFF;
+        const uint8_t* sourceData = reinterpret_cast<const uint8_t*>(data.getData().constData());
 
-        // Copy the data
-        PDFBitReader reader(&data.getData(), data.getBitsPerComponent());
-        for (unsigned int row = 0; row < data.getHeight(); ++row)
+        for (int row = 0; row < height; ++row)
         {
-            for (unsigned int column = 0; column < data.getWidth(); ++column)
+            const uint8_t* sourceLine = sourceData + static_cast<size_t>(row) * bytesPerLine;
+            PDFJBIG2Bitmap::Word* targetRow = bitmap.getRow(row);
+
+            for (int byteIndex = 0; byteIndex < bytesPerLine; ++byteIndex)
             {
-                bitmap.setPixel(column, row, (reader.read()) ? 0x00 : 0xFF);
-            }
+                uint8_t value = static_cast<uint8_t>(~sourceLine[byteIndex]);
+                if (byteIndex == bytesPerLine - 1)
+                {
+                    value &= lastByteMask;
+                }
 
-            reader.alignToBytes();
+                const int shift = (7 - byteIndex % 8) * 8;
+                targetRow[byteIndex / 8] |= static_cast<PDFJBIG2Bitmap::Word>(value) << shift;
+            }
         }
 
         return bitmap;
@@ -3636,23 +3667,25 @@ int32_t PDFJBIG2Decoder::checkInteger(std::optional<int32_t> value)
 
 PDFJBIG2Bitmap::PDFJBIG2Bitmap() :
     m_width(0),
-    m_height(0)
+    m_height(0),
+    m_stride(0)
 {
 
 }
 
 PDFJBIG2Bitmap::PDFJBIG2Bitmap(int width, int height) :
-    m_width(width),
-    m_height(height)
+    PDFJBIG2Bitmap(width, height, 0x00)
 {
-    m_data.resize(width * height, 0);
+
 }
 
 PDFJBIG2Bitmap::PDFJBIG2Bitmap(int width, int height, uint8_t fill) :
     m_width(width),
-    m_height(height)
+    m_height(height),
+    m_stride((width + WORD_BITS - 1) / WORD_BITS)
 {
-    m_data.resize(width * height, fill);
+    m_data.resize(static_cast<size_t>(m_stride) * m_height, 0);
+    PDFJBIG2Bitmap::fill(fill);
 }
 
 PDFJBIG2Bitmap::~PDFJBIG2Bitmap()
@@ -3660,18 +3693,31 @@ PDFJBIG2Bitmap::~PDFJBIG2Bitmap()
 
 }
 
-PDFJBIG2Bitmap PDFJBIG2Bitmap::getSubbitmap(int offsetX, int offsetY, int width, int height) const
+PDFJBIG2Bitmap::Word PDFJBIG2Bitmap::getLastWordMask() const
 {
-    PDFJBIG2Bitmap result(width, height, 0x00);
+    const int usedBits = m_width % WORD_BITS;
+    return usedBits ? ~(~Word(0) >> usedBits) : ~Word(0);
+}
+
+void PDFJBIG2Bitmap::fill(uint8_t value)
+{
+    std::fill(m_data.begin(), m_data.end(), getFillWord(value));
 
-    for (int y = 0; y < height; ++y)
+    if (value && m_stride > 0)
     {
-        for (int x = 0; x < width; ++x)
+        // Keep padding bits zero
+        const Word lastWordMask = getLastWordMask();
+        for (int y = 0; y < m_height; ++y)
         {
-            result.setPixel(x, y, getPixelSafe(x + offsetX, y + offsetY));
+            getRow(y)[m_stride - 1] &= lastWordMask;
         }
     }
+}
 
+PDFJBIG2Bitmap PDFJBIG2Bitmap::getSubbitmap(int offsetX, int offsetY, int width, int height) const
+{
+    PDFJBIG2Bitmap result(width, height, 0x00);
+    result.paint(*this, -offsetX, -offsetY, PDFJBIG2BitOperation::Replace, false, 0x00);
     return result;
 }
 
@@ -3685,8 +3731,18 @@ void PDFJBIG2Bitmap::paint(const PDFJBIG2Bitmap& bitmap, int offsetX, int offset
     // Expand, if it is allowed and target bitmap has too low height
     if (expandY && offsetY + bitmap.getHeight() > m_height)
     {
+        const int oldHeight = m_height;
         m_height = offsetY + bitmap.getHeight();
-        m_data.resize(getPixelCount(), expandPixel);
+        m_data.resize(static_cast<size_t>(m_stride) * m_height, getFillWord(expandPixel));
+
+        if (expandPixel && m_stride > 0)
+        {
+            const Word lastWordMask = getLastWordMask();
+            for (int y = oldHeight; y < m_height; ++y)
+            {
+                getRow(y)[m_stride - 1] &= lastWordMask;
+            }
+        }
     }
 
     // Check out pathological cases
@@ -3695,48 +3751,87 @@ void PDFJBIG2Bitmap::paint(const PDFJBIG2Bitmap& bitmap, int offsetX, int offset
         return;
     }
 
-    const int targetStartX = offsetX;
+    // Clip source area against target bitmap
+    const int sourceStartX = qMax(-offsetX, 0);
+    const int sourceStartY = qMax(-offsetY, 0);
+    const int targetStartX = qMax(offsetX, 0);
+    const int targetStartY = qMax(offsetY, 0);
     const int targetEndX = qMin(offsetX + bitmap.getWidth(), m_width);
-    const int targetStartY = offsetY;
     const int targetEndY = qMin(offsetY + bitmap.getHeight(), m_height);
 
-    for (int targetY = targetStartY; targetY < targetEndY; ++targetY)
+    if (targetStartX >= targetEndX || targetStartY >= targetEndY)
+    {
+        return;
+    }
+
+    const int sourceStride = bitmap.getStride();
+
+    // Returns WORD_BITS source bits starting at source pixel position, aligned
+    // to the most significant bit. Bits past the end of the row are zero.
+    auto fetchSourceWord = [sourceStride](const Word* sourceRow, int position) -> Word
     {
-        for (int targetX = targetStartX; targetX < targetEndX; ++targetX)
+        const int wordIndex = position / WORD_BITS;
+        const int shift = position % WORD_BITS;
+
+        Word value = sourceRow[wordIndex] << shift;
+        if (shift && wordIndex + 1 < sourceStride)
         {
-            const int sourceX = targetX - targetStartX;
-            const int sourceY = targetY - targetStartY;
+            value |= sourceRow[wordIndex + 1] >> (WORD_BITS - shift);
+        }
+        return value;
+    };
 
-            if (targetX < 0 || targetX >= m_width || targetY < 0 || targetY >= m_height)
-            {
-                continue;
-            }
+    auto combine = [operation](Word target, Word source) -> Word
+    {
+        switch (operation)
+        {
+            case PDFJBIG2BitOperation::Or:
+                return target | source;
 
-            switch (operation)
-            {
-                case PDFJBIG2BitOperation::Or:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) | bitmap.getPixel(sourceX, sourceY));
-                    break;
+            case PDFJBIG2BitOperation::And:
+                return target & source;
 
-                case PDFJBIG2BitOperation::And:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) & bitmap.getPixel(sourceX, sourceY));
-                    break;
+            case PDFJBIG2BitOperation::Xor:
+                return target ^ source;
 
-                case PDFJBIG2BitOperation::Xor:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) ^ bitmap.getPixel(sourceX, sourceY));
-                    break;
+            case PDFJBIG2BitOperation::NotXor:
+                return ~(target ^ source);
 
-                case PDFJBIG2BitOperation::NotXor:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) ^ (~bitmap.getPixel(sourceX, sourceY)));
-                    break;
+            case PDFJBIG2BitOperation::Replace:
+                return source;
 
-                case PDFJBIG2BitOperation::Replace:
-                    setPixel(targetX, targetY, bitmap.getPixel(sourceX, sourceY));
-                    break;
+            default:
+                throw PDFException(PDFTranslationContext::tr("JBIG2 - invalid bitmap paint operation."));
+        }
+    };
 
-                default:
-                    throw PDFException(PDFTranslationContext::tr("JBIG2 - invalid bitmap paint operation."));
+    // Validate operation before painting
+    combine(0, 0);
+
+    for (int targetY = targetStartY; targetY < targetEndY; ++targetY)
+    {
+        const Word* sourceRow = bitmap.getRow(sourceStartY + targetY - targetStartY);
+        Word* targetRow = getRow(targetY);
+
+        int targetX = targetStartX;
+        while (targetX < targetEndX)
+        {
+            const int wordIndex = targetX / WORD_BITS;
+            const int bitOffset = targetX % WORD_BITS;
+            const int bitCount = qMin(WORD_BITS - bitOffset, targetEndX - targetX);
+
+            // Mask of bits [bitOffset, bitOffset + bitCount), counted from the most significant bit
+            Word mask = ~Word(0) >> bitOffset;
+            if (bitOffset + bitCount < WORD_BITS)
+            {
+                mask &= ~(~Word(0) >> (bitOffset + bitCount));
             }
+
+            const Word source = fetchSourceWord(sourceRow, sourceStartX + targetX - targetStartX) >> bitOffset;
+            Word& target = targetRow[wordIndex];
+            target = (target & ~mask) | (combine(target, source) & mask);
+
+            targetX += bitCount;
         }
     }
 }
@@ -3748,10 +3843,8 @@ void PDFJBIG2Bitmap::copyRow(int target, int source)
         throw PDFException(PDFTranslationContext::tr("JBIG2 - invalid bitmap copy row operation."));
     }
 
-    auto itSource = std::next(m_data.cbegin(), source * m_width);
-    auto itSourceEnd = std::next(itSource, m_width);
-    auto itTarget = std::next(m_data.begin(), target * m_width);
-    std::copy(itSource, itSourceEnd, itTarget);
+    const Word* sourceRow = getRow(source);
+    std::copy(sourceRow, sourceRow + m_stride, getRow(target));
 }
 
 PDFJBIG2HuffmanCodeTable::PDFJBIG2HuffmanCodeTable(std::vector<PDFJBIG2HuffmanTableEntry>&& entries) :
@@ -323,9 +323,15 @@ private:
     std::vector<PDFJBIG2HuffmanTableEntry> m_entries;
 };
 
+/// JBIG2 bitmap. Pixels are stored packed, one bit per pixel, in rows
+/// of 64-bit words (most significant bit is the leftmost pixel). Padding
+/// bits after the last pixel of each row are always zero. Pixel access
+/// functions use byte values (0x00 for white, 0xFF for black pixel).
 class PDF4QTLIBCORESHARED_EXPORT PDFJBIG2Bitmap : public PDFJBIG2Segment
 {
 public:
+    using Word = uint64_t;
+
     explicit PDFJBIG2Bitmap();
     explicit PDFJBIG2Bitmap(int width, int height);
     explicit PDFJBIG2Bitmap(int width, int height, uint8_t fill);
@@ -334,11 +340,38 @@ public:
     virtual const PDFJBIG2Bitmap* asBitmap() const override { return this; }
     virtual PDFJBIG2Bitmap* asBitmap() override { return this; }
 
+    static constexpr int WORD_BITS = 64;
+
     inline int getWidth() const { return m_width; }
     inline int getHeight() const { return m_height; }
     inline int getPixelCount() const { return m_width * m_height; }
-    inline uint8_t getPixel(int x, int y) const { return m_data[y * m_width + x]; }
-    inline void setPixel(int x, int y, uint8_t value) { m_data[y * m_width + x] = value; }
+
+    /// Returns number of words in one row
+    inline int getStride() const { return m_stride; }
+
+    /// Returns pointer to the first word of the row
+    inline const Word* getRow(int y) const { return m_data.data() + static_cast<size_t>(y) * m_stride; }
+    inline Word* getRow(int y) { return m_data.data() + static_cast<size_t>(y) * m_stride; }
+
+    inline uint8_t getPixel(int x, int y) const
+    {
+        return ((getRow(y)[x / WORD_BITS] >> (WORD_BITS - 1 - x % WORD_BITS)) & 1) ? 0xFF : 0x00;
+    }
+
+    inline void setPixel(int x, int y, uint8_t value)
+    {
+        Word& word = getRow(y)[x / WORD_BITS];
+        const Word bit = Word(1) << (WORD_BITS - 1 - x % WORD_BITS);
+
+        if (value)
+        {
+            word |= bit;
+        }
+        else
+        {
+            word &= ~bit;
+        }
+    }
 
     inline uint8_t getPixelSafe(int x, int y) const
     {
@@ -350,7 +383,7 @@ public:
         return getPixel(x, y);
     }
 
-    inline void fill(uint8_t value) { std::fill(m_data.begin(), m_data.end(), value); }
+    void fill(uint8_t value);
     inline void fillZero() { fill(0); }
     inline void fillOne() { fill(0xFF); }
 
@@ -366,6 +399,7 @@ public:
 
     /// Paints another bitmap onto this bitmap. If bitmap is invalid, nothing is done.
     /// If \p expandY is true, height of target bitmap is expanded to fit source draw area.
+    /// Painting is performed on whole words, not pixel by pixel.
     /// \param bitmap Bitmap to be painted on this
     /// \param offsetX Horizontal offset of paint area
     /// \param offsetY Vertical offset of paint area
@@ -381,9 +415,16 @@ public:
     void copyRow(int target, int source);
 
 private:
+    /// Returns mask of valid bits in the last word of the row
+    Word getLastWordMask() const;
+
+    /// Returns word filled with pixel value (padding bits are not masked)
+    static inline Word getFillWord(uint8_t value) { return value ? ~Word(0) : Word(0); }
+
     int m_width;
     int m_height;
-    std::vector<uint8_t> m_data;
+    int m_stride;
+    std::vector<Word> m_data;
 };
 
 struct PDFJBIG2ReferencedSegments
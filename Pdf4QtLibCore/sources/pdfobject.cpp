@@ -355,11 +355,33 @@ std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const
     return std::find_if(m_dictionary.begin(), m_dictionary.end(), [key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
+PDFStream::PDFStream(const PDFStream& other) :
+    PDFObjectContent(other),
+    m_dictionary(other.m_dictionary),
+    m_content(*other.getContent())
+{
+
+}
+
 bool PDFStream::equals(const PDFObjectContent* other) const
 {
     Q_ASSERT(dynamic_cast<const PDFStream*>(other));
     const PDFStream* otherStream = static_cast<const PDFStream*>(other);
-    return m_dictionary.equals(&otherStream->m_dictionary) && m_content == otherStream->m_content;
+    return m_dictionary.equals(&otherStream->m_dictionary) && *getContent() == *otherStream->getContent();
+}
+
+void PDFStream::decrypt() const
+{
+    QMutexLocker lock(&m_decryptMutex);
+
+    // Jakub Melka: another thread may have decrypted the content
+    // while we were waiting for the mutex.
+    if (m_isEncrypted.load(std::memory_order_relaxed))
+    {
+        m_content = m_decryptor(m_content);
+        m_decryptor = nullptr;
+        m_isEncrypted.store(false, std::memory_order_release);
+    }
 }
 
 PDFObject PDFObjectManipulator::merge(PDFObject left, PDFObject right, MergeFlags flags)
@@ -22,9 +22,12 @@
 #include "pdfglobal.h"
 
 #include <QByteArray>
+#include <QMutex>
 
+#include <atomic>
 #include <memory>
 #include <vector>
+#include <functional>
 #include <variant>
 #include <array>
 #include <initializer_list>
@@ -463,10 +466,15 @@ private:
 };
 
 /// Represents a stream object in the PDF file. Stream consists of dictionary
-/// and stream content - byte array.
+/// and stream content - byte array. Stream content can be stored encrypted,
+/// in that case, it is decrypted on first access to the content and decrypted
+/// data then replace the encrypted data.
 class PDF4QTLIBCORESHARED_EXPORT PDFStream : public PDFObjectContent
 {
 public:
+    /// Function, which decrypts encrypted stream content
+    using Decryptor = std::function<QByteArray(const QByteArray&)>;
+
     inline explicit PDFStream() = default;
     inline explicit PDFStream(PDFDictionary&& dictionary, QByteArray&& content) :
         m_dictionary(std::move(dictionary)),
@@ -475,6 +483,23 @@ public:
 
     }
 
+    /// Creates stream with encrypted content. Content is decrypted using
+    /// \p decryptor on first call of \p getContent function.
+    /// \param dictionary Stream dictionary (already decrypted)
+    /// \param encryptedContent Encrypted content
+    /// \param decryptor Decryptor of the content
+    inline explicit PDFStream(PDFDictionary&& dictionary, QByteArray&& encryptedContent, Decryptor decryptor) :
+        m_dictionary(std::move(dictionary)),
+        m_content(std::move(encryptedContent)),
+        m_decryptor(std::move(decryptor)),
+        m_isEncrypted(true)
+    {
+
+    }
+
+    PDFStream(const PDFStream& other);
+    PDFStream& operator=(const PDFStream&) = delete;
+
     virtual ~PDFStream() override = default;
 
     virtual bool equals(const PDFObjectContent* other) const override;
@@ -485,12 +510,31 @@ public:
     /// Optimizes the stream for memory consumption
     virtual void optimize() override { m_dictionary.optimize(); m_content.shrink_to_fit(); }
 
-    /// Returns content of the stream
-    const QByteArray* getContent() const { return &m_content; }
+    /// Returns content of the stream. If content is encrypted, then
+    /// it is decrypted first (only once, decrypted content is cached).
+    const QByteArray* getContent() const
+    {
+        if (m_isEncrypted.load(std::memory_order_acquire))
+        {
+            decrypt();
+        }
+
+        return &m_content;
+    }
+
+    /// Returns true, if stream content is still encrypted, i.e.
+    /// content was not accessed yet.
+    bool isEncrypted() const { return m_isEncrypted.load(std::memory_order_acquire); }
 
 private:
+    /// Decrypts the content, thread safe
+    void decrypt() const;
+
     PDFDictionary m_dictionary;
-    QByteArray m_content;
+    mutable QByteArray m_content;
+    mutable Decryptor m_decryptor;
+    mutable QMutex m_decryptMutex;
+    mutable std::atomic_bool m_isEncrypted = false;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFObjectManipulator
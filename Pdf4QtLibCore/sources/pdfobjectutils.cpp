@@ -21,6 +21,8 @@
 #include "pdfdocumentwriter.h"
 #include "pdfdbgheap.h"
 
+#include <numeric>
+
 namespace pdf
 {
 
@@ -271,6 +273,266 @@ QString PDFObjectUtils::getObjectTypeName(PDFObject::Type type)
     return QString();
 }
 
+PDFObjectReferenceGraph::PDFObjectReferenceGraph(const PDFObjectStorage& storage)
+{
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    const size_t objectCount = objects.size();
+
+    std::shared_ptr<CompactGraph> compactGraph = std::make_shared<CompactGraph>();
+    std::vector<PDFInteger>& generations = compactGraph->generations;
+    std::vector<std::vector<PDFObjectReference>> references(objectCount);
+    generations.resize(objectCount, -1);
+
+    PDFIntegerRange<size_t> range(0, objectCount);
+    auto collectReferences = [&objects, &references, &generations](size_t objectNumber)
+    {
+        const PDFObjectStorage::Entry& entry = objects[objectNumber];
+        if (!entry.object.isNull())
+        {
+            generations[objectNumber] = entry.generation;
+
+            std::set<PDFObjectReference> objectReferences = PDFObjectUtils::getDirectReferences(entry.object);
+            references[objectNumber].assign(objectReferences.cbegin(), objectReferences.cend());
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), collectReferences);
+
+    auto isValidCompact = [&generations](PDFObjectReference reference)
+    {
+        return reference.objectNumber >= 0 &&
+               reference.objectNumber < PDFInteger(generations.size()) &&
+               generations[reference.objectNumber] == reference.generation;
+    };
+
+    // Forward edges
+    std::vector<size_t>& forwardOffsets = compactGraph->forwardOffsets;
+    std::vector<PDFObjectReference>& forwardEdges = compactGraph->forwardEdges;
+    forwardOffsets.resize(objectCount + 1, 0);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        forwardOffsets[i + 1] = forwardOffsets[i] + references[i].size();
+    }
+
+    forwardEdges.reserve(forwardOffsets.back());
+    for (const std::vector<PDFObjectReference>& objectReferences : references)
+    {
+        forwardEdges.insert(forwardEdges.end(), objectReferences.cbegin(), objectReferences.cend());
+    }
+
+    // Reverse edges, only edges to existing objects are stored. Sources
+    // are visited in ascending order, so each row is sorted.
+    std::vector<size_t>& reverseOffsets = compactGraph->reverseOffsets;
+    std::vector<PDFInteger>& reverseEdges = compactGraph->reverseEdges;
+    reverseOffsets.resize(objectCount + 1, 0);
+    for (const std::vector<PDFObjectReference>& objectReferences : references)
+    {
+        for (const PDFObjectReference& reference : objectReferences)
+        {
+            if (isValidCompact(reference))
+            {
+                ++reverseOffsets[reference.objectNumber + 1];
+            }
+        }
+    }
+    std::partial_sum(reverseOffsets.begin(), reverseOffsets.end(), reverseOffsets.begin());
+
+    reverseEdges.resize(reverseOffsets.back(), 0);
+    std::vector<size_t> positions(reverseOffsets.cbegin(), std::prev(reverseOffsets.cend()));
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        for (const PDFObjectReference& reference : references[i])
+        {
+            if (isValidCompact(reference))
+            {
+                reverseEdges[positions[reference.objectNumber]++] = PDFInteger(i);
+            }
+        }
+    }
+
+    m_compactGraph = qMove(compactGraph);
+    m_objectCount = objectCount;
+    updateTrailerDictionary(storage.getTrailerDictionary());
+}
+
+PDFInteger PDFObjectReferenceGraph::getGeneration(PDFInteger objectNumber) const
+{
+    auto it = m_updatedObjects.find(objectNumber);
+    if (it != m_updatedObjects.cend())
+    {
+        return it->second.generation;
+    }
+
+    if (objectNumber >= 0 && objectNumber < PDFInteger(m_compactGraph->generations.size()))
+    {
+        return m_compactGraph->generations[objectNumber];
+    }
+
+    return -1;
+}
+
+bool PDFObjectReferenceGraph::isValid(PDFObjectReference reference) const
+{
+    return reference.objectNumber >= 0 &&
+           reference.objectNumber < PDFInteger(m_objectCount) &&
+           getGeneration(reference.objectNumber) == reference.generation;
+}
+
+std::span<const PDFObjectReference> PDFObjectReferenceGraph::getReferences(PDFObjectReference reference) const
+{
+    if (!isValid(reference))
+    {
+        return std::span<const PDFObjectReference>();
+    }
+
+    auto it = m_updatedObjects.find(reference.objectNumber);
+    if (it != m_updatedObjects.cend())
+    {
+        return std::span<const PDFObjectReference>(it->second.references);
+    }
+
+    const size_t objectNumber = reference.objectNumber;
+    const CompactGraph& compactGraph = *m_compactGraph;
+    if (objectNumber + 1 < compactGraph.forwardOffsets.size())
+    {
+        const size_t begin = compactGraph.forwardOffsets[objectNumber];
+        const size_t end = compactGraph.forwardOffsets[objectNumber + 1];
+        return std::span<const PDFObjectReference>(compactGraph.forwardEdges.data() + begin, end - begin);
+    }
+
+    return std::span<const PDFObjectReference>();
+}
+
+std::vector<PDFObjectReference> PDFObjectReferenceGraph::getReferencedBy(PDFObjectReference reference) const
+{
+    std::vector<PDFObjectReference> result;
+
+    if (!isValid(reference))
+    {
+        return result;
+    }
+
+    // Reverse edges of compact arrays can be outdated, so each
+    // candidate is verified against its current forward edges.
+    auto addIfReferencing = [this, &result, reference](PDFInteger objectNumber)
+    {
+        const PDFObjectReference sourceReference(objectNumber, getGeneration(objectNumber));
+        std::span<const PDFObjectReference> references = getReferences(sourceReference);
+        if (std::binary_search(references.begin(), references.end(), reference))
+        {
+            result.push_back(sourceReference);
+        }
+    };
+
+    const size_t objectNumber = reference.objectNumber;
+    const CompactGraph& compactGraph = *m_compactGraph;
+    if (objectNumber + 1 < compactGraph.reverseOffsets.size())
+    {
+        for (size_t i = compactGraph.reverseOffsets[objectNumber]; i < compactGraph.reverseOffsets[objectNumber + 1]; ++i)
+        {
+            const PDFInteger sourceObjectNumber = compactGraph.reverseEdges[i];
+            if (!m_updatedObjects.count(sourceObjectNumber))
+            {
+                addIfReferencing(sourceObjectNumber);
+            }
+        }
+    }
+
+    for (const auto& updatedObject : m_updatedObjects)
+    {
+        addIfReferencing(updatedObject.first);
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<PDFObjectReference> PDFObjectReferenceGraph::getClosure(const std::vector<PDFObjectReference>& references) const
+{
+    std::vector<PDFObjectReference> result;
+    std::vector<bool> visited(m_objectCount, false);
+    std::vector<PDFObjectReference> stack(references.crbegin(), references.crend());
+
+    while (!stack.empty())
+    {
+        const PDFObjectReference reference = stack.back();
+        stack.pop_back();
+
+        if (!isValid(reference) || visited[reference.objectNumber])
+        {
+            continue;
+        }
+
+        visited[reference.objectNumber] = true;
+        result.push_back(reference);
+
+        std::span<const PDFObjectReference> objectReferences = getReferences(reference);
+        stack.insert(stack.end(), objectReferences.begin(), objectReferences.end());
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+bool PDFObjectReferenceGraph::isReachable(PDFObjectReference source, PDFObjectReference target) const
+{
+    if (!isValid(source) || !isValid(target))
+    {
+        return false;
+    }
+
+    std::vector<bool> visited(m_objectCount, false);
+    std::vector<PDFObjectReference> stack = { source };
+
+    while (!stack.empty())
+    {
+        const PDFObjectReference reference = stack.back();
+        stack.pop_back();
+
+        if (reference == target)
+        {
+            return true;
+        }
+
+        if (!isValid(reference) || visited[reference.objectNumber])
+        {
+            continue;
+        }
+
+        visited[reference.objectNumber] = true;
+        std::span<const PDFObjectReference> objectReferences = getReferences(reference);
+        stack.insert(stack.end(), objectReferences.begin(), objectReferences.end());
+    }
+
+    return false;
+}
+
+void PDFObjectReferenceGraph::updateObject(PDFObjectReference reference, const PDFObject& object)
+{
+    if (reference.objectNumber < 0)
+    {
+        return;
+    }
+
+    m_objectCount = qMax(m_objectCount, size_t(reference.objectNumber) + 1);
+
+    UpdatedObject& updatedObject = m_updatedObjects[reference.objectNumber];
+    updatedObject.generation = !object.isNull() ? reference.generation : -1;
+
+    std::set<PDFObjectReference> objectReferences = PDFObjectUtils::getDirectReferences(object);
+    updatedObject.references.assign(objectReferences.cbegin(), objectReferences.cend());
+}
+
+void PDFObjectReferenceGraph::updateTrailerDictionary(const PDFObject& trailerDictionary)
+{
+    std::set<PDFObjectReference> trailerReferences = PDFObjectUtils::getDirectReferences(trailerDictionary);
+    m_trailerReferences.assign(trailerReferences.cbegin(), trailerReferences.cend());
+}
+
+bool PDFObjectReferenceGraph::isRebuildRecommended() const
+{
+    return m_updatedObjects.size() > qMax<size_t>(256, m_objectCount / 8);
+}
+
 void PDFObjectClassifier::classify(const PDFDocument* document)
 {
     // Clear old classification, if it exist
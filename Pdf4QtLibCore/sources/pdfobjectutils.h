@@ -23,6 +23,7 @@
 #include <QtCore>
 
 #include <set>
+#include <span>
 #include <vector>
 #include <atomic>
 
@@ -55,6 +56,93 @@ private:
     PDFObjectUtils() = delete;
 };
 
+/// Reference graph of the object storage. For each object, references to directly
+/// referenced objects (forward edges) and objects directly referencing the object
+/// (reverse edges) are stored in compact arrays (compressed sparse rows). Graph can
+/// be updated incrementally, when objects are changed. References of changed objects
+/// are stored aside of the compact arrays, so after many updates, graph should be rebuilt.
+/// Compact arrays are shared between copies of the graph, so copy of the graph is cheap.
+class PDF4QTLIBCORESHARED_EXPORT PDFObjectReferenceGraph
+{
+public:
+    explicit inline PDFObjectReferenceGraph() = default;
+
+    /// Builds reference graph of the object storage
+    /// \param storage Storage
+    explicit PDFObjectReferenceGraph(const PDFObjectStorage& storage);
+
+    /// Returns true, if reference points to an existing object
+    /// \param reference Reference
+    bool isValid(PDFObjectReference reference) const;
+
+    /// Returns sorted references directly referenced by the object. References
+    /// can point to non-existing objects.
+    /// \param reference Reference to the object
+    std::span<const PDFObjectReference> getReferences(PDFObjectReference reference) const;
+
+    /// Returns sorted references of existing objects, which directly reference the object
+    /// \param reference Reference to the object
+    std::vector<PDFObjectReference> getReferencedBy(PDFObjectReference reference) const;
+
+    /// Returns sorted references directly referenced by the trailer dictionary
+    const std::vector<PDFObjectReference>& getTrailerReferences() const { return m_trailerReferences; }
+
+    /// Returns sorted references of all existing objects reachable from given
+    /// references (including the existing objects from \p references).
+    /// \param references References
+    std::vector<PDFObjectReference> getClosure(const std::vector<PDFObjectReference>& references) const;
+
+    /// Returns sorted references of all existing objects reachable from the trailer dictionary
+    std::vector<PDFObjectReference> getReachableObjects() const { return getClosure(m_trailerReferences); }
+
+    /// Returns true, if object \p target is reachable from object \p source
+    /// \param source Source object
+    /// \param target Target object
+    bool isReachable(PDFObjectReference source, PDFObjectReference target) const;
+
+    /// Updates graph, when object was changed or added
+    /// \param reference Reference to the object
+    /// \param object New value of the object
+    void updateObject(PDFObjectReference reference, const PDFObject& object);
+
+    /// Updates graph, when trailer dictionary was changed
+    /// \param trailerDictionary New trailer dictionary
+    void updateTrailerDictionary(const PDFObject& trailerDictionary);
+
+    /// Returns true, if graph was updated too many times, and should be rebuilt
+    bool isRebuildRecommended() const;
+
+private:
+    /// Compact arrays of the graph. They are not modified after the graph is built,
+    /// so they are shared between copies of the graph.
+    struct CompactGraph
+    {
+        /// Generation of each object, -1 for non-existing (null) objects
+        std::vector<PDFInteger> generations;
+
+        std::vector<size_t> forwardOffsets;
+        std::vector<PDFObjectReference> forwardEdges;
+        std::vector<size_t> reverseOffsets;
+        std::vector<PDFInteger> reverseEdges;
+    };
+
+    struct UpdatedObject
+    {
+        PDFInteger generation = -1;
+        std::vector<PDFObjectReference> references;
+    };
+
+    /// Returns generation of the object, -1 for non-existing object
+    PDFInteger getGeneration(PDFInteger objectNumber) const;
+
+    std::shared_ptr<const CompactGraph> m_compactGraph = std::make_shared<const CompactGraph>();
+    std::vector<PDFObjectReference> m_trailerReferences;
+    size_t m_objectCount = 0;
+
+    /// Updated objects (they override compact arrays)
+    std::map<PDFInteger, UpdatedObject> m_updatedObjects;
+};
+
 /// Storage, which can mark objects (for example, when we want to mark already visited objects
 /// during parsing some complex structure, such as tree)
 class PDFMarkedObjectsContext
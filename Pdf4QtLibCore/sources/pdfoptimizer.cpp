@@ -23,89 +23,1041 @@
 #include "pdfconstants.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfstreamfilters.h"
+#include "pdfimage.h"
+#include "pdfccittfaxdecoder.h"
+#include "pdfparser.h"
 #include "pdfdbgheap.h"
-#include "pdfdocumentwriter.h"
+
+#include <QMutex>
+#include <QBuffer>
+#include <QImageWriter>
+#include <QCryptographicHash>
+
+#include <cmath>
+#include <numeric>
+#include <optional>
 
 namespace pdf
 {
 
-class PDFRemoveSimpleObjectsVisitor : public PDFUpdateObjectVisitor
+class PDFRemoveSimpleObjectsVisitor : public PDFUpdateObjectVisitor
+{
+public:
+    explicit inline PDFRemoveSimpleObjectsVisitor(const PDFObjectStorage* storage, std::atomic<PDFInteger>* counter) :
+        PDFUpdateObjectVisitor(storage),
+        m_counter(counter)
+    {
+
+    }
+
+    virtual void visitReference(const PDFObjectReference reference) override;
+
+private:
+    std::atomic<PDFInteger>* m_counter;
+};
+
+void PDFRemoveSimpleObjectsVisitor::visitReference(const PDFObjectReference reference)
+{
+    PDFObject object = m_storage->getObjectByReference(reference);
+
+    switch (object.getType())
+    {
+        case PDFObject::Type::Null:
+        case PDFObject::Type::Bool:
+        case PDFObject::Type::Int:
+        case PDFObject::Type::Real:
+        case PDFObject::Type::String:
+        case PDFObject::Type::Name:
+            ++*m_counter;
+            m_objectStack.push_back(qMove(object));
+            break;
+
+        default:
+            m_objectStack.push_back(PDFObject::createReference(reference));
+            break;
+    }
+}
+
+class PDFRemoveNullDictionaryEntriesVisitor : public PDFUpdateObjectVisitor
+{
+public:
+    explicit PDFRemoveNullDictionaryEntriesVisitor(const PDFObjectStorage* storage, std::atomic<PDFInteger>* counter) :
+        PDFUpdateObjectVisitor(storage),
+        m_counter(counter)
+    {
+
+    }
+
+    virtual void visitDictionary(const PDFDictionary* dictionary) override;
+
+private:
+    std::atomic<PDFInteger>* m_counter;
+};
+
+void PDFRemoveNullDictionaryEntriesVisitor::visitDictionary(const PDFDictionary* dictionary)
+{
+    Q_ASSERT(dictionary);
+
+    std::vector<PDFDictionary::DictionaryEntry> entries;
+    entries.reserve(dictionary->getCount());
+
+    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    {
+        dictionary->getValue(i).accept(this);
+        Q_ASSERT(!m_objectStack.empty());
+        if (!m_objectStack.back().isNull())
+        {
+            entries.emplace_back(dictionary->getKey(i), m_objectStack.back());
+        }
+        else
+        {
+            ++*m_counter;
+        }
+        m_objectStack.pop_back();
+    }
+
+    m_objectStack.push_back(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(entries))));
+}
+
+/// Computes 128-bit hash of the object content. Referenced objects are not hashed,
+/// just a marker is added to the hash, and reference is stored in the list of references
+/// (in the order of appearance). So hash, together with list of references, identifies
+/// the object.
+class PDFObjectContentHashVisitor : public PDFAbstractVisitor
+{
+public:
+    explicit inline PDFObjectContentHashVisitor(std::vector<PDFObjectReference>* references) :
+        m_hasher(QCryptographicHash::Sha256),
+        m_references(references)
+    {
+
+    }
+
+    using Hash = std::array<uint8_t, 16>;
+
+    virtual void visitNull() override;
+    virtual void visitBool(bool value) override;
+    virtual void visitInt(PDFInteger value) override;
+    virtual void visitReal(PDFReal value) override;
+    virtual void visitString(PDFStringRef string) override;
+    virtual void visitName(PDFStringRef name) override;
+    virtual void visitArray(const PDFArray* array) override;
+    virtual void visitDictionary(const PDFDictionary* dictionary) override;
+    virtual void visitStream(const PDFStream* stream) override;
+    virtual void visitReference(const PDFObjectReference reference) override;
+
+    /// Returns hash of the visited object
+    Hash getHash() const;
+
+    /// Converts result of the cryptographic hash to 128-bit hash
+    static Hash toHash(const QByteArray& hash);
+
+private:
+    template<typename T>
+    void addValue(const T& value) { m_hasher.addData(QByteArrayView(reinterpret_cast<const char*>(&value), sizeof(T))); }
+    void addType(PDFObject::Type type) { addValue(static_cast<uint8_t>(type)); }
+    void addByteArray(const QByteArray& byteArray) { addValue(byteArray.size()); m_hasher.addData(byteArray); }
+
+    QCryptographicHash m_hasher;
+    std::vector<PDFObjectReference>* m_references;
+};
+
+void PDFObjectContentHashVisitor::visitNull()
+{
+    addType(PDFObject::Type::Null);
+}
+
+void PDFObjectContentHashVisitor::visitBool(bool value)
+{
+    addType(PDFObject::Type::Bool);
+    addValue(value);
+}
+
+void PDFObjectContentHashVisitor::visitInt(PDFInteger value)
+{
+    addType(PDFObject::Type::Int);
+    addValue(value);
+}
+
+void PDFObjectContentHashVisitor::visitReal(PDFReal value)
+{
+    addType(PDFObject::Type::Real);
+    addValue(value);
+}
+
+void PDFObjectContentHashVisitor::visitString(PDFStringRef string)
+{
+    addType(PDFObject::Type::String);
+    addByteArray(string.getString());
+}
+
+void PDFObjectContentHashVisitor::visitName(PDFStringRef name)
+{
+    addType(PDFObject::Type::Name);
+    addByteArray(name.getString());
+}
+
+void PDFObjectContentHashVisitor::visitArray(const PDFArray* array)
+{
+    addType(PDFObject::Type::Array);
+    addValue(array->getCount());
+    acceptArray(array);
+}
+
+void PDFObjectContentHashVisitor::visitDictionary(const PDFDictionary* dictionary)
+{
+    addType(PDFObject::Type::Dictionary);
+    addValue(dictionary->getCount());
+
+    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    {
+        addByteArray(dictionary->getKey(i).getString());
+        dictionary->getValue(i).accept(this);
+    }
+}
+
+void PDFObjectContentHashVisitor::visitStream(const PDFStream* stream)
+{
+    addType(PDFObject::Type::Stream);
+    visitDictionary(stream->getDictionary());
+    addByteArray(*stream->getContent());
+}
+
+void PDFObjectContentHashVisitor::visitReference(const PDFObjectReference reference)
+{
+    addType(PDFObject::Type::Reference);
+    m_references->push_back(reference);
+}
+
+PDFObjectContentHashVisitor::Hash PDFObjectContentHashVisitor::getHash() const
+{
+    return toHash(m_hasher.result());
+}
+
+PDFObjectContentHashVisitor::Hash PDFObjectContentHashVisitor::toHash(const QByteArray& hash)
+{
+    Hash result = { };
+    Q_ASSERT(hash.size() >= qsizetype(result.size()));
+    std::copy(hash.cbegin(), std::next(hash.cbegin(), result.size()), result.begin());
+    return result;
+}
+
+/// Computes effective resolution of image XObjects painted from page content
+/// streams (forms are processed recursively). If image is painted multiple
+/// times, then the lowest resolution is used, so downsampling of the image
+/// doesn't degrade any of its placements. Images used by patterns, Type 3 fonts,
+/// soft masks of graphic states and annotation appearances are not scanned,
+/// so they get zero resolution (unknown), and they are not downsampled.
+class PDFImageResolutionScanner
+{
+public:
+    explicit PDFImageResolutionScanner(const PDFDocument* document) :
+        m_document(document)
+    {
+
+    }
+
+    struct Resolution
+    {
+        PDFReal x = std::numeric_limits<PDFReal>::infinity();
+        PDFReal y = std::numeric_limits<PDFReal>::infinity();
+    };
+
+    using Resolutions = std::map<PDFObjectReference, Resolution>;
+
+    /// Scans all pages of the document and returns resolutions of placed images
+    Resolutions scan() const;
+
+private:
+    static constexpr int MAX_FORM_DEPTH = 16;
+
+    void scanPage(const PDFPage* page, Resolutions& resolutions) const;
+    void scanContentStream(const QByteArray& content, const PDFObject& resources, QTransform matrix, int depth, Resolutions& resolutions) const;
+    void addImagePlacement(PDFObjectReference reference, const PDFStream* stream, const QTransform& matrix, bool isSoftMask, Resolutions& resolutions) const;
+
+    /// Prevents downsampling of images from resources (used, when content stream can't be parsed)
+    void addUnknownPlacements(const PDFObject& resources, Resolutions& resolutions) const;
+
+    /// Prevents downsampling of images reachable from given object, which
+    /// is not scanned (pattern, font, annotation appearance, ...)
+    void addUnscannedPlacements(const PDFObject& object, Resolutions& resolutions) const;
+
+    static void updateResolution(Resolutions& resolutions, PDFObjectReference reference, Resolution resolution);
+
+    const PDFDocument* m_document;
+};
+
+PDFImageResolutionScanner::Resolutions PDFImageResolutionScanner::scan() const
+{
+    const PDFCatalog* catalog = m_document->getCatalog();
+    std::vector<size_t> pageIndices(catalog->getPageCount(), 0);
+    std::iota(pageIndices.begin(), pageIndices.end(), 0);
+
+    QMutex mutex;
+    Resolutions result;
+
+    auto scanPageImpl = [this, catalog, &mutex, &result](size_t pageIndex)
+    {
+        Resolutions resolutions;
+        scanPage(catalog->getPage(pageIndex), resolutions);
+
+        QMutexLocker lock(&mutex);
+        for (const auto& item : resolutions)
+        {
+            updateResolution(result, item.first, item.second);
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageIndices.begin(), pageIndices.end(), scanPageImpl);
+    return result;
+}
+
+void PDFImageResolutionScanner::scanPage(const PDFPage* page, Resolutions& resolutions) const
+{
+    const PDFObject& resources = m_document->getObject(page->getResources());
+
+    try
+    {
+        QByteArray content;
+        auto addContentStream = [this, &content](const PDFObject& object)
+        {
+            const PDFObject& dereferencedObject = m_document->getObject(object);
+            if (dereferencedObject.isStream())
+            {
+                content.append(m_document->getDecodedStream(dereferencedObject.getStream()));
+                content.append('\n');
+            }
+        };
+
+        const PDFObject& contents = m_document->getObject(page->getContents());
+        if (contents.isArray())
+        {
+            const PDFArray* contentsArray = contents.getArray();
+            for (size_t i = 0, count = contentsArray->getCount(); i < count; ++i)
+            {
+                addContentStream(contentsArray->getItem(i));
+            }
+        }
+        else
+        {
+            addContentStream(contents);
+        }
+
+        // Default user space unit is 1/72 inch multiplied by page's user unit
+        const PDFReal userUnit = page->getUserUnit();
+        scanContentStream(content, resources, QTransform::fromScale(userUnit, userUnit), 0, resolutions);
+    }
+    catch (const PDFException&)
+    {
+        addUnknownPlacements(resources, resolutions);
+    }
+
+    // Appearance streams can be painted anywhere (and scaled arbitrarily)
+    for (const PDFObjectReference& annotationReference : page->getAnnotations())
+    {
+        const PDFObject& annotation = m_document->getObjectByReference(annotationReference);
+        if (annotation.isDictionary())
+        {
+            addUnscannedPlacements(annotation.getDictionary()->get("AP"), resolutions);
+        }
+    }
+}
+
+void PDFImageResolutionScanner::scanContentStream(const QByteArray& content, const PDFObject& resources, QTransform matrix, int depth, Resolutions& resolutions) const
+{
+    if (depth > MAX_FORM_DEPTH)
+    {
+        throw PDFException(PDFTranslationContext::tr("Form nesting is too deep."));
+    }
+
+    const PDFDictionary* xobjectDictionary = nullptr;
+    const PDFObject& resourcesObject = m_document->getObject(resources);
+    if (resourcesObject.isDictionary())
+    {
+        const PDFDictionary* resourcesDictionary = resourcesObject.getDictionary();
+        const PDFObject& xobjectObject = m_document->getObject(resourcesDictionary->get("XObject"));
+        if (xobjectObject.isDictionary())
+        {
+            xobjectDictionary = xobjectObject.getDictionary();
+        }
+
+        addUnscannedPlacements(resourcesDictionary->get("Pattern"), resolutions);
+        addUnscannedPlacements(resourcesDictionary->get("Font"), resolutions);
+        addUnscannedPlacements(resourcesDictionary->get("ExtGState"), resolutions);
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    PDFLexicalAnalyzer parser(content.constBegin(), content.constEnd());
+    std::vector<PDFLexicalAnalyzer::Token> operands;
+    std::vector<QTransform> matrixStack;
+
+    for (PDFLexicalAnalyzer::Token token = parser.fetch(); token.type != PDFLexicalAnalyzer::TokenType::EndOfFile; token = parser.fetch())
+    {
+        if (token.type != PDFLexicalAnalyzer::TokenType::Command)
+        {
+            operands.push_back(qMove(token));
+            continue;
+        }
+
+        const QByteArray command = token.data.toByteArray();
+        if (command == "q")
+        {
+            matrixStack.push_back(matrix);
+        }
+        else if (command == "Q")
+        {
+            if (!matrixStack.empty())
+            {
+                matrix = matrixStack.back();
+                matrixStack.pop_back();
+            }
+        }
+        else if (command == "cm" && operands.size() >= 6)
+        {
+            PDFReal values[6] = { };
+            for (size_t i = 0; i < std::size(values); ++i)
+            {
+                values[i] = operands[operands.size() - std::size(values) + i].data.toDouble();
+            }
+
+            matrix = QTransform(values[0], values[1], values[2], values[3], values[4], values[5]) * matrix;
+        }
+        else if (command == "Do" && xobjectDictionary && !operands.empty() && operands.back().type == PDFLexicalAnalyzer::TokenType::Name)
+        {
+            const PDFObject& xobjectReference = xobjectDictionary->get(operands.back().data.toByteArray());
+            const PDFObject& xobject = m_document->getObject(xobjectReference);
+            if (xobject.isStream())
+            {
+                const PDFStream* stream = xobject.getStream();
+                const PDFDictionary* streamDictionary = stream->getDictionary();
+                const QByteArray subtype = loader.readNameFromDictionary(streamDictionary, "Subtype");
+
+                if (subtype == "Image" && xobjectReference.isReference())
+                {
+                    addImagePlacement(xobjectReference.getReference(), stream, matrix, false, resolutions);
+                }
+                else if (subtype == "Form")
+                {
+                    const QTransform formMatrix = loader.readMatrixFromDictionary(streamDictionary, "Matrix", QTransform());
+                    const PDFObject& formResources = streamDictionary->hasKey("Resources") ? streamDictionary->get("Resources") : resources;
+                    scanContentStream(m_document->getDecodedStream(stream), formResources, formMatrix * matrix, depth + 1, resolutions);
+                }
+            }
+        }
+        else if (command == "BI")
+        {
+            // Inline image data can contain arbitrary bytes, so we must skip them
+            const PDFInteger operatorIDPosition = parser.findSubstring("ID", parser.pos());
+            const PDFInteger operatorEIPosition = operatorIDPosition != -1 ? parser.findSubstring("EI", operatorIDPosition + 3) : -1;
+
+            if (operatorEIPosition == -1)
+            {
+                throw PDFException(PDFTranslationContext::tr("Invalid inline image dictionary, ID operator is missing."));
+            }
+
+            parser.seek(operatorEIPosition + 2);
+        }
+
+        operands.clear();
+    }
+}
+
+void PDFImageResolutionScanner::addImagePlacement(PDFObjectReference reference, const PDFStream* stream, const QTransform& matrix, bool isSoftMask, Resolutions& resolutions) const
+{
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* dictionary = stream->getDictionary();
+    const PDFReal width = loader.readIntegerFromDictionary(dictionary, "Width", 0);
+    const PDFReal height = loader.readIntegerFromDictionary(dictionary, "Height", 0);
+
+    // Image is painted into the unit square mapped by the matrix, so lengths
+    // of mapped unit vectors are sizes of the image in points (1/72 inch).
+    // Degenerate placement prevents downsampling at all.
+    const PDFReal placementWidth = std::hypot(matrix.m11(), matrix.m12());
+    const PDFReal placementHeight = std::hypot(matrix.m21(), matrix.m22());
+
+    Resolution resolution;
+    resolution.x = placementWidth > PDF_EPSILON ? width * 72.0 / placementWidth : 0.0;
+    resolution.y = placementHeight > PDF_EPSILON ? height * 72.0 / placementHeight : 0.0;
+    updateResolution(resolutions, reference, resolution);
+
+    // Soft mask is painted at the same place as the image
+    const PDFObject& softMask = dictionary->get("SMask");
+    if (!isSoftMask && softMask.isReference())
+    {
+        const PDFObject& softMaskObject = m_document->getObject(softMask);
+        if (softMaskObject.isStream())
+        {
+            addImagePlacement(softMask.getReference(), softMaskObject.getStream(), matrix, true, resolutions);
+        }
+    }
+}
+
+void PDFImageResolutionScanner::addUnknownPlacements(const PDFObject& resources, Resolutions& resolutions) const
+{
+    const PDFObject& resourcesObject = m_document->getObject(resources);
+    if (!resourcesObject.isDictionary())
+    {
+        return;
+    }
+
+    const PDFObject& xobjectObject = m_document->getObject(resourcesObject.getDictionary()->get("XObject"));
+    if (!xobjectObject.isDictionary())
+    {
+        return;
+    }
+
+    const PDFDictionary* xobjectDictionary = xobjectObject.getDictionary();
+    for (size_t i = 0, count = xobjectDictionary->getCount(); i < count; ++i)
+    {
+        const PDFObject& xobjectReference = xobjectDictionary->getValue(i);
+        const PDFObject& xobject = m_document->getObject(xobjectReference);
+        if (xobjectReference.isReference() && xobject.isStream())
+        {
+            updateResolution(resolutions, xobjectReference.getReference(), Resolution{ 0.0, 0.0 });
+
+            const PDFObject& softMask = xobject.getStream()->getDictionary()->get("SMask");
+            if (softMask.isReference())
+            {
+                updateResolution(resolutions, softMask.getReference(), Resolution{ 0.0, 0.0 });
+            }
+        }
+    }
+}
+
+void PDFImageResolutionScanner::addUnscannedPlacements(const PDFObject& object, Resolutions& resolutions) const
+{
+    std::set<PDFObjectReference> directReferences = PDFObjectUtils::getDirectReferences(object);
+    if (directReferences.empty())
+    {
+        return;
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    std::shared_ptr<const PDFObjectReferenceGraph> graph = m_document->getStorage().getReferenceGraph();
+    for (const PDFObjectReference& reference : graph->getClosure(std::vector<PDFObjectReference>(directReferences.cbegin(), directReferences.cend())))
+    {
+        const PDFObject& referencedObject = m_document->getObjectByReference(reference);
+        if (referencedObject.isStream() && loader.readNameFromDictionary(referencedObject.getStream()->getDictionary(), "Subtype") == "Image")
+        {
+            updateResolution(resolutions, reference, Resolution{ 0.0, 0.0 });
+        }
+    }
+}
+
+void PDFImageResolutionScanner::updateResolution(Resolutions& resolutions, PDFObjectReference reference, Resolution resolution)
+{
+    Resolution& currentResolution = resolutions[reference];
+    currentResolution.x = qMin(currentResolution.x, resolution.x);
+    currentResolution.y = qMin(currentResolution.y, resolution.y);
+}
+
+/// Recompresses single image XObject. Image is decoded, downsampled (if its effective
+/// resolution is too high) and encoded again - bitonal images by CCITT Group 4 filter,
+/// images originally encoded by DCT filter again by DCT filter, and other images by
+/// Flate filter. Recompressed image is used only, if it is smaller than original one.
+class PDFImageRecompressor
+{
+public:
+    using Resolution = PDFImageResolutionScanner::Resolution;
+
+    explicit PDFImageRecompressor(const PDFDocument* document, const PDFOptimizer::ImageSettings& settings) :
+        m_document(document),
+        m_settings(settings)
+    {
+
+    }
+
+    struct Result
+    {
+        PDFObject object;   ///< Updated image, or null object, if image was not changed
+        PDFInteger bytesSaved = 0;
+        bool isRecompressed = false;
+        bool isSoftMaskRemoved = false;
+    };
+
+    /// Recompresses the image
+    /// \param stream Image stream
+    /// \param isSoftMask Is image a soft mask of another image?
+    /// \param resolution Effective resolution of the image (zero, if not known)
+    Result recompress(const PDFStream* stream, bool isSoftMask, Resolution resolution) const;
+
+private:
+    /// Recompresses image data, dictionary entries describing image data are updated.
+    /// Returns true, if image was recompressed.
+    bool recompressImageData(const PDFStream* stream, bool isSoftMask, Resolution resolution, PDFDictionary& dictionary, QByteArray& content) const;
+
+    /// Returns true, if image has fully opaque soft mask, which can be removed
+    bool isSoftMaskRedundant(const PDFDictionary* dictionary) const;
+
+    /// Returns true, if image contains only black and white samples (image
+    /// must have one component with 8 bits per component)
+    static bool isBitonal(const PDFImageData& imageData);
+
+    /// Converts one bit image to eight bits per component image
+    static PDFImageData expandBitonal(const PDFImageData& imageData);
+
+    /// Packs one component image to one bit per sample. Bit is set,
+    /// if sample is in the upper half of the range.
+    static QByteArray packBitonal(const PDFImageData& imageData);
+
+    /// Downsamples eight bits per component image to the given size
+    /// using area averaging (box filter).
+    static PDFImageData downsample(const PDFImageData& imageData, unsigned int width, unsigned int height);
+
+    /// Encodes one or three component image using DCT filter. Empty
+    /// byte array is returned, if image can't be encoded.
+    QByteArray encodeDCT(const PDFImageData& imageData) const;
+
+    const PDFDocument* m_document;
+    PDFOptimizer::ImageSettings m_settings;
+};
+
+PDFImageRecompressor::Result PDFImageRecompressor::recompress(const PDFStream* stream, bool isSoftMask, Resolution resolution) const
+{
+    Result result;
+
+    try
+    {
+        PDFDictionary dictionary = *stream->getDictionary();
+        QByteArray content = *stream->getContent();
+
+        if (!isSoftMask && isSoftMaskRedundant(&dictionary))
+        {
+            dictionary.removeEntry("SMask");
+            result.isSoftMaskRemoved = true;
+        }
+
+        result.isRecompressed = recompressImageData(stream, isSoftMask, resolution, dictionary, content);
+        if (result.isRecompressed || result.isSoftMaskRemoved)
+        {
+            result.bytesSaved = stream->getContent()->size() - content.size();
+            result.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), qMove(content)));
+        }
+    }
+    catch (const PDFException&)
+    {
+        // Image can't be decoded, leave it unchanged
+        result = Result();
+    }
+    catch (const PDFRendererException&)
+    {
+        result = Result();
+    }
+
+    return result;
+}
+
+bool PDFImageRecompressor::recompressImageData(const PDFStream* stream, bool isSoftMask, Resolution resolution, PDFDictionary& dictionary, QByteArray& content) const
+{
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* streamDictionary = stream->getDictionary();
+
+    if (streamDictionary->hasKey("F") ||
+        streamDictionary->hasKey("Matte") ||
+        streamDictionary->hasKey("SMaskInData") ||
+        loader.readBooleanFromDictionary(streamDictionary, "ImageMask", false) ||
+        m_document->getObject(streamDictionary->get("Mask")).isArray())
+    {
+        // External streams, stencil masks, premultiplied soft masks and
+        // images masked by color key are left unchanged.
+        return false;
+    }
+
+    const PDFObject& softMaskObject = m_document->getObject(streamDictionary->get("SMask"));
+    if (!isSoftMask && softMaskObject.isStream() && softMaskObject.getStream()->getDictionary()->hasKey("Matte"))
+    {
+        // Colors of the image are premultiplied by the soft mask, which
+        // must have the same dimensions as the image, and the soft mask
+        // itself is left unchanged.
+        return false;
+    }
+
+    QByteArray filterName;
+    const PDFObject& filters = m_document->getObject(streamDictionary->get(PDF_STREAM_DICT_FILTER));
+    if (filters.isName())
+    {
+        filterName = filters.getString();
+    }
+    else if (filters.isArray() && filters.getArray()->getCount() > 0)
+    {
+        const PDFArray* filterArray = filters.getArray();
+        const PDFObject& lastFilter = m_document->getObject(filterArray->getItem(filterArray->getCount() - 1));
+        if (lastFilter.isName())
+        {
+            filterName = lastFilter.getString();
+        }
+    }
+    else if (!filters.isNull())
+    {
+        return false;
+    }
+
+    // Images encoded by JPX, JBIG2 or CCITT filters are already encoded
+    // efficiently by image specific compression, so we do not touch them.
+    static constexpr const char* SUPPORTED_FILTERS[] = { "", "FlateDecode", "Fl", "LZWDecode", "LZW", "RunLengthDecode", "RL",
+                                                         "ASCIIHexDecode", "AHx", "ASCII85Decode", "A85", "DCTDecode", "DCT" };
+    if (std::find(std::cbegin(SUPPORTED_FILTERS), std::cend(SUPPORTED_FILTERS), filterName) == std::cend(SUPPORTED_FILTERS))
+    {
+        return false;
+    }
+    const bool isDCT = filterName == "DCTDecode" || filterName == "DCT";
+
+    PDFColorSpacePointer colorSpace;
+    if (isSoftMask)
+    {
+        colorSpace.reset(new PDFDeviceGrayColorSpace());
+    }
+    else
+    {
+        const PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
+        if (!colorSpaceObject.isName() && !colorSpaceObject.isArray())
+        {
+            return false;
+        }
+
+        colorSpace = PDFAbstractColorSpace::createColorSpace(nullptr, m_document, colorSpaceObject);
+    }
+
+    if (!colorSpace || colorSpace->getColorSpace() == PDFAbstractColorSpace::ColorSpace::Indexed)
+    {
+        // Indices of indexed color space can't be averaged
+        return false;
+    }
+
+    // Masks are separate images, we do not want to decode them
+    PDFDictionary decodedDictionary = *streamDictionary;
+    decodedDictionary.removeEntry("SMask");
+    decodedDictionary.removeEntry("Mask");
+    PDFStream decodedStream(qMove(decodedDictionary), QByteArray(*stream->getContent()));
+
+    PDFRenderErrorReporterDummy reporter;
+    PDFImage image = PDFImage::createImage(m_document, &decodedStream, qMove(colorSpace), isSoftMask, RenderingIntent::Perceptual, &reporter);
+    PDFImageData imageData = image.getImageData();
+
+    const unsigned int components = imageData.getComponents();
+    const unsigned int bitsPerComponent = imageData.getBitsPerComponent();
+    const bool isOneBitImage = components == 1 && bitsPerComponent == 1;
+
+    if (imageData.getWidth() == 0 ||
+        imageData.getHeight() == 0 ||
+        (!isOneBitImage && bitsPerComponent != 8) ||
+        imageData.getData().size() < qsizetype(imageData.getStride()) * imageData.getHeight())
+    {
+        return false;
+    }
+
+    if (isDCT && components == 4)
+    {
+        // Four component JPEG images can be stored inverted (Adobe APP14 marker),
+        // and viewers differ in their interpretation. We keep them unchanged.
+        return false;
+    }
+
+    if (isOneBitImage)
+    {
+        imageData = expandBitonal(imageData);
+    }
+
+    const bool isBitonalImage = isOneBitImage || (components == 1 && isBitonal(imageData));
+    const PDFReal targetResolution = isBitonalImage ? m_settings.bitonalTargetResolution : m_settings.targetResolution;
+
+    auto getTargetSize = [this, targetResolution](unsigned int size, PDFReal resolution) -> unsigned int
+    {
+        if (std::isfinite(resolution) && resolution > targetResolution * m_settings.resolutionThreshold)
+        {
+            return qMax(1u, static_cast<unsigned int>(std::round(size * targetResolution / resolution)));
+        }
+
+        return size;
+    };
+
+    const unsigned int width = getTargetSize(imageData.getWidth(), resolution.x);
+    const unsigned int height = getTargetSize(imageData.getHeight(), resolution.y);
+    const bool isDownsampled = width != imageData.getWidth() || height != imageData.getHeight();
+
+    if (isDCT && !isDownsampled)
+    {
+        // Encoding lossy image again would only degrade its quality
+        return false;
+    }
+
+    if (isDownsampled)
+    {
+        imageData = downsample(imageData, width, height);
+    }
+
+    QByteArray encodedData;
+    PDFObject filter;
+    PDFObject decodeParameters;
+    PDFInteger encodedBitsPerComponent = 8;
+
+    if (isBitonalImage)
+    {
+        QByteArray packedData = packBitonal(imageData);
+        QByteArray ccittData = PDFCCITTFaxEncoder::encode(packedData, int(width), int(height), int((width + 7) / 8));
+        QByteArray flateData = PDFFlateDecodeFilter::compress(packedData);
+        encodedBitsPerComponent = 1;
+
+        if (ccittData.size() < flateData.size())
+        {
+            PDFObjectFactory factory;
+            factory.beginDictionary();
+            factory.beginDictionaryItem("K");
+            factory << PDFInteger(-1);
+            factory.endDictionaryItem();
+            factory.beginDictionaryItem("Columns");
+            factory << PDFInteger(width);
+            factory.endDictionaryItem();
+            factory.beginDictionaryItem("Rows");
+            factory << PDFInteger(height);
+            factory.endDictionaryItem();
+            factory.endDictionary();
+
+            encodedData = qMove(ccittData);
+            filter = PDFObject::createName("CCITTFaxDecode");
+            decodeParameters = factory.takeObject();
+        }
+        else
+        {
+            encodedData = qMove(flateData);
+            filter = PDFObject::createName("FlateDecode");
+        }
+    }
+    else
+    {
+        if (isDCT && (components == 1 || components == 3))
+        {
+            encodedData = encodeDCT(imageData);
+            filter = PDFObject::createName("DCTDecode");
+        }
+
+        if (encodedData.isEmpty())
+        {
+            encodedData = PDFFlateDecodeFilter::compress(imageData.getData());
+            filter = PDFObject::createName("FlateDecode");
+        }
+    }
+
+    if (encodedData.size() >= stream->getContent()->size())
+    {
+        return false;
+    }
+
+    dictionary.removeEntry("DL");
+    dictionary.removeEntry(PDF_STREAM_DICT_DECODE_PARMS);
+    dictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_FILTER), qMove(filter));
+    if (!decodeParameters.isNull())
+    {
+        dictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_DECODE_PARMS), qMove(decodeParameters));
+    }
+    dictionary.setEntry(PDFInplaceOrMemoryString("Width"), PDFObject::createInteger(width));
+    dictionary.setEntry(PDFInplaceOrMemoryString("Height"), PDFObject::createInteger(height));
+    dictionary.setEntry(PDFInplaceOrMemoryString("BitsPerComponent"), PDFObject::createInteger(encodedBitsPerComponent));
+    dictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_LENGTH), PDFObject::createInteger(encodedData.size()));
+    content = qMove(encodedData);
+    return true;
+}
+
+bool PDFImageRecompressor::isSoftMaskRedundant(const PDFDictionary* dictionary) const
+{
+    // Soft mask overrides the Mask entry, so we can't remove it in this case.
+    // Also, image soft mask overrides soft mask from graphic state, we assume,
+    // that images with soft mask are painted without graphic state soft mask.
+    if (dictionary->hasKey("Mask"))
+    {
+        return false;
+    }
+
+    const PDFObject& softMaskObject = m_document->getObject(dictionary->get("SMask"));
+    if (!softMaskObject.isStream())
+    {
+        return false;
+    }
+
+    PDFRenderErrorReporterDummy reporter;
+    PDFImage softMask = PDFImage::createImage(m_document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, RenderingIntent::Perceptual, &reporter);
+    const PDFImageData& imageData = softMask.getImageData();
+    const unsigned int bitsPerComponent = imageData.getBitsPerComponent();
+
+    if (imageData.getComponents() != 1 ||
+        bitsPerComponent < 1 || bitsPerComponent > 16 ||
+        imageData.getWidth() == 0 || imageData.getHeight() == 0 ||
+        imageData.getData().size() < qsizetype(imageData.getStride()) * imageData.getHeight())
+    {
+        return false;
+    }
+
+    std::vector<PDFReal> decode = imageData.getDecode();
+    if (decode.size() < 2)
+    {
+        decode = { 0.0, 1.0 };
+    }
+
+    PDFBitReader reader(&imageData.getData(), bitsPerComponent);
+    const PDFReal coefficient = (decode[1] - decode[0]) / reader.max();
+
+    for (unsigned int row = 0; row < imageData.getHeight(); ++row)
+    {
+        reader.seek(qint64(row) * imageData.getStride());
+        for (unsigned int column = 0; column < imageData.getWidth(); ++column)
+        {
+            const PDFReal alpha = decode[0] + reader.read() * coefficient;
+            if (alpha < 1.0 - PDF_EPSILON)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool PDFImageRecompressor::isBitonal(const PDFImageData& imageData)
 {
-public:
-    explicit inline PDFRemoveSimpleObjectsVisitor(const PDFObjectStorage* storage, std::atomic<PDFInteger>* counter) :
-        PDFUpdateObjectVisitor(storage),
-        m_counter(counter)
-    {
+    Q_ASSERT(imageData.getComponents() == 1 && imageData.getBitsPerComponent() == 8);
 
+    for (unsigned int row = 0; row < imageData.getHeight(); ++row)
+    {
+        const uint8_t* line = reinterpret_cast<const uint8_t*>(imageData.getRow(row));
+        if (!std::all_of(line, line + imageData.getWidth(), [](uint8_t value) { return value == 0x00 || value == 0xFF; }))
+        {
+            return false;
+        }
     }
 
-    virtual void visitReference(const PDFObjectReference reference) override;
-
-private:
-    std::atomic<PDFInteger>* m_counter;
-};
+    return true;
+}
 
-void PDFRemoveSimpleObjectsVisitor::visitReference(const PDFObjectReference reference)
+PDFImageData PDFImageRecompressor::expandBitonal(const PDFImageData& imageData)
 {
-    PDFObject object = m_storage->getObjectByReference(reference);
+    Q_ASSERT(imageData.getComponents() == 1 && imageData.getBitsPerComponent() == 1);
 
-    switch (object.getType())
-    {
-        case PDFObject::Type::Null:
-        case PDFObject::Type::Bool:
-        case PDFObject::Type::Int:
-        case PDFObject::Type::Real:
-        case PDFObject::Type::String:
-        case PDFObject::Type::Name:
-            ++*m_counter;
-            m_objectStack.push_back(qMove(object));
-            break;
+    const unsigned int width = imageData.getWidth();
+    const unsigned int height = imageData.getHeight();
+    QByteArray data(qsizetype(width) * height, Qt::Uninitialized);
+    uint8_t* target = reinterpret_cast<uint8_t*>(data.data());
 
-        default:
-            m_objectStack.push_back(PDFObject::createReference(reference));
-            break;
+    for (unsigned int row = 0; row < height; ++row)
+    {
+        const uint8_t* line = reinterpret_cast<const uint8_t*>(imageData.getRow(row));
+        for (unsigned int column = 0; column < width; ++column)
+        {
+            *target++ = (line[column / 8] & (0x80 >> (column % 8))) ? 0xFF : 0x00;
+        }
     }
+
+    return PDFImageData(1, 8, width, height, width, imageData.getMaskingType(), qMove(data), { }, { }, { });
 }
 
-class PDFRemoveNullDictionaryEntriesVisitor : public PDFUpdateObjectVisitor
+QByteArray PDFImageRecompressor::packBitonal(const PDFImageData& imageData)
 {
-public:
-    explicit PDFRemoveNullDictionaryEntriesVisitor(const PDFObjectStorage* storage, std::atomic<PDFInteger>* counter) :
-        PDFUpdateObjectVisitor(storage),
-        m_counter(counter)
+    Q_ASSERT(imageData.getComponents() == 1 && imageData.getBitsPerComponent() == 8);
+
+    const unsigned int width = imageData.getWidth();
+    const unsigned int height = imageData.getHeight();
+    const unsigned int stride = (width + 7) / 8;
+    QByteArray data(qsizetype(stride) * height, 0);
+
+    for (unsigned int row = 0; row < height; ++row)
     {
+        const uint8_t* line = reinterpret_cast<const uint8_t*>(imageData.getRow(row));
+        uint8_t* target = reinterpret_cast<uint8_t*>(data.data()) + qsizetype(row) * stride;
 
+        for (unsigned int column = 0; column < width; ++column)
+        {
+            if (line[column] >= 0x80)
+            {
+                target[column / 8] |= 0x80 >> (column % 8);
+            }
+        }
     }
 
-    virtual void visitDictionary(const PDFDictionary* dictionary) override;
-
-private:
-    std::atomic<PDFInteger>* m_counter;
-};
+    return data;
+}
 
-void PDFRemoveNullDictionaryEntriesVisitor::visitDictionary(const PDFDictionary* dictionary)
+PDFImageData PDFImageRecompressor::downsample(const PDFImageData& imageData, unsigned int width, unsigned int height)
 {
-    Q_ASSERT(dictionary);
+    Q_ASSERT(imageData.getBitsPerComponent() == 8);
+    Q_ASSERT(width <= imageData.getWidth() && height <= imageData.getHeight());
 
-    std::vector<PDFDictionary::DictionaryEntry> entries;
-    entries.reserve(dictionary->getCount());
+    const unsigned int components = imageData.getComponents();
+    const unsigned int stride = width * components;
+    QByteArray data(qsizetype(stride) * height, Qt::Uninitialized);
 
-    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    // Target pixel covers source pixels [starts[i], starts[i + 1])
+    auto getStarts = [](unsigned int sourceSize, unsigned int targetSize)
     {
-        dictionary->getValue(i).accept(this);
-        Q_ASSERT(!m_objectStack.empty());
-        if (!m_objectStack.back().isNull())
+        std::vector<unsigned int> starts(targetSize + 1, 0);
+        for (unsigned int i = 0; i <= targetSize; ++i)
         {
-            entries.emplace_back(dictionary->getKey(i), m_objectStack.back());
+            starts[i] = static_cast<unsigned int>(uint64_t(i) * sourceSize / targetSize);
         }
-        else
+        return starts;
+    };
+
+    const std::vector<unsigned int> columnStarts = getStarts(imageData.getWidth(), width);
+    const std::vector<unsigned int> rowStarts = getStarts(imageData.getHeight(), height);
+    std::vector<uint64_t> sums(stride, 0);
+
+    for (unsigned int row = 0; row < height; ++row)
+    {
+        std::fill(sums.begin(), sums.end(), 0);
+
+        for (unsigned int sourceRow = rowStarts[row]; sourceRow < rowStarts[row + 1]; ++sourceRow)
         {
-            ++*m_counter;
+            const uint8_t* line = reinterpret_cast<const uint8_t*>(imageData.getRow(sourceRow));
+            for (unsigned int column = 0; column < width; ++column)
+            {
+                uint64_t* sum = sums.data() + size_t(column) * components;
+                for (unsigned int sourceColumn = columnStarts[column]; sourceColumn < columnStarts[column + 1]; ++sourceColumn)
+                {
+                    const uint8_t* pixel = line + size_t(sourceColumn) * components;
+                    for (unsigned int component = 0; component < components; ++component)
+                    {
+                        sum[component] += pixel[component];
+                    }
+                }
+            }
+        }
+
+        uint8_t* target = reinterpret_cast<uint8_t*>(data.data()) + qsizetype(row) * stride;
+        for (unsigned int column = 0; column < width; ++column)
+        {
+            const uint64_t count = uint64_t(rowStarts[row + 1] - rowStarts[row]) * (columnStarts[column + 1] - columnStarts[column]);
+            for (unsigned int component = 0; component < components; ++component)
+            {
+                const size_t index = size_t(column) * components + component;
+                target[index] = static_cast<uint8_t>((sums[index] + count / 2) / count);
+            }
         }
-        m_objectStack.pop_back();
     }
 
-    m_objectStack.push_back(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(entries))));
+    return PDFImageData(components, 8, width, height, stride, imageData.getMaskingType(), qMove(data), { }, { }, { });
+}
+
+QByteArray PDFImageRecompressor::encodeDCT(const PDFImageData& imageData) const
+{
+    Q_ASSERT(imageData.getComponents() == 1 || imageData.getComponents() == 3);
+
+    const QImage::Format format = imageData.getComponents() == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888;
+    const QImage image(reinterpret_cast<const uchar*>(imageData.getData().constData()), int(imageData.getWidth()), int(imageData.getHeight()), int(imageData.getStride()), format);
+
+    QByteArray result;
+    QBuffer buffer(&result);
+    if (!buffer.open(QBuffer::WriteOnly))
+    {
+        return QByteArray();
+    }
+
+    QImageWriter writer(&buffer, "jpg");
+    writer.setQuality(m_settings.jpegQuality);
+    if (!writer.write(image))
+    {
+        return QByteArray();
+    }
+
+    buffer.close();
+    return result;
 }
 
 PDFOptimizer::PDFOptimizer(OptimizationFlags flags, QObject* parent) :
@@ -121,6 +1073,7 @@ void PDFOptimizer::optimize()
     // stage can consist from multiple passes.
     constexpr OptimizationFlags stages[] = { OptimizationFlags(DereferenceSimpleObjects),
                                              OptimizationFlags(RemoveNullObjects),
+                                             OptimizationFlags(RecompressImages),
                                              OptimizationFlags(RemoveUnusedObjects | MergeIdenticalObjects),
                                              OptimizationFlags(ShrinkObjectStorage),
                                              OptimizationFlags(RecompressFlateStreams) };
@@ -149,6 +1102,10 @@ void PDFOptimizer::optimize()
             {
                 pass = performRemoveNullObjects() || pass;
             }
+            if (currentSteps.testFlag(RecompressImages))
+            {
+                pass = performRecompressImages() || pass;
+            }
             if (currentSteps.testFlag(RemoveUnusedObjects))
             {
                 pass = performRemoveUnusedObjects() || pass;
@@ -220,24 +1177,28 @@ bool PDFOptimizer::performRemoveNullObjects()
 
 bool PDFOptimizer::performRemoveUnusedObjects()
 {
-    std::atomic<PDFInteger> counter = 0;
+    PDFInteger counter = 0;
     PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    std::set<PDFObjectReference> references = PDFObjectUtils::getReferences({ m_storage.getTrailerDictionary() }, m_storage);
+    const std::vector<PDFObjectReference> references = m_storage.getReferenceGraph()->getReachableObjects();
 
-    PDFIntegerRange<size_t> range(0, objects.size());
-    auto processEntry = [&counter, &objects, &references](size_t index)
+    // Jakub Melka: objects are read using const access, so only
+    // chunks containing removed objects are detached (copied).
+    const PDFObjectStorage::PDFObjects& currentObjects = m_storage.getObjects();
+    for (size_t index = 0; index < currentObjects.size(); ++index)
     {
-        PDFObjectStorage::Entry& entry = objects[index];
+        const PDFObjectStorage::Entry& entry = currentObjects[index];
         PDFObjectReference reference(PDFInteger(index), entry.generation);
-        if (!references.count(reference) && !entry.object.isNull())
+        if (!std::binary_search(references.cbegin(), references.cend(), reference) && !entry.object.isNull())
         {
-            entry.object = PDFObject();
+            objects[index].object = PDFObject();
             ++counter;
         }
-    };
+    }
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
+    if (counter > 0)
+    {
+        m_storage.setObjects(qMove(objects));
+    }
     Q_EMIT optimizationProgress(tr("Unused objects removed: %1").arg(counter));
 
     return counter > 0;
@@ -245,72 +1206,277 @@ bool PDFOptimizer::performRemoveUnusedObjects()
 
 bool PDFOptimizer::performMergeIdenticalObjects()
 {
-    std::atomic<PDFInteger> counter = 0;
-    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
-    std::map<QByteArray, PDFObjectReference> serializedObjectToReference;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    std::vector<QByteArray> serializedObjects(objects.size());
+    // Jakub Melka: we compute Merkle-like hashes of the objects bottom-up over the
+    // reference graph. As the graph can contain cycles, we use partition refinement:
+    // at the beginning, objects are divided into classes by their own content
+    // (references are ignored). Then, in each round, class of the object is refined
+    // by classes of referenced objects, until number of classes is stable. Objects
+    // in the same class are then identical (including objects which become identical
+    // only after their children are merged). Only hashes are stored, not serialized
+    // objects, and objects in the same class are verified by comparison.
+    using Hash = PDFObjectContentHashVisitor::Hash;
+    constexpr size_t INVALID_CLASS = std::numeric_limits<size_t>::max();
+
+    const PDFObjectStorage::PDFObjects& objects = m_storage.getObjects();
+    const size_t objectCount = objects.size();
+    PDFIntegerRange<size_t> range(0, objectCount);
 
-    PDFIntegerRange<size_t> range(0, objects.size());
-    auto serializeEntry = [&, this](size_t index)
-    {
-        const PDFObjectStorage::Entry& entry = objects[index];
+    std::vector<Hash> hashes(objectCount, Hash());
+    std::vector<std::vector<PDFObjectReference>> references(objectCount);
+    std::vector<bool> isMergeable(objectCount, false);
 
-        if (!entry.object.isNull())
+    auto getObjectIndex = [&objects, objectCount](PDFObjectReference reference) -> size_t
+    {
+        if (reference.objectNumber >= 0 &&
+            static_cast<size_t>(reference.objectNumber) < objectCount &&
+            objects[reference.objectNumber].generation == reference.generation &&
+            !objects[reference.objectNumber].object.isNull())
         {
-            serializedObjects[index] = PDFDocumentWriter::getSerializedObject(entry.object);
+            return static_cast<size_t>(reference.objectNumber);
         }
+
+        return INVALID_CLASS;
     };
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), serializeEntry);
 
-    // Find same object
-    for (PDFInteger index : range)
+    auto hashEntry = [&, this](size_t index)
     {
         const PDFObjectStorage::Entry& entry = objects[index];
 
         if (!entry.object.isNull())
         {
+            PDFObjectContentHashVisitor visitor(&references[index]);
+            entry.object.accept(&visitor);
+            hashes[index] = visitor.getHash();
+
             // We do not merge special objects, such as pages
+            isMergeable[index] = true;
             if (const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(entry.object))
             {
                 PDFObject nameObject = m_storage.getObject(dictionary->get("Type"));
-                if (nameObject.isName())
+                if (nameObject.isName() && nameObject.getString() == "Page")
+                {
+                    isMergeable[index] = false;
+                }
+            }
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), hashEntry);
+
+    // Assigns dense class indices to the objects using their hashes
+    std::vector<size_t> classes(objectCount, INVALID_CLASS);
+    auto assignClasses = [&]()
+    {
+        std::map<Hash, size_t> hashToClass;
+        size_t classCount = 0;
+
+        for (size_t index : range)
+        {
+            if (objects[index].object.isNull())
+            {
+                continue;
+            }
+
+            if (!isMergeable[index])
+            {
+                classes[index] = classCount++;
+                continue;
+            }
+
+            auto it = hashToClass.find(hashes[index]);
+            if (it == hashToClass.cend())
+            {
+                it = hashToClass.insert(std::make_pair(hashes[index], classCount++)).first;
+            }
+            classes[index] = it->second;
+        }
+
+        return classCount;
+    };
+
+    size_t classCount = assignClasses();
+
+    // Refine classes until fixpoint is reached
+    while (true)
+    {
+        auto refineEntry = [&](size_t index)
+        {
+            if (objects[index].object.isNull() || !isMergeable[index])
+            {
+                return;
+            }
+
+            QCryptographicHash hasher(QCryptographicHash::Sha256);
+            auto addValue = [&hasher](const auto& value) { hasher.addData(QByteArrayView(reinterpret_cast<const char*>(&value), sizeof(value))); };
+
+            addValue(classes[index]);
+            for (const PDFObjectReference& reference : references[index])
+            {
+                const size_t referencedIndex = getObjectIndex(reference);
+                if (referencedIndex != INVALID_CLASS)
+                {
+                    addValue(classes[referencedIndex]);
+                }
+                else
+                {
+                    // Reference to nonexisting object, we use reference itself
+                    addValue(INVALID_CLASS);
+                    addValue(reference.objectNumber);
+                    addValue(reference.generation);
+                }
+            }
+
+            hashes[index] = PDFObjectContentHashVisitor::toHash(hasher.result());
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), refineEntry);
+
+        const size_t newClassCount = assignClasses();
+        Q_ASSERT(newClassCount >= classCount);
+
+        if (newClassCount == classCount)
+        {
+            break;
+        }
+
+        classCount = newClassCount;
+    }
+
+    // Each object is replaced by the first object of its class
+    std::vector<size_t> representatives(objectCount, INVALID_CLASS);
+    std::vector<size_t> classRepresentatives(classCount, INVALID_CLASS);
+    for (size_t index : range)
+    {
+        if (classes[index] != INVALID_CLASS)
+        {
+            size_t& classRepresentative = classRepresentatives[classes[index]];
+            if (classRepresentative == INVALID_CLASS)
+            {
+                classRepresentative = index;
+            }
+            representatives[index] = classRepresentative;
+        }
+    }
+
+    // Verify, that objects are really identical (hash collisions are possible). If object
+    // is not identical to its representative, we do not merge it. This can break other
+    // objects (referencing the object), so we repeat verification until nothing changes.
+    std::function<bool(const PDFObject&, const PDFObject&)> isEqual = [&](const PDFObject& left, const PDFObject& right) -> bool
+    {
+        if (left.getType() != right.getType())
+        {
+            return false;
+        }
+
+        switch (left.getType())
+        {
+            case PDFObject::Type::Array:
+            {
+                const PDFArray* leftArray = left.getArray();
+                const PDFArray* rightArray = right.getArray();
+
+                if (leftArray->getCount() != rightArray->getCount())
+                {
+                    return false;
+                }
+
+                for (size_t i = 0; i < leftArray->getCount(); ++i)
+                {
+                    if (!isEqual(leftArray->getItem(i), rightArray->getItem(i)))
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            case PDFObject::Type::Dictionary:
+            case PDFObject::Type::Stream:
+            {
+                const PDFDictionary* leftDictionary = left.isStream() ? left.getStream()->getDictionary() : left.getDictionary();
+                const PDFDictionary* rightDictionary = right.isStream() ? right.getStream()->getDictionary() : right.getDictionary();
+
+                if (leftDictionary->getCount() != rightDictionary->getCount())
+                {
+                    return false;
+                }
+
+                for (size_t i = 0; i < leftDictionary->getCount(); ++i)
                 {
-                    if (nameObject.getString() == "Page")
+                    if (leftDictionary->getKey(i) != rightDictionary->getKey(i) ||
+                        !isEqual(leftDictionary->getValue(i), rightDictionary->getValue(i)))
                     {
-                        continue;
+                        return false;
                     }
                 }
+
+                return !left.isStream() || *left.getStream()->getContent() == *right.getStream()->getContent();
             }
 
-            PDFObjectReference currentReference(PDFInteger(index), objects[index].generation);
-            const QByteArray& serializedObject = serializedObjects[index];
-            if (!serializedObjectToReference.count(serializedObject))
+            case PDFObject::Type::Reference:
             {
-                serializedObjectToReference[serializedObject] = currentReference;
+                const size_t leftIndex = getObjectIndex(left.getReference());
+                const size_t rightIndex = getObjectIndex(right.getReference());
+
+                if (leftIndex == INVALID_CLASS || rightIndex == INVALID_CLASS)
+                {
+                    return left.getReference() == right.getReference();
+                }
+
+                return representatives[leftIndex] == representatives[rightIndex];
             }
-            else
+
+            default:
+                return left == right;
+        }
+    };
+
+    bool isVerificationChanged = true;
+    while (isVerificationChanged)
+    {
+        isVerificationChanged = false;
+
+        for (size_t index : range)
+        {
+            const size_t representative = representatives[index];
+            if (representative != INVALID_CLASS && representative != index && !isEqual(objects[index].object, objects[representative].object))
             {
-                PDFObjectReference oldReference = currentReference;
-                PDFObjectReference newReference = serializedObjectToReference.at(serializedObject);
-                replacementMap[oldReference] = newReference;
-                ++counter;
+                representatives[index] = index;
+                isVerificationChanged = true;
             }
         }
     }
 
-    // Replace objects
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    for (size_t index : range)
+    {
+        const size_t representative = representatives[index];
+        if (representative != INVALID_CLASS && representative != index)
+        {
+            PDFObjectReference oldReference(PDFInteger(index), objects[index].generation);
+            PDFObjectReference newReference(PDFInteger(representative), objects[representative].generation);
+            replacementMap[oldReference] = newReference;
+        }
+    }
+    const PDFInteger counter = replacementMap.size();
+
+    // Replace objects, only objects referencing merged objects are changed
     if (!replacementMap.empty())
     {
-        for (size_t i = 0; i < objects.size(); ++i)
+        auto isReplaced = [&replacementMap](const PDFObjectReference& reference) { return replacementMap.count(reference) > 0; };
+
+        PDFObjectStorage::PDFObjects newObjects = objects;
+        for (size_t i = 0; i < objectCount; ++i)
         {
-            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+            if (std::any_of(references[i].cbegin(), references[i].cend(), isReplaced))
+            {
+                newObjects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+            }
         }
         PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
         m_storage.setTrailerDictionary(trailerDictionary);
+        m_storage.setObjects(qMove(newObjects));
     }
 
-    m_storage.setObjects(qMove(objects));
     Q_EMIT optimizationProgress(tr("Identical objects merged: %1").arg(counter));
 
     return counter > 0;
@@ -462,4 +1628,119 @@ bool PDFOptimizer::performRecompressFlateStreams()
     return false;
 }
 
+bool PDFOptimizer::performRecompressImages()
+{
+    using Resolution = PDFImageResolutionScanner::Resolution;
+
+    std::optional<PDFDocument> document;
+    try
+    {
+        document.emplace(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+    }
+    catch (const PDFException& exception)
+    {
+        Q_EMIT optimizationProgress(tr("Images can't be recompressed: %1").arg(exception.getMessage()));
+        return false;
+    }
+
+    struct ImageInfo
+    {
+        PDFObjectReference reference;
+        bool isSoftMask = false;
+        qint64 memoryUsage = 0;
+        PDFImageRecompressor::Result result;
+    };
+
+    PDFDocumentDataLoaderDecorator loader(&document.value());
+    const PDFObjectStorage::PDFObjects& objects = m_storage.getObjects();
+
+    auto getImageDictionary = [&objects, &loader](size_t index) -> const PDFDictionary*
+    {
+        const PDFObject& object = objects[index].object;
+        if (object.isStream() && loader.readNameFromDictionary(object.getStream()->getDictionary(), "Subtype") == "Image")
+        {
+            return object.getStream()->getDictionary();
+        }
+
+        return nullptr;
+    };
+
+    std::set<PDFObjectReference> softMasks;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (const PDFDictionary* dictionary = getImageDictionary(i))
+        {
+            const PDFObject& softMask = dictionary->get("SMask");
+            if (softMask.isReference())
+            {
+                softMasks.insert(softMask.getReference());
+            }
+        }
+    }
+
+    std::vector<ImageInfo> images;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (const PDFDictionary* dictionary = getImageDictionary(i))
+        {
+            ImageInfo info;
+            info.reference = PDFObjectReference(PDFInteger(i), objects[i].generation);
+            info.isSoftMask = softMasks.count(info.reference);
+
+            // Estimate of decoded image with at most four components and its processed copy
+            const qint64 width = qMax(loader.readIntegerFromDictionary(dictionary, "Width", 0), PDFInteger(0));
+            const qint64 height = qMax(loader.readIntegerFromDictionary(dictionary, "Height", 0), PDFInteger(0));
+            info.memoryUsage = width * height * 4 * 2;
+            images.push_back(qMove(info));
+        }
+    }
+
+    PDFImageResolutionScanner scanner(&document.value());
+    const PDFImageResolutionScanner::Resolutions resolutions = scanner.scan();
+    PDFImageRecompressor recompressor(&document.value(), m_imageSettings);
+
+    auto processImage = [&document, &resolutions, &recompressor](ImageInfo& info)
+    {
+        auto it = resolutions.find(info.reference);
+        const Resolution resolution = it != resolutions.cend() ? it->second : Resolution{ 0.0, 0.0 };
+        info.result = recompressor.recompress(document->getObjectByReference(info.reference).getStream(), info.isSoftMask, resolution);
+    };
+
+    // Images are processed in parallel in batches, so decoded images of one batch
+    // fit into the memory limit (image exceeding the limit is processed alone).
+    auto batchBegin = images.begin();
+    while (batchBegin != images.end())
+    {
+        qint64 memoryUsage = batchBegin->memoryUsage;
+        auto batchEnd = std::next(batchBegin);
+        while (batchEnd != images.end() && memoryUsage + batchEnd->memoryUsage <= m_imageSettings.memoryLimit)
+        {
+            memoryUsage += batchEnd->memoryUsage;
+            ++batchEnd;
+        }
+
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, batchBegin, batchEnd, processImage);
+        batchBegin = batchEnd;
+    }
+
+    PDFInteger bytesSaved = 0;
+    PDFInteger recompressedImages = 0;
+    PDFInteger removedSoftMasks = 0;
+    for (ImageInfo& info : images)
+    {
+        if (!info.result.object.isNull())
+        {
+            bytesSaved += info.result.bytesSaved;
+            recompressedImages += info.result.isRecompressed ? 1 : 0;
+            removedSoftMasks += info.result.isSoftMaskRemoved ? 1 : 0;
+            m_storage.setObject(info.reference, qMove(info.result.object));
+        }
+    }
+
+    Q_EMIT optimizationProgress(tr("Images recompressed: %1, redundant soft masks removed: %2").arg(recompressedImages).arg(removedSoftMasks));
+    Q_EMIT optimizationProgress(tr("Bytes saved by recompressing images: %1").arg(bytesSaved));
+
+    return false;
+}
+
 }   // namespace pdf
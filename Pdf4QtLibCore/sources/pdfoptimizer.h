@@ -45,9 +45,24 @@ public:
         ShrinkObjectStorage         = 0x0010, ///< Shrink object storage, so unused objects are filled with used (and generation number increased)
         RecompressFlateStreams      = 0x0020, ///< Flate streams are recompressed with maximal compression
         All                         = 0xFFFF, ///< All optimizations turned on
+        RecompressImages            = 0x10000, ///< Images are downsampled and recompressed (lossy, so it is not part of All)
     };
     Q_DECLARE_FLAGS(OptimizationFlags, OptimizationFlag)
 
+    /// Settings for image recompression (used only, if RecompressImages flag is set).
+    /// Effective resolution of the image is computed from its placements in page
+    /// content streams, the lowest one is used. Images, which are not painted
+    /// from page content streams, or which are used by patterns, Type 3 fonts,
+    /// soft masks or annotation appearances, are recompressed, but never downsampled.
+    struct ImageSettings
+    {
+        PDFReal targetResolution = 150.0;           ///< Target resolution (DPI) of color and grayscale images
+        PDFReal bitonalTargetResolution = 300.0;    ///< Target resolution (DPI) of bitonal (black and white) images
+        PDFReal resolutionThreshold = 1.5;          ///< Image is downsampled only, if its resolution exceeds target resolution multiplied by this factor
+        int jpegQuality = 75;                       ///< Quality of images encoded by DCT filter (0-100)
+        qint64 memoryLimit = 512 * 1024 * 1024;     ///< Limit of memory (in bytes) used by decoded images processed in parallel
+    };
+
     explicit PDFOptimizer(OptimizationFlags flags, QObject* parent);
 
     /// Set document, which should be optimalized
@@ -75,6 +90,9 @@ public:
     OptimizationFlags getFlags() const;
     void setFlags(OptimizationFlags flags);
 
+    const ImageSettings& getImageSettings() const { return m_imageSettings; }
+    void setImageSettings(const ImageSettings& imageSettings) { m_imageSettings = imageSettings; }
+
 signals:
     void optimizationStarted();
     void optimizationProgress(QString progressText);
@@ -87,8 +105,10 @@ private:
     bool performMergeIdenticalObjects();
     bool performShrinkObjectStorage();
     bool performRecompressFlateStreams();
+    bool performRecompressImages();
 
     OptimizationFlags m_flags;
+    ImageSettings m_imageSettings;
     PDFObjectStorage m_storage;
 };
 
@@ -22,6 +22,7 @@
 #include "pdfpattern.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfstreamfilters.h"
+#include "pdfcontentprocessorprofiler.h"
 #include "pdfdbgheap.h"
 
 #include <QPainterPathStroker>
@@ -244,6 +245,7 @@ PDFPageContentProcessor::PDFPageContentProcessor(const PDFPage* page,
     m_textBeginEndState(0),
     m_compatibilityBeginEndState(0),
     m_drawingUncoloredTilingPatternState(0),
+    m_tilingPatternPaintingState(0),
     m_patternBaseMatrix(pagePointToDevicePointMatrix),
     m_pagePointToDevicePointMatrix(pagePointToDevicePointMatrix),
     m_meshQualitySettings(meshQualitySettings),
@@ -473,6 +475,19 @@ void PDFPageContentProcessor::performOutputCharacter(const PDFTextCharacterInfo&
     Q_UNUSED(info);
 }
 
+void PDFPageContentProcessor::outputCharacter(const PDFTextCharacterInfo& info)
+{
+    performOutputCharacter(info);
+
+    if (isSinkOutputEnabled() && !isContentSuppressed())
+    {
+        for (PDFPageContentProcessorSink* sink : m_sinks)
+        {
+            sink->performOutputCharacter(info);
+        }
+    }
+}
+
 void PDFPageContentProcessor::performTextBegin(ProcessOrder order)
 {
     Q_UNUSED(order);
@@ -668,11 +683,13 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
 
                         QByteArray buffer = content.mid(startDataPosition, dataLength);
                         PDFStream imageStream(std::move(*dictionary), std::move(buffer));
+                        PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::Image, "inline image");
                         paintXObjectImage(&imageStream);
                     }
                     else
                     {
                         // Process the command, then clear the operand stack
+                        PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::Operator, command);
                         processCommand(command);
                     }
 
@@ -716,6 +733,8 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
 
 void PDFPageContentProcessor::processContentStream(const PDFStream* stream)
 {
+    PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::ContentStream, "content stream");
+
     try
     {
         QByteArray content = m_document->getDecodedStream(stream);
@@ -738,6 +757,7 @@ void PDFPageContentProcessor::processForm(const QTransform& matrix,
 {
     PDFPageContentProcessorStateGuard guard(this);
     PDFTemporaryValueChange structuralParentChangeGuard(&m_structuralParentKey, formStructuralParent);
+    PDFContentProcessorProfiler::Scope profilerScope(transparencyGroup.isDictionary() ? m_profiler : nullptr, PDFContentProcessorProfiler::Category::TransparencyGroup, "transparency group");
 
     std::unique_ptr<PDFTransparencyGroupGuard> guard2;
     if (transparencyGroup.isDictionary())
@@ -1004,6 +1024,15 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
     if (stroke || fill)
     {
         performPathPainting(path, stroke, fill, text, fillRule);
+
+        if (isSinkOutputEnabled())
+        {
+            const QTransform worldMatrix = getCurrentWorldMatrix();
+            for (PDFPageContentProcessorSink* sink : m_sinks)
+            {
+                sink->performPathPainting(path, worldMatrix, stroke, fill, text, fillRule);
+            }
+        }
     }
 
     performFinishPathPainting();
@@ -1014,6 +1043,7 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
                                                             PDFColorSpacePointer uncoloredPatternColorSpace,
                                                             PDFColor uncoloredPatternColor)
 {
+    PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::Pattern, "tiling pattern");
     PDFPageContentProcessorStateGuard guard(this);
     performClipping(path, path.fillRule());
 
@@ -1067,6 +1097,11 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     // Mark uncolored flag, if we drawing uncolored color pattern
     PDFTemporaryValueChange guard2(&m_drawingUncoloredTilingPatternState, m_drawingUncoloredTilingPatternState + uncoloredTilingPatternFlag);
 
+    // Jakub Melka: content of the pattern is painted once per tile. Sinks would
+    // receive it many times (for example, text of the pattern would appear in
+    // text layout for each tile), so pattern content is not passed to the sinks.
+    PDFTemporaryValueChange guard4(&m_tilingPatternPaintingState, m_tilingPatternPaintingState + 1);
+
     // Tiling parameters
     const QRectF tilingArea = pathTransformationMatrix.map(path).boundingRect();
     const QRectF boundingBox = tilingPattern->getBoundingBox();
@@ -2716,7 +2751,18 @@ void PDFPageContentProcessor::operatorTextSetFontAndFontSize(PDFOperandName font
         {
             try
             {
-                PDFFontPointer font = m_fontCache->getFont(m_fontDictionary->get(fontName.name));
+                const qint64 startTime = m_profiler ? PDFContentProcessorProfiler::getCurrentTime() : 0;
+                bool isCacheHit = false;
+                PDFFontPointer font = m_fontCache->getFont(m_fontDictionary->get(fontName.name), &isCacheHit);
+
+                if (m_profiler)
+                {
+                    m_profiler->addCacheAccess(PDFContentProcessorProfiler::Cache::Font, isCacheHit);
+                    if (!isCacheHit)
+                    {
+                        m_profiler->addEvent(PDFContentProcessorProfiler::Category::Font, fontName.name, startTime);
+                    }
+                }
 
                 m_graphicState.setTextFont(qMove(font));
                 m_graphicState.setTextFontSize(fontSize);
@@ -2919,6 +2965,7 @@ void PDFPageContentProcessor::operatorShadingPaintShape(PDFPageContentProcessor:
         return;
     }
 
+    PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::Shading, name.name);
     QTransform matrix = getCurrentWorldMatrix();
     PDFPageContentProcessorStateGuard guard(this);
     PDFTemporaryValueChange guard2(&m_patternBaseMatrix, matrix);
@@ -2989,6 +3036,15 @@ void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
             if (!image.isNull())
             {
                 performImagePainting(image);
+
+                if (isSinkOutputEnabled() && !isContentSuppressed())
+                {
+                    const QTransform worldMatrix = getCurrentWorldMatrix();
+                    for (PDFPageContentProcessorSink* sink : m_sinks)
+                    {
+                        sink->performImagePainting(image, worldMatrix);
+                    }
+                }
             }
             else
             {
@@ -3063,6 +3119,7 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
             QByteArray subtype = loader.readNameFromDictionary(streamDictionary, "Subtype");
             if (subtype == "Image")
             {
+                PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::Image, name.name);
                 paintXObjectImage(stream);
             }
             else if (subtype == "Form")
@@ -3073,6 +3130,7 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
                     throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Form of type %1 not supported.").arg(formType));
                 }
 
+                PDFContentProcessorProfiler::Scope profilerScope(m_profiler, PDFContentProcessorProfiler::Category::Form, name.name);
                 processForm(stream);
             }
             else
@@ -3129,6 +3187,14 @@ void PDFPageContentProcessor::operatorMarkedContentBeginWithProperties(PDFOperan
     }
 
     performMarkedContentBegin(name.name, properties);
+
+    if (isSinkOutputEnabled())
+    {
+        for (PDFPageContentProcessorSink* sink : m_sinks)
+        {
+            sink->performMarkedContentBegin(name.name, properties);
+        }
+    }
 }
 
 void PDFPageContentProcessor::operatorMarkedContentEnd()
@@ -3140,6 +3206,14 @@ void PDFPageContentProcessor::operatorMarkedContentEnd()
 
     m_markedContentStack.pop_back();
     performMarkedContentEnd();
+
+    if (isSinkOutputEnabled())
+    {
+        for (PDFPageContentProcessorSink* sink : m_sinks)
+        {
+            sink->performMarkedContentEnd();
+        }
+    }
 }
 
 void PDFPageContentProcessor::operatorCompatibilityBegin()
@@ -3239,7 +3313,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                             info.fontSize = fontSize;
                             info.outline = glyphPath;
                             info.matrix = toDeviceSpaceTransform;
-                            performOutputCharacter(info);
+                            outputCharacter(info);
                         }
                     }
 
@@ -3323,7 +3397,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                         info.advance = item.advance;
                         info.fontSize = fontSize;
                         info.matrix = worldMatrix;
-                        performOutputCharacter(info);
+                        outputCharacter(info);
                     }
                 }
 
@@ -3344,7 +3418,15 @@ PDFRealizedFontPointer PDFPageContentProcessor::getRealizedFontImpl()
 {
     if (m_graphicState.getTextFont())
     {
-        return m_fontCache->getRealizedFont(m_graphicState.getTextFont(), m_graphicState.getTextFontSize(), this);
+        bool isCacheHit = false;
+        PDFRealizedFontPointer realizedFont = m_fontCache->getRealizedFont(m_graphicState.getTextFont(), m_graphicState.getTextFontSize(), this, &isCacheHit);
+
+        if (m_profiler)
+        {
+            m_profiler->addCacheAccess(PDFContentProcessorProfiler::Cache::RealizedFont, isCacheHit);
+        }
+
+        return realizedFont;
     }
 
     return PDFRealizedFontPointer();
@@ -3945,6 +4027,38 @@ PDFPageContentProcessor::PDFTransparencyGroupGuard::~PDFTransparencyGroupGuard()
     m_processor->performEndTransparencyGroup(ProcessOrder::AfterOperation, group);
 }
 
+void PDFPageContentProcessorSink::performPathPainting(const QPainterPath& path, const QTransform& worldMatrix, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
+{
+    Q_UNUSED(path);
+    Q_UNUSED(worldMatrix);
+    Q_UNUSED(stroke);
+    Q_UNUSED(fill);
+    Q_UNUSED(text);
+    Q_UNUSED(fillRule);
+}
+
+void PDFPageContentProcessorSink::performImagePainting(const QImage& image, const QTransform& worldMatrix)
+{
+    Q_UNUSED(image);
+    Q_UNUSED(worldMatrix);
+}
+
+void PDFPageContentProcessorSink::performOutputCharacter(const PDFTextCharacterInfo& info)
+{
+    Q_UNUSED(info);
+}
+
+void PDFPageContentProcessorSink::performMarkedContentBegin(const QByteArray& tag, const PDFObject& properties)
+{
+    Q_UNUSED(tag);
+    Q_UNUSED(properties);
+}
+
+void PDFPageContentProcessorSink::performMarkedContentEnd()
+{
+
+}
+
 PDFLineDashPattern::PDFLineDashPattern(const std::vector<PDFReal>& dashArray, PDFReal dashOffset) :
     m_dashArray(dashArray),
     m_dashOffset(dashOffset)
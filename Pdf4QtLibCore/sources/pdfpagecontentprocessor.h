@@ -79,6 +79,44 @@ private:
     PDFReal m_dashOffset = 0.0;
 };
 
+/// Consumer of the interpreted page content. Sinks can be registered to the
+/// content processor, so several consumers (for example, page compiler and
+/// text layout generator) share one interpretation pass, and content streams,
+/// fonts and images are decoded only once. Sinks receive only content, which
+/// is not suppressed by the content processor, to which they are registered.
+class PDF4QTLIBCORESHARED_EXPORT PDFPageContentProcessorSink
+{
+public:
+    explicit inline PDFPageContentProcessorSink() = default;
+    virtual ~PDFPageContentProcessorSink() = default;
+
+    /// Path painting (path is in current user space coordinates)
+    /// \param path Painted path
+    /// \param worldMatrix Matrix mapping user space coordinates to device coordinates
+    /// \param stroke Is path stroked?
+    /// \param fill Is path filled?
+    /// \param text Is text being painted?
+    /// \param fillRule Fill rule
+    virtual void performPathPainting(const QPainterPath& path, const QTransform& worldMatrix, bool stroke, bool fill, bool text, Qt::FillRule fillRule);
+
+    /// Image painting, image is painted into unit square in user space
+    /// \param image Image
+    /// \param worldMatrix Matrix mapping user space coordinates to device coordinates
+    virtual void performImagePainting(const QImage& image, const QTransform& worldMatrix);
+
+    /// Output character (text character with its position)
+    /// \param info Character info
+    virtual void performOutputCharacter(const PDFTextCharacterInfo& info);
+
+    /// Begin of marked content
+    /// \param tag Tag of the marked content
+    /// \param properties Properties of the marked content
+    virtual void performMarkedContentBegin(const QByteArray& tag, const PDFObject& properties);
+
+    /// End of marked content
+    virtual void performMarkedContentEnd();
+};
+
 /// Process the contents of the page.
 class PDF4QTLIBCORESHARED_EXPORT PDFPageContentProcessor : public PDFRenderErrorReporter
 {
@@ -253,6 +291,19 @@ public:
     /// Returns true, if page content processing is being cancelled
     bool isProcessingCancelled() const;
 
+    /// Sets profiler, which measures processing of the content stream. Profiler
+    /// must outlive the processing. If profiler is nullptr, nothing is measured.
+    /// \param profiler Profiler
+    void setProfiler(PDFContentProcessorProfiler* profiler) { m_profiler = profiler; }
+
+    /// Returns profiler (or nullptr, if processing is not profiled)
+    PDFContentProcessorProfiler* getProfiler() const { return m_profiler; }
+
+    /// Registers sink, which receives the interpreted content together with
+    /// this processor. Sink must outlive the processing.
+    /// \param sink Sink
+    void addSink(PDFPageContentProcessorSink* sink) { m_sinks.push_back(sink); }
+
 protected:
 
     struct PDFTransparencyGroup
@@ -675,6 +726,10 @@ protected:
     /// Returns true, if graphic content is suppressed
     bool isContentSuppressed() const;
 
+    /// Returns true, if interpreted content should be passed to the sinks.
+    /// Content of tiling patterns is never passed to the sinks.
+    bool isSinkOutputEnabled() const { return !m_sinks.empty() && m_tilingPatternPaintingState == 0; }
+
     /// Returns page point to device point matrix
     const QTransform& getPagePointToDevicePointMatrix() const { return m_pagePointToDevicePointMatrix; }
 
@@ -1018,12 +1073,18 @@ private:
     /// Finishes marked content (if end of marked content is missing)
     void finishMarkedContent();
 
+    /// Outputs character to the processor and to the registered sinks
+    /// \param info Character info
+    void outputCharacter(const PDFTextCharacterInfo& info);
+
     const PDFPage* m_page;
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
     const PDFCMS* m_CMS;
     const PDFOptionalContentActivity* m_optionalContentActivity;
     const PDFOperationControl* m_operationControl;
+    PDFContentProcessorProfiler* m_profiler = nullptr;
+    std::vector<PDFPageContentProcessorSink*> m_sinks;
     const PDFDictionary* m_colorSpaceDictionary;
     const PDFDictionary* m_fontDictionary;
     const PDFDictionary* m_xobjectDictionary;
@@ -1068,6 +1129,9 @@ private:
     /// Is drawing uncolored tiling pattern?
     int m_drawingUncoloredTilingPatternState;
 
+    /// Nesting level of the tiling pattern painting
+    int m_tilingPatternPaintingState;
+
     /// Actually realized physical font
     PDFCachedItem<PDFRealizedFontPointer> m_realizedFont;
 
@@ -228,6 +228,12 @@ public:
     /// Returns a list of rendering errors
     const QList<PDFRenderError>& getErrors() const { return m_errors; }
 
+    /// Returns profile of the page compilation (or nullptr, if page was not profiled)
+    const PDFContentProcessorProfilerPointer& getProfile() const { return m_profile; }
+
+    /// Sets profile of the page compilation
+    void setProfile(PDFContentProcessorProfilerPointer profile) { m_profile = qMove(profile); }
+
     /// Returns true, if page is valid (i.e. has nonzero instruction count)
     bool isValid() const { return !m_instructions.empty(); }
 
@@ -358,6 +364,7 @@ private:
     std::vector<QTransform> m_matrices;
     std::vector<QPainter::CompositionMode> m_compositionModes;
     QList<PDFRenderError> m_errors;
+    PDFContentProcessorProfilerPointer m_profile;
     PDFSnapInfo m_snapInfo;
     QElapsedTimer m_expirationTimer;
 };
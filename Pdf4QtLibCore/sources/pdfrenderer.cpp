@@ -17,6 +17,7 @@
 
 #include "pdfrenderer.h"
 #include "pdfpainter.h"
+#include "pdftextlayoutgenerator.h"
 #include "pdfdocument.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfprogress.h"
@@ -194,7 +195,7 @@ QList<PDFRenderError> PDFRenderer::render(QPainter* painter, const QTransform& m
     return processor.processContents();
 }
 
-void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex) const
+void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex, PDFTextLayout* textLayout) const
 {
     const PDFCatalog* catalog = m_document->getCatalog();
     if (pageIndex >= catalog->getPageCount() || !catalog->getPage(pageIndex))
@@ -212,8 +213,31 @@ void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex)
 
     PDFPrecompiledPageGenerator generator(precompiledPage, m_features, page, m_document, m_fontCache, m_cms, m_optionalContentActivity, m_meshQualitySettings);
     generator.setOperationControl(m_operationControl);
+
+    // Text layout shares content stream interpretation with the page compiler
+    PDFTextLayoutSink textLayoutSink;
+    if (textLayout)
+    {
+        generator.addSink(&textLayoutSink);
+    }
+
+    std::shared_ptr<PDFContentProcessorProfiler> profiler;
+    if (m_features.testFlag(ProfileContentStream))
+    {
+        profiler = std::make_shared<PDFContentProcessorProfiler>();
+        generator.setProfiler(profiler.get());
+        profiler->beginEvent(PDFContentProcessorProfiler::Category::Page, QString("Page %1").arg(pageIndex + 1).toLatin1());
+    }
+
     QList<PDFRenderError> errors = generator.processContents();
 
+    if (profiler)
+    {
+        profiler->endEvent();
+        errors.append(profiler->getSummary(10));
+        precompiledPage->setProfile(qMove(profiler));
+    }
+
     PDFColorConvertor colorConvertor = m_cms->getColorConvertor();
     PDFRenderer::applyFeaturesToColorConvertor(m_features, colorConvertor);
     precompiledPage->convertColors(colorConvertor);
@@ -221,6 +245,11 @@ void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex)
     precompiledPage->optimize();
     precompiledPage->finalize(timer.nsecsElapsed(), qMove(errors));
     timer.invalidate();
+
+    if (textLayout)
+    {
+        *textLayout = textLayoutSink.createTextLayout();
+    }
 }
 
 PDFRasterizer::PDFRasterizer(QObject* parent) :
@@ -506,7 +535,16 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         info.text = PDFTranslationContext::tr("Rendering document into images.");
         progress->start(pageIndices.size(), qMove(info));
     }
-    auto processPage = [this, progress, &imageSizeGetter, &processImage](const PDFInteger pageIndex)
+    // We can const-cast here, because we do not modify the document in annotation manager.
+    // Annotations are just rendered to the target picture.
+    PDFModifiedDocument modifiedDocument(const_cast<PDFDocument*>(m_document), const_cast<PDFOptionalContentActivity*>(m_optionalContentActivity));
+
+    // Annotation manager is shared by all pages, so annotations and their
+    // precompiled appearance streams are cached between pages.
+    PDFAnnotationManager annotationManager(m_fontCache, m_cmsManager, m_optionalContentActivity, m_meshQualitySettings, m_features, PDFAnnotationManager::Target::Print, nullptr);
+    annotationManager.setDocument(modifiedDocument);
+
+    auto processPage = [this, progress, &imageSizeGetter, &processImage, &annotationManager](const PDFInteger pageIndex)
     {
         const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
 
@@ -539,14 +577,6 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
             Q_EMIT renderError(pageIndex, error);
         }
 
-        // We can const-cast here, because we do not modify the document in annotation manager.
-        // Annotations are just rendered to the target picture.
-        PDFModifiedDocument modifiedDocument(const_cast<PDFDocument*>(m_document), const_cast<PDFOptionalContentActivity*>(m_optionalContentActivity));
-
-        // Annotation manager
-        PDFAnnotationManager annotationManager(m_fontCache, m_cmsManager, m_optionalContentActivity, m_meshQualitySettings, m_features, PDFAnnotationManager::Target::Print, nullptr);
-        annotationManager.setDocument(modifiedDocument);
-
         // Render page to image
         pageTimer.restart();
         PDFRasterizer* rasterizer = acquire();
@@ -563,6 +593,7 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         renderedPageImage.pageWaitTime = pageWaitTime;
         renderedPageImage.pageRenderTime = pageRenderTime;
         renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
+        renderedPageImage.profile = precompiledPage.getProfile();
         processImage(renderedPageImage);
 
         if (progress)
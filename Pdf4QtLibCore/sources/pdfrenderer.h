@@ -24,6 +24,7 @@
 #include "pdfmeshqualitysettings.h"
 #include "pdfutils.h"
 #include "pdfcolorconvertor.h"
+#include "pdfcontentprocessorprofiler.h"
 
 #include <QMutex>
 #include <QSemaphore>
@@ -42,6 +43,7 @@ class PDFCMS;
 class PDFProgress;
 class PDFFontCache;
 class PDFCMSManager;
+class PDFTextLayout;
 class PDFPrecompiledPage;
 class PDFAnnotationManager;
 class PDFOptionalContentActivity;
@@ -95,6 +97,8 @@ public:
         ColorAdjust_HighContrast    = 0x2000,   ///< Convert colors to high constrast colors
         ColorAdjust_Bitonal         = 0x4000,   ///< Convert colors to bitonal (monochromatic)
         ColorAdjust_CustomColors    = 0x8000,   ///< Convert colors to custom color settings
+
+        ProfileContentStream        = 0x10000,  ///< Profile content stream processing (summary is reported as information messages)
     };
 
     Q_DECLARE_FLAGS(Features, Feature)
@@ -124,7 +128,8 @@ public:
     /// to the compiled page.
     /// \param precompiledPage Precompiled page pointer
     /// \param pageIndex Index of page to be compiled
-    void compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex) const;
+    /// \param textLayout If not null, text layout of the page is created in the same pass
+    void compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex, PDFTextLayout* textLayout = nullptr) const;
 
     /// Creates page point to device point matrix for the given rectangle. It creates transformation
     /// from page's media box to the target rectangle.
@@ -240,6 +245,7 @@ struct PDFRenderedPageImage
     qint64 pageTotalTime = 0;
     PDFInteger pageIndex;
     QImage pageImage;
+    PDFContentProcessorProfilerPointer profile; ///< Profile of page compilation, if ProfileContentStream feature is enabled
 };
 
 /// Pool of page image renderers. It can use predefined number of renderers to
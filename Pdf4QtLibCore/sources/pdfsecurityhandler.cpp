@@ -72,6 +72,7 @@ public:
     enum class Mode
     {
         Decrypt,
+        DecryptStreamsOnDemand,
         Encrypt
     };
 
@@ -83,6 +84,10 @@ public:
         m_objectStack.reserve(32);
     }
 
+    /// Sets shared security handler, which is used by streams decrypted on demand.
+    /// It must be the same handler as passed in the constructor.
+    void setSharedSecurityHandler(PDFSecurityHandlerPointer securityHandler) { m_sharedSecurityHandler = qMove(securityHandler); }
+
     virtual void visitNull() override;
     virtual void visitBool(bool value) override;
     virtual void visitInt(PDFInteger value) override;
@@ -98,6 +103,7 @@ public:
 
 private:
     const PDFSecurityHandler* m_securityHandler = nullptr;
+    PDFSecurityHandlerPointer m_sharedSecurityHandler;
     std::vector<PDFObject> m_objectStack;
     PDFObjectReference m_reference;
     Mode m_mode = Mode::Decrypt;
@@ -128,6 +134,7 @@ void PDFDecryptOrEncryptObjectVisitor::visitString(PDFStringRef string)
     switch (m_mode)
     {
         case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::Decrypt:
+        case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::DecryptStreamsOnDemand:
             m_objectStack.push_back(PDFObject::createString(m_securityHandler->decrypt(string.getString(), m_reference, PDFSecurityHandler::EncryptionScope::String)));
             break;
         case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::Encrypt:
@@ -224,6 +231,18 @@ void PDFDecryptOrEncryptObjectVisitor::visitStream(const PDFStream* stream)
             case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::Decrypt:
                 processedData = m_securityHandler->decrypt(*stream->getContent(), m_reference, scope);
                 break;
+            case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::DecryptStreamsOnDemand:
+            {
+                // Stream data are left encrypted, they are decrypted on first access. Length
+                // entry is set to the size of the decrypted data, as in eager decryption.
+                Q_ASSERT(m_sharedSecurityHandler.data() == m_securityHandler);
+                PDFSecurityHandlerPointer securityHandler = m_sharedSecurityHandler;
+                PDFObjectReference reference = m_reference;
+                auto decryptor = [securityHandler, reference, scope](const QByteArray& data) { return securityHandler->decrypt(data, reference, scope); };
+                processedDictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(m_securityHandler->getDecryptedDataSize(*stream->getContent(), m_reference, scope)));
+                m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(qMove(processedDictionary), QByteArray(*stream->getContent()), qMove(decryptor))));
+                return;
+            }
             case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::Encrypt:
                 processedData = m_securityHandler->encrypt(*stream->getContent(), m_reference, scope);
                 break;
@@ -240,6 +259,7 @@ void PDFDecryptOrEncryptObjectVisitor::visitStream(const PDFStream* stream)
         switch (m_mode)
         {
             case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::Decrypt:
+            case pdf::PDFDecryptOrEncryptObjectVisitor::Mode::DecryptStreamsOnDemand:
             {
                 processedData = *stream->getContent();
                 processedDictionary.setEntry(PDFInplaceOrMemoryString(PDFSecurityHandler::OBJECT_REFERENCE_DICTIONARY_NAME), PDFObject::createReference(m_reference));
@@ -281,6 +301,16 @@ PDFObject PDFSecurityHandler::decryptObject(const PDFObject& object, PDFObjectRe
     return visitor.getProcessedObject();
 }
 
+PDFObject PDFSecurityHandler::decryptObjectStreamsOnDemand(const PDFSecurityHandlerPointer& securityHandler, const PDFObject& object, PDFObjectReference reference)
+{
+    Q_ASSERT(securityHandler);
+
+    PDFDecryptOrEncryptObjectVisitor visitor(securityHandler.data(), reference, PDFDecryptOrEncryptObjectVisitor::Mode::DecryptStreamsOnDemand);
+    visitor.setSharedSecurityHandler(securityHandler);
+    object.accept(&visitor);
+    return visitor.getProcessedObject();
+}
+
 PDFObject PDFSecurityHandler::encryptObject(const PDFObject& object, PDFObjectReference reference) const
 {
     PDFDecryptOrEncryptObjectVisitor visitor(this, reference, PDFDecryptOrEncryptObjectVisitor::Mode::Encrypt);
@@ -1083,6 +1113,35 @@ QByteArray PDFStandardOrPublicSecurityHandler::decryptByFilter(const QByteArray&
     return decryptUsingFilter(data, it->second, reference);
 }
 
+PDFInteger PDFStandardOrPublicSecurityHandler::getDecryptedDataSize(const QByteArray& data, PDFObjectReference reference, EncryptionScope encryptionScope) const
+{
+    CryptFilter filter = getCryptFilter(encryptionScope);
+
+    switch (filter.type)
+    {
+        case CryptFilterType::AESV2:
+        case CryptFilterType::AESV3:
+        {
+            // Jakub Melka: AES is used in CBC mode, so the last block can be decrypted
+            // alone, using the previous block as initialization vector. Padding is
+            // stored in the last block, so it determines the size of decrypted data.
+            // Incomplete block at the end of the data is skipped, as in decryption.
+            const qsizetype remainder = qMax(data.size() - AES_BLOCK_SIZE, qsizetype(0)) % AES_BLOCK_SIZE;
+            const qsizetype tailSize = 2 * AES_BLOCK_SIZE + remainder;
+            if (data.size() <= tailSize)
+            {
+                return decryptUsingFilter(data, filter, reference).size();
+            }
+
+            return data.size() - tailSize + decryptUsingFilter(data.right(tailSize), filter, reference).size();
+        }
+
+        default:
+            // Stream ciphers and identity filter doesn't change the size of the data
+            return data.size();
+    }
+}
+
 CryptFilter PDFStandardOrPublicSecurityHandler::getCryptFilter(EncryptionScope encryptionScope) const
 {
     CryptFilter filter = m_filterDefault;
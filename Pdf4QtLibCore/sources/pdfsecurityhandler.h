@@ -139,6 +139,17 @@ public:
     /// \returns Decrypted object
     PDFObject decryptObject(const PDFObject& object, PDFObjectReference reference) const;
 
+    /// Decrypts the PDF object, but leaves data of streams encrypted. Stream data
+    /// are decrypted on first access to the stream content (streams hold a shared
+    /// pointer to the security handler). Strings and dictionaries are decrypted immediately.
+    /// This function works properly only (and only if) \p authenticate function
+    /// returns user/owner authorization code.
+    /// \param securityHandler Security handler
+    /// \param object Object to be decrypted
+    /// \param reference Reference of indirect object (some algorithms require to generate key also from reference)
+    /// \returns Decrypted object
+    static PDFObject decryptObjectStreamsOnDemand(const PDFSecurityHandlerPointer& securityHandler, const PDFObject& object, PDFObjectReference reference);
+
     /// Encrypts the PDF object. This function works properly only (and only if)
     /// \p authenticate function returns user/owner authorization code.
     /// \param object Object to be encrypted
@@ -160,6 +171,14 @@ public:
     /// \param reference Reference object
     virtual QByteArray decryptByFilter(const QByteArray& data, const QByteArray& filterName, PDFObjectReference reference) const = 0;
 
+    /// Returns size of the decrypted data, without decrypting all of the data
+    /// (used, when stream data are decrypted on demand). Parameters are same
+    /// as in function \p decrypt.
+    /// \param data Data to be decrypted
+    /// \param reference Reference of indirect object
+    /// \param encryptionScope Scope of the encryption
+    virtual PDFInteger getDecryptedDataSize(const QByteArray& data, PDFObjectReference reference, EncryptionScope encryptionScope) const = 0;
+
     /// Encrypts the PDF object data. This function works properly only (and only if)
     /// \p authenticate function returns user/owner authorization code.
     /// \param data Data to be encrypted
@@ -249,6 +268,7 @@ public:
     virtual AuthorizationResult authenticate(const std::function<QString(bool*)>&, bool) override { return AuthorizationResult::OwnerAuthorized; }
     virtual QByteArray decrypt(const QByteArray& data, PDFObjectReference, EncryptionScope) const override { return data; }
     virtual QByteArray decryptByFilter(const QByteArray& data, const QByteArray&, PDFObjectReference) const override { return data; }
+    virtual PDFInteger getDecryptedDataSize(const QByteArray& data, PDFObjectReference, EncryptionScope) const override { return data.size(); }
     virtual QByteArray encrypt(const QByteArray& data, PDFObjectReference, EncryptionScope) const override { return data; }
     virtual QByteArray encryptByFilter(const QByteArray& data, const QByteArray&, PDFObjectReference) const override { return data; }
     virtual bool isMetadataEncrypted() const override { return true; }
@@ -263,6 +283,7 @@ class PDFStandardOrPublicSecurityHandler : public PDFSecurityHandler
 public:
     virtual QByteArray decrypt(const QByteArray& data, PDFObjectReference reference, EncryptionScope encryptionScope) const override;
     virtual QByteArray decryptByFilter(const QByteArray& data, const QByteArray& filterName, PDFObjectReference reference) const override;
+    virtual PDFInteger getDecryptedDataSize(const QByteArray& data, PDFObjectReference reference, EncryptionScope encryptionScope) const override;
     virtual QByteArray encrypt(const QByteArray& data, PDFObjectReference reference, EncryptionScope encryptionScope) const override;
     virtual QByteArray encryptByFilter(const QByteArray& data, const QByteArray& filterName, PDFObjectReference reference) const override;
     virtual AuthorizationResult getAuthorizationResult() const override { return m_authorizationData.authorizationResult; }
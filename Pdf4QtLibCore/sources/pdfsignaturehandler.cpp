@@ -20,6 +20,7 @@
 #include "pdfencoding.h"
 #include "pdfform.h"
 #include "pdfutils.h"
+#include "pdfexecutionpolicy.h"
 #include "pdfdbgheap.h"
 #include "pdfsignaturehandler_impl.h"
 
@@ -46,6 +47,7 @@
 #include <QFileInfo>
 
 #include <array>
+#include <numeric>
 #ifdef Q_OS_UNIX
 #include <time.h>
 #endif
@@ -53,22 +55,12 @@
 namespace pdf
 {
 
+// Jakub Melka: OpenSSL (1.1.0 and newer, which is required) is thread safe, as long
+// as objects are not shared between threads (reference counted objects, such as
+// X509_STORE, can be shared). So signatures can be verified concurrently.
 template<typename T>
 using openssl_ptr = std::unique_ptr<T, void(*)(T*)>;
 
-static QRecursiveMutex s_globalOpenSSLMutex;
-
-/// OpenSSL is not thread safe.
-class PDFOpenSSLGlobalLock
-{
-public:
-    explicit inline PDFOpenSSLGlobalLock() : m_mutexLocker(&s_globalOpenSSLMutex) { }
-    inline ~PDFOpenSSLGlobalLock() = default;
-
-private:
-    QMutexLocker<QRecursiveMutex> m_mutexLocker;
-};
-
 PDFSignatureReference PDFSignatureReference::parse(const PDFObjectStorage* storage, PDFObject object)
 {
     PDFSignatureReference result;
@@ -209,13 +201,29 @@ std::vector<PDFSignatureVerificationResult> PDFSignatureHandler::verifySignature
             }
         };
         form.apply(getSignatureFields);
-        result.reserve(signatureFields.size());
 
-        for (const PDFFormFieldSignature* signatureField : signatureFields)
+        if (signatureFields.empty())
         {
-            if (const PDFSignatureHandler* signatureHandler = createHandler(signatureField, sourceData, parameters))
+            return result;
+        }
+
+        // Jakub Melka: create verification context, if it is not provided,
+        // so trusted certificate store is created only once for all signatures.
+        Parameters verificationParameters = parameters;
+        std::optional<PDFSignatureVerificationContext> temporaryContext;
+        if (!verificationParameters.context)
+        {
+            temporaryContext.emplace(parameters.store, parameters.useSystemCertificateStore);
+            verificationParameters.context = &temporaryContext.value();
+        }
+
+        result.resize(signatureFields.size());
+        auto verifySignature = [&](size_t i)
+        {
+            const PDFFormFieldSignature* signatureField = signatureFields[i];
+            if (const PDFSignatureHandler* signatureHandler = createHandler(signatureField, sourceData, verificationParameters))
             {
-                result.emplace_back(signatureHandler->verify());
+                result[i] = signatureHandler->verify();
                 delete signatureHandler;
             }
             else
@@ -224,14 +232,28 @@ std::vector<PDFSignatureVerificationResult> PDFSignatureHandler::verifySignature
                 QString qualifiedName = signatureField->getName(PDFFormField::NameType::FullyQualified);
                 PDFSignatureVerificationResult verificationResult(signatureField->getSignature().getType(), signatureFieldReference, qMove(qualifiedName));
                 verificationResult.addNoHandlerError(signatureField->getSignature().getSubfilter());
-                result.emplace_back(qMove(verificationResult));
+                result[i] = qMove(verificationResult);
             }
-        }
+        };
+
+        std::vector<size_t> indices(signatureFields.size(), 0);
+        std::iota(indices.begin(), indices.end(), 0);
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, indices.cbegin(), indices.cend(), verifySignature);
     }
 
     return result;
 }
 
+void PDFSignatureVerificationResult::addCertificateVerification(const PDFSignatureVerificationResult& certificateVerification)
+{
+    m_flags |= certificateVerification.m_flags & Error_Certificates_Mask;
+    m_flags |= certificateVerification.m_flags & Warning_Certificates_Mask;
+    m_flags |= certificateVerification.m_flags & Certificate_OK;
+    m_errors << certificateVerification.m_errors;
+    m_warnings << certificateVerification.m_warnings;
+    m_certificateInfos.insert(m_certificateInfos.end(), certificateVerification.m_certificateInfos.cbegin(), certificateVerification.m_certificateInfos.cend());
+}
+
 void PDFSignatureVerificationResult::addNoHandlerError(const QByteArray& format)
 {
     m_flags.setFlag(Error_NoHandler);
@@ -528,8 +550,6 @@ STACK_OF(X509)* PDFPublicKeySignatureHandler::getCertificates(PKCS7* pkcs7)
 
 void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationResult& result) const
 {
-    PDFOpenSSLGlobalLock lock;
-
     OpenSSL_add_all_algorithms();
 
     const PDFSignature& signature = m_signatureField->getSignature();
@@ -540,7 +560,7 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
-        X509_STORE* store = X509_STORE_new();
+        X509_STORE* store = createTrustedStore();
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
         // Above functions can fail only if not enough memory. But in this
@@ -548,8 +568,6 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
         Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         STACK_OF(PKCS7_SIGNER_INFO)* signerInfo = PKCS7_get_signer_info(pkcs7);
         const int signerInfoCount = sk_PKCS7_SIGNER_INFO_num(signerInfo);
         STACK_OF(X509)* certificates = getCertificates(pkcs7);
@@ -709,9 +727,33 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
 
     // Jakub Melka: We must find byte string, which corresponds to signature.
     // We find only first occurence, because second one should not exist - because
-    // it will mean that signature must be covered by itself.
+    // it will mean that signature must be covered by itself. Signature is usually
+    // placed in the gap after the first byte range, so we try to find it there
+    // first, to avoid searching the whole document.
     QByteArray hexContents = contents.toHex();
-    int index = sourceData.indexOf(hexContents);
+    qsizetype index = -1;
+    if (!byteRanges.empty())
+    {
+        const PDFInteger gapOffset = byteRanges.front().offset + byteRanges.front().size;
+        if (gapOffset >= 0 && gapOffset < sourceData.size())
+        {
+            const qsizetype gapSearchLength = qMin<qsizetype>(sourceData.size() - gapOffset, hexContents.size() + 2);
+            const QByteArrayView gap(sourceData.constData() + gapOffset, gapSearchLength);
+            index = gap.indexOf(hexContents);
+            if (index == -1)
+            {
+                index = gap.indexOf(hexContents.toUpper());
+            }
+            if (index != -1)
+            {
+                index += gapOffset;
+            }
+        }
+    }
+    if (index == -1)
+    {
+        index = sourceData.indexOf(hexContents);
+    }
     if (index == -1)
     {
         index = sourceData.indexOf(hexContents.toUpper());
@@ -746,8 +788,6 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
 
 void PDFPublicKeySignatureHandler::verifySignature(PDFSignatureVerificationResult& result) const
 {
-    PDFOpenSSLGlobalLock lock;
-
     OpenSSL_add_all_algorithms();
 
     const PDFSignature& signature = m_signatureField->getSignature();
@@ -846,7 +886,7 @@ PDFSignatureVerificationResult PDFSignatureHandler_adbe_pkcs7_detached::verify()
 {
     PDFSignatureVerificationResult result;
     initializeResult(result);
-    verifyCertificate(result);
+    verifyCertificateCached(result, X509_PURPOSE_SMIME_SIGN, false, [this](PDFSignatureVerificationResult& certificateResult) { verifyCertificate(certificateResult); });
     verifySignature(result);
     result.validate();
     return result;
@@ -856,7 +896,7 @@ PDFSignatureVerificationResult PDFSignatureHandler_ETSI_CAdES_detached::verify()
 {
     PDFSignatureVerificationResult result;
     initializeResult(result);
-    verifyCertificateCAdES(result, X509_PURPOSE_SMIME_SIGN);
+    verifyCertificateCached(result, X509_PURPOSE_SMIME_SIGN, true, [this](PDFSignatureVerificationResult& certificateResult) { verifyCertificateCAdES(certificateResult, X509_PURPOSE_SMIME_SIGN); });
     verifySignature(result);
     result.validate();
     return result;
@@ -866,7 +906,7 @@ PDFSignatureVerificationResult PDFSignatureHandler_ETSI_RFC3161::verify() const
 {
     PDFSignatureVerificationResult result;
     initializeResult(result);
-    verifyCertificateCAdES(result, X509_PURPOSE_TIMESTAMP_SIGN);
+    verifyCertificateCached(result, X509_PURPOSE_TIMESTAMP_SIGN, true, [this](PDFSignatureVerificationResult& certificateResult) { verifyCertificateCAdES(certificateResult, X509_PURPOSE_TIMESTAMP_SIGN); });
     verifySignatureTimestamp(result);
     result.validate();
     return result;
@@ -874,8 +914,6 @@ PDFSignatureVerificationResult PDFSignatureHandler_ETSI_RFC3161::verify() const
 
 void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVerificationResult& result) const
 {
-    PDFOpenSSLGlobalLock lock;
-
     OpenSSL_add_all_algorithms();
 
     const PDFSignature& signature = m_signatureField->getSignature();
@@ -889,14 +927,12 @@ void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVeri
         QByteArray buffer;
         if (BIO* inputBuffer = getSignedDataBuffer(result, buffer))
         {
-            X509_STORE* store = X509_STORE_new();
+            X509_STORE* store = createTrustedStore();
 
             // Above function can fail only if not enough memory. But in this
             // case, this library will crash anyway.
             Q_ASSERT(store);
 
-            addTrustedCertificates(store);
-
             // Add certificates from DSS store
             STACK_OF(X509)* certificatesFromPkcs7 = getCertificates(pkcs7);
             STACK_OF(X509)* usedCertificates = sk_X509_new_null();
@@ -981,12 +1017,18 @@ void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVeri
     }
 }
 
-// This is protected by global mutex, but it is ugly
-static PDFSignatureVerificationResult* s_ETSI_currentResult = nullptr;
+/// Returns index of the verification result in X509_STORE_CTX extra data
+static int getETSIResultExDataIndex()
+{
+    static const int index = X509_STORE_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
 
 int PDFSignatureHandler_ETSI_base::verifyCallback(int ok, X509_STORE_CTX* context)
 {
     const int errorCode = X509_STORE_CTX_get_error(context);
+    PDFSignatureVerificationResult* currentResult = static_cast<PDFSignatureVerificationResult*>(X509_STORE_CTX_get_ex_data(context, getETSIResultExDataIndex()));
+    Q_ASSERT(currentResult);
 
     switch (errorCode)
     {
@@ -994,7 +1036,7 @@ int PDFSignatureHandler_ETSI_base::verifyCallback(int ok, X509_STORE_CTX* contex
         case X509_V_ERR_CRL_HAS_EXPIRED:
         {
             // We will treat this as only warning
-            s_ETSI_currentResult->addCertificateCRLValidityTimeExpiredWarning();
+            currentResult->addCertificateCRLValidityTimeExpiredWarning();
             X509_STORE_CTX_set_error(context, X509_V_OK);
             return 1;
         }
@@ -1003,7 +1045,7 @@ int PDFSignatureHandler_ETSI_base::verifyCallback(int ok, X509_STORE_CTX* contex
         {
             // We will treat this as only warning. It means that
             // CRL cannot be downloaded or other error occured.
-            s_ETSI_currentResult->addCertificateUnableToGetCRLWarning();
+            currentResult->addCertificateUnableToGetCRLWarning();
             X509_STORE_CTX_set_error(context, X509_V_OK);
             return 1;
         }
@@ -1036,7 +1078,7 @@ int PDFSignatureHandler_ETSI_base::verifyCallback(int ok, X509_STORE_CTX* contex
                     case NID_qcStatements:
                     {
                         // We will treat this as only warning
-                        s_ETSI_currentResult->addCertificateQualifiedStatementNotVerifiedWarning();
+                        currentResult->addCertificateQualifiedStatementNotVerifiedWarning();
                         X509_STORE_CTX_set_error(context, X509_V_OK);
                         continue;
                     }
@@ -1059,10 +1101,6 @@ int PDFSignatureHandler_ETSI_base::verifyCallback(int ok, X509_STORE_CTX* contex
 
 void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificationResult& result, int purpose) const
 {
-    PDFOpenSSLGlobalLock lock;
-
-    s_ETSI_currentResult = &result;
-
     OpenSSL_add_all_algorithms();
 
     const PDFSignature& signature = m_signatureField->getSignature();
@@ -1073,7 +1111,7 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
-        X509_STORE* store = X509_STORE_new();
+        X509_STORE* store = createTrustedStore();
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
         // Above functions can fail only if not enough memory. But in this
@@ -1081,8 +1119,6 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
         Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         STACK_OF(PKCS7_SIGNER_INFO)* signerInfo = PKCS7_get_signer_info(pkcs7);
         const int signerInfoCount = sk_PKCS7_SIGNER_INFO_num(signerInfo);
         STACK_OF(X509)* certificates = getCertificates(pkcs7);
@@ -1111,7 +1147,9 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
             }
             STACK_OF(X509)* usedCertificates = allCertificates ? allCertificates : certificates;
 
-            // Jakub Melka: add certificate revocation lists
+            // Jakub Melka: add certificate revocation lists. We do not add them
+            // to the store, because store can be shared with other verifications.
+            STACK_OF(X509_CRL)* crls = sk_X509_CRL_new_null();
             if (m_parameters.dss && !m_parameters.dss->getMasterItem()->CRL.empty())
             {
                 for (const QByteArray& crlData : m_parameters.dss->getMasterItem()->CRL)
@@ -1119,8 +1157,7 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
                     const unsigned char* crlDataBuffer = convertByteArrayToUcharPtr(crlData);
                     if (X509_CRL* crl = d2i_X509_CRL(nullptr, &crlDataBuffer, crlData.size()))
                     {
-                        X509_STORE_add_crl(store, crl);
-                        X509_CRL_free(crl);
+                        sk_X509_CRL_push(crls, crl);
                     }
                 }
             }
@@ -1149,6 +1186,9 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
                     break;
                 }
 
+                X509_STORE_CTX_set0_crls(context, crls);
+                X509_STORE_CTX_set_ex_data(context, getETSIResultExDataIndex(), &result);
+
                 unsigned long flags = X509_V_FLAG_TRUSTED_FIRST | X509_V_FLAG_CRL_CHECK | X509_V_FLAG_CRL_CHECK_ALL | X509_V_FLAG_EXTENDED_CRL_SUPPORT;
                 if (m_parameters.ignoreExpirationDate)
                 {
@@ -1221,6 +1261,8 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
 
                 sk_X509_free(allCertificates);
             }
+
+            sk_X509_CRL_pop_free(crls, X509_CRL_free);
         }
         else
         {
@@ -1248,7 +1290,7 @@ PDFSignatureVerificationResult PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verify()
     PDFSignatureVerificationResult result;
     initializeResult(result);
 
-    verifyRSACertificate(result);
+    verifyCertificateCached(result, X509_PURPOSE_SMIME_SIGN, false, [this](PDFSignatureVerificationResult& certificateResult) { verifyRSACertificate(certificateResult); });
     verifyRSASignature(result);
 
     result.validate();
@@ -1352,7 +1394,7 @@ void PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verifyRSACertificate(PDFSignatureV
             }
         }
 
-        X509_STORE* store = X509_STORE_new();
+        X509_STORE* store = createTrustedStore();
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
         // Above functions can fail only if not enough memory. But in this
@@ -1360,8 +1402,6 @@ void PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verifyRSACertificate(PDFSignatureV
         Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         X509* signer = certificate;
         if (!X509_STORE_CTX_init(context, store, signer, certificates))
         {
@@ -1541,7 +1581,7 @@ PDFSignatureVerificationResult PDFSignatureHandler_adbe_pkcs7_sha1::verify() con
 {
     PDFSignatureVerificationResult result;
     initializeResult(result);
-    verifyCertificate(result);
+    verifyCertificateCached(result, X509_PURPOSE_SMIME_SIGN, false, [this](PDFSignatureVerificationResult& certificateResult) { verifyCertificate(certificateResult); });
     verifySignature(result);
     result.validate();
     return result;
@@ -1788,7 +1828,6 @@ std::optional<PDFCertificateInfo> PDFCertificateInfo::getCertificateInfo(const Q
 {
     std::optional<PDFCertificateInfo> result;
 
-    PDFOpenSSLGlobalLock lock;
     const unsigned char* data = convertByteArrayToUcharPtr(certificateData);
     if (X509* certificate = d2i_X509(nullptr, &data, certificateData.length()))
     {
@@ -2039,15 +2078,15 @@ void PDFCertificateStore::createDirectoryForDefaultUserCertificatesStore()
 #endif
 #endif
 
-void pdf::PDFPublicKeySignatureHandler::addTrustedCertificates(X509_STORE* store) const
+static void addTrustedCertificatesToStore(X509_STORE* store, const pdf::PDFCertificateStore* certificateStore, bool useSystemCertificateStore)
 {
-    if (m_parameters.store)
+    if (certificateStore)
     {
-        const PDFCertificateStore::CertificateEntries& certificates = m_parameters.store->getCertificates();
+        const pdf::PDFCertificateStore::CertificateEntries& certificates = certificateStore->getCertificates();
         for (const auto& entry : certificates)
         {
             QByteArray certificateData = entry.info.getCertificateData();
-            const unsigned char* pointer = convertByteArrayToUcharPtr(certificateData);
+            const unsigned char* pointer = pdf::convertByteArrayToUcharPtr(certificateData);
             X509* certificate = d2i_X509(nullptr, &pointer, certificateData.length());
             if (certificate)
             {
@@ -2058,7 +2097,7 @@ void pdf::PDFPublicKeySignatureHandler::addTrustedCertificates(X509_STORE* store
     }
 
 #ifdef Q_OS_WIN
-    if (m_parameters.useSystemCertificateStore)
+    if (useSystemCertificateStore)
     {
         HCERTSTORE certStore = CertOpenSystemStore(0, L"ROOT");
         PCCERT_CONTEXT context = nullptr;
@@ -2078,9 +2117,194 @@ void pdf::PDFPublicKeySignatureHandler::addTrustedCertificates(X509_STORE* store
             CertCloseStore(certStore, CERT_CLOSE_STORE_FORCE_FLAG);
         }
     }
+#else
+    Q_UNUSED(useSystemCertificateStore);
 #endif
 }
 
+void pdf::PDFPublicKeySignatureHandler::addTrustedCertificates(X509_STORE* store) const
+{
+    addTrustedCertificatesToStore(store, m_parameters.store, m_parameters.useSystemCertificateStore);
+}
+
+X509_STORE* pdf::PDFPublicKeySignatureHandler::createTrustedStore() const
+{
+    if (m_parameters.context)
+    {
+        return m_parameters.context->acquireTrustedStore();
+    }
+
+    X509_STORE* store = X509_STORE_new();
+    addTrustedCertificates(store);
+    return store;
+}
+
+void pdf::PDFPublicKeySignatureHandler::verifyCertificateCached(PDFSignatureVerificationResult& result,
+                                                                int purpose,
+                                                                bool useDocumentSecurityStore,
+                                                                const std::function<void(PDFSignatureVerificationResult&)>& verifyFunction) const
+{
+    PDFSignatureVerificationContext* context = m_parameters.context;
+    const QByteArray key = context ? getCertificateCacheKey(purpose, useDocumentSecurityStore) : QByteArray();
+
+    if (key.isEmpty())
+    {
+        verifyFunction(result);
+        return;
+    }
+
+    if (context->restoreCertificateVerification(key, result))
+    {
+        return;
+    }
+
+    // Jakub Melka: verify certificates into empty result, so we have
+    // only certificate part of the verification, which can be cached.
+    PDFSignatureVerificationResult certificateVerification;
+    verifyFunction(certificateVerification);
+    result.addCertificateVerification(certificateVerification);
+    context->storeCertificateVerification(key, qMove(certificateVerification));
+}
+
+void pdf::PDFPublicKeySignatureHandler::addParametersToCertificateCacheKey(QCryptographicHash& hash, int purpose, bool useDocumentSecurityStore) const
+{
+    hash.addData(m_signatureField->getSignature().getSubfilter());
+    hash.addData(QByteArray::number(purpose));
+    hash.addData(m_parameters.ignoreExpirationDate ? "1" : "0");
+
+    if (useDocumentSecurityStore && m_parameters.dss)
+    {
+        for (const QByteArray& certificateData : m_parameters.dss->getMasterItem()->Cert)
+        {
+            hash.addData(certificateData);
+        }
+
+        hash.addData("CRL");
+        for (const QByteArray& crlData : m_parameters.dss->getMasterItem()->CRL)
+        {
+            hash.addData(crlData);
+        }
+    }
+}
+
+QByteArray pdf::PDFPublicKeySignatureHandler::getCertificateCacheKey(int purpose, bool useDocumentSecurityStore) const
+{
+    const PDFSignature& signature = m_signatureField->getSignature();
+    const QByteArray& content = signature.getContents();
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addParametersToCertificateCacheKey(hash, purpose, useDocumentSecurityStore);
+
+    const unsigned char* data = convertByteArrayToUcharPtr(content);
+    PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size());
+    if (!pkcs7)
+    {
+        // Invalid certificate data, verification fails immediately
+        return QByteArray();
+    }
+
+    STACK_OF(X509)* certificates = getCertificates(pkcs7);
+    for (int i = 0, count = sk_X509_num(certificates); i < count; ++i)
+    {
+        unsigned char* buffer = nullptr;
+        const int length = i2d_X509(sk_X509_value(certificates, i), &buffer);
+        if (length > 0)
+        {
+            hash.addData(QByteArrayView(reinterpret_cast<const char*>(buffer), length));
+        }
+        OPENSSL_free(buffer);
+    }
+
+    // Signer is identified by issuer and serial number
+    hash.addData("SIGNERS");
+    STACK_OF(PKCS7_SIGNER_INFO)* signerInfo = PKCS7_get_signer_info(pkcs7);
+    for (int i = 0, count = sk_PKCS7_SIGNER_INFO_num(signerInfo); i < count; ++i)
+    {
+        PKCS7_SIGNER_INFO* signerInfoValue = sk_PKCS7_SIGNER_INFO_value(signerInfo, i);
+        unsigned char* buffer = nullptr;
+        const int length = i2d_PKCS7_ISSUER_AND_SERIAL(signerInfoValue->issuer_and_serial, &buffer);
+        if (length > 0)
+        {
+            hash.addData(QByteArrayView(reinterpret_cast<const char*>(buffer), length));
+        }
+        OPENSSL_free(buffer);
+    }
+
+    PKCS7_free(pkcs7);
+    return hash.result();
+}
+
+QByteArray pdf::PDFSignatureHandler_adbe_pkcs7_rsa_sha1::getCertificateCacheKey(int purpose, bool useDocumentSecurityStore) const
+{
+    const std::vector<QByteArray>* certificates = m_signatureField->getSignature().getCertificates();
+    if (!certificates || certificates->empty())
+    {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addParametersToCertificateCacheKey(hash, purpose, useDocumentSecurityStore);
+
+    for (const QByteArray& certificateData : *certificates)
+    {
+        hash.addData(certificateData);
+    }
+
+    return hash.result();
+}
+
+pdf::PDFSignatureVerificationContext::PDFSignatureVerificationContext(const PDFCertificateStore* store, bool useSystemCertificateStore) :
+    m_store(X509_STORE_new())
+{
+    Q_ASSERT(m_store);
+    addTrustedCertificatesToStore(m_store, store, useSystemCertificateStore);
+}
+
+pdf::PDFSignatureVerificationContext::~PDFSignatureVerificationContext()
+{
+    X509_STORE_free(m_store);
+}
+
+x509_store_st* pdf::PDFSignatureVerificationContext::acquireTrustedStore() const
+{
+    X509_STORE_up_ref(m_store);
+    return m_store;
+}
+
+bool pdf::PDFSignatureVerificationContext::restoreCertificateVerification(const QByteArray& key, PDFSignatureVerificationResult& result) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_certificateVerificationCache.find(key);
+    if (it != m_certificateVerificationCache.cend())
+    {
+        ++m_cacheHits;
+        result.addCertificateVerification(it->second);
+        return true;
+    }
+
+    ++m_cacheMisses;
+    return false;
+}
+
+void pdf::PDFSignatureVerificationContext::storeCertificateVerification(const QByteArray& key, PDFSignatureVerificationResult certificateVerification)
+{
+    QMutexLocker lock(&m_mutex);
+    m_certificateVerificationCache.emplace(key, qMove(certificateVerification));
+}
+
+pdf::PDFInteger pdf::PDFSignatureVerificationContext::getCacheHits() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheHits;
+}
+
+pdf::PDFInteger pdf::PDFSignatureVerificationContext::getCacheMisses() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheMisses;
+}
+
 pdf::PDFCertificateStore::CertificateEntries pdf::PDFCertificateStore::getSystemCertificates()
 {
     CertificateEntries result;
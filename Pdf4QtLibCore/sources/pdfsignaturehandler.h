@@ -22,12 +22,15 @@
 #include "pdfobject.h"
 #include "pdfutils.h"
 
+#include <QMutex>
 #include <QString>
 #include <QDateTime>
 
+#include <map>
 #include <optional>
 
 class QDataStream;
+struct x509_store_st;
 
 namespace pdf
 {
@@ -36,6 +39,7 @@ class PDFObjectStorage;
 class PDFCertificateStore;
 class PDFFormFieldSignature;
 class PDFDocumentSecurityStore;
+class PDFSignatureVerificationContext;
 
 /// Signature reference dictionary.
 class PDFSignatureReference
@@ -387,6 +391,11 @@ public:
     void setSignatureFieldReference(PDFObjectReference signatureFieldReference);
 
     void addCertificateInfo(PDFCertificateInfo info) { m_certificateInfos.emplace_back(qMove(info)); }
+
+    /// Adds certificate part of the verification (certificate flags, errors,
+    /// warnings and certificate infos) from another verification result.
+    /// \param certificateVerification Result of certificate verification
+    void addCertificateVerification(const PDFSignatureVerificationResult& certificateVerification);
     void addHashAlgorithm(const QString& algorithm);
 
     /// Adds OK flag, if both certificate and signature are valid
@@ -443,10 +452,16 @@ public:
         bool enableVerification = true;
         bool ignoreExpirationDate = false;
         bool useSystemCertificateStore = true;
+
+        /// Shared verification context. If it is set, then trusted certificates
+        /// are taken from the context (not from \p store) and certificate verification
+        /// results are cached in the context. If it is not set, then temporary
+        /// context is created for each call of \p verifySignatures.
+        PDFSignatureVerificationContext* context = nullptr;
     };
 
     /// Tries to verify all signatures in the form. If form is invalid, then
-    /// empty vector is returned.
+    /// empty vector is returned. Signatures are verified in parallel.
     /// \param form Form
     /// \param sourceData Source data
     /// \param parameters Verification settings
@@ -462,6 +477,57 @@ private:
     static PDFSignatureHandler* createHandler(const PDFFormFieldSignature* signatureField, const QByteArray& sourceData, const Parameters& parameters);
 };
 
+/// Shared context for signature verification. Contains prebuilt store of trusted
+/// certificates, so it is not created for each verified signature, and cache of
+/// certificate verification results. Cache is keyed by fingerprint of certificates
+/// (and revocation lists) used in the verification, together with verification
+/// settings. Context is thread safe, so it can be shared by verifications of many
+/// documents, running concurrently. Cached results are never invalidated, so context
+/// should not live longer than one verification session (certificates can expire,
+/// or be revoked).
+class PDF4QTLIBCORESHARED_EXPORT PDFSignatureVerificationContext
+{
+public:
+    /// Creates verification context
+    /// \param store Trusted certificates (can be nullptr)
+    /// \param useSystemCertificateStore Add system trusted certificates
+    explicit PDFSignatureVerificationContext(const PDFCertificateStore* store, bool useSystemCertificateStore);
+    ~PDFSignatureVerificationContext();
+
+    PDFSignatureVerificationContext(const PDFSignatureVerificationContext&) = delete;
+    PDFSignatureVerificationContext& operator=(const PDFSignatureVerificationContext&) = delete;
+
+    /// Returns trusted certificate store. Reference count of the store
+    /// is incremented, caller must release it using X509_STORE_free.
+    /// Store must not be modified.
+    x509_store_st* acquireTrustedStore() const;
+
+    /// Tries to find cached certificate verification for given key. If it is found,
+    /// then it is added to the \p result and true is returned, otherwise
+    /// false is returned and \p result is unchanged.
+    /// \param key Certificate fingerprint key
+    /// \param result Verification result
+    bool restoreCertificateVerification(const QByteArray& key, PDFSignatureVerificationResult& result) const;
+
+    /// Stores result of certificate verification to the cache
+    /// \param key Certificate fingerprint key
+    /// \param certificateVerification Result of certificate verification
+    void storeCertificateVerification(const QByteArray& key, PDFSignatureVerificationResult certificateVerification);
+
+    /// Returns count of certificate verifications found in the cache
+    PDFInteger getCacheHits() const;
+
+    /// Returns count of certificate verifications not found in the cache
+    PDFInteger getCacheMisses() const;
+
+private:
+    x509_store_st* m_store = nullptr;
+    mutable QMutex m_mutex;
+    mutable PDFInteger m_cacheHits = 0;
+    mutable PDFInteger m_cacheMisses = 0;
+    std::map<QByteArray, PDFSignatureVerificationResult> m_certificateVerificationCache;
+};
+
 /// Trusted certificate store. Contains list of trusted certificates. Store
 /// can be persisted to the persistent storage trough serialization/deserialization.
 /// Persisting method is versioned.
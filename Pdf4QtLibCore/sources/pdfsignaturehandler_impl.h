@@ -24,6 +24,10 @@
 #include <openssl/x509v3.h>
 #include <openssl/pkcs7.h>
 
+#include <QCryptographicHash>
+
+#include <functional>
+
 namespace pdf
 {
 
@@ -44,6 +48,34 @@ protected:
     void verifySignature(PDFSignatureVerificationResult& result) const;
     void addTrustedCertificates(X509_STORE* store) const;
 
+    /// Creates store of trusted certificates. If verification context is present,
+    /// then shared store from the context is returned. Store must be released
+    /// by X509_STORE_free.
+    X509_STORE* createTrustedStore() const;
+
+    /// Performs certificate verification using \p verifyFunction. If verification
+    /// context is present, then certificate verification result is taken from
+    /// the cache, or it is stored into the cache after the verification.
+    /// \param result Verification result
+    /// \param purpose Certificate purpose
+    /// \param useDocumentSecurityStore Verification uses document security store
+    /// \param verifyFunction Certificate verification function
+    void verifyCertificateCached(PDFSignatureVerificationResult& result,
+                                 int purpose,
+                                 bool useDocumentSecurityStore,
+                                 const std::function<void(PDFSignatureVerificationResult&)>& verifyFunction) const;
+
+    /// Returns key for certificate verification cache. Key is fingerprint
+    /// of all certificates used in the verification (and of verification settings).
+    /// If empty key is returned, then result will not be cached.
+    /// \param purpose Certificate purpose
+    /// \param useDocumentSecurityStore Verification uses document security store
+    virtual QByteArray getCertificateCacheKey(int purpose, bool useDocumentSecurityStore) const;
+
+    /// Adds verification settings and content of the document security
+    /// store (if it is used) to the certificate cache key hash
+    void addParametersToCertificateCacheKey(QCryptographicHash& hash, int purpose, bool useDocumentSecurityStore) const;
+
     virtual BIO* getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const;
 
 public:
@@ -106,6 +138,9 @@ public:
 
     virtual PDFSignatureVerificationResult verify() const override;
 
+protected:
+    virtual QByteArray getCertificateCacheKey(int purpose, bool useDocumentSecurityStore) const override;
+
 private:
     X509* createCertificate(size_t index) const;
     bool getMessageDigest(const QByteArray& message, ASN1_OCTET_STRING* encryptedString, RSA* rsa, int& algorithmNID, QByteArray& digest) const;
@@ -20,9 +20,13 @@
 #include "pdfexecutionpolicy.h"
 #include "pdfdbgheap.h"
 
+#include <QMutex>
 #include <QPainter>
 
 #include <execution>
+#include <list>
+#include <map>
+#include <numeric>
 
 namespace pdf
 {
@@ -726,15 +730,40 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
         lines.emplace_back(qMove(item.second));
     }
 
-    // Step 4) - detect text blocks
+    // Step 4) - detect text blocks. Bounding rectangles of lines are computed only once,
+    // and lines are swept in the order of their top edges, so we compare only lines,
+    // which can satisfy the vertical criterium (instead of comparing all pairs of lines).
     const size_t lineCount = lines.size();
+    std::vector<QRectF> lineBoundingRects;
+    lineBoundingRects.reserve(lineCount);
+    PDFReal maximalLineHeight = 0.0;
+    for (const PDFTextLine& line : lines)
+    {
+        lineBoundingRects.push_back(line.getBoundingBox().boundingRect());
+        maximalLineHeight = qMax(maximalLineHeight, lineBoundingRects.back().height());
+    }
+
+    std::vector<size_t> linesByTop(lineCount, 0);
+    std::iota(linesByTop.begin(), linesByTop.end(), 0);
+    std::stable_sort(linesByTop.begin(), linesByTop.end(), [&lineBoundingRects](const size_t l, const size_t r) { return lineBoundingRects[l].top() < lineBoundingRects[r].top(); });
+
     PDFUnionFindAlgorithm<size_t> textBlocksUF(lineCount);
-    for (size_t i = 0; i < lineCount; ++i)
+    for (auto it = linesByTop.cbegin(); it != linesByTop.cend(); ++it)
     {
-        for (size_t j = i + 1; j < lineCount; ++j)
+        const QRectF& bb1 = lineBoundingRects[*it];
+
+        // Jakub Melka: height of the united bounding box is at least the distance
+        // of top edges of the lines, so we can stop, when this distance exceeds
+        // the height limit, which is computed for the highest line on the page.
+        const PDFReal sweepHeightLimit = (bb1.height() + maximalLineHeight) * m_settings.blockVerticalSensitivity;
+
+        for (auto it2 = std::next(it); it2 != linesByTop.cend(); ++it2)
         {
-            QRectF bb1 = lines[i].getBoundingBox().boundingRect();
-            QRectF bb2 = lines[j].getBoundingBox().boundingRect();
+            const QRectF& bb2 = lineBoundingRects[*it2];
+            if (bb2.top() - bb1.top() >= sweepHeightLimit)
+            {
+                break;
+            }
 
             // Jakub Melka: we will join two blocks, if these two conditions both holds:
             //     1) bounding boxes overlap horizontally by large portion
@@ -747,7 +776,7 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
             const PDFReal minimalOverlap = qMin(bb1.width(), bb2.width()) * m_settings.blockOverlapSensitivity;
             if (height < heightLimit && overlap > minimalOverlap)
             {
-                textBlocksUF.unify(i, j);
+                textBlocksUF.unify(*it, *it2);
             }
         }
     }
@@ -778,33 +807,56 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
     //    - there doesn't exist block c, which is between a,b in y-axis
     //      and moreover, overlaps both a and b in x-axis.
 
-    auto isBeforeByRule1 = [&blocks](const size_t aIndex, const size_t bIndex)
+    const size_t blockCount = blocks.size();
+    std::vector<QRectF> blockBoundingRects;
+    blockBoundingRects.reserve(blockCount);
+    for (const PDFTextBlock& block : blocks)
+    {
+        blockBoundingRects.push_back(block.getBoundingBox().boundingRect());
+    }
+
+    // Blocks sorted by top edge, used to find 'c' blocks for rule 2
+    std::vector<size_t> blocksByTop(blockCount, 0);
+    std::iota(blocksByTop.begin(), blocksByTop.end(), 0);
+    std::stable_sort(blocksByTop.begin(), blocksByTop.end(), [&blockBoundingRects](const size_t l, const size_t r) { return blockBoundingRects[l].top() < blockBoundingRects[r].top(); });
+
+    auto isBeforeByRule1 = [&blockBoundingRects](const size_t aIndex, const size_t bIndex)
     {
-        QRectF aBB = blocks[aIndex].getBoundingBox().boundingRect();
-        QRectF bBB = blocks[bIndex].getBoundingBox().boundingRect();
+        const QRectF& aBB = blockBoundingRects[aIndex];
+        const QRectF& bBB = blockBoundingRects[bIndex];
 
         const bool isOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(aBB, bBB);
         const bool isAoverB = aBB.bottom() > bBB.top();
         return isOverlappedOnHorizontalAxis && isAoverB;
     };
-    auto isBeforeByRule2 = [&blocks](const size_t aIndex, const size_t bIndex)
+    auto isBeforeByRule2 = [&blockBoundingRects, &blocksByTop](const size_t aIndex, const size_t bIndex)
     {
-        QRectF aBB = blocks[aIndex].getBoundingBox().boundingRect();
-        QRectF bBB = blocks[bIndex].getBoundingBox().boundingRect();
-        QRectF abBB = aBB.united(bBB);
+        const QRectF& aBB = blockBoundingRects[aIndex];
+        const QRectF& bBB = blockBoundingRects[bIndex];
 
         if (aBB.right() < bBB.left())
         {
-            // Check, if 'c' block doesn't exist
-            for (size_t i = 0, count = blocks.size(); i < count; ++i)
+            QRectF abBB = aBB.united(bBB);
+
+            // Check, if 'c' block doesn't exist. Only blocks, whose top edge
+            // is in the vertical range of the united bounding box, are checked.
+            auto it = std::lower_bound(blocksByTop.cbegin(), blocksByTop.cend(), abBB.top(), [&blockBoundingRects](const size_t index, const PDFReal top) { return blockBoundingRects[index].top() < top; });
+            for (; it != blocksByTop.cend(); ++it)
             {
+                const size_t i = *it;
+                const QRectF& cBB = blockBoundingRects[i];
+
+                if (cBB.top() > abBB.bottom())
+                {
+                    break;
+                }
+
                 if (i == aIndex || i == bIndex)
                 {
                     continue;
                 }
 
-                QRectF cBB = blocks[i].getBoundingBox().boundingRect();
-                if (cBB.top() >= abBB.top() && cBB.bottom() <= abBB.bottom())
+                if (cBB.bottom() <= abBB.bottom())
                 {
                     const bool isAOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(aBB, cBB);
                     const bool isBOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(bBB, cBB);
@@ -821,38 +873,100 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
         return false;
     };
 
+    // Blocks sorted by left edge and by right edge. Predecessor of the block by
+    // rule 1 overlaps the block in x-axis, so its left edge is in the range
+    // [left - maximal block width, right]. Predecessor by rule 2 is entirely
+    // on the left side of the block, so its right edge is less than block's left edge.
+    std::vector<size_t> blocksByLeft(blockCount, 0);
+    std::iota(blocksByLeft.begin(), blocksByLeft.end(), 0);
+    std::stable_sort(blocksByLeft.begin(), blocksByLeft.end(), [&blockBoundingRects](const size_t l, const size_t r) { return blockBoundingRects[l].left() < blockBoundingRects[r].left(); });
+
+    std::vector<size_t> blocksByRight(blockCount, 0);
+    std::iota(blocksByRight.begin(), blocksByRight.end(), 0);
+    std::stable_sort(blocksByRight.begin(), blocksByRight.end(), [&blockBoundingRects](const size_t l, const size_t r) { return blockBoundingRects[l].right() < blockBoundingRects[r].right(); });
+
+    PDFReal maximalBlockWidth = 0.0;
+    for (const QRectF& boundingRect : blockBoundingRects)
+    {
+        maximalBlockWidth = qMax(maximalBlockWidth, boundingRect.width());
+    }
+
     // Order blocks using topological sort (https://en.wikipedia.org/wiki/Topological_sorting,
-    // Kahn's algorithm is used)
-    std::set<size_t> workBlocks;
-    std::vector<size_t> ordering;
-    std::vector<std::set<size_t>> orderingEdges(blocks.size(), std::set<size_t>());
-    ordering.reserve(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-        workBlocks.insert(workBlocks.end(), i);
-        for (size_t j = 0; j < blocks.size(); ++j)
+    // Kahn's algorithm is used). Predecessors of each block are computed in parallel.
+    std::vector<std::vector<size_t>> predecessors(blockCount);
+    auto findPredecessors = [&](size_t i)
+    {
+        const QRectF& boundingRect = blockBoundingRects[i];
+
+        // Rule 1 - only blocks, whose left edge is in the range, are checked (small
+        // margin is added, so no block is missed due to rounding errors)
+        const PDFReal minimalLeft = boundingRect.left() - maximalBlockWidth - PDF_EPSILON;
+        auto itRule1Begin = std::lower_bound(blocksByLeft.cbegin(), blocksByLeft.cend(), minimalLeft, [&blockBoundingRects](const size_t index, const PDFReal left) { return blockBoundingRects[index].left() < left; });
+        auto itRule1End = std::upper_bound(itRule1Begin, blocksByLeft.cend(), boundingRect.right(), [&blockBoundingRects](const PDFReal right, const size_t index) { return right < blockBoundingRects[index].left(); });
+        for (auto it = itRule1Begin; it != itRule1End; ++it)
+        {
+            const size_t j = *it;
+            if (i != j && isBeforeByRule1(j, i))
+            {
+                predecessors[i].push_back(j);
+            }
+        }
+
+        // Rule 2 - only blocks entirely on the left side are checked. Blocks
+        // found by rule 1 overlap the block in x-axis, so they are not found again.
+        auto itRule2End = std::lower_bound(blocksByRight.cbegin(), blocksByRight.cend(), boundingRect.left(), [&blockBoundingRects](const size_t index, const PDFReal left) { return blockBoundingRects[index].right() < left; });
+        for (auto it = blocksByRight.cbegin(); it != itRule2End; ++it)
         {
-            if (i != j && (isBeforeByRule1(j, i) || isBeforeByRule2(j, i)))
+            const size_t j = *it;
+            if (isBeforeByRule2(j, i))
             {
-                orderingEdges[i].insert(j);
+                predecessors[i].push_back(j);
             }
         }
+    };
+
+    auto blockRange = PDFIntegerRange<size_t>(0, blockCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, blockRange.begin(), blockRange.end(), findPredecessors);
+
+    std::vector<size_t> edgeCounts(blockCount, 0);
+    std::vector<std::vector<size_t>> successors(blockCount);
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+        edgeCounts[i] = predecessors[i].size();
+        for (const size_t j : predecessors[i])
+        {
+            successors[j].push_back(i);
+        }
+    }
+
+    // Jakub Melka: ordering rules can create cycles, so we always take block with minimal
+    // number of remaining edges (and with minimal index, if there are more such blocks).
+    // Work blocks are ordered by pair (number of remaining edges, block index).
+    std::set<std::pair<size_t, size_t>> workBlocks;
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+        workBlocks.insert(workBlocks.end(), std::make_pair(edgeCounts[i], i));
     }
 
     // Topological sort
     QTransform invertedAngleMatrix = angleMatrix.inverted();
     while (!workBlocks.empty())
     {
-        auto it = std::min_element(workBlocks.begin(), workBlocks.end(), [&orderingEdges](const size_t l, const size_t r) { return orderingEdges[l].size() < orderingEdges[r].size(); });
-        ordering.push_back(*it);
-        for (std::set<size_t>& edges : orderingEdges)
+        const size_t blockIndex = workBlocks.begin()->second;
+        workBlocks.erase(workBlocks.begin());
+
+        for (const size_t successor : successors[blockIndex])
         {
-            edges.erase(*it);
+            auto it = workBlocks.find(std::make_pair(edgeCounts[successor], successor));
+            if (it != workBlocks.end())
+            {
+                workBlocks.erase(it);
+                workBlocks.insert(std::make_pair(--edgeCounts[successor], successor));
+            }
         }
 
-        blocks[*it].applyTransform(invertedAngleMatrix);
-        m_blocks.emplace_back(qMove(blocks[*it]));
-        workBlocks.erase(it);
+        blocks[blockIndex].applyTransform(invertedAngleMatrix);
+        m_blocks.emplace_back(qMove(blocks[blockIndex]));
     }
 }
 
@@ -1086,7 +1200,102 @@ QDataStream& operator>>(QDataStream& stream, TextCharacter& character)
     return stream;
 }
 
+/// Cache of the text layout storage
+struct PDFTextLayoutStorageCache
+{
+    using Layout = std::pair<PDFInteger, std::shared_ptr<const PDFTextLayout>>;
+    using FlowTexts = std::shared_ptr<const std::vector<QStringList>>;
+
+    QMutex mutex;
+    std::list<Layout> layouts;          ///< Decompressed text layouts, most recently used first
+    std::map<int, FlowTexts> flowTexts; ///< Flat texts of text flows for given flow flags
+};
+
+PDFTextLayoutStorage::PDFTextLayoutStorage() :
+    m_cache(std::make_shared<PDFTextLayoutStorageCache>())
+{
+
+}
+
+PDFTextLayoutStorage::PDFTextLayoutStorage(PDFInteger pageCount) :
+    m_offsets(pageCount, 0),
+    m_cache(std::make_shared<PDFTextLayoutStorageCache>())
+{
+
+}
+
+PDFTextLayoutStorage::PDFTextLayoutStorage(const PDFTextLayoutStorage& other) :
+    m_offsets(other.m_offsets),
+    m_textLayouts(other.m_textLayouts),
+    m_cache(std::make_shared<PDFTextLayoutStorageCache>())
+{
+
+}
+
+PDFTextLayoutStorage& PDFTextLayoutStorage::operator=(const PDFTextLayoutStorage& other)
+{
+    if (this != &other)
+    {
+        m_offsets = other.m_offsets;
+        m_textLayouts = other.m_textLayouts;
+        m_cache = std::make_shared<PDFTextLayoutStorageCache>();
+    }
+
+    return *this;
+}
+
+PDFTextLayoutStorage::PDFTextLayoutStorage(PDFTextLayoutStorage&& other) :
+    m_offsets(std::exchange(other.m_offsets, std::vector<int>())),
+    m_textLayouts(std::exchange(other.m_textLayouts, QByteArray())),
+    m_cache(std::exchange(other.m_cache, std::make_shared<PDFTextLayoutStorageCache>()))
+{
+
+}
+
+PDFTextLayoutStorage& PDFTextLayoutStorage::operator=(PDFTextLayoutStorage&& other)
+{
+    if (this != &other)
+    {
+        m_offsets = std::exchange(other.m_offsets, std::vector<int>());
+        m_textLayouts = std::exchange(other.m_textLayouts, QByteArray());
+        m_cache = std::exchange(other.m_cache, std::make_shared<PDFTextLayoutStorageCache>());
+    }
+
+    return *this;
+}
+
 PDFTextLayout PDFTextLayoutStorage::getTextLayout(PDFInteger pageIndex) const
+{
+    if (pageIndex < 0 || pageIndex >= static_cast<PDFInteger>(m_offsets.size()))
+    {
+        return PDFTextLayout();
+    }
+
+    {
+        QMutexLocker lock(&m_cache->mutex);
+        auto it = std::find_if(m_cache->layouts.begin(), m_cache->layouts.end(), [pageIndex](const auto& item) { return item.first == pageIndex; });
+        if (it != m_cache->layouts.end())
+        {
+            m_cache->layouts.splice(m_cache->layouts.begin(), m_cache->layouts, it);
+            return *m_cache->layouts.front().second;
+        }
+    }
+
+    // Jakub Melka: Decompress layout outside of the lock, so more
+    // layouts can be decompressed in parallel.
+    std::shared_ptr<const PDFTextLayout> layout = std::make_shared<const PDFTextLayout>(decompressTextLayout(pageIndex));
+
+    QMutexLocker lock(&m_cache->mutex);
+    m_cache->layouts.emplace_front(pageIndex, layout);
+    if (m_cache->layouts.size() > LAYOUT_CACHE_SIZE)
+    {
+        m_cache->layouts.pop_back();
+    }
+
+    return *layout;
+}
+
+PDFTextLayout PDFTextLayoutStorage::decompressTextLayout(PDFInteger pageIndex) const
 {
     PDFTextLayout result;
 
@@ -1113,56 +1322,85 @@ void PDFTextLayoutStorage::setTextLayout(PDFInteger pageIndex, const PDFTextLayo
         QDataStream stream(&result, QIODevice::WriteOnly);
         stream << layout;
     }
-    result = qCompress(result, 9);
+
+    // Jakub Melka: we use fast compression level, because layouts are decompressed
+    // only for pages, where something was found, or which are being displayed.
+    result = qCompress(result, 1);
 
     QMutexLocker lock(mutex);
     m_offsets[pageIndex] = m_textLayouts.size();
 
     QDataStream layoutStream(&m_textLayouts, QIODevice::Append | QIODevice::WriteOnly);
     layoutStream << result;
+
+    QMutexLocker cacheLock(&m_cache->mutex);
+    m_cache->layouts.remove_if([pageIndex](const auto& item) { return item.first == pageIndex; });
+    m_cache->flowTexts.clear();
 }
 
-PDFFindResults PDFTextLayoutStorage::find(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const
+std::shared_ptr<const std::vector<QStringList>> PDFTextLayoutStorage::getTextFlowTexts(PDFTextFlow::FlowFlags flowFlags) const
 {
-    PDFFindResults results;
+    {
+        QMutexLocker lock(&m_cache->mutex);
+        auto it = m_cache->flowTexts.find(flowFlags.toInt());
+        if (it != m_cache->flowTexts.cend())
+        {
+            return it->second;
+        }
+    }
 
-    QMutex resultsMutex;
-    auto findImpl = [this, flowFlags, caseSensitivity, &results, &resultsMutex, &text](size_t pageIndex)
+    std::vector<QStringList> flowTexts(m_offsets.size());
+    auto createFlowTexts = [this, flowFlags, &flowTexts](size_t pageIndex)
     {
-        PDFTextLayout textLayout = getTextLayout(pageIndex);
+        PDFTextLayout textLayout = decompressTextLayout(pageIndex);
         PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, flowFlags, pageIndex);
+
+        QStringList& texts = flowTexts[pageIndex];
+        texts.reserve(textFlows.size());
         for (const PDFTextFlow& textFlow : textFlows)
         {
-            PDFFindResults flowResults = textFlow.find(text, caseSensitivity);
-
-            // Jakub Melka: Do not lock mutex, if we didn't find anything. In that case, just skip to next flow.
-            if (!flowResults.empty())
-            {
-                QMutexLocker lock(&resultsMutex);
-                results.insert(results.end(), flowResults.begin(), flowResults.end());
-            }
+            texts << textFlow.getText();
         }
     };
 
     auto range = PDFIntegerRange<size_t>(0, m_offsets.size());
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findImpl);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), createFlowTexts);
 
-    std::sort(results.begin(), results.end());
-    return results;
+    QMutexLocker lock(&m_cache->mutex);
+    auto it = m_cache->flowTexts.emplace(flowFlags.toInt(), std::make_shared<const std::vector<QStringList>>(qMove(flowTexts))).first;
+    return it->second;
 }
 
-PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const
+template<typename Predicate, typename FindFunction>
+PDFFindResults PDFTextLayoutStorage::findImpl(PDFTextFlow::FlowFlags flowFlags, Predicate predicate, FindFunction findFunction) const
 {
     PDFFindResults results;
 
+    std::shared_ptr<const std::vector<QStringList>> flowTexts = getTextFlowTexts(flowFlags);
+
     QMutex resultsMutex;
-    auto findImpl = [this, flowFlags, &results, &resultsMutex, &expression](size_t pageIndex)
+    auto findOnPage = [this, flowFlags, &flowTexts, &predicate, &findFunction, &results, &resultsMutex](size_t pageIndex)
     {
+        // Jakub Melka: search in flat texts first, and only if something
+        // is found, create text flows, which are needed to create results.
+        const QStringList& texts = (*flowTexts)[pageIndex];
+        if (std::none_of(texts.cbegin(), texts.cend(), predicate))
+        {
+            return;
+        }
+
         PDFTextLayout textLayout = getTextLayout(pageIndex);
         PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, flowFlags, pageIndex);
-        for (const PDFTextFlow& textFlow : textFlows)
+        Q_ASSERT(textFlows.size() == size_t(texts.size()));
+
+        for (size_t i = 0; i < textFlows.size() && i < size_t(texts.size()); ++i)
         {
-            PDFFindResults flowResults = textFlow.find(expression);
+            if (!predicate(texts[i]))
+            {
+                continue;
+            }
+
+            PDFFindResults flowResults = findFunction(textFlows[i]);
 
             // Jakub Melka: Do not lock mutex, if we didn't find anything. In that case, just skip to next flow.
             if (!flowResults.empty())
@@ -1174,12 +1412,26 @@ PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression,
     };
 
     auto range = PDFIntegerRange<size_t>(0, m_offsets.size());
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findImpl);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findOnPage);
 
     std::sort(results.begin(), results.end());
     return results;
 }
 
+PDFFindResults PDFTextLayoutStorage::find(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const
+{
+    auto predicate = [&text, caseSensitivity](const QString& flowText) { return flowText.contains(text, caseSensitivity); };
+    auto findFunction = [&text, caseSensitivity](const PDFTextFlow& textFlow) { return textFlow.find(text, caseSensitivity); };
+    return findImpl(flowFlags, predicate, findFunction);
+}
+
+PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const
+{
+    auto predicate = [&expression](const QString& flowText) { return expression.match(flowText).hasMatch(); };
+    auto findFunction = [&expression](const PDFTextFlow& textFlow) { return textFlow.find(expression); };
+    return findImpl(flowFlags, predicate, findFunction);
+}
+
 QDataStream& operator<<(QDataStream& stream, const PDFTextLayoutSettings& settings)
 {
     stream << settings.samples;
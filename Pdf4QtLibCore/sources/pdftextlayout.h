@@ -26,6 +26,7 @@
 #include <QPainterPath>
 
 #include <set>
+#include <memory>
 #include <compare>
 
 namespace pdf
@@ -33,6 +34,7 @@ namespace pdf
 class PDFTextLayout;
 class PDFTextLayoutStorage;
 struct PDFCharacterPointer;
+struct PDFTextLayoutStorageCache;
 
 struct PDFTextCharacterInfo
 {
@@ -540,15 +542,28 @@ private:
 /// For writing, mutex is used to synchronize asynchronous writes, for reading
 /// no mutex is used at all. For this reason, both reading/writing at the same time
 /// is prohibited, it is not thread safe.
+///
+/// Text layouts are stored compressed. To avoid decompression of all pages
+/// during each search, storage creates (on first search with given flow flags)
+/// an index of flat, uncompressed texts of all text flows. Searching is then
+/// performed on the flat texts and only pages containing a match are decompressed.
+/// Recently used decompressed text layouts are kept in the LRU cache. Each copy
+/// of the storage has its own cache, cache is never shared between storages.
 class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutStorage
 {
 public:
-    explicit inline PDFTextLayoutStorage() = default;
-    explicit inline PDFTextLayoutStorage(PDFInteger pageCount) :
-        m_offsets(pageCount, 0)
-    {
+    explicit PDFTextLayoutStorage();
+    explicit PDFTextLayoutStorage(PDFInteger pageCount);
 
-    }
+    /// Copy of the storage has its own (empty) cache, so layouts
+    /// changed in one copy are never returned from the other copy.
+    PDFTextLayoutStorage(const PDFTextLayoutStorage& other);
+    PDFTextLayoutStorage& operator=(const PDFTextLayoutStorage& other);
+
+    /// Moved storage takes the cache, moved-from storage is left
+    /// empty with a new (empty) cache, so it can still be used.
+    PDFTextLayoutStorage(PDFTextLayoutStorage&& other);
+    PDFTextLayoutStorage& operator=(PDFTextLayoutStorage&& other);
 
     /// Returns text layout for particular page. If page index is invalid,
     /// then empty text layout is returned. Function is not thread safe, if
@@ -580,12 +595,30 @@ public:
     /// \param flowFlags Text flow flags
     PDFFindResults find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const;
 
+    /// Returns texts of the text flows for each page, created using given flow flags
+    /// (one string for each text flow, in the same order as flows created by
+    /// \p PDFTextFlow::createTextFlows). Texts are created on first call and
+    /// then they are cached.
+    /// \param flowFlags Text flow flags
+    std::shared_ptr<const std::vector<QStringList>> getTextFlowTexts(PDFTextFlow::FlowFlags flowFlags) const;
+
     /// Returns number of pages
     size_t getCount() const { return m_offsets.size(); }
 
 private:
+    static constexpr size_t LAYOUT_CACHE_SIZE = 32;
+
+    /// Decompresses text layout, without using the cache
+    PDFTextLayout decompressTextLayout(PDFInteger pageIndex) const;
+
+    /// Finds results in all pages. Only pages, whose flow text satisfies
+    /// \p predicate, are decompressed and searched using \p findFunction.
+    template<typename Predicate, typename FindFunction>
+    PDFFindResults findImpl(PDFTextFlow::FlowFlags flowFlags, Predicate predicate, FindFunction findFunction) const;
+
     std::vector<int> m_offsets;
     QByteArray m_textLayouts;
+    std::shared_ptr<PDFTextLayoutStorageCache> m_cache;
 };
 
 }   // namespace pdf
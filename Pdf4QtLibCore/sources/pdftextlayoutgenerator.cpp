@@ -20,13 +20,26 @@
 namespace pdf
 {
 
-PDFTextLayout PDFTextLayoutGenerator::createTextLayout()
+PDFTextLayout PDFTextLayoutSink::createTextLayout()
 {
     m_textLayout.perform();
     m_textLayout.optimize();
     return qMove(m_textLayout);
 }
 
+void PDFTextLayoutSink::performOutputCharacter(const PDFTextCharacterInfo& info)
+{
+    if (!info.character.isSpace())
+    {
+        m_textLayout.addCharacter(info);
+    }
+}
+
+PDFTextLayout PDFTextLayoutGenerator::createTextLayout()
+{
+    return m_textLayoutSink.createTextLayout();
+}
+
 bool PDFTextLayoutGenerator::isContentSuppressedByOC(PDFObjectReference ocgOrOcmd)
 {
     if (m_features.testFlag(PDFRenderer::IgnoreOptionalContent))
@@ -60,12 +73,4 @@ bool PDFTextLayoutGenerator::isContentKindSuppressed(ContentKind kind) const
     return false;
 }
 
-void PDFTextLayoutGenerator::performOutputCharacter(const PDFTextCharacterInfo& info)
-{
-    if (!isContentSuppressed() && !info.character.isSpace())
-    {
-        m_textLayout.addCharacter(info);
-    }
-}
-
 }   // namespace pdf
@@ -20,6 +20,23 @@
 namespace pdf
 {
 
+/// Sink collecting text characters into the text layout. It can be registered
+/// to other content processor (for example, page compiler), so text layout
+/// is created in the same pass, in which page is compiled.
+class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutSink : public PDFPageContentProcessorSink
+{
+public:
+    explicit inline PDFTextLayoutSink() = default;
+
+    /// Creates text layout from the collected characters
+    PDFTextLayout createTextLayout();
+
+    virtual void performOutputCharacter(const PDFTextCharacterInfo& info) override;
+
+private:
+    PDFTextLayout m_textLayout;
+};
+
 class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutGenerator : public PDFPageContentProcessor
 {
     using BaseClass = PDFPageContentProcessor;
@@ -36,7 +53,7 @@ public:
         BaseClass(page, document, fontCache, cms, optionalContentActivity, pagePointToDevicePointMatrix, meshQualitySettings),
         m_features(features)
     {
-
+        addSink(&m_textLayoutSink);
     }
 
     /// Creates text layout from the text
@@ -45,11 +62,10 @@ public:
 protected:
     virtual bool isContentSuppressedByOC(PDFObjectReference ocgOrOcmd) override;
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
-    virtual void performOutputCharacter(const PDFTextCharacterInfo& info) override;
 
 private:
     PDFRenderer::Features m_features;
-    PDFTextLayout m_textLayout;
+    PDFTextLayoutSink m_textLayoutSink;
 };
 
 }   // namespace pdf
@@ -95,22 +95,19 @@ PDFBitReader::Value PDFBitReader::read(PDFBitReader::Value bits)
 
 PDFBitReader::Value PDFBitReader::look(Value bits) const
 {
-    PDFBitReader temp(*this);
+    Value buffer = m_buffer;
+    Value bitsInBuffer = m_bitsInBuffer;
+    int position = m_position;
 
-    Value result = 0;
-    for (Value i = 0; i < bits; ++i)
+    // Bits past the end of the stream are treated as zero bits
+    while (bitsInBuffer < bits)
     {
-        if (!temp.isAtEnd())
-        {
-            result = (result << 1) | temp.read(1);
-        }
-        else
-        {
-            result = (result << 1);
-        }
+        const uint8_t currentByte = (position < m_stream->size()) ? static_cast<uint8_t>((*m_stream)[position++]) : 0;
+        buffer = (buffer << 8) | currentByte;
+        bitsInBuffer += 8;
     }
 
-    return result;
+    return (buffer >> (bitsInBuffer - bits)) & ((static_cast<Value>(1) << bits) - static_cast<Value>(1));
 }
 
 void PDFBitReader::seek(qint64 position)
@@ -26,6 +26,7 @@
 #include <QDataStream>
 
 #include <set>
+#include <memory>
 #include <vector>
 #include <iterator>
 #include <functional>
@@ -574,6 +575,209 @@ private:
     value_ptr m_end;
 };
 
+/// Vector, which is divided into chunks of fixed size. Chunks are shared between
+/// copies of the vector (copy-on-write), so copying the vector is cheap, and when
+/// the copy is modified, only modified chunks are copied. Functions, which can modify
+/// items (non-const operator[], begin(), end(), back()), detach shared chunks, so they
+/// are thread safe only, if chunks are not shared (for example, newly created vector,
+/// or vector after call of detach()). Const functions are thread safe.
+template<typename T, size_t ChunkSize = 256>
+class PDFChunkedVector
+{
+private:
+    using Chunk = std::vector<T>;
+    using ChunkPointer = std::shared_ptr<Chunk>;
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using reference = T&;
+    using const_reference = const T&;
+
+    template<bool IsConst>
+    struct IteratorBase
+    {
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff_t;
+        using value_type        = T;
+        using pointer           = std::conditional_t<IsConst, const T*, T*>;
+        using reference         = std::conditional_t<IsConst, const T&, T&>;
+        using container         = std::conditional_t<IsConst, const PDFChunkedVector, PDFChunkedVector>;
+
+        inline IteratorBase() = default;
+        inline IteratorBase(container* vector, size_t index) : vector(vector), index(index) { }
+
+        inline bool operator==(const IteratorBase& other) const { return index == other.index; }
+        inline bool operator!=(const IteratorBase& other) const { return index != other.index; }
+        inline bool operator<(const IteratorBase& other) const { return index < other.index; }
+        inline bool operator>(const IteratorBase& other) const { return index > other.index; }
+        inline bool operator<=(const IteratorBase& other) const { return index <= other.index; }
+        inline bool operator>=(const IteratorBase& other) const { return index >= other.index; }
+
+        inline reference operator*() const { return vector->getItem(index); }
+        inline pointer operator->() const { return &vector->getItem(index); }
+        inline reference operator[](ptrdiff_t offset) const { return vector->getItem(index + offset); }
+
+        inline IteratorBase& operator+=(ptrdiff_t movement) { index += movement; return *this; }
+        inline IteratorBase& operator-=(ptrdiff_t movement) { index -= movement; return *this; }
+        inline IteratorBase operator+(ptrdiff_t movement) const { return IteratorBase(vector, index + movement); }
+        inline IteratorBase operator-(ptrdiff_t movement) const { return IteratorBase(vector, index - movement); }
+        inline ptrdiff_t operator-(const IteratorBase& other) const { return ptrdiff_t(index) - ptrdiff_t(other.index); }
+        friend inline IteratorBase operator+(ptrdiff_t movement, const IteratorBase& iterator) { return iterator + movement; }
+
+        inline IteratorBase& operator++()
+        {
+            ++index;
+            return *this;
+        }
+
+        inline IteratorBase operator++(int)
+        {
+            IteratorBase copy(*this);
+            ++index;
+            return copy;
+        }
+
+        inline IteratorBase& operator--()
+        {
+            --index;
+            return *this;
+        }
+
+        inline IteratorBase operator--(int)
+        {
+            IteratorBase copy(*this);
+            --index;
+            return copy;
+        }
+
+        container* vector = nullptr;
+        size_t index = 0;
+    };
+
+    using iterator = IteratorBase<false>;
+    using const_iterator = IteratorBase<true>;
+
+    inline PDFChunkedVector() = default;
+    inline explicit PDFChunkedVector(size_t size) { resize(size); }
+
+    inline bool operator==(const PDFChunkedVector& other) const
+    {
+        if (size() != other.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            // Shared chunks are equal, we do not need to compare them
+            if (m_chunks[i] != other.m_chunks[i] && *m_chunks[i] != *other.m_chunks[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    inline bool operator!=(const PDFChunkedVector& other) const { return !(*this == other); }
+
+    inline size_t size() const { return !m_chunks.empty() ? (m_chunks.size() - 1) * ChunkSize + m_chunks.back()->size() : 0; }
+    inline bool empty() const { return m_chunks.empty(); }
+    inline void clear() { m_chunks.clear(); }
+    inline void reserve(size_t size) { m_chunks.reserve((size + ChunkSize - 1) / ChunkSize); }
+
+    /// Resizes the vector, new items are default constructed
+    /// \param newSize New size
+    void resize(size_t newSize)
+    {
+        const size_t chunkCount = (newSize + ChunkSize - 1) / ChunkSize;
+        m_chunks.resize(chunkCount);
+
+        for (size_t i = 0; i < chunkCount; ++i)
+        {
+            const size_t chunkSize = (i + 1 < chunkCount) ? ChunkSize : newSize - i * ChunkSize;
+            ChunkPointer& chunk = m_chunks[i];
+
+            if (!chunk)
+            {
+                chunk = std::make_shared<Chunk>();
+                chunk->reserve(ChunkSize);
+            }
+
+            if (chunk->size() != chunkSize)
+            {
+                detachChunk(i);
+                chunk->resize(chunkSize);
+            }
+        }
+    }
+
+    template<typename... Arguments>
+    T& emplace_back(Arguments&&... arguments)
+    {
+        if (m_chunks.empty() || m_chunks.back()->size() == ChunkSize)
+        {
+            m_chunks.emplace_back(std::make_shared<Chunk>());
+            m_chunks.back()->reserve(ChunkSize);
+        }
+        else
+        {
+            detachChunk(m_chunks.size() - 1);
+        }
+
+        return m_chunks.back()->emplace_back(std::forward<Arguments>(arguments)...);
+    }
+
+    inline void push_back(const T& value) { emplace_back(value); }
+    inline void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    inline const T& operator[](size_t index) const { return getItem(index); }
+    inline T& operator[](size_t index) { detachChunk(index / ChunkSize); return getItem(index); }
+
+    inline const T& back() const { return m_chunks.back()->back(); }
+    inline T& back() { detachChunk(m_chunks.size() - 1); return m_chunks.back()->back(); }
+
+    /// Returns iterator to the first item. All shared chunks are detached,
+    /// so items can be modified using the iterator (also from multiple threads).
+    inline iterator begin() { detach(); return iterator(this, 0); }
+    inline iterator end() { detach(); return iterator(this, size()); }
+
+    inline const_iterator begin() const { return const_iterator(this, 0); }
+    inline const_iterator end() const { return const_iterator(this, size()); }
+
+    inline const_iterator cbegin() const { return const_iterator(this, 0); }
+    inline const_iterator cend() const { return const_iterator(this, size()); }
+
+    /// Detaches all shared chunks, so this vector doesn't
+    /// share any chunk with other vectors.
+    void detach()
+    {
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            detachChunk(i);
+        }
+    }
+
+private:
+    inline T& getItem(size_t index) const { return (*m_chunks[index / ChunkSize])[index % ChunkSize]; }
+
+    void detachChunk(size_t chunkIndex)
+    {
+        ChunkPointer& chunk = m_chunks[chunkIndex];
+        if (chunk.use_count() > 1)
+        {
+            ChunkPointer detachedChunk = std::make_shared<Chunk>();
+            detachedChunk->reserve(ChunkSize);
+            detachedChunk->insert(detachedChunk->end(), chunk->cbegin(), chunk->cend());
+            chunk = std::move(detachedChunk);
+        }
+    }
+
+    /// Chunks of the vector, all chunks except the last one are full
+    std::vector<ChunkPointer> m_chunks;
+};
+
 /// Storage for result of some operation. Stores, if operation was successful, or not and
 /// also error message, why operation has failed. Can be converted explicitly to bool.
 class PDFOperationResult
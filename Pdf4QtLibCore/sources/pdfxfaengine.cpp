@@ -21,8 +21,8 @@
 #include "pdffont.h"
 #include "pdfdbgheap.h"
 
-#include <QDomElement>
-#include <QDomDocument>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 #include <QStringList>
 #include <QDateTime>
 #include <QImageReader>
@@ -257,41 +257,45 @@ public:
     virtual void accept(XFA_AbstractVisitor* visitor) const = 0;
 
     template<typename Type>
-    static void parseItem(const QDomElement& element, QString value, XFA_Node<Type>& node)
+    static void parseItem(QXmlStreamReader& reader, XFA_Node<Type>& node)
     {
-        // Jakub Melka: set node value to null
-        node = XFA_Node<Type>();
-
-        QDomElement child = element.firstChildElement(value);
-        if (!child.isNull())
+        // Jakub Melka: only first item is used, other items are skipped
+        if (node.hasValue())
         {
-            node = XFA_Node<Type>(Type::parse(child));
+            reader.skipCurrentElement();
+            return;
         }
+
+        node = XFA_Node<Type>(Type::parse(reader));
     }
 
     template<typename Type>
-    static void parseItem(const QDomElement& element, QString value, std::vector<XFA_Node<Type>>& nodes)
+    static void parseItem(QXmlStreamReader& reader, std::vector<XFA_Node<Type>>& nodes)
     {
-        // Jakub Melka: clear node list
-        nodes.clear();
+        nodes.emplace_back(XFA_Node<Type>(Type::parse(reader)));
+    }
 
-        QDomElement child = element.firstChildElement(value);
-        while (!child.isNull())
+    static QString getAttributeValue(const QXmlStreamAttributes& attributes,
+                                     QString attributeFieldName,
+                                     QString defaultValue)
+    {
+        if (attributes.hasAttribute(attributeFieldName))
         {
-            nodes.emplace_back(XFA_Node<Type>(Type::parse(child)));
-            child = child.nextSiblingElement(value);
+            return attributes.value(attributeFieldName).toString();
         }
+
+        return defaultValue;
     }
 
     template<typename Enum>
-    static void parseEnumAttribute(const QDomElement& element,
+    static void parseEnumAttribute(const QXmlStreamAttributes& attributes,
                                    QString attributeFieldName,
                                    XFA_Attribute<Enum>& attribute,
                                    QString defaultValue,
                                    const auto& enumValues)
     {
         attribute = XFA_Attribute<Enum>();
-        QString value = element.attribute(attributeFieldName, defaultValue);
+        QString value = getAttributeValue(attributes, attributeFieldName, defaultValue);
 
         for (const auto& enumValue : enumValues)
         {
@@ -303,48 +307,48 @@ public:
         }
     }
 
-    static void parseAttribute(const QDomElement& element,
+    static void parseAttribute(const QXmlStreamAttributes& attributes,
                                QString attributeFieldName,
                                XFA_Attribute<QString>& attribute,
                                QString defaultValue)
     {
-        attribute = XFA_Attribute<QString>(element.attribute(attributeFieldName, defaultValue));
+        attribute = XFA_Attribute<QString>(getAttributeValue(attributes, attributeFieldName, defaultValue));
     }
 
-    static void parseAttribute(const QDomElement& element,
+    static void parseAttribute(const QXmlStreamAttributes& attributes,
                                QString attributeFieldName,
                                XFA_Attribute<bool>& attribute,
                                QString defaultValue)
     {
-        attribute = XFA_Attribute<bool>(element.attribute(attributeFieldName, defaultValue).toInt() != 0);
+        attribute = XFA_Attribute<bool>(getAttributeValue(attributes, attributeFieldName, defaultValue).toInt() != 0);
     }
 
-    static void parseAttribute(const QDomElement& element,
+    static void parseAttribute(const QXmlStreamAttributes& attributes,
                                QString attributeFieldName,
                                XFA_Attribute<PDFReal>& attribute,
                                QString defaultValue)
     {
-        attribute = XFA_Attribute<PDFReal>(element.attribute(attributeFieldName, defaultValue).toDouble());
+        attribute = XFA_Attribute<PDFReal>(getAttributeValue(attributes, attributeFieldName, defaultValue).toDouble());
     }
 
-    static void parseAttribute(const QDomElement& element,
+    static void parseAttribute(const QXmlStreamAttributes& attributes,
                                QString attributeFieldName,
                                XFA_Attribute<PDFInteger>& attribute,
                                QString defaultValue)
     {
-        attribute = XFA_Attribute<PDFInteger>(element.attribute(attributeFieldName, defaultValue).toInt());
+        attribute = XFA_Attribute<PDFInteger>(getAttributeValue(attributes, attributeFieldName, defaultValue).toInt());
     }
 
 
 
-    static void parseAttribute(const QDomElement& element,
+    static void parseAttribute(const QXmlStreamAttributes& attributes,
                                QString attributeFieldName,
                                XFA_Attribute<XFA_Measurement>& attribute,
                                QString defaultValue)
     {
         attribute = XFA_Attribute<XFA_Measurement>();
 
-        QString measurement = element.attribute(attributeFieldName, defaultValue);
+        QString measurement = getAttributeValue(attributes, attributeFieldName, defaultValue);
 
         XFA_Measurement value;
         if (XFA_Measurement::parseMeasurement(measurement, value))
@@ -353,20 +357,68 @@ public:
         }
     }
 
-    static void parseValue(const QDomElement& element, XFA_Value<QString>& nodeValue)
+    /// Reads node value - content of the current element (including
+    /// child elements, which are written as xml). Reader must be positioned
+    /// at the start of the element, after the call, it is positioned at the end
+    /// of the element.
+    static void parseValue(QXmlStreamReader& reader, XFA_Value<QString>& nodeValue)
     {
         nodeValue = XFA_Value<QString>();
 
         QString text;
+        QXmlStreamWriter writer(&text);
 
-        if (element.hasChildNodes())
+        int depth = 0;
+        bool isFinished = false;
+        while (!isFinished && !reader.atEnd())
         {
-            QTextStream textStream(&text);
-            QDomNode node = element.firstChild();
-            while (!node.isNull())
+            switch (reader.readNext())
             {
-                textStream << node;
-                node = node.nextSibling();
+                case QXmlStreamReader::StartElement:
+                    ++depth;
+                    writer.writeStartElement(reader.qualifiedName().toString());
+                    writer.writeAttributes(reader.attributes());
+                    break;
+
+                case QXmlStreamReader::EndElement:
+                    if (depth == 0)
+                    {
+                        isFinished = true;
+                    }
+                    else
+                    {
+                        --depth;
+                        writer.writeEndElement();
+                    }
+                    break;
+
+                case QXmlStreamReader::Characters:
+                    if (reader.isWhitespace())
+                    {
+                        // Jakub Melka: whitespace-only text is skipped (as in DOM parser)
+                        break;
+                    }
+
+                    if (reader.isCDATA())
+                    {
+                        writer.writeCDATA(reader.text().toString());
+                    }
+                    else
+                    {
+                        writer.writeCharacters(reader.text().toString());
+                    }
+                    break;
+
+                case QXmlStreamReader::Comment:
+                    writer.writeComment(reader.text().toString());
+                    break;
+
+                case QXmlStreamReader::EntityReference:
+                    writer.writeEntityReference(reader.name().toString());
+                    break;
+
+                default:
+                    break;
             }
         }
 
@@ -379,7 +431,7 @@ public:
     /// Get ordering of the element in original document
     size_t getOrder() const { return m_order; }
 
-    void setOrderFromElement(const QDomElement& element);
+    void setOrderFromReader(const QXmlStreamReader& reader);
 
     static inline constexpr void addNodesToContainer(std::vector<const XFA_AbstractNode*>&) { }
 
@@ -423,10 +475,10 @@ private:
     size_t m_order = 0;
 };
 
-void XFA_AbstractNode::setOrderFromElement(const QDomElement& element)
+void XFA_AbstractNode::setOrderFromReader(const QXmlStreamReader& reader)
 {
-    const uint32_t lineNumber = element.lineNumber();
-    const uint32_t columnNumber = element.columnNumber();
+    const uint32_t lineNumber = uint32_t(reader.lineNumber());
+    const uint32_t columnNumber = uint32_t(reader.columnNumber());
 
     if constexpr (sizeof(decltype(m_order)) > 4)
     {
@@ -1461,7 +1513,7 @@ public:
         Bold,
     };
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ACCESS>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ACCESS>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ACCESS::Open, "open"),
@@ -1469,20 +1521,20 @@ public:
             std::make_pair(ACCESS::Protected, "protected"),
             std::make_pair(ACCESS::ReadOnly, "readOnly"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ACTION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ACTION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ACTION::Include, "include"),
             std::make_pair(ACTION::All, "all"),
             std::make_pair(ACTION::Exclude, "exclude"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ACTIVITY>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ACTIVITY>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ACTIVITY::Click, "click"),
@@ -1513,10 +1565,10 @@ public:
             std::make_pair(ACTIVITY::Ready, "ready"),
             std::make_pair(ACTIVITY::ValidationState, "validationState"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<AFTER>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<AFTER>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(AFTER::Auto, "auto"),
@@ -1525,10 +1577,10 @@ public:
             std::make_pair(AFTER::PageEven, "pageEven"),
             std::make_pair(AFTER::PageOdd, "pageOdd"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ANCHORTYPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ANCHORTYPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ANCHORTYPE::TopLeft, "topLeft"),
@@ -1541,10 +1593,10 @@ public:
             std::make_pair(ANCHORTYPE::TopCenter, "topCenter"),
             std::make_pair(ANCHORTYPE::TopRight, "topRight"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ASPECT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ASPECT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ASPECT::Fit, "fit"),
@@ -1553,19 +1605,19 @@ public:
             std::make_pair(ASPECT::None, "none"),
             std::make_pair(ASPECT::Width, "width"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<BASEPROFILE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<BASEPROFILE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(BASEPROFILE::Full, "full"),
             std::make_pair(BASEPROFILE::InteractiveForms, "interactiveForms"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<BEFORE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<BEFORE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(BEFORE::Auto, "auto"),
@@ -1574,39 +1626,39 @@ public:
             std::make_pair(BEFORE::PageEven, "pageEven"),
             std::make_pair(BEFORE::PageOdd, "pageOdd"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<BLANKORNOTBLANK>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<BLANKORNOTBLANK>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(BLANKORNOTBLANK::Any, "any"),
             std::make_pair(BLANKORNOTBLANK::Blank, "blank"),
             std::make_pair(BLANKORNOTBLANK::NotBlank, "notBlank"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<BREAK>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<BREAK>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(BREAK::Close, "close"),
             std::make_pair(BREAK::Open, "open"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<CAP>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<CAP>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(CAP::Square, "square"),
             std::make_pair(CAP::Butt, "butt"),
             std::make_pair(CAP::Round, "round"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<CHECKSUM>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<CHECKSUM>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(CHECKSUM::None, "none"),
@@ -1615,74 +1667,74 @@ public:
             std::make_pair(CHECKSUM::_2mod10, "2mod10"),
             std::make_pair(CHECKSUM::Auto, "auto"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<COMMITON>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<COMMITON>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(COMMITON::Select, "select"),
             std::make_pair(COMMITON::Exit, "exit"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<CREDENTIALSERVERPOLICY>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<CREDENTIALSERVERPOLICY>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(CREDENTIALSERVERPOLICY::Optional, "optional"),
             std::make_pair(CREDENTIALSERVERPOLICY::Required, "required"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<DATAPREP>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<DATAPREP>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(DATAPREP::None, "none"),
             std::make_pair(DATAPREP::FlateCompress, "flateCompress"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<DATA>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<DATA>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(DATA::Link, "link"),
             std::make_pair(DATA::Embed, "embed"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<DUPLEXIMPOSITION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<DUPLEXIMPOSITION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(DUPLEXIMPOSITION::LongEdge, "longEdge"),
             std::make_pair(DUPLEXIMPOSITION::ShortEdge, "shortEdge"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<EXECUTETYPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<EXECUTETYPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(EXECUTETYPE::Import, "import"),
             std::make_pair(EXECUTETYPE::Remerge, "remerge"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<FORMATTEST>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<FORMATTEST>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(FORMATTEST::Warning, "warning"),
             std::make_pair(FORMATTEST::Disabled, "disabled"),
             std::make_pair(FORMATTEST::Error, "error"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<FORMAT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<FORMAT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(FORMAT::Xdp, "xdp"),
@@ -1692,10 +1744,10 @@ public:
             std::make_pair(FORMAT::Xfd, "xfd"),
             std::make_pair(FORMAT::Xml, "xml"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<HALIGN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<HALIGN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(HALIGN::Left, "left"),
@@ -1705,30 +1757,30 @@ public:
             std::make_pair(HALIGN::Radix, "radix"),
             std::make_pair(HALIGN::Right, "right"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<HSCROLLPOLICY>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<HSCROLLPOLICY>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(HSCROLLPOLICY::Auto, "auto"),
             std::make_pair(HSCROLLPOLICY::Off, "off"),
             std::make_pair(HSCROLLPOLICY::On, "on"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<HAND>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<HAND>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(HAND::Even, "even"),
             std::make_pair(HAND::Left, "left"),
             std::make_pair(HAND::Right, "right"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<HIGHLIGHT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<HIGHLIGHT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(HIGHLIGHT::Inverted, "inverted"),
@@ -1736,38 +1788,38 @@ public:
             std::make_pair(HIGHLIGHT::Outline, "outline"),
             std::make_pair(HIGHLIGHT::Push, "push"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<INTACT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<INTACT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(INTACT::None, "none"),
             std::make_pair(INTACT::ContentArea, "contentArea"),
             std::make_pair(INTACT::PageArea, "pageArea"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<JOIN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<JOIN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(JOIN::Square, "square"),
             std::make_pair(JOIN::Round, "round"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<KERNINGMODE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<KERNINGMODE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(KERNINGMODE::None, "none"),
             std::make_pair(KERNINGMODE::Pair, "pair"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<LAYOUT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<LAYOUT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(LAYOUT::Position, "position"),
@@ -1778,38 +1830,38 @@ public:
             std::make_pair(LAYOUT::Table, "table"),
             std::make_pair(LAYOUT::Tb, "tb"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<LINETHROUGHPERIOD>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<LINETHROUGHPERIOD>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(LINETHROUGHPERIOD::All, "all"),
             std::make_pair(LINETHROUGHPERIOD::Word, "word"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<LINETHROUGH>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<LINETHROUGH>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(LINETHROUGH::_0, "0"),
             std::make_pair(LINETHROUGH::_1, "1"),
             std::make_pair(LINETHROUGH::_2, "2"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<LISTEN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<LISTEN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(LISTEN::RefOnly, "refOnly"),
             std::make_pair(LISTEN::RefAndDescendents, "refAndDescendents"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<MARK>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<MARK>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(MARK::Default, "default"),
@@ -1820,10 +1872,10 @@ public:
             std::make_pair(MARK::Square, "square"),
             std::make_pair(MARK::Star, "star"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<MATCH>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<MATCH>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(MATCH::Once, "once"),
@@ -1831,58 +1883,58 @@ public:
             std::make_pair(MATCH::Global, "global"),
             std::make_pair(MATCH::None, "none"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<MERGEMODE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<MERGEMODE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(MERGEMODE::ConsumeData, "consumeData"),
             std::make_pair(MERGEMODE::MatchTemplate, "matchTemplate"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<MULTILINE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<MULTILINE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(MULTILINE::_1, "1"),
             std::make_pair(MULTILINE::_0, "0"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<NEXT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<NEXT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(NEXT::None, "none"),
             std::make_pair(NEXT::ContentArea, "contentArea"),
             std::make_pair(NEXT::PageArea, "pageArea"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<NULLTEST>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<NULLTEST>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(NULLTEST::Disabled, "disabled"),
             std::make_pair(NULLTEST::Error, "error"),
             std::make_pair(NULLTEST::Warning, "warning"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ODDOREVEN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ODDOREVEN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ODDOREVEN::Any, "any"),
             std::make_pair(ODDOREVEN::Even, "even"),
             std::make_pair(ODDOREVEN::Odd, "odd"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OPEN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OPEN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OPEN::UserControl, "userControl"),
@@ -1890,19 +1942,19 @@ public:
             std::make_pair(OPEN::MultiSelect, "multiSelect"),
             std::make_pair(OPEN::OnEntry, "onEntry"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OPERATION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OPERATION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OPERATION::Encrypt, "encrypt"),
             std::make_pair(OPERATION::Decrypt, "decrypt"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OPERATION2>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OPERATION2>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OPERATION2::Next, "next"),
@@ -1913,48 +1965,48 @@ public:
             std::make_pair(OPERATION2::Right, "right"),
             std::make_pair(OPERATION2::Up, "up"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OPERATION1>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OPERATION1>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OPERATION1::Sign, "sign"),
             std::make_pair(OPERATION1::Clear, "clear"),
             std::make_pair(OPERATION1::Verify, "verify"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<ORIENTATION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<ORIENTATION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(ORIENTATION::Portrait, "portrait"),
             std::make_pair(ORIENTATION::Landscape, "landscape"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OVERLINEPERIOD>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OVERLINEPERIOD>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OVERLINEPERIOD::All, "all"),
             std::make_pair(OVERLINEPERIOD::Word, "word"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OVERLINE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OVERLINE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OVERLINE::_0, "0"),
             std::make_pair(OVERLINE::_1, "1"),
             std::make_pair(OVERLINE::_2, "2"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<OVERRIDE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<OVERRIDE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(OVERRIDE::Disabled, "disabled"),
@@ -1962,10 +2014,10 @@ public:
             std::make_pair(OVERRIDE::Ignore, "ignore"),
             std::make_pair(OVERRIDE::Warning, "warning"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PAGEPOSITION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PAGEPOSITION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PAGEPOSITION::Any, "any"),
@@ -1974,29 +2026,29 @@ public:
             std::make_pair(PAGEPOSITION::Only, "only"),
             std::make_pair(PAGEPOSITION::Rest, "rest"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PERMISSIONS>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PERMISSIONS>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PERMISSIONS::_2, "2"),
             std::make_pair(PERMISSIONS::_1, "1"),
             std::make_pair(PERMISSIONS::_3, "3"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PICKER>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PICKER>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PICKER::Host, "host"),
             std::make_pair(PICKER::None, "none"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PLACEMENT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PLACEMENT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PLACEMENT::Left, "left"),
@@ -2005,19 +2057,19 @@ public:
             std::make_pair(PLACEMENT::Right, "right"),
             std::make_pair(PLACEMENT::Top, "top"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<POSTURE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<POSTURE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(POSTURE::Normal, "normal"),
             std::make_pair(POSTURE::Italic, "italic"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PRESENCE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PRESENCE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PRESENCE::Visible, "visible"),
@@ -2025,20 +2077,20 @@ public:
             std::make_pair(PRESENCE::Inactive, "inactive"),
             std::make_pair(PRESENCE::Invisible, "invisible"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PREVIOUS>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PREVIOUS>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PREVIOUS::None, "none"),
             std::make_pair(PREVIOUS::ContentArea, "contentArea"),
             std::make_pair(PREVIOUS::PageArea, "pageArea"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<PRIORITY>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<PRIORITY>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(PRIORITY::Custom, "custom"),
@@ -2046,95 +2098,95 @@ public:
             std::make_pair(PRIORITY::Name, "name"),
             std::make_pair(PRIORITY::ToolTip, "toolTip"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<RELATION1>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<RELATION1>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(RELATION1::Ordered, "ordered"),
             std::make_pair(RELATION1::Choice, "choice"),
             std::make_pair(RELATION1::Unordered, "unordered"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<RELATION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<RELATION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(RELATION::OrderedOccurrence, "orderedOccurrence"),
             std::make_pair(RELATION::DuplexPaginated, "duplexPaginated"),
             std::make_pair(RELATION::SimplexPaginated, "simplexPaginated"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<RESTORESTATE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<RESTORESTATE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(RESTORESTATE::Manual, "manual"),
             std::make_pair(RESTORESTATE::Auto, "auto"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<RUNAT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<RUNAT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(RUNAT::Client, "client"),
             std::make_pair(RUNAT::Both, "both"),
             std::make_pair(RUNAT::Server, "server"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<SCOPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<SCOPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(SCOPE::Name, "name"),
             std::make_pair(SCOPE::None, "none"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<SCRIPTTEST>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<SCRIPTTEST>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(SCRIPTTEST::Error, "error"),
             std::make_pair(SCRIPTTEST::Disabled, "disabled"),
             std::make_pair(SCRIPTTEST::Warning, "warning"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<SHAPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<SHAPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(SHAPE::Square, "square"),
             std::make_pair(SHAPE::Round, "round"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<SIGNATURETYPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<SIGNATURETYPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(SIGNATURETYPE::Filler, "filler"),
             std::make_pair(SIGNATURETYPE::Author, "author"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<SLOPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<SLOPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(SLOPE::Backslash, "\\"),
             std::make_pair(SLOPE::Slash, "/"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<STROKE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<STROKE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(STROKE::Solid, "solid"),
@@ -2147,10 +2199,10 @@ public:
             std::make_pair(STROKE::Lowered, "lowered"),
             std::make_pair(STROKE::Raised, "raised"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TARGETTYPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TARGETTYPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TARGETTYPE::Auto, "auto"),
@@ -2159,10 +2211,10 @@ public:
             std::make_pair(TARGETTYPE::PageEven, "pageEven"),
             std::make_pair(TARGETTYPE::PageOdd, "pageOdd"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TEXTLOCATION>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TEXTLOCATION>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TEXTLOCATION::Below, "below"),
@@ -2171,58 +2223,58 @@ public:
             std::make_pair(TEXTLOCATION::BelowEmbedded, "belowEmbedded"),
             std::make_pair(TEXTLOCATION::None, "none"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TRANSFERENCODING1>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TRANSFERENCODING1>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TRANSFERENCODING1::Base64, "base64"),
             std::make_pair(TRANSFERENCODING1::None, "none"),
             std::make_pair(TRANSFERENCODING1::Package, "package"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TRANSFERENCODING>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TRANSFERENCODING>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TRANSFERENCODING::None, "none"),
             std::make_pair(TRANSFERENCODING::Base64, "base64"),
             std::make_pair(TRANSFERENCODING::Package, "package"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TRAYIN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TRAYIN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TRAYIN::Auto, "auto"),
             std::make_pair(TRAYIN::Delegate, "delegate"),
             std::make_pair(TRAYIN::PageFront, "pageFront"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TRAYOUT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TRAYOUT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TRAYOUT::Auto, "auto"),
             std::make_pair(TRAYOUT::Delegate, "delegate"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TYPE4>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TYPE4>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TYPE4::PDF1_3, "PDF1.3"),
             std::make_pair(TYPE4::PDF1_6, "PDF1.6"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TYPE2>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TYPE2>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TYPE2::CrossHatch, "crossHatch"),
@@ -2232,28 +2284,28 @@ public:
             std::make_pair(TYPE2::Horizontal, "horizontal"),
             std::make_pair(TYPE2::Vertical, "vertical"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TYPE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TYPE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TYPE::Optional, "optional"),
             std::make_pair(TYPE::Required, "required"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TYPE3>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TYPE3>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TYPE3::ToEdge, "toEdge"),
             std::make_pair(TYPE3::ToCenter, "toCenter"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<TYPE1>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<TYPE1>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(TYPE1::ToRight, "toRight"),
@@ -2261,29 +2313,29 @@ public:
             std::make_pair(TYPE1::ToLeft, "toLeft"),
             std::make_pair(TYPE1::ToTop, "toTop"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<UNDERLINEPERIOD>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<UNDERLINEPERIOD>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(UNDERLINEPERIOD::All, "all"),
             std::make_pair(UNDERLINEPERIOD::Word, "word"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<UNDERLINE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<UNDERLINE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(UNDERLINE::_0, "0"),
             std::make_pair(UNDERLINE::_1, "1"),
             std::make_pair(UNDERLINE::_2, "2"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<UPSMODE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<UPSMODE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(UPSMODE::UsCarrier, "usCarrier"),
@@ -2291,46 +2343,46 @@ public:
             std::make_pair(UPSMODE::SecureSymbol, "secureSymbol"),
             std::make_pair(UPSMODE::StandardSymbol, "standardSymbol"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<USAGE>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<USAGE>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(USAGE::ExportAndImport, "exportAndImport"),
             std::make_pair(USAGE::ExportOnly, "exportOnly"),
             std::make_pair(USAGE::ImportOnly, "importOnly"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<VALIGN>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<VALIGN>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(VALIGN::Top, "top"),
             std::make_pair(VALIGN::Bottom, "bottom"),
             std::make_pair(VALIGN::Middle, "middle"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<VSCROLLPOLICY>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<VSCROLLPOLICY>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(VSCROLLPOLICY::Auto, "auto"),
             std::make_pair(VSCROLLPOLICY::Off, "off"),
             std::make_pair(VSCROLLPOLICY::On, "on"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
-    static void parseAttribute(const QDomElement& element, QString attributeFieldName, XFA_Attribute<WEIGHT>& attribute, QString defaultValue)
+    static void parseAttribute(const QXmlStreamAttributes& attributes, QString attributeFieldName, XFA_Attribute<WEIGHT>& attribute, QString defaultValue)
     {
         constexpr std::array enumValues = {
             std::make_pair(WEIGHT::Normal, "normal"),
             std::make_pair(WEIGHT::Bold, "bold"),
         };
-        parseEnumAttribute(element, attributeFieldName, attribute, defaultValue, enumValues);
+        parseEnumAttribute(attributes, attributeFieldName, attribute, defaultValue, enumValues);
     }
 
 };
@@ -2349,7 +2401,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_appearanceFilter> parse(const QDomElement& element);
+    static std::optional<XFA_appearanceFilter> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2363,27 +2415,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_appearanceFilter> XFA_appearanceFilter::parse(const QDomElement& element)
+std::optional<XFA_appearanceFilter> XFA_appearanceFilter::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_appearanceFilter myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2400,7 +2446,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_bindItems> parse(const QDomElement& element);
+    static std::optional<XFA_bindItems> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2412,23 +2458,21 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_bindItems> XFA_bindItems::parse(const QDomElement& element)
+std::optional<XFA_bindItems> XFA_bindItems::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_bindItems myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "connection", myClass.m_connection, "");
-    parseAttribute(element, "labelRef", myClass.m_labelRef, "");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "valueRef", myClass.m_valueRef, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "connection", myClass.m_connection, "");
+    parseAttribute(attributes, "labelRef", myClass.m_labelRef, "");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "valueRef", myClass.m_valueRef, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -2446,7 +2490,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_bookend> parse(const QDomElement& element);
+    static std::optional<XFA_bookend> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2459,24 +2503,22 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_bookend> XFA_bookend::parse(const QDomElement& element)
+std::optional<XFA_bookend> XFA_bookend::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_bookend myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "leader", myClass.m_leader, "");
-    parseAttribute(element, "trailer", myClass.m_trailer, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "leader", myClass.m_leader, "");
+    parseAttribute(attributes, "trailer", myClass.m_trailer, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -2495,7 +2537,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_boolean> parse(const QDomElement& element);
+    static std::optional<XFA_boolean> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2509,27 +2551,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_boolean> XFA_boolean::parse(const QDomElement& element)
+std::optional<XFA_boolean> XFA_boolean::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_boolean myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2548,7 +2584,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_certificate> parse(const QDomElement& element);
+    static std::optional<XFA_certificate> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2562,27 +2598,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_certificate> XFA_certificate::parse(const QDomElement& element)
+std::optional<XFA_certificate> XFA_certificate::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_certificate myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2599,7 +2629,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_comb> parse(const QDomElement& element);
+    static std::optional<XFA_comb> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2611,23 +2641,21 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_comb> XFA_comb::parse(const QDomElement& element)
+std::optional<XFA_comb> XFA_comb::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_comb myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "numberOfCells", myClass.m_numberOfCells, "0");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "numberOfCells", myClass.m_numberOfCells, "0");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -2646,7 +2674,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_date> parse(const QDomElement& element);
+    static std::optional<XFA_date> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2660,27 +2688,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_date> XFA_date::parse(const QDomElement& element)
+std::optional<XFA_date> XFA_date::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_date myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2699,7 +2721,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_dateTime> parse(const QDomElement& element);
+    static std::optional<XFA_dateTime> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2713,27 +2735,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_dateTime> XFA_dateTime::parse(const QDomElement& element)
+std::optional<XFA_dateTime> XFA_dateTime::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_dateTime myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2754,7 +2770,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_decimal> parse(const QDomElement& element);
+    static std::optional<XFA_decimal> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2770,29 +2786,23 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_decimal> XFA_decimal::parse(const QDomElement& element)
+std::optional<XFA_decimal> XFA_decimal::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_decimal myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "fracDigits", myClass.m_fracDigits, "2");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "leadDigits", myClass.m_leadDigits, "-1");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "fracDigits", myClass.m_fracDigits, "2");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "leadDigits", myClass.m_leadDigits, "-1");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2810,7 +2820,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_digestMethod> parse(const QDomElement& element);
+    static std::optional<XFA_digestMethod> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2823,26 +2833,20 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_digestMethod> XFA_digestMethod::parse(const QDomElement& element)
+std::optional<XFA_digestMethod> XFA_digestMethod::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_digestMethod myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2860,7 +2864,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_digestMethods> parse(const QDomElement& element);
+    static std::optional<XFA_digestMethods> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2873,24 +2877,33 @@ private:
     std::vector<XFA_Node<XFA_digestMethod>> m_digestMethod;
 };
 
-std::optional<XFA_digestMethods> XFA_digestMethods::parse(const QDomElement& element)
+std::optional<XFA_digestMethods> XFA_digestMethods::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_digestMethods myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "digestMethod", myClass.m_digestMethod);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"digestMethod")
+        {
+            parseItem(reader, myClass.m_digestMethod);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -2908,7 +2921,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encoding> parse(const QDomElement& element);
+    static std::optional<XFA_encoding> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2921,26 +2934,20 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_encoding> XFA_encoding::parse(const QDomElement& element)
+std::optional<XFA_encoding> XFA_encoding::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encoding myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -2958,7 +2965,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encodings> parse(const QDomElement& element);
+    static std::optional<XFA_encodings> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -2971,24 +2978,33 @@ private:
     std::vector<XFA_Node<XFA_encoding>> m_encoding;
 };
 
-std::optional<XFA_encodings> XFA_encodings::parse(const QDomElement& element)
+std::optional<XFA_encodings> XFA_encodings::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encodings myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "encoding", myClass.m_encoding);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"encoding")
+        {
+            parseItem(reader, myClass.m_encoding);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -3005,7 +3021,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encrypt> parse(const QDomElement& element);
+    static std::optional<XFA_encrypt> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3017,23 +3033,32 @@ private:
     XFA_Node<XFA_certificate> m_certificate;
 };
 
-std::optional<XFA_encrypt> XFA_encrypt::parse(const QDomElement& element)
+std::optional<XFA_encrypt> XFA_encrypt::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encrypt myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "certificate", myClass.m_certificate);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"certificate")
+        {
+            parseItem(reader, myClass.m_certificate);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -3051,7 +3076,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encryption> parse(const QDomElement& element);
+    static std::optional<XFA_encryption> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3064,24 +3089,33 @@ private:
     std::vector<XFA_Node<XFA_certificate>> m_certificate;
 };
 
-std::optional<XFA_encryption> XFA_encryption::parse(const QDomElement& element)
+std::optional<XFA_encryption> XFA_encryption::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encryption myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "certificate", myClass.m_certificate);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"certificate")
+        {
+            parseItem(reader, myClass.m_certificate);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -3099,7 +3133,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encryptionMethod> parse(const QDomElement& element);
+    static std::optional<XFA_encryptionMethod> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3112,26 +3146,20 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_encryptionMethod> XFA_encryptionMethod::parse(const QDomElement& element)
+std::optional<XFA_encryptionMethod> XFA_encryptionMethod::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encryptionMethod myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3149,7 +3177,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encryptionMethods> parse(const QDomElement& element);
+    static std::optional<XFA_encryptionMethods> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3162,24 +3190,33 @@ private:
     std::vector<XFA_Node<XFA_encryptionMethod>> m_encryptionMethod;
 };
 
-std::optional<XFA_encryptionMethods> XFA_encryptionMethods::parse(const QDomElement& element)
+std::optional<XFA_encryptionMethods> XFA_encryptionMethods::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encryptionMethods myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "encryptionMethod", myClass.m_encryptionMethod);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"encryptionMethod")
+        {
+            parseItem(reader, myClass.m_encryptionMethod);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -3203,7 +3240,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_exData> parse(const QDomElement& element);
+    static std::optional<XFA_exData> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3222,32 +3259,26 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_exData> XFA_exData::parse(const QDomElement& element)
+std::optional<XFA_exData> XFA_exData::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_exData myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "contentType", myClass.m_contentType, "");
-    parseAttribute(element, "href", myClass.m_href, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "maxLength", myClass.m_maxLength, "-1");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "rid", myClass.m_rid, "");
-    parseAttribute(element, "transferEncoding", myClass.m_transferEncoding, "none");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "contentType", myClass.m_contentType, "");
+    parseAttribute(attributes, "href", myClass.m_href, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "maxLength", myClass.m_maxLength, "-1");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "rid", myClass.m_rid, "");
+    parseAttribute(attributes, "transferEncoding", myClass.m_transferEncoding, "none");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3266,7 +3297,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_execute> parse(const QDomElement& element);
+    static std::optional<XFA_execute> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3280,25 +3311,23 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_execute> XFA_execute::parse(const QDomElement& element)
+std::optional<XFA_execute> XFA_execute::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_execute myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "connection", myClass.m_connection, "");
-    parseAttribute(element, "executeType", myClass.m_executeType, "import");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "runAt", myClass.m_runAt, "client");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "connection", myClass.m_connection, "");
+    parseAttribute(attributes, "executeType", myClass.m_executeType, "import");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "runAt", myClass.m_runAt, "client");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -3317,7 +3346,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_float> parse(const QDomElement& element);
+    static std::optional<XFA_float> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3331,27 +3360,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_float> XFA_float::parse(const QDomElement& element)
+std::optional<XFA_float> XFA_float::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_float myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3370,7 +3393,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_handler> parse(const QDomElement& element);
+    static std::optional<XFA_handler> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3384,27 +3407,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_handler> XFA_handler::parse(const QDomElement& element)
+std::optional<XFA_handler> XFA_handler::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_handler myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3426,7 +3443,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_hyphenation> parse(const QDomElement& element);
+    static std::optional<XFA_hyphenation> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3443,28 +3460,26 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_hyphenation> XFA_hyphenation::parse(const QDomElement& element)
+std::optional<XFA_hyphenation> XFA_hyphenation::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_hyphenation myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "excludeAllCaps", myClass.m_excludeAllCaps, "0");
-    parseAttribute(element, "excludeInitialCap", myClass.m_excludeInitialCap, "0");
-    parseAttribute(element, "hyphenate", myClass.m_hyphenate, "0");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "pushCharacterCount", myClass.m_pushCharacterCount, "3");
-    parseAttribute(element, "remainCharacterCount", myClass.m_remainCharacterCount, "3");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "wordCharacterCount", myClass.m_wordCharacterCount, "7");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "excludeAllCaps", myClass.m_excludeAllCaps, "0");
+    parseAttribute(attributes, "excludeInitialCap", myClass.m_excludeInitialCap, "0");
+    parseAttribute(attributes, "hyphenate", myClass.m_hyphenate, "0");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "pushCharacterCount", myClass.m_pushCharacterCount, "3");
+    parseAttribute(attributes, "remainCharacterCount", myClass.m_remainCharacterCount, "3");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "wordCharacterCount", myClass.m_wordCharacterCount, "7");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -3487,7 +3502,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_image> parse(const QDomElement& element);
+    static std::optional<XFA_image> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3505,31 +3520,25 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_image> XFA_image::parse(const QDomElement& element)
+std::optional<XFA_image> XFA_image::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_image myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "aspect", myClass.m_aspect, "fit");
-    parseAttribute(element, "contentType", myClass.m_contentType, "");
-    parseAttribute(element, "href", myClass.m_href, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "transferEncoding", myClass.m_transferEncoding, "base64");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "aspect", myClass.m_aspect, "fit");
+    parseAttribute(attributes, "contentType", myClass.m_contentType, "");
+    parseAttribute(attributes, "href", myClass.m_href, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "transferEncoding", myClass.m_transferEncoding, "base64");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3548,7 +3557,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_integer> parse(const QDomElement& element);
+    static std::optional<XFA_integer> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3562,27 +3571,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_integer> XFA_integer::parse(const QDomElement& element)
+std::optional<XFA_integer> XFA_integer::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_integer myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3600,7 +3603,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_issuers> parse(const QDomElement& element);
+    static std::optional<XFA_issuers> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3613,24 +3616,33 @@ private:
     std::vector<XFA_Node<XFA_certificate>> m_certificate;
 };
 
-std::optional<XFA_issuers> XFA_issuers::parse(const QDomElement& element)
+std::optional<XFA_issuers> XFA_issuers::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_issuers myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "certificate", myClass.m_certificate);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"certificate")
+        {
+            parseItem(reader, myClass.m_certificate);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -3656,7 +3668,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_keyUsage> parse(const QDomElement& element);
+    static std::optional<XFA_keyUsage> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3677,32 +3689,30 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_keyUsage> XFA_keyUsage::parse(const QDomElement& element)
+std::optional<XFA_keyUsage> XFA_keyUsage::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_keyUsage myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "crlSign", myClass.m_crlSign, "");
-    parseAttribute(element, "dataEncipherment", myClass.m_dataEncipherment, "");
-    parseAttribute(element, "decipherOnly", myClass.m_decipherOnly, "");
-    parseAttribute(element, "digitalSignature", myClass.m_digitalSignature, "");
-    parseAttribute(element, "encipherOnly", myClass.m_encipherOnly, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "keyAgreement", myClass.m_keyAgreement, "");
-    parseAttribute(element, "keyCertSign", myClass.m_keyCertSign, "");
-    parseAttribute(element, "keyEncipherment", myClass.m_keyEncipherment, "");
-    parseAttribute(element, "nonRepudiation", myClass.m_nonRepudiation, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "crlSign", myClass.m_crlSign, "");
+    parseAttribute(attributes, "dataEncipherment", myClass.m_dataEncipherment, "");
+    parseAttribute(attributes, "decipherOnly", myClass.m_decipherOnly, "");
+    parseAttribute(attributes, "digitalSignature", myClass.m_digitalSignature, "");
+    parseAttribute(attributes, "encipherOnly", myClass.m_encipherOnly, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "keyAgreement", myClass.m_keyAgreement, "");
+    parseAttribute(attributes, "keyCertSign", myClass.m_keyCertSign, "");
+    parseAttribute(attributes, "keyEncipherment", myClass.m_keyEncipherment, "");
+    parseAttribute(attributes, "nonRepudiation", myClass.m_nonRepudiation, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -3721,7 +3731,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_lockDocument> parse(const QDomElement& element);
+    static std::optional<XFA_lockDocument> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3735,27 +3745,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_lockDocument> XFA_lockDocument::parse(const QDomElement& element)
+std::optional<XFA_lockDocument> XFA_lockDocument::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_lockDocument myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3773,7 +3777,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_mdp> parse(const QDomElement& element);
+    static std::optional<XFA_mdp> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3786,24 +3790,22 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_mdp> XFA_mdp::parse(const QDomElement& element)
+std::optional<XFA_mdp> XFA_mdp::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_mdp myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "permissions", myClass.m_permissions, "2");
-    parseAttribute(element, "signatureType", myClass.m_signatureType, "filler");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "permissions", myClass.m_permissions, "2");
+    parseAttribute(attributes, "signatureType", myClass.m_signatureType, "filler");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -3826,7 +3828,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_medium> parse(const QDomElement& element);
+    static std::optional<XFA_medium> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3844,29 +3846,27 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_medium> XFA_medium::parse(const QDomElement& element)
+std::optional<XFA_medium> XFA_medium::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_medium myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "imagingBBox", myClass.m_imagingBBox, "");
-    parseAttribute(element, "long", myClass.m_long, "0in");
-    parseAttribute(element, "orientation", myClass.m_orientation, "portrait");
-    parseAttribute(element, "short", myClass.m_short, "0in");
-    parseAttribute(element, "stock", myClass.m_stock, "");
-    parseAttribute(element, "trayIn", myClass.m_trayIn, "auto");
-    parseAttribute(element, "trayOut", myClass.m_trayOut, "auto");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "imagingBBox", myClass.m_imagingBBox, "");
+    parseAttribute(attributes, "long", myClass.m_long, "0in");
+    parseAttribute(attributes, "orientation", myClass.m_orientation, "portrait");
+    parseAttribute(attributes, "short", myClass.m_short, "0in");
+    parseAttribute(attributes, "stock", myClass.m_stock, "");
+    parseAttribute(attributes, "trayIn", myClass.m_trayIn, "auto");
+    parseAttribute(attributes, "trayOut", myClass.m_trayOut, "auto");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -3885,7 +3885,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_oid> parse(const QDomElement& element);
+    static std::optional<XFA_oid> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3899,27 +3899,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_oid> XFA_oid::parse(const QDomElement& element)
+std::optional<XFA_oid> XFA_oid::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_oid myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -3937,7 +3931,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_oids> parse(const QDomElement& element);
+    static std::optional<XFA_oids> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -3950,24 +3944,33 @@ private:
     std::vector<XFA_Node<XFA_oid>> m_oid;
 };
 
-std::optional<XFA_oids> XFA_oids::parse(const QDomElement& element)
+std::optional<XFA_oids> XFA_oids::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_oids myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "oid", myClass.m_oid);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"oid")
+        {
+            parseItem(reader, myClass.m_oid);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -3986,7 +3989,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_overflow> parse(const QDomElement& element);
+    static std::optional<XFA_overflow> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4000,25 +4003,23 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_overflow> XFA_overflow::parse(const QDomElement& element)
+std::optional<XFA_overflow> XFA_overflow::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_overflow myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "leader", myClass.m_leader, "");
-    parseAttribute(element, "target", myClass.m_target, "");
-    parseAttribute(element, "trailer", myClass.m_trailer, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "leader", myClass.m_leader, "");
+    parseAttribute(attributes, "target", myClass.m_target, "");
+    parseAttribute(attributes, "trailer", myClass.m_trailer, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -4049,7 +4050,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_para> parse(const QDomElement& element);
+    static std::optional<XFA_para> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4075,37 +4076,46 @@ private:
     XFA_Node<XFA_hyphenation> m_hyphenation;
 };
 
-std::optional<XFA_para> XFA_para::parse(const QDomElement& element)
+std::optional<XFA_para> XFA_para::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_para myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "hAlign", myClass.m_hAlign, "left");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "lineHeight", myClass.m_lineHeight, "0pt");
-    parseAttribute(element, "marginLeft", myClass.m_marginLeft, "0in");
-    parseAttribute(element, "marginRight", myClass.m_marginRight, "0in");
-    parseAttribute(element, "orphans", myClass.m_orphans, "0");
-    parseAttribute(element, "preserve", myClass.m_preserve, "");
-    parseAttribute(element, "radixOffset", myClass.m_radixOffset, "0in");
-    parseAttribute(element, "spaceAbove", myClass.m_spaceAbove, "0in");
-    parseAttribute(element, "spaceBelow", myClass.m_spaceBelow, "0in");
-    parseAttribute(element, "tabDefault", myClass.m_tabDefault, "");
-    parseAttribute(element, "tabStops", myClass.m_tabStops, "");
-    parseAttribute(element, "textIndent", myClass.m_textIndent, "0in");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "vAlign", myClass.m_vAlign, "top");
-    parseAttribute(element, "widows", myClass.m_widows, "0");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "hAlign", myClass.m_hAlign, "left");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "lineHeight", myClass.m_lineHeight, "0pt");
+    parseAttribute(attributes, "marginLeft", myClass.m_marginLeft, "0in");
+    parseAttribute(attributes, "marginRight", myClass.m_marginRight, "0in");
+    parseAttribute(attributes, "orphans", myClass.m_orphans, "0");
+    parseAttribute(attributes, "preserve", myClass.m_preserve, "");
+    parseAttribute(attributes, "radixOffset", myClass.m_radixOffset, "0in");
+    parseAttribute(attributes, "spaceAbove", myClass.m_spaceAbove, "0in");
+    parseAttribute(attributes, "spaceBelow", myClass.m_spaceBelow, "0in");
+    parseAttribute(attributes, "tabDefault", myClass.m_tabDefault, "");
+    parseAttribute(attributes, "tabStops", myClass.m_tabStops, "");
+    parseAttribute(attributes, "textIndent", myClass.m_textIndent, "0in");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "vAlign", myClass.m_vAlign, "top");
+    parseAttribute(attributes, "widows", myClass.m_widows, "0");
 
     // load items
-    parseItem(element, "hyphenation", myClass.m_hyphenation);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"hyphenation")
+        {
+            parseItem(reader, myClass.m_hyphenation);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4123,7 +4133,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_picture> parse(const QDomElement& element);
+    static std::optional<XFA_picture> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4136,26 +4146,20 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_picture> XFA_picture::parse(const QDomElement& element)
+std::optional<XFA_picture> XFA_picture::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_picture myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4171,7 +4175,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_bind> parse(const QDomElement& element);
+    static std::optional<XFA_bind> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4182,28 +4186,37 @@ private:
     XFA_Node<XFA_picture> m_picture;
 };
 
-std::optional<XFA_bind> XFA_bind::parse(const QDomElement& element)
+std::optional<XFA_bind> XFA_bind::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_bind myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "match", myClass.m_match, "once");
-    parseAttribute(element, "ref", myClass.m_ref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "match", myClass.m_match, "once");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
 
     // load items
-    parseItem(element, "picture", myClass.m_picture);
-    myClass.setOrderFromElement(element);
-    return myClass;
-}
-
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
 
-class XFA_connect : public XFA_BaseNode
-{
+        if (name == u"picture")
+        {
+            parseItem(reader, myClass.m_picture);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
+    return myClass;
+}
+
+
+class XFA_connect : public XFA_BaseNode
+{
 public:
 
     QString getConnection() const {  return m_connection.getValueOrDefault(); }
@@ -4217,7 +4230,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_connect> parse(const QDomElement& element);
+    static std::optional<XFA_connect> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4232,26 +4245,35 @@ private:
     XFA_Node<XFA_picture> m_picture;
 };
 
-std::optional<XFA_connect> XFA_connect::parse(const QDomElement& element)
+std::optional<XFA_connect> XFA_connect::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_connect myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "connection", myClass.m_connection, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "usage", myClass.m_usage, "exportAndImport");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "connection", myClass.m_connection, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "usage", myClass.m_usage, "exportAndImport");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "picture", myClass.m_picture);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"picture")
+        {
+            parseItem(reader, myClass.m_picture);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4270,7 +4292,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_reason> parse(const QDomElement& element);
+    static std::optional<XFA_reason> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4284,27 +4306,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_reason> XFA_reason::parse(const QDomElement& element)
+std::optional<XFA_reason> XFA_reason::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_reason myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4322,7 +4338,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_reasons> parse(const QDomElement& element);
+    static std::optional<XFA_reasons> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4335,24 +4351,33 @@ private:
     std::vector<XFA_Node<XFA_reason>> m_reason;
 };
 
-std::optional<XFA_reasons> XFA_reasons::parse(const QDomElement& element)
+std::optional<XFA_reasons> XFA_reasons::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_reasons myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "reason", myClass.m_reason);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"reason")
+        {
+            parseItem(reader, myClass.m_reason);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4370,7 +4395,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_ref> parse(const QDomElement& element);
+    static std::optional<XFA_ref> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4383,26 +4408,20 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_ref> XFA_ref::parse(const QDomElement& element)
+std::optional<XFA_ref> XFA_ref::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_ref myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4424,7 +4443,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_script> parse(const QDomElement& element);
+    static std::optional<XFA_script> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4441,30 +4460,24 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_script> XFA_script::parse(const QDomElement& element)
+std::optional<XFA_script> XFA_script::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_script myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "binding", myClass.m_binding, "");
-    parseAttribute(element, "contentType", myClass.m_contentType, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "runAt", myClass.m_runAt, "client");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "binding", myClass.m_binding, "");
+    parseAttribute(attributes, "contentType", myClass.m_contentType, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "runAt", myClass.m_runAt, "client");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4486,7 +4499,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_breakAfter> parse(const QDomElement& element);
+    static std::optional<XFA_breakAfter> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4503,28 +4516,37 @@ private:
     XFA_Node<XFA_script> m_script;
 };
 
-std::optional<XFA_breakAfter> XFA_breakAfter::parse(const QDomElement& element)
+std::optional<XFA_breakAfter> XFA_breakAfter::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_breakAfter myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "leader", myClass.m_leader, "");
-    parseAttribute(element, "startNew", myClass.m_startNew, "0");
-    parseAttribute(element, "target", myClass.m_target, "");
-    parseAttribute(element, "targetType", myClass.m_targetType, "auto");
-    parseAttribute(element, "trailer", myClass.m_trailer, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "leader", myClass.m_leader, "");
+    parseAttribute(attributes, "startNew", myClass.m_startNew, "0");
+    parseAttribute(attributes, "target", myClass.m_target, "");
+    parseAttribute(attributes, "targetType", myClass.m_targetType, "auto");
+    parseAttribute(attributes, "trailer", myClass.m_trailer, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "script", myClass.m_script);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4546,7 +4568,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_breakBefore> parse(const QDomElement& element);
+    static std::optional<XFA_breakBefore> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4563,28 +4585,37 @@ private:
     XFA_Node<XFA_script> m_script;
 };
 
-std::optional<XFA_breakBefore> XFA_breakBefore::parse(const QDomElement& element)
+std::optional<XFA_breakBefore> XFA_breakBefore::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_breakBefore myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "leader", myClass.m_leader, "");
-    parseAttribute(element, "startNew", myClass.m_startNew, "0");
-    parseAttribute(element, "target", myClass.m_target, "");
-    parseAttribute(element, "targetType", myClass.m_targetType, "auto");
-    parseAttribute(element, "trailer", myClass.m_trailer, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "leader", myClass.m_leader, "");
+    parseAttribute(attributes, "startNew", myClass.m_startNew, "0");
+    parseAttribute(attributes, "target", myClass.m_target, "");
+    parseAttribute(attributes, "targetType", myClass.m_targetType, "auto");
+    parseAttribute(attributes, "trailer", myClass.m_trailer, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "script", myClass.m_script);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4600,7 +4631,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_setProperty> parse(const QDomElement& element);
+    static std::optional<XFA_setProperty> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4611,22 +4642,20 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_setProperty> XFA_setProperty::parse(const QDomElement& element)
+std::optional<XFA_setProperty> XFA_setProperty::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_setProperty myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "connection", myClass.m_connection, "");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "target", myClass.m_target, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "connection", myClass.m_connection, "");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "target", myClass.m_target, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -4644,7 +4673,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_signing> parse(const QDomElement& element);
+    static std::optional<XFA_signing> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4657,24 +4686,33 @@ private:
     std::vector<XFA_Node<XFA_certificate>> m_certificate;
 };
 
-std::optional<XFA_signing> XFA_signing::parse(const QDomElement& element)
+std::optional<XFA_signing> XFA_signing::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_signing myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "certificate", myClass.m_certificate);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"certificate")
+        {
+            parseItem(reader, myClass.m_certificate);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4695,7 +4733,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_speak> parse(const QDomElement& element);
+    static std::optional<XFA_speak> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4711,29 +4749,23 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_speak> XFA_speak::parse(const QDomElement& element)
+std::optional<XFA_speak> XFA_speak::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_speak myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "disable", myClass.m_disable, "0");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "priority", myClass.m_priority, "custom");
-    parseAttribute(element, "rid", myClass.m_rid, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "disable", myClass.m_disable, "0");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "priority", myClass.m_priority, "custom");
+    parseAttribute(attributes, "rid", myClass.m_rid, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4753,7 +4785,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_subjectDN> parse(const QDomElement& element);
+    static std::optional<XFA_subjectDN> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4768,28 +4800,22 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_subjectDN> XFA_subjectDN::parse(const QDomElement& element)
+std::optional<XFA_subjectDN> XFA_subjectDN::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_subjectDN myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "delimiter", myClass.m_delimiter, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "delimiter", myClass.m_delimiter, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4807,7 +4833,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_subjectDNs> parse(const QDomElement& element);
+    static std::optional<XFA_subjectDNs> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4820,24 +4846,33 @@ private:
     std::vector<XFA_Node<XFA_subjectDN>> m_subjectDN;
 };
 
-std::optional<XFA_subjectDNs> XFA_subjectDNs::parse(const QDomElement& element)
+std::optional<XFA_subjectDNs> XFA_subjectDNs::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_subjectDNs myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "subjectDN", myClass.m_subjectDN);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"subjectDN")
+        {
+            parseItem(reader, myClass.m_subjectDN);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4862,7 +4897,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_certificates> parse(const QDomElement& element);
+    static std::optional<XFA_certificates> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4882,31 +4917,55 @@ private:
     XFA_Node<XFA_subjectDNs> m_subjectDNs;
 };
 
-std::optional<XFA_certificates> XFA_certificates::parse(const QDomElement& element)
+std::optional<XFA_certificates> XFA_certificates::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_certificates myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "credentialServerPolicy", myClass.m_credentialServerPolicy, "optional");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "url", myClass.m_url, "");
-    parseAttribute(element, "urlPolicy", myClass.m_urlPolicy, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "credentialServerPolicy", myClass.m_credentialServerPolicy, "optional");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "url", myClass.m_url, "");
+    parseAttribute(attributes, "urlPolicy", myClass.m_urlPolicy, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "encryption", myClass.m_encryption);
-    parseItem(element, "issuers", myClass.m_issuers);
-    parseItem(element, "keyUsage", myClass.m_keyUsage);
-    parseItem(element, "oids", myClass.m_oids);
-    parseItem(element, "signing", myClass.m_signing);
-    parseItem(element, "subjectDNs", myClass.m_subjectDNs);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"encryption")
+        {
+            parseItem(reader, myClass.m_encryption);
+        }
+        else if (name == u"issuers")
+        {
+            parseItem(reader, myClass.m_issuers);
+        }
+        else if (name == u"keyUsage")
+        {
+            parseItem(reader, myClass.m_keyUsage);
+        }
+        else if (name == u"oids")
+        {
+            parseItem(reader, myClass.m_oids);
+        }
+        else if (name == u"signing")
+        {
+            parseItem(reader, myClass.m_signing);
+        }
+        else if (name == u"subjectDNs")
+        {
+            parseItem(reader, myClass.m_subjectDNs);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -4927,7 +4986,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_text> parse(const QDomElement& element);
+    static std::optional<XFA_text> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4943,29 +5002,23 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_text> XFA_text::parse(const QDomElement& element)
+std::optional<XFA_text> XFA_text::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_text myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "maxChars", myClass.m_maxChars, "0");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "rid", myClass.m_rid, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "maxChars", myClass.m_maxChars, "0");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "rid", myClass.m_rid, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -4982,7 +5035,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_message> parse(const QDomElement& element);
+    static std::optional<XFA_message> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -4994,23 +5047,32 @@ private:
     std::vector<XFA_Node<XFA_text>> m_text;
 };
 
-std::optional<XFA_message> XFA_message::parse(const QDomElement& element)
+std::optional<XFA_message> XFA_message::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_message myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "text", myClass.m_text);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5029,7 +5091,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_time> parse(const QDomElement& element);
+    static std::optional<XFA_time> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5043,27 +5105,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_time> XFA_time::parse(const QDomElement& element)
+std::optional<XFA_time> XFA_time::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_time myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -5089,7 +5145,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_desc> parse(const QDomElement& element);
+    static std::optional<XFA_desc> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5110,32 +5166,68 @@ private:
     std::vector<XFA_Node<XFA_time>> m_time;
 };
 
-std::optional<XFA_desc> XFA_desc::parse(const QDomElement& element)
+std::optional<XFA_desc> XFA_desc::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_desc myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "time", myClass.m_time);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5163,7 +5255,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_extras> parse(const QDomElement& element);
+    static std::optional<XFA_extras> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5186,34 +5278,73 @@ private:
     std::vector<XFA_Node<XFA_time>> m_time;
 };
 
-std::optional<XFA_extras> XFA_extras::parse(const QDomElement& element)
+std::optional<XFA_extras> XFA_extras::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_extras myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "time", myClass.m_time);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5249,7 +5380,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_barcode> parse(const QDomElement& element);
+    static std::optional<XFA_barcode> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5280,42 +5411,54 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_barcode> XFA_barcode::parse(const QDomElement& element)
+std::optional<XFA_barcode> XFA_barcode::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_barcode myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "charEncoding", myClass.m_charEncoding, "");
-    parseAttribute(element, "checksum", myClass.m_checksum, "none");
-    parseAttribute(element, "dataColumnCount", myClass.m_dataColumnCount, "");
-    parseAttribute(element, "dataLength", myClass.m_dataLength, "");
-    parseAttribute(element, "dataPrep", myClass.m_dataPrep, "none");
-    parseAttribute(element, "dataRowCount", myClass.m_dataRowCount, "");
-    parseAttribute(element, "endChar", myClass.m_endChar, "");
-    parseAttribute(element, "errorCorrectionLevel", myClass.m_errorCorrectionLevel, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "moduleHeight", myClass.m_moduleHeight, "5mm");
-    parseAttribute(element, "moduleWidth", myClass.m_moduleWidth, "0.25mm");
-    parseAttribute(element, "printCheckDigit", myClass.m_printCheckDigit, "0");
-    parseAttribute(element, "rowColumnRatio", myClass.m_rowColumnRatio, "");
-    parseAttribute(element, "startChar", myClass.m_startChar, "");
-    parseAttribute(element, "textLocation", myClass.m_textLocation, "below");
-    parseAttribute(element, "truncate", myClass.m_truncate, "");
-    parseAttribute(element, "type", myClass.m_type, "");
-    parseAttribute(element, "upsMode", myClass.m_upsMode, "usCarrier");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "wideNarrowRatio", myClass.m_wideNarrowRatio, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "charEncoding", myClass.m_charEncoding, "");
+    parseAttribute(attributes, "checksum", myClass.m_checksum, "none");
+    parseAttribute(attributes, "dataColumnCount", myClass.m_dataColumnCount, "");
+    parseAttribute(attributes, "dataLength", myClass.m_dataLength, "");
+    parseAttribute(attributes, "dataPrep", myClass.m_dataPrep, "none");
+    parseAttribute(attributes, "dataRowCount", myClass.m_dataRowCount, "");
+    parseAttribute(attributes, "endChar", myClass.m_endChar, "");
+    parseAttribute(attributes, "errorCorrectionLevel", myClass.m_errorCorrectionLevel, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "moduleHeight", myClass.m_moduleHeight, "5mm");
+    parseAttribute(attributes, "moduleWidth", myClass.m_moduleWidth, "0.25mm");
+    parseAttribute(attributes, "printCheckDigit", myClass.m_printCheckDigit, "0");
+    parseAttribute(attributes, "rowColumnRatio", myClass.m_rowColumnRatio, "");
+    parseAttribute(attributes, "startChar", myClass.m_startChar, "");
+    parseAttribute(attributes, "textLocation", myClass.m_textLocation, "below");
+    parseAttribute(attributes, "truncate", myClass.m_truncate, "");
+    parseAttribute(attributes, "type", myClass.m_type, "");
+    parseAttribute(attributes, "upsMode", myClass.m_upsMode, "usCarrier");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "wideNarrowRatio", myClass.m_wideNarrowRatio, "");
 
     // load items
-    parseItem(element, "encrypt", myClass.m_encrypt);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"encrypt")
+        {
+            parseItem(reader, myClass.m_encrypt);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5342,7 +5485,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_break> parse(const QDomElement& element);
+    static std::optional<XFA_break> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5364,33 +5507,42 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_break> XFA_break::parse(const QDomElement& element)
+std::optional<XFA_break> XFA_break::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_break myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "after", myClass.m_after, "auto");
-    parseAttribute(element, "afterTarget", myClass.m_afterTarget, "");
-    parseAttribute(element, "before", myClass.m_before, "auto");
-    parseAttribute(element, "beforeTarget", myClass.m_beforeTarget, "");
-    parseAttribute(element, "bookendLeader", myClass.m_bookendLeader, "");
-    parseAttribute(element, "bookendTrailer", myClass.m_bookendTrailer, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "overflowLeader", myClass.m_overflowLeader, "");
-    parseAttribute(element, "overflowTarget", myClass.m_overflowTarget, "");
-    parseAttribute(element, "overflowTrailer", myClass.m_overflowTrailer, "");
-    parseAttribute(element, "startNew", myClass.m_startNew, "0");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "after", myClass.m_after, "auto");
+    parseAttribute(attributes, "afterTarget", myClass.m_afterTarget, "");
+    parseAttribute(attributes, "before", myClass.m_before, "auto");
+    parseAttribute(attributes, "beforeTarget", myClass.m_beforeTarget, "");
+    parseAttribute(attributes, "bookendLeader", myClass.m_bookendLeader, "");
+    parseAttribute(attributes, "bookendTrailer", myClass.m_bookendTrailer, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "overflowLeader", myClass.m_overflowLeader, "");
+    parseAttribute(attributes, "overflowTarget", myClass.m_overflowTarget, "");
+    parseAttribute(attributes, "overflowTrailer", myClass.m_overflowTrailer, "");
+    parseAttribute(attributes, "startNew", myClass.m_startNew, "0");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5408,7 +5560,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_button> parse(const QDomElement& element);
+    static std::optional<XFA_button> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5421,31 +5573,40 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_button> XFA_button::parse(const QDomElement& element)
+std::optional<XFA_button> XFA_button::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_button myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "highlight", myClass.m_highlight, "inverted");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "highlight", myClass.m_highlight, "inverted");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
-    return myClass;
-}
-
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
 
-class XFA_calculate : public XFA_BaseNode
-{
-public:
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
+    return myClass;
+}
+
+
+class XFA_calculate : public XFA_BaseNode
+{
+public:
 
     QString getId() const {  return m_id.getValueOrDefault(); }
     OVERRIDE getOverride() const {  return m_override.getValueOrDefault(); }
@@ -5458,7 +5619,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_calculate> parse(const QDomElement& element);
+    static std::optional<XFA_calculate> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5473,26 +5634,41 @@ private:
     XFA_Node<XFA_script> m_script;
 };
 
-std::optional<XFA_calculate> XFA_calculate::parse(const QDomElement& element)
+std::optional<XFA_calculate> XFA_calculate::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_calculate myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "override", myClass.m_override, "disabled");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "override", myClass.m_override, "disabled");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "message", myClass.m_message);
-    parseItem(element, "script", myClass.m_script);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"message")
+        {
+            parseItem(reader, myClass.m_message);
+        }
+        else if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5511,7 +5687,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_color> parse(const QDomElement& element);
+    static std::optional<XFA_color> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5525,25 +5701,34 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_color> XFA_color::parse(const QDomElement& element)
+std::optional<XFA_color> XFA_color::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_color myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "cSpace", myClass.m_cSpace, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "value", myClass.m_value, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "cSpace", myClass.m_cSpace, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "value", myClass.m_value, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5567,7 +5752,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_contentArea> parse(const QDomElement& element);
+    static std::optional<XFA_contentArea> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5586,30 +5771,42 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_contentArea> XFA_contentArea::parse(const QDomElement& element)
+std::optional<XFA_contentArea> XFA_contentArea::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_contentArea myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "h", myClass.m_h, "0in");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "w", myClass.m_w, "0in");
-    parseAttribute(element, "x", myClass.m_x, "0in");
-    parseAttribute(element, "y", myClass.m_y, "0in");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "h", myClass.m_h, "0in");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "w", myClass.m_w, "0in");
+    parseAttribute(attributes, "x", myClass.m_x, "0in");
+    parseAttribute(attributes, "y", myClass.m_y, "0in");
 
     // load items
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5633,7 +5830,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_corner> parse(const QDomElement& element);
+    static std::optional<XFA_corner> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5652,30 +5849,42 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_corner> XFA_corner::parse(const QDomElement& element)
+std::optional<XFA_corner> XFA_corner::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_corner myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "inverted", myClass.m_inverted, "0");
-    parseAttribute(element, "join", myClass.m_join, "square");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "radius", myClass.m_radius, "0in");
-    parseAttribute(element, "stroke", myClass.m_stroke, "solid");
-    parseAttribute(element, "thickness", myClass.m_thickness, "0.5pt");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "inverted", myClass.m_inverted, "0");
+    parseAttribute(attributes, "join", myClass.m_join, "square");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "radius", myClass.m_radius, "0in");
+    parseAttribute(attributes, "stroke", myClass.m_stroke, "solid");
+    parseAttribute(attributes, "thickness", myClass.m_thickness, "0.5pt");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5692,7 +5901,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_defaultUi> parse(const QDomElement& element);
+    static std::optional<XFA_defaultUi> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5704,23 +5913,32 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_defaultUi> XFA_defaultUi::parse(const QDomElement& element)
+std::optional<XFA_defaultUi> XFA_defaultUi::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_defaultUi myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5742,7 +5960,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_edge> parse(const QDomElement& element);
+    static std::optional<XFA_edge> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5759,28 +5977,40 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_edge> XFA_edge::parse(const QDomElement& element)
+std::optional<XFA_edge> XFA_edge::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_edge myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "cap", myClass.m_cap, "square");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "stroke", myClass.m_stroke, "solid");
-    parseAttribute(element, "thickness", myClass.m_thickness, "0.5pt");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "cap", myClass.m_cap, "square");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "stroke", myClass.m_stroke, "solid");
+    parseAttribute(attributes, "thickness", myClass.m_thickness, "0.5pt");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5813,7 +6043,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_exObject> parse(const QDomElement& element);
+    static std::optional<XFA_exObject> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5841,39 +6071,81 @@ private:
     std::vector<XFA_Node<XFA_time>> m_time;
 };
 
-std::optional<XFA_exObject> XFA_exObject::parse(const QDomElement& element)
+std::optional<XFA_exObject> XFA_exObject::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_exObject myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "archive", myClass.m_archive, "");
-    parseAttribute(element, "classId", myClass.m_classId, "");
-    parseAttribute(element, "codeBase", myClass.m_codeBase, "");
-    parseAttribute(element, "codeType", myClass.m_codeType, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "archive", myClass.m_archive, "");
+    parseAttribute(attributes, "classId", myClass.m_classId, "");
+    parseAttribute(attributes, "codeBase", myClass.m_codeBase, "");
+    parseAttribute(attributes, "codeType", myClass.m_codeType, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "exObject", myClass.m_exObject);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "time", myClass.m_time);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"exObject")
+        {
+            parseItem(reader, myClass.m_exObject);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5891,7 +6163,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_format> parse(const QDomElement& element);
+    static std::optional<XFA_format> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5904,24 +6176,36 @@ private:
     XFA_Node<XFA_picture> m_picture;
 };
 
-std::optional<XFA_format> XFA_format::parse(const QDomElement& element)
+std::optional<XFA_format> XFA_format::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_format myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "picture", myClass.m_picture);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"picture")
+        {
+            parseItem(reader, myClass.m_picture);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -5951,7 +6235,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_items> parse(const QDomElement& element);
+    static std::optional<XFA_items> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -5976,36 +6260,72 @@ private:
     std::vector<XFA_Node<XFA_time>> m_time;
 };
 
-std::optional<XFA_items> XFA_items::parse(const QDomElement& element)
+std::optional<XFA_items> XFA_items::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_items myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "save", myClass.m_save, "0");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "save", myClass.m_save, "0");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "time", myClass.m_time);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6025,7 +6345,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_keep> parse(const QDomElement& element);
+    static std::optional<XFA_keep> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6040,26 +6360,35 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_keep> XFA_keep::parse(const QDomElement& element)
+std::optional<XFA_keep> XFA_keep::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_keep myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "intact", myClass.m_intact, "none");
-    parseAttribute(element, "next", myClass.m_next, "none");
-    parseAttribute(element, "previous", myClass.m_previous, "none");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "intact", myClass.m_intact, "none");
+    parseAttribute(attributes, "next", myClass.m_next, "none");
+    parseAttribute(attributes, "previous", myClass.m_previous, "none");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6078,7 +6407,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_line> parse(const QDomElement& element);
+    static std::optional<XFA_line> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6092,25 +6421,34 @@ private:
     XFA_Node<XFA_edge> m_edge;
 };
 
-std::optional<XFA_line> XFA_line::parse(const QDomElement& element)
+std::optional<XFA_line> XFA_line::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_line myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "hand", myClass.m_hand, "even");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "slope", myClass.m_slope, "\\");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "hand", myClass.m_hand, "even");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "slope", myClass.m_slope, "\\");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "edge", myClass.m_edge);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"edge")
+        {
+            parseItem(reader, myClass.m_edge);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6129,7 +6467,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_linear> parse(const QDomElement& element);
+    static std::optional<XFA_linear> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6143,25 +6481,37 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_linear> XFA_linear::parse(const QDomElement& element)
+std::optional<XFA_linear> XFA_linear::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_linear myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "toRight");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "toRight");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6181,7 +6531,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_manifest> parse(const QDomElement& element);
+    static std::optional<XFA_manifest> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6196,26 +6546,38 @@ private:
     std::vector<XFA_Node<XFA_ref>> m_ref;
 };
 
-std::optional<XFA_manifest> XFA_manifest::parse(const QDomElement& element)
+std::optional<XFA_manifest> XFA_manifest::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_manifest myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "action", myClass.m_action, "include");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "action", myClass.m_action, "include");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "ref", myClass.m_ref);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"ref")
+        {
+            parseItem(reader, myClass.m_ref);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6236,7 +6598,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_margin> parse(const QDomElement& element);
+    static std::optional<XFA_margin> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6252,27 +6614,36 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_margin> XFA_margin::parse(const QDomElement& element)
+std::optional<XFA_margin> XFA_margin::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_margin myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "bottomInset", myClass.m_bottomInset, "0in");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "leftInset", myClass.m_leftInset, "0in");
-    parseAttribute(element, "rightInset", myClass.m_rightInset, "0in");
-    parseAttribute(element, "topInset", myClass.m_topInset, "0in");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "bottomInset", myClass.m_bottomInset, "0in");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "leftInset", myClass.m_leftInset, "0in");
+    parseAttribute(attributes, "rightInset", myClass.m_rightInset, "0in");
+    parseAttribute(attributes, "topInset", myClass.m_topInset, "0in");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6292,7 +6663,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_occur> parse(const QDomElement& element);
+    static std::optional<XFA_occur> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6307,26 +6678,35 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_occur> XFA_occur::parse(const QDomElement& element)
+std::optional<XFA_occur> XFA_occur::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_occur myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "initial", myClass.m_initial, "1");
-    parseAttribute(element, "max", myClass.m_max, "1");
-    parseAttribute(element, "min", myClass.m_min, "1");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "initial", myClass.m_initial, "1");
+    parseAttribute(attributes, "max", myClass.m_max, "1");
+    parseAttribute(attributes, "min", myClass.m_min, "1");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6345,7 +6725,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_pattern> parse(const QDomElement& element);
+    static std::optional<XFA_pattern> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6359,27 +6739,39 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_pattern> XFA_pattern::parse(const QDomElement& element)
+std::optional<XFA_pattern> XFA_pattern::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_pattern myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "crossHatch");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "crossHatch");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
-    return myClass;
-}
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
+    return myClass;
+}
 
 
 class XFA_radial : public XFA_BaseNode
@@ -6396,7 +6788,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_radial> parse(const QDomElement& element);
+    static std::optional<XFA_radial> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6410,25 +6802,37 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_radial> XFA_radial::parse(const QDomElement& element)
+std::optional<XFA_radial> XFA_radial::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_radial myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "toEdge");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "toEdge");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6445,7 +6849,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_solid> parse(const QDomElement& element);
+    static std::optional<XFA_solid> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6457,23 +6861,32 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_solid> XFA_solid::parse(const QDomElement& element)
+std::optional<XFA_solid> XFA_solid::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_solid myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6492,7 +6905,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_stipple> parse(const QDomElement& element);
+    static std::optional<XFA_stipple> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6506,25 +6919,37 @@ private:
     XFA_Node<XFA_extras> m_extras;
 };
 
-std::optional<XFA_stipple> XFA_stipple::parse(const QDomElement& element)
+std::optional<XFA_stipple> XFA_stipple::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_stipple myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "rate", myClass.m_rate, "50");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "rate", myClass.m_rate, "50");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6548,7 +6973,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_fill> parse(const QDomElement& element);
+    static std::optional<XFA_fill> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6567,30 +6992,57 @@ private:
     XFA_Node<XFA_stipple> m_stipple;
 };
 
-std::optional<XFA_fill> XFA_fill::parse(const QDomElement& element)
+std::optional<XFA_fill> XFA_fill::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_fill myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "linear", myClass.m_linear);
-    parseItem(element, "pattern", myClass.m_pattern);
-    parseItem(element, "radial", myClass.m_radial);
-    parseItem(element, "solid", myClass.m_solid);
-    parseItem(element, "stipple", myClass.m_stipple);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"linear")
+        {
+            parseItem(reader, myClass.m_linear);
+        }
+        else if (name == u"pattern")
+        {
+            parseItem(reader, myClass.m_pattern);
+        }
+        else if (name == u"radial")
+        {
+            parseItem(reader, myClass.m_radial);
+        }
+        else if (name == u"solid")
+        {
+            parseItem(reader, myClass.m_solid);
+        }
+        else if (name == u"stipple")
+        {
+            parseItem(reader, myClass.m_stipple);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6612,7 +7064,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_arc> parse(const QDomElement& element);
+    static std::optional<XFA_arc> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6629,28 +7081,40 @@ private:
     XFA_Node<XFA_fill> m_fill;
 };
 
-std::optional<XFA_arc> XFA_arc::parse(const QDomElement& element)
+std::optional<XFA_arc> XFA_arc::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_arc myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "circular", myClass.m_circular, "0");
-    parseAttribute(element, "hand", myClass.m_hand, "even");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "startAngle", myClass.m_startAngle, "0");
-    parseAttribute(element, "sweepAngle", myClass.m_sweepAngle, "360");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "circular", myClass.m_circular, "0");
+    parseAttribute(attributes, "hand", myClass.m_hand, "even");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "startAngle", myClass.m_startAngle, "0");
+    parseAttribute(attributes, "sweepAngle", myClass.m_sweepAngle, "360");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "edge", myClass.m_edge);
-    parseItem(element, "fill", myClass.m_fill);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"edge")
+        {
+            parseItem(reader, myClass.m_edge);
+        }
+        else if (name == u"fill")
+        {
+            parseItem(reader, myClass.m_fill);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6675,7 +7139,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_border> parse(const QDomElement& element);
+    static std::optional<XFA_border> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6695,31 +7159,52 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_border> XFA_border::parse(const QDomElement& element)
+std::optional<XFA_border> XFA_border::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_border myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "break", myClass.m_break, "close");
-    parseAttribute(element, "hand", myClass.m_hand, "even");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "break", myClass.m_break, "close");
+    parseAttribute(attributes, "hand", myClass.m_hand, "even");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "corner", myClass.m_corner);
-    parseItem(element, "edge", myClass.m_edge);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "fill", myClass.m_fill);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"corner")
+        {
+            parseItem(reader, myClass.m_corner);
+        }
+        else if (name == u"edge")
+        {
+            parseItem(reader, myClass.m_edge);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"fill")
+        {
+            parseItem(reader, myClass.m_fill);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6741,7 +7226,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_checkButton> parse(const QDomElement& element);
+    static std::optional<XFA_checkButton> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6758,28 +7243,43 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_checkButton> XFA_checkButton::parse(const QDomElement& element)
+std::optional<XFA_checkButton> XFA_checkButton::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_checkButton myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "mark", myClass.m_mark, "default");
-    parseAttribute(element, "shape", myClass.m_shape, "square");
-    parseAttribute(element, "size", myClass.m_size, "10pt");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "mark", myClass.m_mark, "default");
+    parseAttribute(attributes, "shape", myClass.m_shape, "square");
+    parseAttribute(attributes, "size", myClass.m_size, "10pt");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6801,7 +7301,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_choiceList> parse(const QDomElement& element);
+    static std::optional<XFA_choiceList> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6818,28 +7318,43 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_choiceList> XFA_choiceList::parse(const QDomElement& element)
+std::optional<XFA_choiceList> XFA_choiceList::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_choiceList myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "commitOn", myClass.m_commitOn, "select");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "open", myClass.m_open, "userControl");
-    parseAttribute(element, "textEntry", myClass.m_textEntry, "0");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "commitOn", myClass.m_commitOn, "select");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "open", myClass.m_open, "userControl");
+    parseAttribute(attributes, "textEntry", myClass.m_textEntry, "0");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6861,7 +7376,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_dateTimeEdit> parse(const QDomElement& element);
+    static std::optional<XFA_dateTimeEdit> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6878,28 +7393,46 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_dateTimeEdit> XFA_dateTimeEdit::parse(const QDomElement& element)
+std::optional<XFA_dateTimeEdit> XFA_dateTimeEdit::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_dateTimeEdit myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "picker", myClass.m_picker, "host");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "picker", myClass.m_picker, "host");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "comb", myClass.m_comb);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"comb")
+        {
+            parseItem(reader, myClass.m_comb);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -6932,7 +7465,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_font> parse(const QDomElement& element);
+    static std::optional<XFA_font> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -6960,39 +7493,51 @@ private:
     XFA_Node<XFA_fill> m_fill;
 };
 
-std::optional<XFA_font> XFA_font::parse(const QDomElement& element)
+std::optional<XFA_font> XFA_font::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_font myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "baselineShift", myClass.m_baselineShift, "0in");
-    parseAttribute(element, "fontHorizontalScale", myClass.m_fontHorizontalScale, "");
-    parseAttribute(element, "fontVerticalScale", myClass.m_fontVerticalScale, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "kerningMode", myClass.m_kerningMode, "none");
-    parseAttribute(element, "letterSpacing", myClass.m_letterSpacing, "");
-    parseAttribute(element, "lineThrough", myClass.m_lineThrough, "0");
-    parseAttribute(element, "lineThroughPeriod", myClass.m_lineThroughPeriod, "all");
-    parseAttribute(element, "overline", myClass.m_overline, "0");
-    parseAttribute(element, "overlinePeriod", myClass.m_overlinePeriod, "all");
-    parseAttribute(element, "posture", myClass.m_posture, "normal");
-    parseAttribute(element, "size", myClass.m_size, "10pt");
-    parseAttribute(element, "typeface", myClass.m_typeface, "");
-    parseAttribute(element, "underline", myClass.m_underline, "0");
-    parseAttribute(element, "underlinePeriod", myClass.m_underlinePeriod, "all");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "weight", myClass.m_weight, "normal");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "baselineShift", myClass.m_baselineShift, "0in");
+    parseAttribute(attributes, "fontHorizontalScale", myClass.m_fontHorizontalScale, "");
+    parseAttribute(attributes, "fontVerticalScale", myClass.m_fontVerticalScale, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "kerningMode", myClass.m_kerningMode, "none");
+    parseAttribute(attributes, "letterSpacing", myClass.m_letterSpacing, "");
+    parseAttribute(attributes, "lineThrough", myClass.m_lineThrough, "0");
+    parseAttribute(attributes, "lineThroughPeriod", myClass.m_lineThroughPeriod, "all");
+    parseAttribute(attributes, "overline", myClass.m_overline, "0");
+    parseAttribute(attributes, "overlinePeriod", myClass.m_overlinePeriod, "all");
+    parseAttribute(attributes, "posture", myClass.m_posture, "normal");
+    parseAttribute(attributes, "size", myClass.m_size, "10pt");
+    parseAttribute(attributes, "typeface", myClass.m_typeface, "");
+    parseAttribute(attributes, "underline", myClass.m_underline, "0");
+    parseAttribute(attributes, "underlinePeriod", myClass.m_underlinePeriod, "all");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "weight", myClass.m_weight, "normal");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "fill", myClass.m_fill);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"fill")
+        {
+            parseItem(reader, myClass.m_fill);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7012,7 +7557,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_imageEdit> parse(const QDomElement& element);
+    static std::optional<XFA_imageEdit> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7027,26 +7572,41 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_imageEdit> XFA_imageEdit::parse(const QDomElement& element)
+std::optional<XFA_imageEdit> XFA_imageEdit::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_imageEdit myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "data", myClass.m_data, "link");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "data", myClass.m_data, "link");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7067,7 +7627,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_numericEdit> parse(const QDomElement& element);
+    static std::optional<XFA_numericEdit> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7083,27 +7643,45 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_numericEdit> XFA_numericEdit::parse(const QDomElement& element)
+std::optional<XFA_numericEdit> XFA_numericEdit::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_numericEdit myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "comb", myClass.m_comb);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"comb")
+        {
+            parseItem(reader, myClass.m_comb);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7124,7 +7702,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_passwordEdit> parse(const QDomElement& element);
+    static std::optional<XFA_passwordEdit> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7140,27 +7718,42 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_passwordEdit> XFA_passwordEdit::parse(const QDomElement& element)
+std::optional<XFA_passwordEdit> XFA_passwordEdit::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_passwordEdit myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "passwordChar", myClass.m_passwordChar, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "passwordChar", myClass.m_passwordChar, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7180,7 +7773,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_rectangle> parse(const QDomElement& element);
+    static std::optional<XFA_rectangle> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7195,26 +7788,41 @@ private:
     XFA_Node<XFA_fill> m_fill;
 };
 
-std::optional<XFA_rectangle> XFA_rectangle::parse(const QDomElement& element)
+std::optional<XFA_rectangle> XFA_rectangle::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_rectangle myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "hand", myClass.m_hand, "even");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "hand", myClass.m_hand, "even");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "corner", myClass.m_corner);
-    parseItem(element, "edge", myClass.m_edge);
-    parseItem(element, "fill", myClass.m_fill);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"corner")
+        {
+            parseItem(reader, myClass.m_corner);
+        }
+        else if (name == u"edge")
+        {
+            parseItem(reader, myClass.m_edge);
+        }
+        else if (name == u"fill")
+        {
+            parseItem(reader, myClass.m_fill);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7238,7 +7846,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_textEdit> parse(const QDomElement& element);
+    static std::optional<XFA_textEdit> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7257,48 +7865,66 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_textEdit> XFA_textEdit::parse(const QDomElement& element)
+std::optional<XFA_textEdit> XFA_textEdit::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_textEdit myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "allowRichText", myClass.m_allowRichText, "0");
-    parseAttribute(element, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "multiLine", myClass.m_multiLine, "1");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "vScrollPolicy", myClass.m_vScrollPolicy, "auto");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "allowRichText", myClass.m_allowRichText, "0");
+    parseAttribute(attributes, "hScrollPolicy", myClass.m_hScrollPolicy, "auto");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "multiLine", myClass.m_multiLine, "1");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "vScrollPolicy", myClass.m_vScrollPolicy, "auto");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "comb", myClass.m_comb);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
-    return myClass;
-}
-
-
-class XFA_timeStamp : public XFA_BaseNode
-{
-public:
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"comb")
+        {
+            parseItem(reader, myClass.m_comb);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
+    return myClass;
+}
 
-    QString getId() const {  return m_id.getValueOrDefault(); }
-    QString getServer() const {  return m_server.getValueOrDefault(); }
-    TYPE getType() const {  return m_type.getValueOrDefault(); }
-    QString getUse() const {  return m_use.getValueOrDefault(); }
-    QString getUsehref() const {  return m_usehref.getValueOrDefault(); }
+
+class XFA_timeStamp : public XFA_BaseNode
+{
+public:
+
+    QString getId() const {  return m_id.getValueOrDefault(); }
+    QString getServer() const {  return m_server.getValueOrDefault(); }
+    TYPE getType() const {  return m_type.getValueOrDefault(); }
+    QString getUse() const {  return m_use.getValueOrDefault(); }
+    QString getUsehref() const {  return m_usehref.getValueOrDefault(); }
 
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_timeStamp> parse(const QDomElement& element);
+    static std::optional<XFA_timeStamp> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7311,24 +7937,22 @@ private:
     /* subnodes */
 };
 
-std::optional<XFA_timeStamp> XFA_timeStamp::parse(const QDomElement& element)
+std::optional<XFA_timeStamp> XFA_timeStamp::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_timeStamp myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "server", myClass.m_server, "");
-    parseAttribute(element, "type", myClass.m_type, "optional");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "server", myClass.m_server, "");
+    parseAttribute(attributes, "type", myClass.m_type, "optional");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    myClass.setOrderFromElement(element);
+    reader.skipCurrentElement();
+
     return myClass;
 }
 
@@ -7357,7 +7981,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_filter> parse(const QDomElement& element);
+    static std::optional<XFA_filter> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7381,35 +8005,71 @@ private:
     XFA_Node<XFA_timeStamp> m_timeStamp;
 };
 
-std::optional<XFA_filter> XFA_filter::parse(const QDomElement& element)
+std::optional<XFA_filter> XFA_filter::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_filter myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "addRevocationInfo", myClass.m_addRevocationInfo, "");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "version", myClass.m_version, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "addRevocationInfo", myClass.m_addRevocationInfo, "");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "version", myClass.m_version, "");
 
     // load items
-    parseItem(element, "appearanceFilter", myClass.m_appearanceFilter);
-    parseItem(element, "certificates", myClass.m_certificates);
-    parseItem(element, "digestMethods", myClass.m_digestMethods);
-    parseItem(element, "encodings", myClass.m_encodings);
-    parseItem(element, "encryptionMethods", myClass.m_encryptionMethods);
-    parseItem(element, "handler", myClass.m_handler);
-    parseItem(element, "lockDocument", myClass.m_lockDocument);
-    parseItem(element, "mdp", myClass.m_mdp);
-    parseItem(element, "reasons", myClass.m_reasons);
-    parseItem(element, "timeStamp", myClass.m_timeStamp);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"appearanceFilter")
+        {
+            parseItem(reader, myClass.m_appearanceFilter);
+        }
+        else if (name == u"certificates")
+        {
+            parseItem(reader, myClass.m_certificates);
+        }
+        else if (name == u"digestMethods")
+        {
+            parseItem(reader, myClass.m_digestMethods);
+        }
+        else if (name == u"encodings")
+        {
+            parseItem(reader, myClass.m_encodings);
+        }
+        else if (name == u"encryptionMethods")
+        {
+            parseItem(reader, myClass.m_encryptionMethods);
+        }
+        else if (name == u"handler")
+        {
+            parseItem(reader, myClass.m_handler);
+        }
+        else if (name == u"lockDocument")
+        {
+            parseItem(reader, myClass.m_lockDocument);
+        }
+        else if (name == u"mdp")
+        {
+            parseItem(reader, myClass.m_mdp);
+        }
+        else if (name == u"reasons")
+        {
+            parseItem(reader, myClass.m_reasons);
+        }
+        else if (name == u"timeStamp")
+        {
+            parseItem(reader, myClass.m_timeStamp);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7429,7 +8089,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_encryptData> parse(const QDomElement& element);
+    static std::optional<XFA_encryptData> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7444,26 +8104,38 @@ private:
     XFA_Node<XFA_manifest> m_manifest;
 };
 
-std::optional<XFA_encryptData> XFA_encryptData::parse(const QDomElement& element)
+std::optional<XFA_encryptData> XFA_encryptData::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_encryptData myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "operation", myClass.m_operation, "encrypt");
-    parseAttribute(element, "target", myClass.m_target, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "operation", myClass.m_operation, "encrypt");
+    parseAttribute(attributes, "target", myClass.m_target, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "filter", myClass.m_filter);
-    parseItem(element, "manifest", myClass.m_manifest);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"filter")
+        {
+            parseItem(reader, myClass.m_filter);
+        }
+        else if (name == u"manifest")
+        {
+            parseItem(reader, myClass.m_manifest);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7484,7 +8156,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_signData> parse(const QDomElement& element);
+    static std::optional<XFA_signData> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7500,27 +8172,39 @@ private:
     XFA_Node<XFA_manifest> m_manifest;
 };
 
-std::optional<XFA_signData> XFA_signData::parse(const QDomElement& element)
+std::optional<XFA_signData> XFA_signData::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_signData myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "operation", myClass.m_operation, "sign");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "target", myClass.m_target, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "operation", myClass.m_operation, "sign");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "target", myClass.m_target, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "filter", myClass.m_filter);
-    parseItem(element, "manifest", myClass.m_manifest);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"filter")
+        {
+            parseItem(reader, myClass.m_filter);
+        }
+        else if (name == u"manifest")
+        {
+            parseItem(reader, myClass.m_manifest);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7542,7 +8226,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_signature> parse(const QDomElement& element);
+    static std::optional<XFA_signature> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7559,28 +8243,49 @@ private:
     XFA_Node<XFA_margin> m_margin;
 };
 
-std::optional<XFA_signature> XFA_signature::parse(const QDomElement& element)
+std::optional<XFA_signature> XFA_signature::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_signature myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "type", myClass.m_type, "PDF1.3");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "type", myClass.m_type, "PDF1.3");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "filter", myClass.m_filter);
-    parseItem(element, "manifest", myClass.m_manifest);
-    parseItem(element, "margin", myClass.m_margin);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"filter")
+        {
+            parseItem(reader, myClass.m_filter);
+        }
+        else if (name == u"manifest")
+        {
+            parseItem(reader, myClass.m_manifest);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7604,7 +8309,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_submit> parse(const QDomElement& element);
+    static std::optional<XFA_submit> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7623,30 +8328,45 @@ private:
     std::vector<XFA_Node<XFA_signData>> m_signData;
 };
 
-std::optional<XFA_submit> XFA_submit::parse(const QDomElement& element)
+std::optional<XFA_submit> XFA_submit::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_submit myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "embedPDF", myClass.m_embedPDF, "0");
-    parseAttribute(element, "format", myClass.m_format, "xdp");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "target", myClass.m_target, "");
-    parseAttribute(element, "textEncoding", myClass.m_textEncoding, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "xdpContent", myClass.m_xdpContent, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "embedPDF", myClass.m_embedPDF, "0");
+    parseAttribute(attributes, "format", myClass.m_format, "xdp");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "target", myClass.m_target, "");
+    parseAttribute(attributes, "textEncoding", myClass.m_textEncoding, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "xdpContent", myClass.m_xdpContent, "");
 
     // load items
-    parseItem(element, "encrypt", myClass.m_encrypt);
-    parseItem(element, "encryptData", myClass.m_encryptData);
-    parseItem(element, "signData", myClass.m_signData);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"encrypt")
+        {
+            parseItem(reader, myClass.m_encrypt);
+        }
+        else if (name == u"encryptData")
+        {
+            parseItem(reader, myClass.m_encryptData);
+        }
+        else if (name == u"signData")
+        {
+            parseItem(reader, myClass.m_signData);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7672,7 +8392,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_event> parse(const QDomElement& element);
+    static std::optional<XFA_event> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7693,32 +8413,56 @@ private:
     XFA_Node<XFA_submit> m_submit;
 };
 
-std::optional<XFA_event> XFA_event::parse(const QDomElement& element)
+std::optional<XFA_event> XFA_event::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_event myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "activity", myClass.m_activity, "click");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "listen", myClass.m_listen, "refOnly");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "activity", myClass.m_activity, "click");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "listen", myClass.m_listen, "refOnly");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "encryptData", myClass.m_encryptData);
-    parseItem(element, "execute", myClass.m_execute);
-    parseItem(element, "script", myClass.m_script);
-    parseItem(element, "signData", myClass.m_signData);
-    parseItem(element, "submit", myClass.m_submit);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"encryptData")
+        {
+            parseItem(reader, myClass.m_encryptData);
+        }
+        else if (name == u"execute")
+        {
+            parseItem(reader, myClass.m_execute);
+        }
+        else if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else if (name == u"signData")
+        {
+            parseItem(reader, myClass.m_signData);
+        }
+        else if (name == u"submit")
+        {
+            parseItem(reader, myClass.m_submit);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7737,7 +8481,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_toolTip> parse(const QDomElement& element);
+    static std::optional<XFA_toolTip> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7751,27 +8495,21 @@ private:
     XFA_Value<QString> m_nodeValue;
 };
 
-std::optional<XFA_toolTip> XFA_toolTip::parse(const QDomElement& element)
+std::optional<XFA_toolTip> XFA_toolTip::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_toolTip myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "rid", myClass.m_rid, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-
-    // load items
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "rid", myClass.m_rid, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load node value
-    parseValue(element, myClass.m_nodeValue);
+    parseValue(reader, myClass.m_nodeValue);
 
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -7790,7 +8528,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_assist> parse(const QDomElement& element);
+    static std::optional<XFA_assist> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7804,25 +8542,37 @@ private:
     XFA_Node<XFA_toolTip> m_toolTip;
 };
 
-std::optional<XFA_assist> XFA_assist::parse(const QDomElement& element)
+std::optional<XFA_assist> XFA_assist::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_assist myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "role", myClass.m_role, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "role", myClass.m_role, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "speak", myClass.m_speak);
-    parseItem(element, "toolTip", myClass.m_toolTip);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"speak")
+        {
+            parseItem(reader, myClass.m_speak);
+        }
+        else if (name == u"toolTip")
+        {
+            parseItem(reader, myClass.m_toolTip);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7842,7 +8592,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_traverse> parse(const QDomElement& element);
+    static std::optional<XFA_traverse> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7857,26 +8607,38 @@ private:
     XFA_Node<XFA_script> m_script;
 };
 
-std::optional<XFA_traverse> XFA_traverse::parse(const QDomElement& element)
+std::optional<XFA_traverse> XFA_traverse::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_traverse myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "operation", myClass.m_operation, "next");
-    parseAttribute(element, "ref", myClass.m_ref, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "operation", myClass.m_operation, "next");
+    parseAttribute(attributes, "ref", myClass.m_ref, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "script", myClass.m_script);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7894,7 +8656,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_traversal> parse(const QDomElement& element);
+    static std::optional<XFA_traversal> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7907,24 +8669,36 @@ private:
     std::vector<XFA_Node<XFA_traverse>> m_traverse;
 };
 
-std::optional<XFA_traversal> XFA_traversal::parse(const QDomElement& element)
+std::optional<XFA_traversal> XFA_traversal::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_traversal myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "traverse", myClass.m_traverse);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"traverse")
+        {
+            parseItem(reader, myClass.m_traverse);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -7953,7 +8727,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_ui> parse(const QDomElement& element);
+    static std::optional<XFA_ui> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -7977,35 +8751,80 @@ private:
     XFA_Node<XFA_textEdit> m_textEdit;
 };
 
-std::optional<XFA_ui> XFA_ui::parse(const QDomElement& element)
+std::optional<XFA_ui> XFA_ui::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_ui myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "picture", myClass.m_picture);
-    parseItem(element, "barcode", myClass.m_barcode);
-    parseItem(element, "button", myClass.m_button);
-    parseItem(element, "checkButton", myClass.m_checkButton);
-    parseItem(element, "choiceList", myClass.m_choiceList);
-    parseItem(element, "dateTimeEdit", myClass.m_dateTimeEdit);
-    parseItem(element, "defaultUi", myClass.m_defaultUi);
-    parseItem(element, "imageEdit", myClass.m_imageEdit);
-    parseItem(element, "numericEdit", myClass.m_numericEdit);
-    parseItem(element, "passwordEdit", myClass.m_passwordEdit);
-    parseItem(element, "signature", myClass.m_signature);
-    parseItem(element, "textEdit", myClass.m_textEdit);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"picture")
+        {
+            parseItem(reader, myClass.m_picture);
+        }
+        else if (name == u"barcode")
+        {
+            parseItem(reader, myClass.m_barcode);
+        }
+        else if (name == u"button")
+        {
+            parseItem(reader, myClass.m_button);
+        }
+        else if (name == u"checkButton")
+        {
+            parseItem(reader, myClass.m_checkButton);
+        }
+        else if (name == u"choiceList")
+        {
+            parseItem(reader, myClass.m_choiceList);
+        }
+        else if (name == u"dateTimeEdit")
+        {
+            parseItem(reader, myClass.m_dateTimeEdit);
+        }
+        else if (name == u"defaultUi")
+        {
+            parseItem(reader, myClass.m_defaultUi);
+        }
+        else if (name == u"imageEdit")
+        {
+            parseItem(reader, myClass.m_imageEdit);
+        }
+        else if (name == u"numericEdit")
+        {
+            parseItem(reader, myClass.m_numericEdit);
+        }
+        else if (name == u"passwordEdit")
+        {
+            parseItem(reader, myClass.m_passwordEdit);
+        }
+        else if (name == u"signature")
+        {
+            parseItem(reader, myClass.m_signature);
+        }
+        else if (name == u"textEdit")
+        {
+            parseItem(reader, myClass.m_textEdit);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8028,7 +8847,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_validate> parse(const QDomElement& element);
+    static std::optional<XFA_validate> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8046,29 +8865,47 @@ private:
     XFA_Node<XFA_script> m_script;
 };
 
-std::optional<XFA_validate> XFA_validate::parse(const QDomElement& element)
+std::optional<XFA_validate> XFA_validate::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_validate myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "formatTest", myClass.m_formatTest, "warning");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "nullTest", myClass.m_nullTest, "disabled");
-    parseAttribute(element, "scriptTest", myClass.m_scriptTest, "error");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "formatTest", myClass.m_formatTest, "warning");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "nullTest", myClass.m_nullTest, "disabled");
+    parseAttribute(attributes, "scriptTest", myClass.m_scriptTest, "error");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "message", myClass.m_message);
-    parseItem(element, "picture", myClass.m_picture);
-    parseItem(element, "script", myClass.m_script);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"message")
+        {
+            parseItem(reader, myClass.m_message);
+        }
+        else if (name == u"picture")
+        {
+            parseItem(reader, myClass.m_picture);
+        }
+        else if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8099,7 +8936,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_value> parse(const QDomElement& element);
+    static std::optional<XFA_value> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8125,43 +8962,88 @@ private:
     XFA_Node<XFA_time> m_time;
 };
 
-std::optional<XFA_value> XFA_value::parse(const QDomElement& element)
+std::optional<XFA_value> XFA_value::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_value myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "override", myClass.m_override, "0");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "override", myClass.m_override, "0");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "arc", myClass.m_arc);
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "line", myClass.m_line);
-    parseItem(element, "rectangle", myClass.m_rectangle);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "time", myClass.m_time);
-    myClass.setOrderFromElement(element);
-    return myClass;
-}
-
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
 
-class XFA_caption : public XFA_BaseNode
-{
+        if (name == u"arc")
+        {
+            parseItem(reader, myClass.m_arc);
+        }
+        else if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"line")
+        {
+            parseItem(reader, myClass.m_line);
+        }
+        else if (name == u"rectangle")
+        {
+            parseItem(reader, myClass.m_rectangle);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
+    return myClass;
+}
+
+
+class XFA_caption : public XFA_BaseNode
+{
 public:
 
     QString getId() const {  return m_id.getValueOrDefault(); }
@@ -8179,7 +9061,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_caption> parse(const QDomElement& element);
+    static std::optional<XFA_caption> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8198,30 +9080,51 @@ private:
     XFA_Node<XFA_value> m_value;
 };
 
-std::optional<XFA_caption> XFA_caption::parse(const QDomElement& element)
+std::optional<XFA_caption> XFA_caption::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_caption myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "placement", myClass.m_placement, "left");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "reserve", myClass.m_reserve, "-1");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "placement", myClass.m_placement, "left");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "reserve", myClass.m_reserve, "-1");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "font", myClass.m_font);
-    parseItem(element, "margin", myClass.m_margin);
-    parseItem(element, "para", myClass.m_para);
-    parseItem(element, "value", myClass.m_value);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"font")
+        {
+            parseItem(reader, myClass.m_font);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else if (name == u"para")
+        {
+            parseItem(reader, myClass.m_para);
+        }
+        else if (name == u"value")
+        {
+            parseItem(reader, myClass.m_value);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8266,7 +9169,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_draw> parse(const QDomElement& element);
+    static std::optional<XFA_draw> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8306,51 +9209,96 @@ private:
     std::vector<XFA_Node<XFA_setProperty>> m_setProperty;
 };
 
-std::optional<XFA_draw> XFA_draw::parse(const QDomElement& element)
+std::optional<XFA_draw> XFA_draw::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_draw myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "anchorType", myClass.m_anchorType, "topleft");
-    parseAttribute(element, "colSpan", myClass.m_colSpan, "1");
-    parseAttribute(element, "h", myClass.m_h, "0in");
-    parseAttribute(element, "hAlign", myClass.m_hAlign, "left");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "locale", myClass.m_locale, "");
-    parseAttribute(element, "maxH", myClass.m_maxH, "0in");
-    parseAttribute(element, "maxW", myClass.m_maxW, "0in");
-    parseAttribute(element, "minH", myClass.m_minH, "0in");
-    parseAttribute(element, "minW", myClass.m_minW, "0in");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "rotate", myClass.m_rotate, "0");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "w", myClass.m_w, "0in");
-    parseAttribute(element, "x", myClass.m_x, "0in");
-    parseAttribute(element, "y", myClass.m_y, "0in");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "anchorType", myClass.m_anchorType, "topleft");
+    parseAttribute(attributes, "colSpan", myClass.m_colSpan, "1");
+    parseAttribute(attributes, "h", myClass.m_h, "0in");
+    parseAttribute(attributes, "hAlign", myClass.m_hAlign, "left");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "locale", myClass.m_locale, "");
+    parseAttribute(attributes, "maxH", myClass.m_maxH, "0in");
+    parseAttribute(attributes, "maxW", myClass.m_maxW, "0in");
+    parseAttribute(attributes, "minH", myClass.m_minH, "0in");
+    parseAttribute(attributes, "minW", myClass.m_minW, "0in");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "rotate", myClass.m_rotate, "0");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "w", myClass.m_w, "0in");
+    parseAttribute(attributes, "x", myClass.m_x, "0in");
+    parseAttribute(attributes, "y", myClass.m_y, "0in");
 
     // load items
-    parseItem(element, "assist", myClass.m_assist);
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "caption", myClass.m_caption);
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "font", myClass.m_font);
-    parseItem(element, "keep", myClass.m_keep);
-    parseItem(element, "margin", myClass.m_margin);
-    parseItem(element, "para", myClass.m_para);
-    parseItem(element, "traversal", myClass.m_traversal);
-    parseItem(element, "ui", myClass.m_ui);
-    parseItem(element, "value", myClass.m_value);
-    parseItem(element, "setProperty", myClass.m_setProperty);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"assist")
+        {
+            parseItem(reader, myClass.m_assist);
+        }
+        else if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"caption")
+        {
+            parseItem(reader, myClass.m_caption);
+        }
+        else if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"font")
+        {
+            parseItem(reader, myClass.m_font);
+        }
+        else if (name == u"keep")
+        {
+            parseItem(reader, myClass.m_keep);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else if (name == u"para")
+        {
+            parseItem(reader, myClass.m_para);
+        }
+        else if (name == u"traversal")
+        {
+            parseItem(reader, myClass.m_traversal);
+        }
+        else if (name == u"ui")
+        {
+            parseItem(reader, myClass.m_ui);
+        }
+        else if (name == u"value")
+        {
+            parseItem(reader, myClass.m_value);
+        }
+        else if (name == u"setProperty")
+        {
+            parseItem(reader, myClass.m_setProperty);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8405,7 +9353,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_field> parse(const QDomElement& element);
+    static std::optional<XFA_field> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8455,61 +9403,130 @@ private:
     std::vector<XFA_Node<XFA_setProperty>> m_setProperty;
 };
 
-std::optional<XFA_field> XFA_field::parse(const QDomElement& element)
+std::optional<XFA_field> XFA_field::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_field myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "access", myClass.m_access, "open");
-    parseAttribute(element, "accessKey", myClass.m_accessKey, "");
-    parseAttribute(element, "anchorType", myClass.m_anchorType, "topleft");
-    parseAttribute(element, "colSpan", myClass.m_colSpan, "1");
-    parseAttribute(element, "h", myClass.m_h, "0in");
-    parseAttribute(element, "hAlign", myClass.m_hAlign, "left");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "locale", myClass.m_locale, "");
-    parseAttribute(element, "maxH", myClass.m_maxH, "0in");
-    parseAttribute(element, "maxW", myClass.m_maxW, "0in");
-    parseAttribute(element, "minH", myClass.m_minH, "0in");
-    parseAttribute(element, "minW", myClass.m_minW, "0in");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "rotate", myClass.m_rotate, "0");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "w", myClass.m_w, "0in");
-    parseAttribute(element, "x", myClass.m_x, "0in");
-    parseAttribute(element, "y", myClass.m_y, "0in");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "access", myClass.m_access, "open");
+    parseAttribute(attributes, "accessKey", myClass.m_accessKey, "");
+    parseAttribute(attributes, "anchorType", myClass.m_anchorType, "topleft");
+    parseAttribute(attributes, "colSpan", myClass.m_colSpan, "1");
+    parseAttribute(attributes, "h", myClass.m_h, "0in");
+    parseAttribute(attributes, "hAlign", myClass.m_hAlign, "left");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "locale", myClass.m_locale, "");
+    parseAttribute(attributes, "maxH", myClass.m_maxH, "0in");
+    parseAttribute(attributes, "maxW", myClass.m_maxW, "0in");
+    parseAttribute(attributes, "minH", myClass.m_minH, "0in");
+    parseAttribute(attributes, "minW", myClass.m_minW, "0in");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "rotate", myClass.m_rotate, "0");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "w", myClass.m_w, "0in");
+    parseAttribute(attributes, "x", myClass.m_x, "0in");
+    parseAttribute(attributes, "y", myClass.m_y, "0in");
 
     // load items
-    parseItem(element, "assist", myClass.m_assist);
-    parseItem(element, "bind", myClass.m_bind);
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "calculate", myClass.m_calculate);
-    parseItem(element, "caption", myClass.m_caption);
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "font", myClass.m_font);
-    parseItem(element, "format", myClass.m_format);
-    parseItem(element, "items", myClass.m_items);
-    parseItem(element, "keep", myClass.m_keep);
-    parseItem(element, "margin", myClass.m_margin);
-    parseItem(element, "para", myClass.m_para);
-    parseItem(element, "traversal", myClass.m_traversal);
-    parseItem(element, "ui", myClass.m_ui);
-    parseItem(element, "validate", myClass.m_validate);
-    parseItem(element, "value", myClass.m_value);
-    parseItem(element, "bindItems", myClass.m_bindItems);
-    parseItem(element, "connect", myClass.m_connect);
-    parseItem(element, "event", myClass.m_event);
-    parseItem(element, "setProperty", myClass.m_setProperty);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"assist")
+        {
+            parseItem(reader, myClass.m_assist);
+        }
+        else if (name == u"bind")
+        {
+            parseItem(reader, myClass.m_bind);
+        }
+        else if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"calculate")
+        {
+            parseItem(reader, myClass.m_calculate);
+        }
+        else if (name == u"caption")
+        {
+            parseItem(reader, myClass.m_caption);
+        }
+        else if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"font")
+        {
+            parseItem(reader, myClass.m_font);
+        }
+        else if (name == u"format")
+        {
+            parseItem(reader, myClass.m_format);
+        }
+        else if (name == u"items")
+        {
+            parseItem(reader, myClass.m_items);
+        }
+        else if (name == u"keep")
+        {
+            parseItem(reader, myClass.m_keep);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else if (name == u"para")
+        {
+            parseItem(reader, myClass.m_para);
+        }
+        else if (name == u"traversal")
+        {
+            parseItem(reader, myClass.m_traversal);
+        }
+        else if (name == u"ui")
+        {
+            parseItem(reader, myClass.m_ui);
+        }
+        else if (name == u"validate")
+        {
+            parseItem(reader, myClass.m_validate);
+        }
+        else if (name == u"value")
+        {
+            parseItem(reader, myClass.m_value);
+        }
+        else if (name == u"bindItems")
+        {
+            parseItem(reader, myClass.m_bindItems);
+        }
+        else if (name == u"connect")
+        {
+            parseItem(reader, myClass.m_connect);
+        }
+        else if (name == u"event")
+        {
+            parseItem(reader, myClass.m_event);
+        }
+        else if (name == u"setProperty")
+        {
+            parseItem(reader, myClass.m_setProperty);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8557,7 +9574,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_exclGroup> parse(const QDomElement& element);
+    static std::optional<XFA_exclGroup> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8600,54 +9617,105 @@ private:
     std::vector<XFA_Node<XFA_setProperty>> m_setProperty;
 };
 
-std::optional<XFA_exclGroup> XFA_exclGroup::parse(const QDomElement& element)
+std::optional<XFA_exclGroup> XFA_exclGroup::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_exclGroup myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "access", myClass.m_access, "open");
-    parseAttribute(element, "accessKey", myClass.m_accessKey, "");
-    parseAttribute(element, "anchorType", myClass.m_anchorType, "topleft");
-    parseAttribute(element, "colSpan", myClass.m_colSpan, "1");
-    parseAttribute(element, "h", myClass.m_h, "0in");
-    parseAttribute(element, "hAlign", myClass.m_hAlign, "left");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "layout", myClass.m_layout, "position");
-    parseAttribute(element, "maxH", myClass.m_maxH, "0in");
-    parseAttribute(element, "maxW", myClass.m_maxW, "0in");
-    parseAttribute(element, "minH", myClass.m_minH, "0in");
-    parseAttribute(element, "minW", myClass.m_minW, "0in");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "w", myClass.m_w, "0in");
-    parseAttribute(element, "x", myClass.m_x, "0in");
-    parseAttribute(element, "y", myClass.m_y, "0in");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "access", myClass.m_access, "open");
+    parseAttribute(attributes, "accessKey", myClass.m_accessKey, "");
+    parseAttribute(attributes, "anchorType", myClass.m_anchorType, "topleft");
+    parseAttribute(attributes, "colSpan", myClass.m_colSpan, "1");
+    parseAttribute(attributes, "h", myClass.m_h, "0in");
+    parseAttribute(attributes, "hAlign", myClass.m_hAlign, "left");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "layout", myClass.m_layout, "position");
+    parseAttribute(attributes, "maxH", myClass.m_maxH, "0in");
+    parseAttribute(attributes, "maxW", myClass.m_maxW, "0in");
+    parseAttribute(attributes, "minH", myClass.m_minH, "0in");
+    parseAttribute(attributes, "minW", myClass.m_minW, "0in");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "w", myClass.m_w, "0in");
+    parseAttribute(attributes, "x", myClass.m_x, "0in");
+    parseAttribute(attributes, "y", myClass.m_y, "0in");
 
     // load items
-    parseItem(element, "assist", myClass.m_assist);
-    parseItem(element, "bind", myClass.m_bind);
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "calculate", myClass.m_calculate);
-    parseItem(element, "caption", myClass.m_caption);
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "margin", myClass.m_margin);
-    parseItem(element, "para", myClass.m_para);
-    parseItem(element, "traversal", myClass.m_traversal);
-    parseItem(element, "validate", myClass.m_validate);
-    parseItem(element, "connect", myClass.m_connect);
-    parseItem(element, "event", myClass.m_event);
-    parseItem(element, "field", myClass.m_field);
-    parseItem(element, "setProperty", myClass.m_setProperty);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"assist")
+        {
+            parseItem(reader, myClass.m_assist);
+        }
+        else if (name == u"bind")
+        {
+            parseItem(reader, myClass.m_bind);
+        }
+        else if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"calculate")
+        {
+            parseItem(reader, myClass.m_calculate);
+        }
+        else if (name == u"caption")
+        {
+            parseItem(reader, myClass.m_caption);
+        }
+        else if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else if (name == u"para")
+        {
+            parseItem(reader, myClass.m_para);
+        }
+        else if (name == u"traversal")
+        {
+            parseItem(reader, myClass.m_traversal);
+        }
+        else if (name == u"validate")
+        {
+            parseItem(reader, myClass.m_validate);
+        }
+        else if (name == u"connect")
+        {
+            parseItem(reader, myClass.m_connect);
+        }
+        else if (name == u"event")
+        {
+            parseItem(reader, myClass.m_event);
+        }
+        else if (name == u"field")
+        {
+            parseItem(reader, myClass.m_field);
+        }
+        else if (name == u"setProperty")
+        {
+            parseItem(reader, myClass.m_setProperty);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8675,7 +9743,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_variables> parse(const QDomElement& element);
+    static std::optional<XFA_variables> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8698,34 +9766,76 @@ private:
     std::vector<XFA_Node<XFA_time>> m_time;
 };
 
-std::optional<XFA_variables> XFA_variables::parse(const QDomElement& element)
+std::optional<XFA_variables> XFA_variables::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_variables myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "manifest", myClass.m_manifest);
-    parseItem(element, "script", myClass.m_script);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "time", myClass.m_time);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"manifest")
+        {
+            parseItem(reader, myClass.m_manifest);
+        }
+        else if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8755,7 +9865,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_area> parse(const QDomElement& element);
+    static std::optional<XFA_area> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8780,36 +9890,69 @@ private:
     std::vector<XFA_Node<XFA_subformSet>> m_subformSet;
 };
 
-std::optional<XFA_area> XFA_area::parse(const QDomElement& element)
+std::optional<XFA_area> XFA_area::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_area myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "colSpan", myClass.m_colSpan, "1");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "x", myClass.m_x, "0in");
-    parseAttribute(element, "y", myClass.m_y, "0in");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "colSpan", myClass.m_colSpan, "1");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "x", myClass.m_x, "0in");
+    parseAttribute(attributes, "y", myClass.m_y, "0in");
 
     // load items
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "area", myClass.m_area);
-    parseItem(element, "draw", myClass.m_draw);
-    parseItem(element, "exObject", myClass.m_exObject);
-    parseItem(element, "exclGroup", myClass.m_exclGroup);
-    parseItem(element, "field", myClass.m_field);
-    parseItem(element, "subform", myClass.m_subform);
-    parseItem(element, "subformSet", myClass.m_subformSet);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"area")
+        {
+            parseItem(reader, myClass.m_area);
+        }
+        else if (name == u"draw")
+        {
+            parseItem(reader, myClass.m_draw);
+        }
+        else if (name == u"exObject")
+        {
+            parseItem(reader, myClass.m_exObject);
+        }
+        else if (name == u"exclGroup")
+        {
+            parseItem(reader, myClass.m_exclGroup);
+        }
+        else if (name == u"field")
+        {
+            parseItem(reader, myClass.m_field);
+        }
+        else if (name == u"subform")
+        {
+            parseItem(reader, myClass.m_subform);
+        }
+        else if (name == u"subformSet")
+        {
+            parseItem(reader, myClass.m_subformSet);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8842,7 +9985,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_pageArea> parse(const QDomElement& element);
+    static std::optional<XFA_pageArea> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8870,39 +10013,75 @@ private:
     std::vector<XFA_Node<XFA_subform>> m_subform;
 };
 
-std::optional<XFA_pageArea> XFA_pageArea::parse(const QDomElement& element)
+std::optional<XFA_pageArea> XFA_pageArea::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_pageArea myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "blankOrNotBlank", myClass.m_blankOrNotBlank, "any");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "initialNumber", myClass.m_initialNumber, "1");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "numbered", myClass.m_numbered, "1");
-    parseAttribute(element, "oddOrEven", myClass.m_oddOrEven, "any");
-    parseAttribute(element, "pagePosition", myClass.m_pagePosition, "any");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "blankOrNotBlank", myClass.m_blankOrNotBlank, "any");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "initialNumber", myClass.m_initialNumber, "1");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "numbered", myClass.m_numbered, "1");
+    parseAttribute(attributes, "oddOrEven", myClass.m_oddOrEven, "any");
+    parseAttribute(attributes, "pagePosition", myClass.m_pagePosition, "any");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "medium", myClass.m_medium);
-    parseItem(element, "occur", myClass.m_occur);
-    parseItem(element, "area", myClass.m_area);
-    parseItem(element, "contentArea", myClass.m_contentArea);
-    parseItem(element, "draw", myClass.m_draw);
-    parseItem(element, "exclGroup", myClass.m_exclGroup);
-    parseItem(element, "field", myClass.m_field);
-    parseItem(element, "subform", myClass.m_subform);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"medium")
+        {
+            parseItem(reader, myClass.m_medium);
+        }
+        else if (name == u"occur")
+        {
+            parseItem(reader, myClass.m_occur);
+        }
+        else if (name == u"area")
+        {
+            parseItem(reader, myClass.m_area);
+        }
+        else if (name == u"contentArea")
+        {
+            parseItem(reader, myClass.m_contentArea);
+        }
+        else if (name == u"draw")
+        {
+            parseItem(reader, myClass.m_draw);
+        }
+        else if (name == u"exclGroup")
+        {
+            parseItem(reader, myClass.m_exclGroup);
+        }
+        else if (name == u"field")
+        {
+            parseItem(reader, myClass.m_field);
+        }
+        else if (name == u"subform")
+        {
+            parseItem(reader, myClass.m_subform);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -8926,7 +10105,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_pageSet> parse(const QDomElement& element);
+    static std::optional<XFA_pageSet> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -8945,30 +10124,48 @@ private:
     std::vector<XFA_Node<XFA_pageSet>> m_pageSet;
 };
 
-std::optional<XFA_pageSet> XFA_pageSet::parse(const QDomElement& element)
+std::optional<XFA_pageSet> XFA_pageSet::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_pageSet myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "duplexImposition", myClass.m_duplexImposition, "longEdge");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "relation", myClass.m_relation, "orderedOccurrence");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "duplexImposition", myClass.m_duplexImposition, "longEdge");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "relation", myClass.m_relation, "orderedOccurrence");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "occur", myClass.m_occur);
-    parseItem(element, "pageArea", myClass.m_pageArea);
-    parseItem(element, "pageSet", myClass.m_pageSet);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"occur")
+        {
+            parseItem(reader, myClass.m_occur);
+        }
+        else if (name == u"pageArea")
+        {
+            parseItem(reader, myClass.m_pageArea);
+        }
+        else if (name == u"pageSet")
+        {
+            parseItem(reader, myClass.m_pageSet);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -9091,7 +10288,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_proto> parse(const QDomElement& element);
+    static std::optional<XFA_proto> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -9209,129 +10406,464 @@ private:
     std::vector<XFA_Node<XFA_variables>> m_variables;
 };
 
-std::optional<XFA_proto> XFA_proto::parse(const QDomElement& element)
+std::optional<XFA_proto> XFA_proto::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
+    XFA_proto myClass;
+    myClass.setOrderFromReader(reader);
+
+    // load attributes
+
+    // load items
+    while (reader.readNextStartElement())
     {
-        return std::nullopt;
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"appearanceFilter")
+        {
+            parseItem(reader, myClass.m_appearanceFilter);
+        }
+        else if (name == u"arc")
+        {
+            parseItem(reader, myClass.m_arc);
+        }
+        else if (name == u"area")
+        {
+            parseItem(reader, myClass.m_area);
+        }
+        else if (name == u"assist")
+        {
+            parseItem(reader, myClass.m_assist);
+        }
+        else if (name == u"barcode")
+        {
+            parseItem(reader, myClass.m_barcode);
+        }
+        else if (name == u"bindItems")
+        {
+            parseItem(reader, myClass.m_bindItems);
+        }
+        else if (name == u"bookend")
+        {
+            parseItem(reader, myClass.m_bookend);
+        }
+        else if (name == u"boolean")
+        {
+            parseItem(reader, myClass.m_boolean);
+        }
+        else if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"break")
+        {
+            parseItem(reader, myClass.m_break);
+        }
+        else if (name == u"breakAfter")
+        {
+            parseItem(reader, myClass.m_breakAfter);
+        }
+        else if (name == u"breakBefore")
+        {
+            parseItem(reader, myClass.m_breakBefore);
+        }
+        else if (name == u"button")
+        {
+            parseItem(reader, myClass.m_button);
+        }
+        else if (name == u"calculate")
+        {
+            parseItem(reader, myClass.m_calculate);
+        }
+        else if (name == u"caption")
+        {
+            parseItem(reader, myClass.m_caption);
+        }
+        else if (name == u"certificate")
+        {
+            parseItem(reader, myClass.m_certificate);
+        }
+        else if (name == u"certificates")
+        {
+            parseItem(reader, myClass.m_certificates);
+        }
+        else if (name == u"checkButton")
+        {
+            parseItem(reader, myClass.m_checkButton);
+        }
+        else if (name == u"choiceList")
+        {
+            parseItem(reader, myClass.m_choiceList);
+        }
+        else if (name == u"color")
+        {
+            parseItem(reader, myClass.m_color);
+        }
+        else if (name == u"comb")
+        {
+            parseItem(reader, myClass.m_comb);
+        }
+        else if (name == u"connect")
+        {
+            parseItem(reader, myClass.m_connect);
+        }
+        else if (name == u"contentArea")
+        {
+            parseItem(reader, myClass.m_contentArea);
+        }
+        else if (name == u"corner")
+        {
+            parseItem(reader, myClass.m_corner);
+        }
+        else if (name == u"date")
+        {
+            parseItem(reader, myClass.m_date);
+        }
+        else if (name == u"dateTime")
+        {
+            parseItem(reader, myClass.m_dateTime);
+        }
+        else if (name == u"dateTimeEdit")
+        {
+            parseItem(reader, myClass.m_dateTimeEdit);
+        }
+        else if (name == u"decimal")
+        {
+            parseItem(reader, myClass.m_decimal);
+        }
+        else if (name == u"defaultUi")
+        {
+            parseItem(reader, myClass.m_defaultUi);
+        }
+        else if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"digestMethod")
+        {
+            parseItem(reader, myClass.m_digestMethod);
+        }
+        else if (name == u"digestMethods")
+        {
+            parseItem(reader, myClass.m_digestMethods);
+        }
+        else if (name == u"draw")
+        {
+            parseItem(reader, myClass.m_draw);
+        }
+        else if (name == u"edge")
+        {
+            parseItem(reader, myClass.m_edge);
+        }
+        else if (name == u"encoding")
+        {
+            parseItem(reader, myClass.m_encoding);
+        }
+        else if (name == u"encodings")
+        {
+            parseItem(reader, myClass.m_encodings);
+        }
+        else if (name == u"encrypt")
+        {
+            parseItem(reader, myClass.m_encrypt);
+        }
+        else if (name == u"encryptData")
+        {
+            parseItem(reader, myClass.m_encryptData);
+        }
+        else if (name == u"encryption")
+        {
+            parseItem(reader, myClass.m_encryption);
+        }
+        else if (name == u"encryptionMethod")
+        {
+            parseItem(reader, myClass.m_encryptionMethod);
+        }
+        else if (name == u"encryptionMethods")
+        {
+            parseItem(reader, myClass.m_encryptionMethods);
+        }
+        else if (name == u"event")
+        {
+            parseItem(reader, myClass.m_event);
+        }
+        else if (name == u"exData")
+        {
+            parseItem(reader, myClass.m_exData);
+        }
+        else if (name == u"exObject")
+        {
+            parseItem(reader, myClass.m_exObject);
+        }
+        else if (name == u"exclGroup")
+        {
+            parseItem(reader, myClass.m_exclGroup);
+        }
+        else if (name == u"execute")
+        {
+            parseItem(reader, myClass.m_execute);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"field")
+        {
+            parseItem(reader, myClass.m_field);
+        }
+        else if (name == u"fill")
+        {
+            parseItem(reader, myClass.m_fill);
+        }
+        else if (name == u"filter")
+        {
+            parseItem(reader, myClass.m_filter);
+        }
+        else if (name == u"float")
+        {
+            parseItem(reader, myClass.m_float);
+        }
+        else if (name == u"font")
+        {
+            parseItem(reader, myClass.m_font);
+        }
+        else if (name == u"format")
+        {
+            parseItem(reader, myClass.m_format);
+        }
+        else if (name == u"handler")
+        {
+            parseItem(reader, myClass.m_handler);
+        }
+        else if (name == u"hyphenation")
+        {
+            parseItem(reader, myClass.m_hyphenation);
+        }
+        else if (name == u"image")
+        {
+            parseItem(reader, myClass.m_image);
+        }
+        else if (name == u"imageEdit")
+        {
+            parseItem(reader, myClass.m_imageEdit);
+        }
+        else if (name == u"integer")
+        {
+            parseItem(reader, myClass.m_integer);
+        }
+        else if (name == u"issuers")
+        {
+            parseItem(reader, myClass.m_issuers);
+        }
+        else if (name == u"items")
+        {
+            parseItem(reader, myClass.m_items);
+        }
+        else if (name == u"keep")
+        {
+            parseItem(reader, myClass.m_keep);
+        }
+        else if (name == u"keyUsage")
+        {
+            parseItem(reader, myClass.m_keyUsage);
+        }
+        else if (name == u"line")
+        {
+            parseItem(reader, myClass.m_line);
+        }
+        else if (name == u"linear")
+        {
+            parseItem(reader, myClass.m_linear);
+        }
+        else if (name == u"lockDocument")
+        {
+            parseItem(reader, myClass.m_lockDocument);
+        }
+        else if (name == u"manifest")
+        {
+            parseItem(reader, myClass.m_manifest);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else if (name == u"mdp")
+        {
+            parseItem(reader, myClass.m_mdp);
+        }
+        else if (name == u"medium")
+        {
+            parseItem(reader, myClass.m_medium);
+        }
+        else if (name == u"message")
+        {
+            parseItem(reader, myClass.m_message);
+        }
+        else if (name == u"numericEdit")
+        {
+            parseItem(reader, myClass.m_numericEdit);
+        }
+        else if (name == u"occur")
+        {
+            parseItem(reader, myClass.m_occur);
+        }
+        else if (name == u"oid")
+        {
+            parseItem(reader, myClass.m_oid);
+        }
+        else if (name == u"oids")
+        {
+            parseItem(reader, myClass.m_oids);
+        }
+        else if (name == u"overflow")
+        {
+            parseItem(reader, myClass.m_overflow);
+        }
+        else if (name == u"pageArea")
+        {
+            parseItem(reader, myClass.m_pageArea);
+        }
+        else if (name == u"pageSet")
+        {
+            parseItem(reader, myClass.m_pageSet);
+        }
+        else if (name == u"para")
+        {
+            parseItem(reader, myClass.m_para);
+        }
+        else if (name == u"passwordEdit")
+        {
+            parseItem(reader, myClass.m_passwordEdit);
+        }
+        else if (name == u"pattern")
+        {
+            parseItem(reader, myClass.m_pattern);
+        }
+        else if (name == u"picture")
+        {
+            parseItem(reader, myClass.m_picture);
+        }
+        else if (name == u"radial")
+        {
+            parseItem(reader, myClass.m_radial);
+        }
+        else if (name == u"reason")
+        {
+            parseItem(reader, myClass.m_reason);
+        }
+        else if (name == u"reasons")
+        {
+            parseItem(reader, myClass.m_reasons);
+        }
+        else if (name == u"rectangle")
+        {
+            parseItem(reader, myClass.m_rectangle);
+        }
+        else if (name == u"ref")
+        {
+            parseItem(reader, myClass.m_ref);
+        }
+        else if (name == u"script")
+        {
+            parseItem(reader, myClass.m_script);
+        }
+        else if (name == u"setProperty")
+        {
+            parseItem(reader, myClass.m_setProperty);
+        }
+        else if (name == u"signData")
+        {
+            parseItem(reader, myClass.m_signData);
+        }
+        else if (name == u"signature")
+        {
+            parseItem(reader, myClass.m_signature);
+        }
+        else if (name == u"signing")
+        {
+            parseItem(reader, myClass.m_signing);
+        }
+        else if (name == u"solid")
+        {
+            parseItem(reader, myClass.m_solid);
+        }
+        else if (name == u"speak")
+        {
+            parseItem(reader, myClass.m_speak);
+        }
+        else if (name == u"stipple")
+        {
+            parseItem(reader, myClass.m_stipple);
+        }
+        else if (name == u"subform")
+        {
+            parseItem(reader, myClass.m_subform);
+        }
+        else if (name == u"subformSet")
+        {
+            parseItem(reader, myClass.m_subformSet);
+        }
+        else if (name == u"subjectDN")
+        {
+            parseItem(reader, myClass.m_subjectDN);
+        }
+        else if (name == u"subjectDNs")
+        {
+            parseItem(reader, myClass.m_subjectDNs);
+        }
+        else if (name == u"submit")
+        {
+            parseItem(reader, myClass.m_submit);
+        }
+        else if (name == u"text")
+        {
+            parseItem(reader, myClass.m_text);
+        }
+        else if (name == u"textEdit")
+        {
+            parseItem(reader, myClass.m_textEdit);
+        }
+        else if (name == u"time")
+        {
+            parseItem(reader, myClass.m_time);
+        }
+        else if (name == u"timeStamp")
+        {
+            parseItem(reader, myClass.m_timeStamp);
+        }
+        else if (name == u"toolTip")
+        {
+            parseItem(reader, myClass.m_toolTip);
+        }
+        else if (name == u"traversal")
+        {
+            parseItem(reader, myClass.m_traversal);
+        }
+        else if (name == u"traverse")
+        {
+            parseItem(reader, myClass.m_traverse);
+        }
+        else if (name == u"ui")
+        {
+            parseItem(reader, myClass.m_ui);
+        }
+        else if (name == u"validate")
+        {
+            parseItem(reader, myClass.m_validate);
+        }
+        else if (name == u"value")
+        {
+            parseItem(reader, myClass.m_value);
+        }
+        else if (name == u"variables")
+        {
+            parseItem(reader, myClass.m_variables);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
     }
 
-    XFA_proto myClass;
-
-    // load attributes
-
-    // load items
-    parseItem(element, "appearanceFilter", myClass.m_appearanceFilter);
-    parseItem(element, "arc", myClass.m_arc);
-    parseItem(element, "area", myClass.m_area);
-    parseItem(element, "assist", myClass.m_assist);
-    parseItem(element, "barcode", myClass.m_barcode);
-    parseItem(element, "bindItems", myClass.m_bindItems);
-    parseItem(element, "bookend", myClass.m_bookend);
-    parseItem(element, "boolean", myClass.m_boolean);
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "break", myClass.m_break);
-    parseItem(element, "breakAfter", myClass.m_breakAfter);
-    parseItem(element, "breakBefore", myClass.m_breakBefore);
-    parseItem(element, "button", myClass.m_button);
-    parseItem(element, "calculate", myClass.m_calculate);
-    parseItem(element, "caption", myClass.m_caption);
-    parseItem(element, "certificate", myClass.m_certificate);
-    parseItem(element, "certificates", myClass.m_certificates);
-    parseItem(element, "checkButton", myClass.m_checkButton);
-    parseItem(element, "choiceList", myClass.m_choiceList);
-    parseItem(element, "color", myClass.m_color);
-    parseItem(element, "comb", myClass.m_comb);
-    parseItem(element, "connect", myClass.m_connect);
-    parseItem(element, "contentArea", myClass.m_contentArea);
-    parseItem(element, "corner", myClass.m_corner);
-    parseItem(element, "date", myClass.m_date);
-    parseItem(element, "dateTime", myClass.m_dateTime);
-    parseItem(element, "dateTimeEdit", myClass.m_dateTimeEdit);
-    parseItem(element, "decimal", myClass.m_decimal);
-    parseItem(element, "defaultUi", myClass.m_defaultUi);
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "digestMethod", myClass.m_digestMethod);
-    parseItem(element, "digestMethods", myClass.m_digestMethods);
-    parseItem(element, "draw", myClass.m_draw);
-    parseItem(element, "edge", myClass.m_edge);
-    parseItem(element, "encoding", myClass.m_encoding);
-    parseItem(element, "encodings", myClass.m_encodings);
-    parseItem(element, "encrypt", myClass.m_encrypt);
-    parseItem(element, "encryptData", myClass.m_encryptData);
-    parseItem(element, "encryption", myClass.m_encryption);
-    parseItem(element, "encryptionMethod", myClass.m_encryptionMethod);
-    parseItem(element, "encryptionMethods", myClass.m_encryptionMethods);
-    parseItem(element, "event", myClass.m_event);
-    parseItem(element, "exData", myClass.m_exData);
-    parseItem(element, "exObject", myClass.m_exObject);
-    parseItem(element, "exclGroup", myClass.m_exclGroup);
-    parseItem(element, "execute", myClass.m_execute);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "field", myClass.m_field);
-    parseItem(element, "fill", myClass.m_fill);
-    parseItem(element, "filter", myClass.m_filter);
-    parseItem(element, "float", myClass.m_float);
-    parseItem(element, "font", myClass.m_font);
-    parseItem(element, "format", myClass.m_format);
-    parseItem(element, "handler", myClass.m_handler);
-    parseItem(element, "hyphenation", myClass.m_hyphenation);
-    parseItem(element, "image", myClass.m_image);
-    parseItem(element, "imageEdit", myClass.m_imageEdit);
-    parseItem(element, "integer", myClass.m_integer);
-    parseItem(element, "issuers", myClass.m_issuers);
-    parseItem(element, "items", myClass.m_items);
-    parseItem(element, "keep", myClass.m_keep);
-    parseItem(element, "keyUsage", myClass.m_keyUsage);
-    parseItem(element, "line", myClass.m_line);
-    parseItem(element, "linear", myClass.m_linear);
-    parseItem(element, "lockDocument", myClass.m_lockDocument);
-    parseItem(element, "manifest", myClass.m_manifest);
-    parseItem(element, "margin", myClass.m_margin);
-    parseItem(element, "mdp", myClass.m_mdp);
-    parseItem(element, "medium", myClass.m_medium);
-    parseItem(element, "message", myClass.m_message);
-    parseItem(element, "numericEdit", myClass.m_numericEdit);
-    parseItem(element, "occur", myClass.m_occur);
-    parseItem(element, "oid", myClass.m_oid);
-    parseItem(element, "oids", myClass.m_oids);
-    parseItem(element, "overflow", myClass.m_overflow);
-    parseItem(element, "pageArea", myClass.m_pageArea);
-    parseItem(element, "pageSet", myClass.m_pageSet);
-    parseItem(element, "para", myClass.m_para);
-    parseItem(element, "passwordEdit", myClass.m_passwordEdit);
-    parseItem(element, "pattern", myClass.m_pattern);
-    parseItem(element, "picture", myClass.m_picture);
-    parseItem(element, "radial", myClass.m_radial);
-    parseItem(element, "reason", myClass.m_reason);
-    parseItem(element, "reasons", myClass.m_reasons);
-    parseItem(element, "rectangle", myClass.m_rectangle);
-    parseItem(element, "ref", myClass.m_ref);
-    parseItem(element, "script", myClass.m_script);
-    parseItem(element, "setProperty", myClass.m_setProperty);
-    parseItem(element, "signData", myClass.m_signData);
-    parseItem(element, "signature", myClass.m_signature);
-    parseItem(element, "signing", myClass.m_signing);
-    parseItem(element, "solid", myClass.m_solid);
-    parseItem(element, "speak", myClass.m_speak);
-    parseItem(element, "stipple", myClass.m_stipple);
-    parseItem(element, "subform", myClass.m_subform);
-    parseItem(element, "subformSet", myClass.m_subformSet);
-    parseItem(element, "subjectDN", myClass.m_subjectDN);
-    parseItem(element, "subjectDNs", myClass.m_subjectDNs);
-    parseItem(element, "submit", myClass.m_submit);
-    parseItem(element, "text", myClass.m_text);
-    parseItem(element, "textEdit", myClass.m_textEdit);
-    parseItem(element, "time", myClass.m_time);
-    parseItem(element, "timeStamp", myClass.m_timeStamp);
-    parseItem(element, "toolTip", myClass.m_toolTip);
-    parseItem(element, "traversal", myClass.m_traversal);
-    parseItem(element, "traverse", myClass.m_traverse);
-    parseItem(element, "ui", myClass.m_ui);
-    parseItem(element, "validate", myClass.m_validate);
-    parseItem(element, "value", myClass.m_value);
-    parseItem(element, "variables", myClass.m_variables);
-    myClass.setOrderFromElement(element);
     return myClass;
 }
 
@@ -9399,7 +10931,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_subform> parse(const QDomElement& element);
+    static std::optional<XFA_subform> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -9462,74 +10994,170 @@ private:
     std::vector<XFA_Node<XFA_subformSet>> m_subformSet;
 };
 
-std::optional<XFA_subform> XFA_subform::parse(const QDomElement& element)
+std::optional<XFA_subform> XFA_subform::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_subform myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "access", myClass.m_access, "open");
-    parseAttribute(element, "allowMacro", myClass.m_allowMacro, "0");
-    parseAttribute(element, "anchorType", myClass.m_anchorType, "topLeft");
-    parseAttribute(element, "colSpan", myClass.m_colSpan, "1");
-    parseAttribute(element, "columnWidths", myClass.m_columnWidths, "");
-    parseAttribute(element, "h", myClass.m_h, "0in");
-    parseAttribute(element, "hAlign", myClass.m_hAlign, "left");
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "layout", myClass.m_layout, "position");
-    parseAttribute(element, "locale", myClass.m_locale, "");
-    parseAttribute(element, "maxH", myClass.m_maxH, "0in");
-    parseAttribute(element, "maxW", myClass.m_maxW, "0in");
-    parseAttribute(element, "mergeMode", myClass.m_mergeMode, "consumeData");
-    parseAttribute(element, "minH", myClass.m_minH, "0in");
-    parseAttribute(element, "minW", myClass.m_minW, "0in");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "presence", myClass.m_presence, "visible");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "restoreState", myClass.m_restoreState, "manual");
-    parseAttribute(element, "scope", myClass.m_scope, "name");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
-    parseAttribute(element, "w", myClass.m_w, "0in");
-    parseAttribute(element, "x", myClass.m_x, "0in");
-    parseAttribute(element, "y", myClass.m_y, "0in");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "access", myClass.m_access, "open");
+    parseAttribute(attributes, "allowMacro", myClass.m_allowMacro, "0");
+    parseAttribute(attributes, "anchorType", myClass.m_anchorType, "topLeft");
+    parseAttribute(attributes, "colSpan", myClass.m_colSpan, "1");
+    parseAttribute(attributes, "columnWidths", myClass.m_columnWidths, "");
+    parseAttribute(attributes, "h", myClass.m_h, "0in");
+    parseAttribute(attributes, "hAlign", myClass.m_hAlign, "left");
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "layout", myClass.m_layout, "position");
+    parseAttribute(attributes, "locale", myClass.m_locale, "");
+    parseAttribute(attributes, "maxH", myClass.m_maxH, "0in");
+    parseAttribute(attributes, "maxW", myClass.m_maxW, "0in");
+    parseAttribute(attributes, "mergeMode", myClass.m_mergeMode, "consumeData");
+    parseAttribute(attributes, "minH", myClass.m_minH, "0in");
+    parseAttribute(attributes, "minW", myClass.m_minW, "0in");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "presence", myClass.m_presence, "visible");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "restoreState", myClass.m_restoreState, "manual");
+    parseAttribute(attributes, "scope", myClass.m_scope, "name");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
+    parseAttribute(attributes, "w", myClass.m_w, "0in");
+    parseAttribute(attributes, "x", myClass.m_x, "0in");
+    parseAttribute(attributes, "y", myClass.m_y, "0in");
 
     // load items
-    parseItem(element, "assist", myClass.m_assist);
-    parseItem(element, "bind", myClass.m_bind);
-    parseItem(element, "bookend", myClass.m_bookend);
-    parseItem(element, "border", myClass.m_border);
-    parseItem(element, "break", myClass.m_break);
-    parseItem(element, "calculate", myClass.m_calculate);
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "keep", myClass.m_keep);
-    parseItem(element, "margin", myClass.m_margin);
-    parseItem(element, "occur", myClass.m_occur);
-    parseItem(element, "overflow", myClass.m_overflow);
-    parseItem(element, "pageSet", myClass.m_pageSet);
-    parseItem(element, "para", myClass.m_para);
-    parseItem(element, "traversal", myClass.m_traversal);
-    parseItem(element, "validate", myClass.m_validate);
-    parseItem(element, "variables", myClass.m_variables);
-    parseItem(element, "area", myClass.m_area);
-    parseItem(element, "breakAfter", myClass.m_breakAfter);
-    parseItem(element, "breakBefore", myClass.m_breakBefore);
-    parseItem(element, "connect", myClass.m_connect);
-    parseItem(element, "draw", myClass.m_draw);
-    parseItem(element, "event", myClass.m_event);
-    parseItem(element, "exObject", myClass.m_exObject);
-    parseItem(element, "exclGroup", myClass.m_exclGroup);
-    parseItem(element, "field", myClass.m_field);
-    parseItem(element, "proto", myClass.m_proto);
-    parseItem(element, "setProperty", myClass.m_setProperty);
-    parseItem(element, "subform", myClass.m_subform);
-    parseItem(element, "subformSet", myClass.m_subformSet);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"assist")
+        {
+            parseItem(reader, myClass.m_assist);
+        }
+        else if (name == u"bind")
+        {
+            parseItem(reader, myClass.m_bind);
+        }
+        else if (name == u"bookend")
+        {
+            parseItem(reader, myClass.m_bookend);
+        }
+        else if (name == u"border")
+        {
+            parseItem(reader, myClass.m_border);
+        }
+        else if (name == u"break")
+        {
+            parseItem(reader, myClass.m_break);
+        }
+        else if (name == u"calculate")
+        {
+            parseItem(reader, myClass.m_calculate);
+        }
+        else if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"keep")
+        {
+            parseItem(reader, myClass.m_keep);
+        }
+        else if (name == u"margin")
+        {
+            parseItem(reader, myClass.m_margin);
+        }
+        else if (name == u"occur")
+        {
+            parseItem(reader, myClass.m_occur);
+        }
+        else if (name == u"overflow")
+        {
+            parseItem(reader, myClass.m_overflow);
+        }
+        else if (name == u"pageSet")
+        {
+            parseItem(reader, myClass.m_pageSet);
+        }
+        else if (name == u"para")
+        {
+            parseItem(reader, myClass.m_para);
+        }
+        else if (name == u"traversal")
+        {
+            parseItem(reader, myClass.m_traversal);
+        }
+        else if (name == u"validate")
+        {
+            parseItem(reader, myClass.m_validate);
+        }
+        else if (name == u"variables")
+        {
+            parseItem(reader, myClass.m_variables);
+        }
+        else if (name == u"area")
+        {
+            parseItem(reader, myClass.m_area);
+        }
+        else if (name == u"breakAfter")
+        {
+            parseItem(reader, myClass.m_breakAfter);
+        }
+        else if (name == u"breakBefore")
+        {
+            parseItem(reader, myClass.m_breakBefore);
+        }
+        else if (name == u"connect")
+        {
+            parseItem(reader, myClass.m_connect);
+        }
+        else if (name == u"draw")
+        {
+            parseItem(reader, myClass.m_draw);
+        }
+        else if (name == u"event")
+        {
+            parseItem(reader, myClass.m_event);
+        }
+        else if (name == u"exObject")
+        {
+            parseItem(reader, myClass.m_exObject);
+        }
+        else if (name == u"exclGroup")
+        {
+            parseItem(reader, myClass.m_exclGroup);
+        }
+        else if (name == u"field")
+        {
+            parseItem(reader, myClass.m_field);
+        }
+        else if (name == u"proto")
+        {
+            parseItem(reader, myClass.m_proto);
+        }
+        else if (name == u"setProperty")
+        {
+            parseItem(reader, myClass.m_setProperty);
+        }
+        else if (name == u"subform")
+        {
+            parseItem(reader, myClass.m_subform);
+        }
+        else if (name == u"subformSet")
+        {
+            parseItem(reader, myClass.m_subformSet);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -9558,7 +11186,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_subformSet> parse(const QDomElement& element);
+    static std::optional<XFA_subformSet> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -9582,35 +11210,71 @@ private:
     std::vector<XFA_Node<XFA_subformSet>> m_subformSet;
 };
 
-std::optional<XFA_subformSet> XFA_subformSet::parse(const QDomElement& element)
+std::optional<XFA_subformSet> XFA_subformSet::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_subformSet myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "id", myClass.m_id, "");
-    parseAttribute(element, "name", myClass.m_name, "");
-    parseAttribute(element, "relation", myClass.m_relation, "ordered");
-    parseAttribute(element, "relevant", myClass.m_relevant, "");
-    parseAttribute(element, "use", myClass.m_use, "");
-    parseAttribute(element, "usehref", myClass.m_usehref, "");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "id", myClass.m_id, "");
+    parseAttribute(attributes, "name", myClass.m_name, "");
+    parseAttribute(attributes, "relation", myClass.m_relation, "ordered");
+    parseAttribute(attributes, "relevant", myClass.m_relevant, "");
+    parseAttribute(attributes, "use", myClass.m_use, "");
+    parseAttribute(attributes, "usehref", myClass.m_usehref, "");
 
     // load items
-    parseItem(element, "bookend", myClass.m_bookend);
-    parseItem(element, "break", myClass.m_break);
-    parseItem(element, "desc", myClass.m_desc);
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "occur", myClass.m_occur);
-    parseItem(element, "overflow", myClass.m_overflow);
-    parseItem(element, "breakAfter", myClass.m_breakAfter);
-    parseItem(element, "breakBefore", myClass.m_breakBefore);
-    parseItem(element, "subform", myClass.m_subform);
-    parseItem(element, "subformSet", myClass.m_subformSet);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"bookend")
+        {
+            parseItem(reader, myClass.m_bookend);
+        }
+        else if (name == u"break")
+        {
+            parseItem(reader, myClass.m_break);
+        }
+        else if (name == u"desc")
+        {
+            parseItem(reader, myClass.m_desc);
+        }
+        else if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"occur")
+        {
+            parseItem(reader, myClass.m_occur);
+        }
+        else if (name == u"overflow")
+        {
+            parseItem(reader, myClass.m_overflow);
+        }
+        else if (name == u"breakAfter")
+        {
+            parseItem(reader, myClass.m_breakAfter);
+        }
+        else if (name == u"breakBefore")
+        {
+            parseItem(reader, myClass.m_breakBefore);
+        }
+        else if (name == u"subform")
+        {
+            parseItem(reader, myClass.m_subform);
+        }
+        else if (name == u"subformSet")
+        {
+            parseItem(reader, myClass.m_subformSet);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -9626,7 +11290,7 @@ public:
 
     virtual void accept(XFA_AbstractVisitor* visitor) const override { visitor->visit(this); }
 
-    static std::optional<XFA_template> parse(const QDomElement& element);
+    static std::optional<XFA_template> parse(QXmlStreamReader& reader);
 
 private:
     /* properties */
@@ -9637,22 +11301,34 @@ private:
     std::vector<XFA_Node<XFA_subform>> m_subform;
 };
 
-std::optional<XFA_template> XFA_template::parse(const QDomElement& element)
+std::optional<XFA_template> XFA_template::parse(QXmlStreamReader& reader)
 {
-    if (element.isNull())
-    {
-        return std::nullopt;
-    }
-
     XFA_template myClass;
+    myClass.setOrderFromReader(reader);
 
     // load attributes
-    parseAttribute(element, "baseProfile", myClass.m_baseProfile, "full");
+    const QXmlStreamAttributes attributes = reader.attributes();
+    parseAttribute(attributes, "baseProfile", myClass.m_baseProfile, "full");
 
     // load items
-    parseItem(element, "extras", myClass.m_extras);
-    parseItem(element, "subform", myClass.m_subform);
-    myClass.setOrderFromElement(element);
+    while (reader.readNextStartElement())
+    {
+        const QStringView name = reader.qualifiedName();
+
+        if (name == u"extras")
+        {
+            parseItem(reader, myClass.m_extras);
+        }
+        else if (name == u"subform")
+        {
+            parseItem(reader, myClass.m_subform);
+        }
+        else
+        {
+            reader.skipCurrentElement();
+        }
+    }
+
     return myClass;
 }
 
@@ -11648,7 +13324,9 @@ void PDFXFAEngineImpl::setDocument(const PDFModifiedDocument& document, PDFForm*
                     const PDFObject& xfaObject = m_document->getObject(form->getXFA());
                     updateResources(m_document->getObject(form->getResources()));
 
-                    std::map<QByteArray, QByteArray> xfaData;
+                    // Jakub Melka: only template packet is used, so we do not
+                    // decode other packets (datasets, config, etc.) at all.
+                    QByteArray templateData;
                     if (xfaObject.isArray())
                     {
                         const PDFArray* xfaArrayData = xfaObject.getArray();
@@ -11659,21 +13337,31 @@ void PDFXFAEngineImpl::setDocument(const PDFModifiedDocument& document, PDFForm*
                             const PDFObject& itemName = m_document->getObject(xfaArrayData->getItem(2 * i + 0));
                             const PDFObject& streamObject = m_document->getObject(xfaArrayData->getItem(2 * i + 1));
 
-                            if (itemName.isString() && streamObject.isStream())
+                            if (itemName.isString() && itemName.getString() == "template" && streamObject.isStream())
                             {
-                                xfaData[itemName.getString()] = m_document->getDecodedStream(streamObject.getStream());
+                                templateData = m_document->getDecodedStream(streamObject.getStream());
                             }
                         }
                     }
                     else if (xfaObject.isStream())
                     {
-                        xfaData["template"] = m_document->getDecodedStream(xfaObject.getStream());
+                        templateData = m_document->getDecodedStream(xfaObject.getStream());
+                    }
+
+                    // Template is parsed directly into the node tree using
+                    // streaming parser, without building DOM tree.
+                    QXmlStreamReader reader(templateData);
+                    reader.setNamespaceProcessing(false);
+
+                    if (reader.readNextStartElement() && reader.qualifiedName() == QLatin1String("template"))
+                    {
+                        m_template = xfa::XFA_template::parse(reader);
                     }
 
-                    QDomDocument templateDocument;
-                    if (templateDocument.setContent(xfaData["template"]))
+                    if (reader.hasError())
                     {
-                        m_template = xfa::XFA_template::parse(templateDocument.firstChildElement("template"));
+                        // Invalid xml data, do not use partially parsed template
+                        m_template = xfa::XFA_Node<xfa::XFA_template>();
                     }
                 }
                 catch (const PDFException&)
@@ -76,6 +76,12 @@ PDFRenderingErrorsWidget::PDFRenderingErrorsWidget(QWidget* parent, PDFWidget* p
                     break;
                 }
 
+                case RenderErrorType::Information:
+                {
+                    typeString = tr("Information");
+                    break;
+                }
+
                 default:
                 {
                     Q_ASSERT(false);
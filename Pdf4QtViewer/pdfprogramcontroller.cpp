@@ -1689,6 +1689,7 @@ void PDFProgramController::onFileChanged(const QString& fileName)
 
             // Try to open a new document
             pdf::PDFDocumentReader reader(m_progress, qMove(queryPassword), true, false);
+            reader.setDecryptStreamsOnDemand(true);
             pdf::PDFDocument document = reader.readFromFile(fileName);
 
             if (reader.getReadingResult() == pdf::PDFDocumentReader::Result::OK)
@@ -1758,6 +1759,7 @@ void PDFProgramController::openDocument(const QString& fileName)
 
         // Try to open a new document
         pdf::PDFDocumentReader reader(m_progress, qMove(queryPassword), true, false);
+        reader.setDecryptStreamsOnDemand(true);
         pdf::PDFDocument document = reader.readFromFile(fileName);
 
         result.errorMessage = reader.getErrorMessage();
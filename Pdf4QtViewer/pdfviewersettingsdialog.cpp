@@ -312,6 +312,7 @@ void PDFViewerSettingsDialog::loadData()
     ui->clipToCropBoxCheckBox->setChecked(m_settings.m_features.testFlag(pdf::PDFRenderer::ClipToCropBox));
     ui->displayTimeCheckBox->setChecked(m_settings.m_features.testFlag(pdf::PDFRenderer::DisplayTimes));
     ui->displayAnnotationsCheckBox->setChecked(m_settings.m_features.testFlag(pdf::PDFRenderer::DisplayAnnotations));
+    ui->profileContentCheckBox->setChecked(m_settings.m_features.testFlag(pdf::PDFRenderer::ProfileContentStream));
 
     // Shading
     ui->preferredMeshResolutionEdit->setValue(m_settings.m_preferredMeshResolutionRatio);
@@ -463,6 +464,10 @@ void PDFViewerSettingsDialog::saveData()
     {
         m_settings.m_features.setFlag(pdf::PDFRenderer::DisplayAnnotations, ui->displayAnnotationsCheckBox->isChecked());
     }
+    else if (sender == ui->profileContentCheckBox)
+    {
+        m_settings.m_features.setFlag(pdf::PDFRenderer::ProfileContentStream, ui->profileContentCheckBox->isChecked());
+    }
     else if (sender == ui->clipToCropBoxCheckBox)
     {
         m_settings.m_features.setFlag(pdf::PDFRenderer::ClipToCropBox, ui->clipToCropBoxCheckBox->isChecked());
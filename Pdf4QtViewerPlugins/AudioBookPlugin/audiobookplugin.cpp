@@ -20,6 +20,7 @@
 #include "pdfwidgettool.h"
 #include "pdfutils.h"
 #include "pdfwidgetutils.h"
+#include "pdfcompiler.h"
 #include "audiobookcreator.h"
 
 #include <QAction>
@@ -259,6 +260,7 @@ void AudioBookPlugin::onCreateTextStreamTriggered()
 
     pdf::PDFDocumentTextFlowFactory factory;
     factory.setCalculateBoundingBoxes(true);
+    factory.setTextLayoutStorage(m_widget->getDrawWidgetProxy()->getTextLayoutCompiler()->getTextLayoutStorage(), m_widget->getDrawWidgetProxy()->getFeatures());
     pdf::PDFDocumentTextFlow textFlow = factory.create(m_document, pdf::PDFDocumentTextFlowFactory::Algorithm::Auto);
 
     m_audioTextStreamEditorModel->beginFlowChange();
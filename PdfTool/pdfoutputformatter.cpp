@@ -634,8 +634,21 @@ QString PDFOutputFormatter::getString() const
     return m_impl->getString();
 }
 
+static thread_local PDFConsoleCapture* s_threadCapture = nullptr;
+
+void PDFConsole::setThreadCapture(PDFConsoleCapture* capture)
+{
+    s_threadCapture = capture;
+}
+
 void PDFConsole::writeText(QString text, QStringConverter::Encoding encoding)
 {
+    if (s_threadCapture)
+    {
+        s_threadCapture->text += text;
+        return;
+    }
+
 #ifdef Q_OS_WIN
     HANDLE outputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
     if (!WriteConsoleW(outputHandle, text.utf16(), text.size(), nullptr, nullptr))
@@ -661,6 +674,13 @@ void PDFConsole::writeError(QString text, QStringConverter::Encoding encoding)
         return;
     }
 
+    if (s_threadCapture)
+    {
+        s_threadCapture->errors += text;
+        s_threadCapture->errors += "\n";
+        return;
+    }
+
     QMutexLocker lock(&s_writeErrorMutex);
 
     text += "\n";
@@ -687,6 +707,12 @@ void PDFConsole::writeData(const QByteArray& data)
 {
     if (!data.isEmpty())
     {
+        if (s_threadCapture)
+        {
+            s_threadCapture->data += data;
+            return;
+        }
+
         QTextStream stream(stdout);
         stream.device()->write(data);
     }
@@ -93,10 +93,27 @@ private:
     PDFOutputFormatterImpl* m_impl;
 };
 
+/// Captured console output of one job. Batch mode processes multiple jobs
+/// in parallel, each job has its own output.
+struct PDFConsoleCapture
+{
+    QString text;
+    QString errors;
+    QByteArray data;
+};
+
 class PDFConsole
 {
 public:
 
+    /// Redirects console output of the calling thread to the \p capture.
+    /// If \p capture is nullptr, output is written to the console again.
+    /// Output written by other threads (for example, by worker threads of
+    /// the parallel execution policy) is not captured, so commands must
+    /// not write to the console from parallel sections.
+    /// \param capture Capture
+    static void setThreadCapture(PDFConsoleCapture* capture);
+
     /// Writes text to the console
     static void writeText(QString text, QStringConverter::Encoding encoding);
 
@@ -310,6 +310,7 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("render-show-page-stat", "Show page rendering statistics."));
         parser->addOption(QCommandLineOption("render-msaa-samples", "MSAA sample count for GPU rendering.", "samples", "4"));
         parser->addOption(QCommandLineOption("render-rasterizers", "Number of rasterizer contexts.", "rasterizers", QString::number(pdf::PDFRasterizerPool::getDefaultRasterizerCount())));
+        parser->addOption(QCommandLineOption("render-trace", "Write Chrome trace event JSON of page content processing to the file (enables profiling).", "file"));
     }
 
     if (optionFlags.testFlag(Optimize))
@@ -318,6 +319,13 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         {
             parser->addOption(QCommandLineOption(info.option, info.description));
         }
+
+        const pdf::PDFOptimizer::ImageSettings defaultImageSettings;
+        parser->addOption(QCommandLineOption("opt-image-dpi", "Target resolution of downsampled color and grayscale images.", "dpi", QString::number(defaultImageSettings.targetResolution)));
+        parser->addOption(QCommandLineOption("opt-image-bitonal-dpi", "Target resolution of downsampled bitonal images.", "dpi", QString::number(defaultImageSettings.bitonalTargetResolution)));
+        parser->addOption(QCommandLineOption("opt-image-threshold", "Downsample only images with resolution above target resolution multiplied by this factor.", "factor", QString::number(defaultImageSettings.resolutionThreshold)));
+        parser->addOption(QCommandLineOption("opt-image-jpeg-quality", "Quality of images recompressed by DCT filter (0-100).", "quality", QString::number(defaultImageSettings.jpegQuality)));
+        parser->addOption(QCommandLineOption("opt-image-memory-limit", "Memory limit for images processed in parallel (in MB).", "limit", QString::number(defaultImageSettings.memoryLimit / (1024 * 1024))));
     }
 
     if (optionFlags.testFlag(CertStore))
@@ -339,6 +347,24 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("enc-owner-password", "Owner password.", "owner password"));
         parser->addOption(QCommandLineOption("enc-permissions", "Document permissions (flags represented as a number).", "permissions"));
     }
+
+    if (optionFlags.testFlag(Batch))
+    {
+        parser->addPositionalArgument("jobs", "Job list file (JSON lines). If omitted, jobs are read from standard input.", "[jobs]");
+        parser->addOption(QCommandLineOption("batch-jobs", "Number of jobs processed in parallel (0 = number of processor cores).", "count", "0"));
+    }
+
+    if (optionFlags.testFlag(BenchmarkSuite))
+    {
+        parser->addPositionalArgument("corpus", "Directory with documents (searched recursively for pdf files).");
+        parser->addOption(QCommandLineOption("bench-output", "Write results (JSON) to the file instead of standard output.", "file"));
+        parser->addOption(QCommandLineOption("bench-baseline", "Compare results with baseline (JSON results of previous run).", "file"));
+        parser->addOption(QCommandLineOption("bench-threshold", "Regression threshold in percents.", "percent", "10"));
+        parser->addOption(QCommandLineOption("bench-no-text-layout", "Skip text layout analysis."));
+        parser->addOption(QCommandLineOption("bench-optimize", "Benchmark document optimization."));
+        parser->addOption(QCommandLineOption("bench-diff", "Benchmark document comparison (document is compared with its copy, where each page is modified)."));
+        parser->addOption(QCommandLineOption("bench-jbig2", "Benchmark decoding of JBIG2 images."));
+    }
 }
 
 PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser) const
@@ -881,6 +907,11 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         }
 
         options.renderShowPageStatistics = parser->isSet("render-show-page-stat");
+        options.renderTraceFile = parser->value("render-trace");
+        if (!options.renderTraceFile.isEmpty())
+        {
+            options.renderFeatures |= pdf::PDFRenderer::ProfileContentStream;
+        }
     }
 
     if (optionFlags.testFlag(Unite))
@@ -903,6 +934,47 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
                 options.optimizeFlags |= info.flag;
             }
         }
+
+        pdf::PDFOptimizer::ImageSettings& imageSettings = options.optimizeImageSettings;
+
+        auto readReal = [parser, &options](const char* option, pdf::PDFReal& value)
+        {
+            bool ok = false;
+            const pdf::PDFReal readValue = parser->value(option).toDouble(&ok);
+            if (ok && readValue > 0.0)
+            {
+                value = readValue;
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid value of option '%1': '%2'.").arg(QString::fromLatin1(option), parser->value(option)), options.outputCodec);
+            }
+        };
+
+        readReal("opt-image-dpi", imageSettings.targetResolution);
+        readReal("opt-image-bitonal-dpi", imageSettings.bitonalTargetResolution);
+        readReal("opt-image-threshold", imageSettings.resolutionThreshold);
+
+        bool ok = false;
+        const int jpegQuality = parser->value("opt-image-jpeg-quality").toInt(&ok);
+        if (ok && jpegQuality >= 0 && jpegQuality <= 100)
+        {
+            imageSettings.jpegQuality = jpegQuality;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid JPEG quality '%1'. Value must be in range 0-100.").arg(parser->value("opt-image-jpeg-quality")), options.outputCodec);
+        }
+
+        const qint64 memoryLimit = parser->value("opt-image-memory-limit").toLongLong(&ok);
+        if (ok && memoryLimit > 0)
+        {
+            imageSettings.memoryLimit = memoryLimit * 1024 * 1024;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid memory limit '%1'.").arg(parser->value("opt-image-memory-limit")), options.outputCodec);
+        }
     }
 
     if (optionFlags.testFlag(CertStore))
@@ -969,6 +1041,44 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.encryptionPermissions = parser->value("enc-permissions").toUInt();
     }
 
+    if (optionFlags.testFlag(Batch))
+    {
+        options.batchJobsFile = positionalArguments.isEmpty() ? QString() : positionalArguments.front();
+
+        bool ok = false;
+        const int parallelJobs = parser->value("batch-jobs").toInt(&ok);
+        if (ok && parallelJobs >= 0)
+        {
+            options.batchParallelJobs = parallelJobs;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid number of parallel jobs '%1'.").arg(parser->value("batch-jobs")), options.outputCodec);
+        }
+    }
+
+    if (optionFlags.testFlag(BenchmarkSuite))
+    {
+        options.benchmarkCorpusDirectory = positionalArguments.isEmpty() ? QString() : positionalArguments.front();
+        options.benchmarkOutputFile = parser->value("bench-output");
+        options.benchmarkBaselineFile = parser->value("bench-baseline");
+        options.benchmarkTextLayout = !parser->isSet("bench-no-text-layout");
+        options.benchmarkOptimize = parser->isSet("bench-optimize");
+        options.benchmarkDiff = parser->isSet("bench-diff");
+        options.benchmarkJBIG2 = parser->isSet("bench-jbig2");
+
+        bool ok = false;
+        const pdf::PDFReal threshold = parser->value("bench-threshold").toDouble(&ok);
+        if (ok && threshold >= 0.0)
+        {
+            options.benchmarkRegressionThreshold = threshold;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid regression threshold '%1'. Defaulting to %2 %.").arg(parser->value("bench-threshold")).arg(options.benchmarkRegressionThreshold), options.outputCodec);
+        }
+    }
+
     return options;
 }
 
@@ -1172,7 +1282,8 @@ std::vector<PDFToolOptions::RenderFeatureInfo> PDFToolOptions::getRenderFeatures
         RenderFeatureInfo{ "render-high-contrast", "Color conversion: high contrast colors", pdf::PDFRenderer::ColorAdjust_HighContrast },
         RenderFeatureInfo{ "render-bitonal", "Color conversion: bitonal page image", pdf::PDFRenderer::ColorAdjust_Bitonal },
         RenderFeatureInfo{ "render-custom-colors", "Color conversion: custom colors", pdf::PDFRenderer::ColorAdjust_CustomColors },
-        RenderFeatureInfo{ "render-display-annot", "Display annotations.", pdf::PDFRenderer::DisplayAnnotations }
+        RenderFeatureInfo{ "render-display-annot", "Display annotations.", pdf::PDFRenderer::DisplayAnnotations },
+        RenderFeatureInfo{ "render-profile", "Profile content stream processing (results are reported as information messages).", pdf::PDFRenderer::ProfileContentStream }
     };
 }
 
@@ -1185,7 +1296,8 @@ std::vector<PDFToolOptions::OptimizeFeatureInfo> PDFToolOptions::getOptimizeFlag
         OptimizeFeatureInfo{ "opt-merge-identical", "Merge identical objects.", pdf::PDFOptimizer::MergeIdenticalObjects },
         OptimizeFeatureInfo{ "opt-shrink-storage", "Shrink object storage by renumbering objects.", pdf::PDFOptimizer::ShrinkObjectStorage },
         OptimizeFeatureInfo{ "opt-recompress-flate", "Recompress flate streams with maximal compression.", pdf::PDFOptimizer::RecompressFlateStreams },
-        OptimizeFeatureInfo{ "opt-all", "Use all optimization algorithms.", pdf::PDFOptimizer::All }
+        OptimizeFeatureInfo{ "opt-all", "Use all lossless optimization algorithms.", pdf::PDFOptimizer::All },
+        OptimizeFeatureInfo{ "opt-recompress-images", "Downsample images above target resolution and recompress them (lossy).", pdf::PDFOptimizer::RecompressImages }
     };
 }
 
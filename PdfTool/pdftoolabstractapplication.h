@@ -139,6 +139,7 @@ struct PDFToolOptions
     bool renderShowPageStatistics = false;
     int renderMSAAsamples = 4;
     int renderRasterizerCount = pdf::PDFRasterizerPool::getDefaultRasterizerCount();
+    QString renderTraceFile;
 
     // For option 'Separate'
     QString separatePagePattern;
@@ -151,6 +152,7 @@ struct PDFToolOptions
 
     // For option 'Optimize'
     pdf::PDFOptimizer::OptimizationFlags optimizeFlags = pdf::PDFOptimizer::None;
+    pdf::PDFOptimizer::ImageSettings optimizeImageSettings;
 
     // For option 'CertStore'
     bool certStoreEnumerateSystemCertificates = false;
@@ -166,6 +168,20 @@ struct PDFToolOptions
     QString encryptionOwnerPassword;
     uint32_t encryptionPermissions = 0;
 
+    // For option 'Batch'
+    QString batchJobsFile;
+    int batchParallelJobs = 0;
+
+    // For option 'BenchmarkSuite'
+    QString benchmarkCorpusDirectory;
+    QString benchmarkOutputFile;
+    QString benchmarkBaselineFile;
+    pdf::PDFReal benchmarkRegressionThreshold = 10.0;
+    bool benchmarkTextLayout = true;
+    bool benchmarkOptimize = false;
+    bool benchmarkDiff = false;
+    bool benchmarkJBIG2 = false;
+
     /// Returns page range. If page range is invalid, then \p errorMessage is empty.
     /// \param pageCount Page count
     /// \param[out] errorMessage Error message
@@ -215,7 +231,8 @@ public:
         ErrorNoText,
         ErrorCOM,
         ErrorSAPI,
-        ErrorEncryptionSettings
+        ErrorEncryptionSettings,
+        ErrorBenchmarkRegression
     };
 
     enum StandardString
@@ -252,6 +269,8 @@ public:
         CertStoreInstall                = 0x00400000,       ///< Settings for certificate store install certificate tool
         Encrypt                         = 0x00800000,       ///< Encryption settings
         Diff                            = 0x01000000,       ///< Diff settings (compare documents)
+        Batch                           = 0x02000000,       ///< Settings for batch processing of jobs
+        BenchmarkSuite                  = 0x04000000,       ///< Settings for benchmark suite
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -259,6 +278,11 @@ public:
     virtual int execute(const PDFToolOptions& options) = 0;
     virtual Options getOptionsFlags() const = 0;
 
+    /// Returns true, if application can execute multiple jobs in parallel
+    /// (i.e. it doesn't modify its own state during execution). Jobs of
+    /// non-reentrant applications are serialized in batch mode.
+    virtual bool isReentrant() const { return true; }
+
     void initializeCommandLineParser(QCommandLineParser* parser) const;
     PDFToolOptions getOptions(QCommandLineParser* parser) const;
 
@@ -0,0 +1,239 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolbatch.h"
+#include "pdfexception.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QThreadPool>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+#include <QCommandLineParser>
+
+#include <map>
+#include <atomic>
+#include <memory>
+#include <cstdio>
+
+namespace pdftool
+{
+
+static PDFToolBatchApplication s_batchApplication;
+
+QString PDFToolBatchApplication::getStandardString(StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "batch";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Batch");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Process multiple jobs in a single process. Jobs are read as JSON lines, results are written as JSON lines.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolBatchApplication::execute(const PDFToolOptions& options)
+{
+    QFile file;
+    bool isOpened = false;
+    if (options.batchJobsFile.isEmpty())
+    {
+        isOpened = file.open(stdin, QFile::ReadOnly);
+    }
+    else
+    {
+        file.setFileName(options.batchJobsFile);
+        isOpened = file.open(QFile::ReadOnly);
+    }
+
+    if (!isOpened)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open job list '%1'. %2").arg(options.batchJobsFile, file.errorString()), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    struct Job
+    {
+        QString id;
+        QString command;
+        QStringList arguments;
+        QString error;
+    };
+
+    // Applications, which are not reentrant, must process their jobs one by one
+    std::map<const PDFToolAbstractApplication*, std::unique_ptr<QMutex>> applicationMutexes;
+    for (const PDFToolAbstractApplication* application : PDFToolApplicationStorage::getApplications())
+    {
+        if (!application->isReentrant())
+        {
+            applicationMutexes[application] = std::make_unique<QMutex>();
+        }
+    }
+
+    QMutex outputMutex;
+    std::atomic<int> failedJobCount = 0;
+
+    auto processJob = [this, &applicationMutexes, &outputMutex, &failedJobCount](const Job& job)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        PDFConsoleCapture capture;
+        PDFConsole::setThreadCapture(&capture);
+
+        int exitCode = ExitSuccess;
+        PDFToolAbstractApplication* application = PDFToolApplicationStorage::getApplicationByCommand(job.command);
+
+        if (!job.error.isEmpty())
+        {
+            capture.errors = job.error;
+            exitCode = ErrorInvalidArguments;
+        }
+        else if (!application || application == this)
+        {
+            capture.errors = PDFToolTranslationContext::tr("Unknown command '%1'.").arg(job.command);
+            exitCode = ErrorInvalidArguments;
+        }
+        else
+        {
+            QCommandLineParser parser;
+            application->initializeCommandLineParser(&parser);
+
+            if (parser.parse(QStringList(QCoreApplication::applicationFilePath()) + job.arguments))
+            {
+                PDFToolOptions jobOptions = application->getOptions(&parser);
+
+                auto it = applicationMutexes.find(application);
+                QMutexLocker lock(it != applicationMutexes.cend() ? it->second.get() : nullptr);
+
+                try
+                {
+                    exitCode = application->execute(jobOptions);
+                }
+                catch (const pdf::PDFException& exception)
+                {
+                    PDFConsole::writeError(exception.getMessage(), jobOptions.outputCodec);
+                    exitCode = ErrorUnknown;
+                }
+            }
+            else
+            {
+                capture.errors = parser.errorText();
+                exitCode = ErrorInvalidArguments;
+            }
+        }
+
+        PDFConsole::setThreadCapture(nullptr);
+
+        if (exitCode != ExitSuccess)
+        {
+            ++failedJobCount;
+        }
+
+        QJsonObject result;
+        result["id"] = job.id;
+        result["command"] = job.command;
+        result["exitCode"] = exitCode;
+        result["time"] = timer.elapsed();
+        result["output"] = capture.text;
+        result["errors"] = capture.errors;
+        if (!capture.data.isEmpty())
+        {
+            result["data"] = QString::fromLatin1(capture.data.toBase64());
+        }
+
+        QByteArray resultData = QJsonDocument(result).toJson(QJsonDocument::Compact);
+        resultData.append('\n');
+
+        QMutexLocker lock(&outputMutex);
+        PDFConsole::writeData(resultData);
+        std::fflush(stdout);
+    };
+
+    QThreadPool threadPool;
+    if (options.batchParallelJobs > 0)
+    {
+        threadPool.setMaxThreadCount(options.batchParallelJobs);
+    }
+
+    // Jakub Melka: jobs are dispatched as they are read, so the list can also be
+    // streamed through standard input by a long running producer.
+    int lineNumber = 0;
+    for (QByteArray line = file.readLine(); !line.isEmpty(); line = file.readLine())
+    {
+        ++lineNumber;
+
+        line = line.trimmed();
+        if (line.isEmpty())
+        {
+            continue;
+        }
+
+        Job job;
+        job.id = QString::number(lineNumber);
+
+        QJsonParseError parseError;
+        QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+        if (parseError.error == QJsonParseError::NoError && document.isObject())
+        {
+            QJsonObject jobObject = document.object();
+            QJsonValue idValue = jobObject.value("id");
+            if (idValue.isString())
+            {
+                job.id = idValue.toString();
+            }
+            else if (idValue.isDouble())
+            {
+                job.id = QString::number(idValue.toDouble());
+            }
+
+            job.command = jobObject.value("command").toString();
+            for (const QJsonValue& argument : jobObject.value("arguments").toArray())
+            {
+                job.arguments << argument.toString();
+            }
+        }
+        else
+        {
+            job.error = PDFToolTranslationContext::tr("Invalid job on line %1. %2").arg(lineNumber).arg(parseError.error != QJsonParseError::NoError ? parseError.errorString() : PDFToolTranslationContext::tr("Job must be a JSON object."));
+        }
+
+        threadPool.start([job, &processJob]() { processJob(job); });
+    }
+
+    threadPool.waitForDone();
+    return failedJobCount > 0 ? ExitFailure : ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolBatchApplication::getOptionsFlags() const
+{
+    return Batch;
+}
+
+}   // namespace pdftool
@@ -0,0 +1,42 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTOOLBATCH_H
+#define PDFTOOLBATCH_H
+
+#include "pdftoolabstractapplication.h"
+
+namespace pdftool
+{
+
+/// Batch application, which processes multiple jobs in a single process. Jobs
+/// are read as JSON lines (from file or standard input), each job specifies
+/// command and its arguments, for example:
+///     {"id": "1", "command": "info", "arguments": ["file.pdf", "--console-format", "xml"]}
+/// Jobs are processed in parallel, result of each job is written as a single
+/// JSON line (containing job id, exit code and captured output) when the job finishes.
+class PDFToolBatchApplication : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLBATCH_H
@@ -0,0 +1,655 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolbenchmarksuite.h"
+#include "pdfdocumentreader.h"
+#include "pdfconstants.h"
+#include "pdffont.h"
+#include "pdfdiff.h"
+#include "pdftextlayoutgenerator.h"
+#include "pdfpainter.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfjbig2decoder.h"
+
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QColorSpace>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QPainter>
+
+#include <cmath>
+#include <atomic>
+#include <numeric>
+#include <optional>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace pdftool
+{
+
+static PDFToolBenchmarkSuite s_toolBenchmarkSuiteApplication;
+
+/// Resource usage of the whole process
+struct PDFProcessResourceUsage
+{
+    pdf::PDFReal cpuTime = 0.0; ///< Processor time (user + kernel) in milliseconds
+    qint64 peakMemory = 0;      ///< Peak resident set size in bytes
+};
+
+static PDFProcessResourceUsage getProcessResourceUsage()
+{
+    PDFProcessResourceUsage usage;
+
+#ifdef Q_OS_WIN
+    FILETIME creationTime = { };
+    FILETIME exitTime = { };
+    FILETIME kernelTime = { };
+    FILETIME userTime = { };
+    if (GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        auto toMilliseconds = [](const FILETIME& time)
+        {
+            ULARGE_INTEGER value;
+            value.LowPart = time.dwLowDateTime;
+            value.HighPart = time.dwHighDateTime;
+            return pdf::PDFReal(value.QuadPart) / 10000.0;
+        };
+        usage.cpuTime = toMilliseconds(kernelTime) + toMilliseconds(userTime);
+    }
+
+    PROCESS_MEMORY_COUNTERS counters = { };
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        usage.peakMemory = counters.PeakWorkingSetSize;
+    }
+#else
+    rusage resourceUsage = { };
+    if (getrusage(RUSAGE_SELF, &resourceUsage) == 0)
+    {
+        auto toMilliseconds = [](const timeval& time) { return pdf::PDFReal(time.tv_sec) * 1000.0 + pdf::PDFReal(time.tv_usec) / 1000.0; };
+        usage.cpuTime = toMilliseconds(resourceUsage.ru_utime) + toMilliseconds(resourceUsage.ru_stime);
+#ifdef Q_OS_MACOS
+        usage.peakMemory = resourceUsage.ru_maxrss;
+#else
+        usage.peakMemory = qint64(resourceUsage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+
+    return usage;
+}
+
+static pdf::PDFReal getElapsedMilliseconds(const QElapsedTimer& timer)
+{
+    return pdf::PDFReal(timer.nsecsElapsed()) / 1000000.0;
+}
+
+/// Returns statistics (count, total, mean, maximum and percentiles) of
+/// measured times in milliseconds. Percentiles use nearest-rank method.
+static QJsonObject getStageStatistics(std::vector<pdf::PDFReal> values)
+{
+    QJsonObject statistics;
+    statistics["count"] = qint64(values.size());
+
+    if (values.empty())
+    {
+        return statistics;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    auto getPercentile = [&values](pdf::PDFReal percentile)
+    {
+        const size_t rank = size_t(std::ceil(percentile / 100.0 * values.size()));
+        return values[qBound<size_t>(1, rank, values.size()) - 1];
+    };
+
+    const pdf::PDFReal total = std::accumulate(values.cbegin(), values.cend(), 0.0);
+    statistics["total"] = total;
+    statistics["mean"] = total / values.size();
+    statistics["p50"] = getPercentile(50.0);
+    statistics["p90"] = getPercentile(90.0);
+    statistics["p95"] = getPercentile(95.0);
+    statistics["p99"] = getPercentile(99.0);
+    statistics["max"] = values.back();
+    return statistics;
+}
+
+/// Compares results with baseline, returns list of detected regressions.
+static QJsonArray getRegressions(const QJsonObject& results, const QJsonObject& baseline, pdf::PDFReal threshold)
+{
+    // Jakub Melka: very short stages are dominated by noise, so we require
+    // also an absolute difference to report a regression.
+    constexpr pdf::PDFReal MINIMAL_TIME_DIFFERENCE = 1.0;
+    constexpr pdf::PDFReal MINIMAL_MEMORY_DIFFERENCE = 1024.0 * 1024.0;
+
+    QJsonArray regressions;
+    const pdf::PDFReal factor = 1.0 + threshold / 100.0;
+
+    auto check = [&regressions, factor](const QString& name, pdf::PDFReal baselineValue, pdf::PDFReal value, pdf::PDFReal minimalDifference)
+    {
+        if (value > baselineValue * factor && value - baselineValue > minimalDifference)
+        {
+            QJsonObject regression;
+            regression["metric"] = name;
+            regression["baseline"] = baselineValue;
+            regression["value"] = value;
+            regression["change"] = baselineValue > 0.0 ? (value / baselineValue - 1.0) * 100.0 : 100.0;
+            regressions.append(regression);
+        }
+    };
+
+    const QJsonObject stages = results["stages"].toObject();
+    const QJsonObject baselineStages = baseline["stages"].toObject();
+    for (auto it = stages.constBegin(); it != stages.constEnd(); ++it)
+    {
+        if (!baselineStages.contains(it.key()))
+        {
+            continue;
+        }
+
+        const QJsonObject stage = it.value().toObject();
+        const QJsonObject baselineStage = baselineStages[it.key()].toObject();
+        for (const char* metric : { "mean", "p50", "p90", "p99" })
+        {
+            if (stage.contains(metric) && baselineStage.contains(metric))
+            {
+                check(QString("%1.%2").arg(it.key(), QString::fromLatin1(metric)), baselineStage[metric].toDouble(), stage[metric].toDouble(), MINIMAL_TIME_DIFFERENCE);
+            }
+        }
+    }
+
+    if (baseline.contains("peakMemory"))
+    {
+        check("peakMemory", baseline["peakMemory"].toDouble(), results["peakMemory"].toDouble(), MINIMAL_MEMORY_DIFFERENCE);
+    }
+
+    return regressions;
+}
+
+QString PDFToolBenchmarkSuite::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "benchmark-suite";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Benchmark suite");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Benchmark loading, rendering and text layout of documents in a corpus directory, write results as JSON and compare them with a baseline.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+PDFToolAbstractApplication::Options PDFToolBenchmarkSuite::getOptionsFlags() const
+{
+    return BenchmarkSuite | ImageExportSettingsResolution | ColorManagementSystem | RenderFlags;
+}
+
+int PDFToolBenchmarkSuite::execute(const PDFToolOptions& options)
+{
+    QString errorMessage;
+    if (!options.imageExportSettings.validate(&errorMessage, false, false, true))
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QDir corpusDirectory(options.benchmarkCorpusDirectory);
+    if (options.benchmarkCorpusDirectory.isEmpty() || !corpusDirectory.exists())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Corpus directory '%1' doesn't exist.").arg(options.benchmarkCorpusDirectory), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QJsonObject baseline;
+    if (!options.benchmarkBaselineFile.isEmpty())
+    {
+        QFile baselineFile(options.benchmarkBaselineFile);
+        if (!baselineFile.open(QFile::ReadOnly))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open baseline file '%1'. %2").arg(options.benchmarkBaselineFile, baselineFile.errorString()), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+
+        QJsonParseError parseError;
+        baseline = QJsonDocument::fromJson(baselineFile.readAll(), &parseError).object();
+        if (parseError.error != QJsonParseError::NoError)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid baseline file '%1'. %2").arg(options.benchmarkBaselineFile, parseError.errorString()), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+    }
+
+    // Sort documents, so the order of processing is reproducible
+    QStringList fileNames;
+    QDirIterator iterator(corpusDirectory.absolutePath(), QStringList() << "*.pdf", QDir::Files, QDirIterator::Subdirectories);
+    while (iterator.hasNext())
+    {
+        fileNames << iterator.next();
+    }
+    fileNames.sort();
+
+    std::vector<pdf::PDFReal> loadTimes;
+    std::vector<pdf::PDFReal> compileTimes;
+    std::vector<pdf::PDFReal> waitTimes;
+    std::vector<pdf::PDFReal> rasterizeTimes;
+    std::vector<pdf::PDFReal> pageTimes;
+    std::vector<pdf::PDFReal> textLayoutTimes;
+    std::vector<pdf::PDFReal> pageTextLayoutTimes;
+    std::vector<pdf::PDFReal> pageCompileTextLayoutTimes;
+    std::vector<pdf::PDFReal> optimizeTimes;
+    std::vector<pdf::PDFReal> diffTimes;
+    std::vector<pdf::PDFReal> jbig2DecodeTimes;
+    QJsonArray documentResults;
+    qint64 totalPageCount = 0;
+    int failedDocumentCount = 0;
+
+    QSurfaceFormat surfaceFormat;
+    if (options.renderUseHardwareRendering)
+    {
+        surfaceFormat = QSurfaceFormat::defaultFormat();
+        surfaceFormat.setProfile(QSurfaceFormat::CoreProfile);
+        surfaceFormat.setSamples(options.renderMSAAsamples);
+        surfaceFormat.setColorSpace(QColorSpace(QColorSpace::SRgb));
+        surfaceFormat.setSwapBehavior(QSurfaceFormat::DefaultSwapBehavior);
+    }
+
+    const PDFProcessResourceUsage startUsage = getProcessResourceUsage();
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    for (const QString& fileName : fileNames)
+    {
+        QJsonObject documentResult;
+        documentResult["file"] = corpusDirectory.relativeFilePath(fileName);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, true, false);
+        pdf::PDFDocument document = reader.readFromFile(fileName);
+
+        const pdf::PDFReal loadTime = getElapsedMilliseconds(timer);
+        documentResult["load"] = loadTime;
+
+        if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+        {
+            ++failedDocumentCount;
+            documentResult["error"] = reader.getErrorMessage();
+            documentResults.append(documentResult);
+            continue;
+        }
+
+        loadTimes.push_back(loadTime);
+
+        const size_t pageCount = document.getCatalog()->getPageCount();
+        totalPageCount += pageCount;
+        documentResult["pages"] = qint64(pageCount);
+
+        std::vector<pdf::PDFInteger> pageIndices(pageCount, 0);
+        std::iota(pageIndices.begin(), pageIndices.end(), 0);
+
+        // Compile and rasterize pages
+        {
+            pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+            pdf::PDFCMSManager cmsManager(nullptr);
+            cmsManager.setDocument(&document);
+            cmsManager.setSettings(options.cmsSettings);
+            pdf::PDFMeshQualitySettings meshQualitySettings;
+            pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+            pdf::PDFModifiedDocument md(&document, &optionalContentActivity);
+            fontCache.setDocument(md);
+            fontCache.setCacheShrinkEnabled(nullptr, false);
+
+            pdf::PDFRasterizerPool rasterizerPool(&document, &fontCache, &cmsManager,
+                                                  &optionalContentActivity, options.renderFeatures, meshQualitySettings,
+                                                  pdf::PDFRasterizerPool::getCorrectedRasterizerCount(options.renderRasterizerCount),
+                                                  options.renderUseHardwareRendering, surfaceFormat, nullptr);
+
+            std::atomic<int> renderErrorCount = 0;
+            QObject holder;
+            QObject::connect(&rasterizerPool, &pdf::PDFRasterizerPool::renderError, &holder, [&renderErrorCount](pdf::PDFInteger, pdf::PDFRenderError) { ++renderErrorCount; }, Qt::DirectConnection);
+
+            auto imageSizeGetter = [&options](const pdf::PDFPage* page) -> QSize
+            {
+                Q_ASSERT(page);
+
+                if (options.imageExportSettings.getResolutionMode() == pdf::PDFPageImageExportSettings::ResolutionMode::Pixels)
+                {
+                    const int pixelResolution = options.imageExportSettings.getPixelResolution();
+                    return page->getRotatedMediaBox().size().scaled(pixelResolution, pixelResolution, Qt::KeepAspectRatio).toSize();
+                }
+
+                return (page->getRotatedMediaBox().size() * pdf::PDF_POINT_TO_INCH * options.imageExportSettings.getDpiResolution()).toSize();
+            };
+
+            std::vector<pdf::PDFRenderedPageImage> pageInfos(pageCount);
+            auto onPageRendered = [&pageInfos](pdf::PDFRenderedPageImage& renderedPageImage)
+            {
+                pdf::PDFRenderedPageImage& info = pageInfos[renderedPageImage.pageIndex];
+                info.pageIndex = renderedPageImage.pageIndex;
+                info.pageCompileTime = renderedPageImage.pageCompileTime;
+                info.pageWaitTime = renderedPageImage.pageWaitTime;
+                info.pageRenderTime = renderedPageImage.pageRenderTime;
+                info.pageTotalTime = renderedPageImage.pageTotalTime;
+            };
+
+            timer.restart();
+            rasterizerPool.render(pageIndices, imageSizeGetter, onPageRendered, nullptr);
+            documentResult["render"] = getElapsedMilliseconds(timer);
+            documentResult["renderErrors"] = renderErrorCount.load();
+
+            for (const pdf::PDFRenderedPageImage& info : pageInfos)
+            {
+                compileTimes.push_back(info.pageCompileTime);
+                waitTimes.push_back(info.pageWaitTime);
+                rasterizeTimes.push_back(info.pageRenderTime);
+                pageTimes.push_back(info.pageTotalTime);
+            }
+
+            fontCache.setCacheShrinkEnabled(nullptr, true);
+        }
+
+        if (options.benchmarkTextLayout)
+        {
+            timer.restart();
+            pdf::PDFDocumentTextFlowFactory factory;
+            factory.create(&document, pageIndices, pdf::PDFDocumentTextFlowFactory::Algorithm::Layout);
+            const pdf::PDFReal textLayoutTime = getElapsedMilliseconds(timer);
+            textLayoutTimes.push_back(textLayoutTime);
+            documentResult["textLayout"] = textLayoutTime;
+
+            // Jakub Melka: measure layout analysis of each page alone (without
+            // content stream processing), so dense pages can be identified.
+            pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+            pdf::PDFCMSGeneric cms;
+            pdf::PDFMeshQualitySettings meshQualitySettings;
+            pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+            pdf::PDFModifiedDocument md(&document, &optionalContentActivity);
+            fontCache.setDocument(md);
+            fontCache.setCacheShrinkEnabled(nullptr, false);
+
+            pdf::PDFReal maximalPageTextLayoutTime = 0.0;
+            for (const pdf::PDFInteger pageIndex : pageIndices)
+            {
+                const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
+                if (!page)
+                {
+                    continue;
+                }
+
+                pdf::PDFTextLayoutGenerator generator(pdf::PDFRenderer::IgnoreOptionalContent, page, &document, &fontCache, &cms, &optionalContentActivity, QTransform(), meshQualitySettings);
+                generator.processContents();
+
+                timer.restart();
+                generator.createTextLayout();
+                const pdf::PDFReal pageTextLayoutTime = getElapsedMilliseconds(timer);
+                pageTextLayoutTimes.push_back(pageTextLayoutTime);
+                maximalPageTextLayoutTime = qMax(maximalPageTextLayoutTime, pageTextLayoutTime);
+            }
+
+            // Page compilation together with text layout (single content stream pass)
+            pdf::PDFRenderer renderer(&document, &fontCache, &cms, &optionalContentActivity, pdf::PDFRenderer::IgnoreOptionalContent, meshQualitySettings);
+            for (const pdf::PDFInteger pageIndex : pageIndices)
+            {
+                timer.restart();
+                pdf::PDFPrecompiledPage precompiledPage;
+                pdf::PDFTextLayout textLayout;
+                renderer.compile(&precompiledPage, pageIndex, &textLayout);
+                pageCompileTextLayoutTimes.push_back(getElapsedMilliseconds(timer));
+            }
+
+            fontCache.setCacheShrinkEnabled(nullptr, true);
+            documentResult["pageTextLayoutMax"] = maximalPageTextLayoutTime;
+        }
+
+        if (options.benchmarkOptimize)
+        {
+            timer.restart();
+            pdf::PDFOptimizer optimizer(pdf::PDFOptimizer::All, nullptr);
+            optimizer.setDocument(&document);
+            optimizer.optimize();
+            optimizer.takeOptimizedDocument();
+            const pdf::PDFReal optimizeTime = getElapsedMilliseconds(timer);
+            optimizeTimes.push_back(optimizeTime);
+            documentResult["optimize"] = optimizeTime;
+        }
+
+        if (options.benchmarkJBIG2)
+        {
+            // Each JBIG2 image stream of the document is decoded separately
+            pdf::PDFRenderErrorReporterDummy errorReporter;
+            int jbig2ImageCount = 0;
+            int jbig2ErrorCount = 0;
+
+            const pdf::PDFObjectStorage::PDFObjects& entries = document.getStorage().getObjects();
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                const pdf::PDFObject& object = entries[i].object;
+                if (!object.isStream())
+                {
+                    continue;
+                }
+
+                const pdf::PDFStream* stream = object.getStream();
+                const pdf::PDFDictionary* dictionary = stream->getDictionary();
+
+                // Image filter is the last filter of the stream
+                pdf::PDFObject filter = document.getObject(dictionary->get(pdf::PDF_STREAM_DICT_FILTER));
+                pdf::PDFObject filterParameters = document.getObject(dictionary->get(pdf::PDF_STREAM_DICT_DECODE_PARMS));
+                if (filter.isArray() && filter.getArray()->getCount() > 0)
+                {
+                    filter = document.getObject(filter.getArray()->getItem(filter.getArray()->getCount() - 1));
+                }
+                if (filterParameters.isArray() && filterParameters.getArray()->getCount() > 0)
+                {
+                    filterParameters = document.getObject(filterParameters.getArray()->getItem(filterParameters.getArray()->getCount() - 1));
+                }
+
+                if (!filter.isName() || filter.getString() != "JBIG2Decode")
+                {
+                    continue;
+                }
+
+                ++jbig2ImageCount;
+                timer.restart();
+
+                try
+                {
+                    QByteArray data = document.getDecodedStream(stream);
+                    QByteArray globalData;
+                    if (const pdf::PDFDictionary* filterParametersDictionary = document.getDictionaryFromObject(filterParameters))
+                    {
+                        const pdf::PDFObject& globalDataObject = document.getObject(filterParametersDictionary->get("JBIG2Globals"));
+                        if (globalDataObject.isStream())
+                        {
+                            globalData = document.getDecodedStream(globalDataObject.getStream());
+                        }
+                    }
+
+                    pdf::PDFJBIG2Decoder decoder(qMove(data), qMove(globalData), &errorReporter);
+                    if (!decoder.decode(pdf::PDFImageData::MaskingType::None).isValid())
+                    {
+                        ++jbig2ErrorCount;
+                    }
+                }
+                catch (const pdf::PDFException&)
+                {
+                    ++jbig2ErrorCount;
+                }
+
+                jbig2DecodeTimes.push_back(getElapsedMilliseconds(timer));
+            }
+
+            documentResult["jbig2Images"] = jbig2ImageCount;
+            documentResult["jbig2Errors"] = jbig2ErrorCount;
+        }
+
+        std::optional<pdf::PDFDocument> modifiedDocument;
+        if (options.benchmarkDiff && pageCount > 0)
+        {
+            // Document is compared with its modified copy, where small rectangle is
+            // painted on each page. So no page has the same fingerprint as a page
+            // in the other document, and content of all pages is extracted, pages
+            // are matched and compared.
+            try
+            {
+                pdf::PDFDocumentBuilder builder(&document);
+                for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+                {
+                    const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
+                    if (!page)
+                    {
+                        continue;
+                    }
+
+                    pdf::PDFPageContentStreamBuilder pageContentStreamBuilder(&builder,
+                                                                              pdf::PDFContentStreamBuilder::CoordinateSystem::PDF,
+                                                                              pdf::PDFPageContentStreamBuilder::Mode::PlaceAfter);
+                    QPainter* painter = pageContentStreamBuilder.begin(page->getPageReference());
+                    if (painter)
+                    {
+                        painter->fillRect(QRectF(page->getMediaBox().topLeft(), QSizeF(10.0, 10.0)), Qt::red);
+                        pageContentStreamBuilder.end(painter);
+                    }
+                }
+                modifiedDocument = builder.build();
+            }
+            catch (const pdf::PDFException&)
+            {
+                // Document can't be modified, diff is not benchmarked
+                modifiedDocument.reset();
+            }
+        }
+
+        if (modifiedDocument)
+        {
+            pdf::PDFClosedIntervalSet pages;
+            pages.addInterval(0, pageCount - 1);
+
+            timer.restart();
+            pdf::PDFDiff diff(nullptr);
+            diff.setOption(pdf::PDFDiff::Asynchronous, false);
+            diff.setLeftDocument(&document);
+            diff.setRightDocument(&modifiedDocument.value());
+            diff.setPagesForLeftDocument(pages);
+            diff.setPagesForRightDocument(pages);
+            diff.start();
+            const pdf::PDFReal diffTime = getElapsedMilliseconds(timer);
+            diffTimes.push_back(diffTime);
+            documentResult["diff"] = diffTime;
+        }
+
+        documentResults.append(documentResult);
+    }
+
+    const pdf::PDFReal wallTime = getElapsedMilliseconds(wallTimer);
+    const PDFProcessResourceUsage endUsage = getProcessResourceUsage();
+    const pdf::PDFReal cpuTime = endUsage.cpuTime - startUsage.cpuTime;
+    const int threadCount = QThread::idealThreadCount();
+
+    QJsonObject stages;
+    stages["load"] = getStageStatistics(qMove(loadTimes));
+    stages["compile"] = getStageStatistics(qMove(compileTimes));
+    stages["wait"] = getStageStatistics(qMove(waitTimes));
+    stages["rasterize"] = getStageStatistics(qMove(rasterizeTimes));
+    stages["page"] = getStageStatistics(qMove(pageTimes));
+    if (options.benchmarkTextLayout)
+    {
+        stages["textLayout"] = getStageStatistics(qMove(textLayoutTimes));
+        stages["pageTextLayout"] = getStageStatistics(qMove(pageTextLayoutTimes));
+        stages["pageCompileTextLayout"] = getStageStatistics(qMove(pageCompileTextLayoutTimes));
+    }
+    if (options.benchmarkOptimize)
+    {
+        stages["optimize"] = getStageStatistics(qMove(optimizeTimes));
+    }
+    if (options.benchmarkDiff)
+    {
+        stages["diff"] = getStageStatistics(qMove(diffTimes));
+    }
+    if (options.benchmarkJBIG2)
+    {
+        stages["jbig2Decode"] = getStageStatistics(qMove(jbig2DecodeTimes));
+    }
+
+    QJsonObject results;
+    results["version"] = 1;
+    results["library"] = QString(pdf::PDF_LIBRARY_VERSION);
+    results["corpus"] = corpusDirectory.absolutePath();
+    results["documentCount"] = qint64(fileNames.size());
+    results["failedDocumentCount"] = failedDocumentCount;
+    results["pageCount"] = totalPageCount;
+    results["threadCount"] = threadCount;
+    results["wallTime"] = wallTime;
+    results["cpuTime"] = cpuTime;
+    results["threadUtilization"] = wallTime > 0.0 ? cpuTime / (wallTime * threadCount) : 0.0;
+    results["peakMemory"] = endUsage.peakMemory;
+    results["stages"] = stages;
+    results["documents"] = documentResults;
+
+    QJsonArray regressions;
+    if (!baseline.isEmpty())
+    {
+        regressions = getRegressions(results, baseline, options.benchmarkRegressionThreshold);
+        results["regressions"] = regressions;
+
+        for (const QJsonValue& value : regressions)
+        {
+            const QJsonObject regression = value.toObject();
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Regression of '%1': %2 (baseline %3, change %4 %).").arg(regression["metric"].toString()).arg(regression["value"].toDouble()).arg(regression["baseline"].toDouble()).arg(regression["change"].toDouble(), 0, 'f', 1), options.outputCodec);
+        }
+    }
+
+    const QByteArray resultData = QJsonDocument(results).toJson(QJsonDocument::Indented);
+    if (!options.benchmarkOutputFile.isEmpty())
+    {
+        QFile outputFile(options.benchmarkOutputFile);
+        if (!outputFile.open(QFile::WriteOnly | QFile::Truncate) || outputFile.write(resultData) != resultData.size())
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write benchmark results to file '%1'. %2").arg(options.benchmarkOutputFile, outputFile.errorString()), options.outputCodec);
+            return ErrorFailedWriteToFile;
+        }
+    }
+    else
+    {
+        PDFConsole::writeData(resultData);
+    }
+
+    return regressions.isEmpty() ? ExitSuccess : ErrorBenchmarkRegression;
+}
+
+}   // namespace pdftool
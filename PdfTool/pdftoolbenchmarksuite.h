@@ -0,0 +1,42 @@
+//    Copyright (C) 2023 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTOOLBENCHMARKSUITE_H
+#define PDFTOOLBENCHMARKSUITE_H
+
+#include "pdftoolabstractapplication.h"
+
+namespace pdftool
+{
+
+/// Benchmark suite, which runs all documents from a corpus directory through
+/// document loading, page compilation, rasterization, text layout analysis and
+/// optionally optimization and comparison. Results (percentiles of stage times,
+/// peak memory, thread utilization) are written as JSON, which can be compared
+/// against a stored baseline. If regression above threshold is detected,
+/// \p ErrorBenchmarkRegression is returned.
+class PDFToolBenchmarkSuite : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLBENCHMARKSUITE_H
@@ -226,8 +226,11 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
     formatter.endDocument();
     PDFConsole::writeText(formatter.getString(), options.outputCodec);
 
-    // Store images to the disk file
-    auto saveImage = [this, &options](size_t index)
+    // Store images to the disk file. Error messages are written afterwards
+    // in the order of images, because console output of the worker threads
+    // is not captured in batch mode.
+    std::vector<QString> errorMessages(m_images.size());
+    auto saveImage = [this, &options, &errorMessages](size_t index)
     {
         Image& image = m_images[index];
 
@@ -240,13 +243,18 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
 
         if (!imageWriter.write(image.image))
         {
-            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(image.fileName).arg(imageWriter.errorString()), options.outputCodec);
+            errorMessages[index] = PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(image.fileName).arg(imageWriter.errorString());
         }
     };
 
     auto imageRange = pdf::PDFIntegerRange<size_t>(0, m_images.size());
     pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, imageRange.begin(), imageRange.end(), saveImage);
 
+    for (const QString& errorMessage : errorMessages)
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+    }
+
     return ExitSuccess;
 }
 
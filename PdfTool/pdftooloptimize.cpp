@@ -61,6 +61,7 @@ int PDFToolOptimize::execute(const PDFToolOptions& options)
     }
 
     pdf::PDFOptimizer optimizer(options.optimizeFlags, nullptr);
+    optimizer.setImageSettings(options.optimizeImageSettings);
     QObject::connect(&optimizer, &pdf::PDFOptimizer::optimizationProgress, &optimizer, [&options](QString text) { PDFConsole::writeError(text, options.outputCodec); }, Qt::DirectConnection);
     optimizer.setDocument(&document);
     optimizer.optimize();
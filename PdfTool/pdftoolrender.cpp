@@ -20,7 +20,11 @@
 #include "pdfconstants.h"
 
 #include <QColorSpace>
+#include <QFile>
 #include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
 
 namespace pdftool
 {
@@ -237,6 +241,7 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
 
     QElapsedTimer timer;
     timer.start();
+    const qint64 traceTimeOrigin = pdf::PDFContentProcessorProfiler::getCurrentTime();
 
     rasterizerPool.render(pageIndices, imageSizeGetter, std::bind(&PDFToolRenderBase::onPageRendered, this, options, std::placeholders::_1), nullptr);
 
@@ -244,10 +249,43 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
 
     fontCache.setCacheShrinkEnabled(nullptr, true);
 
+    if (!options.renderTraceFile.isEmpty() && !writeTrace(options, traceTimeOrigin))
+    {
+        return ErrorFailedWriteToFile;
+    }
+
     finish(options);
     return ExitSuccess;
 }
 
+bool PDFToolRenderBase::writeTrace(const PDFToolOptions& options, qint64 timeOrigin)
+{
+    QJsonArray traceEvents;
+    for (const PageInfo& info : m_pageInfo)
+    {
+        if (info.isRendered && info.profile)
+        {
+            // Jakub Melka: each page is displayed as separate thread in the trace viewer,
+            // pages are compiled in parallel, so their events can overlap in time.
+            info.profile->writeChromeTraceEvents(traceEvents, info.pageIndex + 1, PDFToolTranslationContext::tr("Page %1").arg(info.pageIndex + 1), timeOrigin);
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+
+    const QByteArray traceData = QJsonDocument(trace).toJson(QJsonDocument::Compact);
+    QFile traceFile(options.renderTraceFile);
+    if (!traceFile.open(QFile::WriteOnly | QFile::Truncate) || traceFile.write(traceData) != traceData.size())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write trace to file '%1'. %2").arg(options.renderTraceFile, traceFile.errorString()), options.outputCodec);
+        return false;
+    }
+
+    return true;
+}
+
 void PDFToolRenderBase::writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage)
 {
     PageInfo& info = m_pageInfo[renderedPageImage.pageIndex];
@@ -257,6 +295,7 @@ void PDFToolRenderBase::writePageInfoStatistics(const pdf::PDFRenderedPageImage&
     info.pageRenderTime = renderedPageImage.pageRenderTime;
     info.pageTotalTime = renderedPageImage.pageTotalTime;
     info.pageIndex = renderedPageImage.pageIndex;
+    info.profile = renderedPageImage.profile;
 }
 
 void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
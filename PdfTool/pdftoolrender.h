@@ -28,6 +28,7 @@ class PDFToolRenderBase : public PDFToolAbstractApplication
 {
 public:
     virtual int execute(const PDFToolOptions& options) override;
+    virtual bool isReentrant() const override { return false; }
 
 protected:
     virtual void finish(const PDFToolOptions& options) = 0;
@@ -39,6 +40,12 @@ protected:
     void writePageStatistics(PDFOutputFormatter& formatter);
     void writeErrors(PDFOutputFormatter& formatter);
 
+    /// Writes content stream profiles of rendered pages as Chrome trace
+    /// events to the file. Returns true, if file was successfully written.
+    /// \param options Options
+    /// \param timeOrigin Time, when rendering has started
+    bool writeTrace(const PDFToolOptions& options, qint64 timeOrigin);
+
     struct PageInfo
     {
         bool isRendered = false;
@@ -49,6 +56,7 @@ protected:
         qint64 pageTotalTime = 0;
         qint64 pageWriteTime = 0;
         std::vector<pdf::PDFRenderError> errors;
+        pdf::PDFContentProcessorProfilerPointer profile;
     };
 
     std::vector<PageInfo> m_pageInfo;
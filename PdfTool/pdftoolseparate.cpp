@@ -16,10 +16,10 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdftoolseparate.h"
-#include "pdfdocumentbuilder.h"
+#include "pdfdocumentmanipulator.h"
 #include "pdfexception.h"
-#include "pdfoptimizer.h"
 #include "pdfdocumentwriter.h"
+#include "pdfexecutionpolicy.h"
 
 namespace pdftool
 {
@@ -83,50 +83,59 @@ int PDFToolSeparate::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
-    for (pdf::PDFInteger pageIndex : pageIndices)
+    try
     {
-        try
+        // Jakub Melka: document is prepared only once, then single page
+        // documents are created and written in parallel. Error messages
+        // are written afterwards in the order of pages.
+        pdf::PDFDocumentPageSplitter splitter(&document);
+        std::vector<QString> errorMessages(pageIndices.size());
+
+        pdf::PDFIntegerRange<size_t> range(0, pageIndices.size());
+        auto separatePage = [&](size_t index)
         {
-            pdf::PDFDocumentBuilder documentBuilder(&document);
-            documentBuilder.flattenPageTree();
-            std::vector<pdf::PDFObjectReference> pageReferences = documentBuilder.getPages();
-            std::vector<pdf::PDFObjectReference> singlePageRef = { pageReferences[pageIndex] };
-            documentBuilder.setPages(singlePageRef);
-            documentBuilder.removeOutline();
-            documentBuilder.removeThreads();
-            documentBuilder.removeDocumentActions();
-            documentBuilder.removeStructureTree();
-
-            pdf::PDFDocument singlePageDocument = documentBuilder.build();
-
-            // Optimize document - remove unused objects and shrink object storage
-            pdf::PDFOptimizer optimizer(pdf::PDFOptimizer::RemoveUnusedObjects | pdf::PDFOptimizer::ShrinkObjectStorage, nullptr);
-            optimizer.setDocument(&singlePageDocument);
-            optimizer.optimize();
-            singlePageDocument = optimizer.takeOptimizedDocument();
-
-            QString fileName = options.separatePagePattern;
-            fileName.replace('%', QString::number(pageIndex + 1));
-
-            if (QFileInfo::exists(fileName))
-            {
-                PDFConsole::writeError(PDFToolTranslationContext::tr("File '%1' already exists. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1), options.outputCodec);
-            }
-            else
+            const pdf::PDFInteger pageIndex = pageIndices[index];
+
+            try
             {
-                pdf::PDFDocumentWriter writer(nullptr);
-                pdf::PDFOperationResult result = writer.write(fileName, &singlePageDocument, false);
-                if (!result)
+                QString fileName = options.separatePagePattern;
+                fileName.replace('%', QString::number(pageIndex + 1));
+
+                if (QFileInfo::exists(fileName))
                 {
-                    PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+                    errorMessages[index] = PDFToolTranslationContext::tr("File '%1' already exists. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1);
+                }
+                else
+                {
+                    pdf::PDFDocument singlePageDocument = splitter.createPageDocument(pageIndex);
+
+                    pdf::PDFDocumentWriter writer(nullptr);
+                    pdf::PDFOperationResult result = writer.write(fileName, &singlePageDocument, false);
+                    if (!result)
+                    {
+                        errorMessages[index] = result.getErrorMessage();
+                    }
                 }
             }
-        }
-        catch (const pdf::PDFException &exception)
+            catch (const pdf::PDFException &exception)
+            {
+                errorMessages[index] = exception.getMessage();
+            }
+        };
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), separatePage);
+
+        for (const QString& errorMessage : errorMessages)
         {
-            PDFConsole::writeError(exception.getMessage(), options.outputCodec);
+            if (!errorMessage.isEmpty())
+            {
+                PDFConsole::writeError(errorMessage, options.outputCodec);
+            }
         }
     }
+    catch (const pdf::PDFException &exception)
+    {
+        PDFConsole::writeError(exception.getMessage(), options.outputCodec);
+    }
 
     return ExitSuccess;
 }
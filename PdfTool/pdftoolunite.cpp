@@ -20,6 +20,9 @@
 #include "pdfdocumentreader.h"
 #include "pdfoptimizer.h"
 #include "pdfdocumentwriter.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QThread>
 
 namespace pdftool
 {
@@ -76,28 +79,45 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
         pdf::PDFObjectReference formMerged = documentBuilder.addObject(pdf::PDFObject());
         pdf::PDFObjectReference namesMerged = documentBuilder.addObject(pdf::PDFObject());
 
-        std::vector<pdf::PDFObjectReference> pages;
-        for (const QString& fileName : files)
+        // Jakub Melka: documents are processed in batches. Documents of the batch
+        // are loaded and their objects are copied in parallel, then the batch
+        // is released, so only a limited number of source documents is held
+        // in the memory at once. Result is the same as if documents were
+        // merged one by one.
+        struct SourceDocument
+        {
+            pdf::PDFDocument document;
+            std::unique_ptr<pdf::PDFDocumentBuilder> temporaryBuilder;
+            std::vector<pdf::PDFObjectReference> objectsToMerge;
+            int errorCode = ExitSuccess;
+            QString errorMessage;
+        };
+
+        auto prepareSourceDocument = [&options](const QString& fileName, SourceDocument& sourceDocument)
         {
             pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, options.permissiveReading, false);
-            pdf::PDFDocument document = reader.readFromFile(fileName);
+            sourceDocument.document = reader.readFromFile(fileName);
             if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
             {
-                PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(fileName), options.outputCodec);
-                return ErrorDocumentReading;
+                sourceDocument.errorCode = ErrorDocumentReading;
+                sourceDocument.errorMessage = PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(fileName);
+                return;
             }
 
+            const pdf::PDFDocument& document = sourceDocument.document;
             if (!document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::Assemble))
             {
-                PDFConsole::writeError(PDFToolTranslationContext::tr("Document doesn't allow to assemble pages."), options.outputCodec);
-                return ErrorPermissions;
+                sourceDocument.errorCode = ErrorPermissions;
+                sourceDocument.errorMessage = PDFToolTranslationContext::tr("Document doesn't allow to assemble pages.");
+                return;
             }
 
-            pdf::PDFDocumentBuilder temporaryBuilder(&document);
+            sourceDocument.temporaryBuilder = std::make_unique<pdf::PDFDocumentBuilder>(&document);
+            pdf::PDFDocumentBuilder& temporaryBuilder = *sourceDocument.temporaryBuilder;
             temporaryBuilder.flattenPageTree();
 
-            std::vector<pdf::PDFObjectReference> currentPages = temporaryBuilder.getPages();
-            std::vector<pdf::PDFObjectReference> objectsToMerge = currentPages;
+            std::vector<pdf::PDFObjectReference>& objectsToMerge = sourceDocument.objectsToMerge;
+            objectsToMerge = temporaryBuilder.getPages();
 
             pdf::PDFObjectReference acroFormReference;
             pdf::PDFObjectReference namesReference;
@@ -139,23 +159,68 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
             }
 
             objectsToMerge.insert(objectsToMerge.end(), { acroFormReference, namesReference, ocPropertiesReference });
+        };
+
+        const int batchSize = qMax(QThread::idealThreadCount(), 1);
+        std::vector<pdf::PDFObjectReference> pages;
+        for (int batchBegin = 0; batchBegin < files.size(); batchBegin += batchSize)
+        {
+            const int batchEnd = qMin(batchBegin + batchSize, int(files.size()));
+            std::vector<SourceDocument> sourceDocuments(batchEnd - batchBegin);
+
+            pdf::PDFIntegerRange<int> range(batchBegin, batchEnd);
+            auto processDocument = [&](int fileIndex)
+            {
+                SourceDocument& sourceDocument = sourceDocuments[fileIndex - batchBegin];
+
+                try
+                {
+                    prepareSourceDocument(files[fileIndex], sourceDocument);
+                }
+                catch (const pdf::PDFException &exception)
+                {
+                    sourceDocument.errorCode = ErrorUnknown;
+                    sourceDocument.errorMessage = exception.getMessage();
+                }
+            };
+            pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processDocument);
+
+            std::vector<pdf::PDFDocumentBuilder::CopySource> copySources;
+            copySources.reserve(sourceDocuments.size());
+            for (const SourceDocument& sourceDocument : sourceDocuments)
+            {
+                if (sourceDocument.errorCode != ExitSuccess)
+                {
+                    PDFConsole::writeError(sourceDocument.errorMessage, options.outputCodec);
+                    return sourceDocument.errorCode;
+                }
+
+                copySources.push_back(pdf::PDFDocumentBuilder::CopySource{ pdf::PDFDocumentBuilder::createObjectsFromReferences(sourceDocument.objectsToMerge), sourceDocument.temporaryBuilder->getStorage() });
+            }
 
             // Now, we are ready to merge objects into target document builder
-            std::vector<pdf::PDFObjectReference> references = pdf::PDFDocumentBuilder::createReferencesFromObjects(documentBuilder.copyFrom(pdf::PDFDocumentBuilder::createObjectsFromReferences(objectsToMerge), *temporaryBuilder.getStorage(), true));
+            std::vector<std::vector<pdf::PDFObject>> copiedObjects = documentBuilder.copyFrom(copySources, true);
+            copySources.clear();
+            sourceDocuments.clear();
 
-            ocPropertiesReference = references.back();
-            references.pop_back();
-            namesReference = references.back();
-            references.pop_back();
-            acroFormReference = references.back();
-            references.pop_back();
+            for (const std::vector<pdf::PDFObject>& objects : copiedObjects)
+            {
+                std::vector<pdf::PDFObjectReference> references = pdf::PDFDocumentBuilder::createReferencesFromObjects(objects);
 
-            documentPartPageCounts.push_back(references.size());
+                pdf::PDFObjectReference ocPropertiesReference = references.back();
+                references.pop_back();
+                pdf::PDFObjectReference namesReference = references.back();
+                references.pop_back();
+                pdf::PDFObjectReference acroFormReference = references.back();
+                references.pop_back();
 
-            documentBuilder.appendTo(ocPropertiesMerged, documentBuilder.getObjectByReference(ocPropertiesReference));
-            documentBuilder.appendTo(formMerged, documentBuilder.getObjectByReference(acroFormReference));
-            documentBuilder.mergeNames(namesMerged, namesReference);
-            pages.insert(pages.end(), references.cbegin(), references.cend());
+                documentPartPageCounts.push_back(references.size());
+
+                documentBuilder.appendTo(ocPropertiesMerged, documentBuilder.getObjectByReference(ocPropertiesReference));
+                documentBuilder.appendTo(formMerged, documentBuilder.getObjectByReference(acroFormReference));
+                documentBuilder.mergeNames(namesMerged, namesReference);
+                pages.insert(pages.end(), references.cbegin(), references.cend());
+            }
         }
 
         documentBuilder.setPages(pages);
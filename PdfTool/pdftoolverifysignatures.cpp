@@ -21,11 +21,42 @@
 #include "pdfsignaturehandler.h"
 #include "pdfform.h"
 
+#include <QMutex>
+
+#include <map>
+#include <memory>
+
 namespace pdftool
 {
 
 static PDFToolVerifySignaturesApplication s_verifySignaturesApplication;
 
+/// Returns verification context shared by all verifications in this process. When
+/// many documents are verified (for example, in batch mode), trusted certificate
+/// store is built only once and certificate verification results are reused.
+static pdf::PDFSignatureVerificationContext* getSharedVerificationContext(const PDFToolOptions& options)
+{
+    static QMutex s_mutex;
+    static std::map<std::pair<bool, bool>, std::unique_ptr<pdf::PDFSignatureVerificationContext>> s_contexts;
+
+    QMutexLocker lock(&s_mutex);
+
+    const std::pair<bool, bool> key(options.verificationUseUserCertificates, options.verificationUseSystemCertificates);
+    std::unique_ptr<pdf::PDFSignatureVerificationContext>& context = s_contexts[key];
+    if (!context)
+    {
+        pdf::PDFCertificateStore certificateStore;
+        if (options.verificationUseUserCertificates)
+        {
+            certificateStore.loadDefaultUserCertificates();
+        }
+
+        context = std::make_unique<pdf::PDFSignatureVerificationContext>(&certificateStore, options.verificationUseSystemCertificates);
+    }
+
+    return context.get();
+}
+
 QString PDFToolVerifySignaturesApplication::getStandardString(StandardString standardString) const
 {
     switch (standardString)
@@ -91,14 +122,8 @@ int PDFToolVerifySignaturesApplication::execute(const PDFToolOptions& options)
     }
 
     // Verify signatures
-    pdf::PDFCertificateStore certificateStore;
-    if (options.verificationUseUserCertificates)
-    {
-        certificateStore.loadDefaultUserCertificates();
-    }
-
     pdf::PDFSignatureHandler::Parameters parameters;
-    parameters.store = &certificateStore;
+    parameters.context = getSharedVerificationContext(options);
     parameters.dss = &document.getCatalog()->getDocumentSecurityStore();
     parameters.enableVerification = true;
     parameters.ignoreExpirationDate = options.verificationIgnoreExpirationDate;
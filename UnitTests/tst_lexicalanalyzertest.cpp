@@ -18,6 +18,9 @@
 
 #include <QtTest>
 #include <QMetaType>
+#include <QRandomGenerator>
+#include <QBuffer>
+#include <QImageWriter>
 
 #include "pdfparser.h"
 #include "pdfconstants.h"
@@ -27,8 +30,33 @@
 #include "pdfdocument.h"
 #include "pdfexception.h"
 #include "pdfjbig2decoder.h"
+#include "pdfccittfaxdecoder.h"
+#include "pdffont.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfalgorithmlcs.h"
+#include "pdfexecutionpolicy.h"
+#include "pdftextlayout.h"
+#include "pdfobjectutils.h"
+#include "pdfcms.h"
+#include "pdfoptimizer.h"
+#include "pdfdocumentreader.h"
+#include "pdfdocumentwriter.h"
+#include "pdfsecurityhandler.h"
+#include "pdfrenderer.h"
+#include "pdfpainter.h"
+#include "pdftextlayoutgenerator.h"
+#include "pdfdocumenttextflow.h"
+#include "pdfdiff.h"
+#include "pdfdocumentmanipulator.h"
+#include "pdfdocumentsanitizer.h"
 
 #include <regex>
+#include <thread>
+
+#ifndef CMS_NO_REGISTER_KEYWORD
+#define CMS_NO_REGISTER_KEYWORD
+#endif
+#include <lcms2.h>
 
 #ifdef PDF4QT_COMPILER_MSVC
 #pragma warning(push)
@@ -60,6 +88,24 @@ private slots:
     void test_stitching_function();
     void test_postscript_function();
     void test_jbig2_arithmetic_decoder();
+    void test_jbig2_bitmap_paint();
+    void test_ccitt_fax_decoder();
+    void test_ccitt_fax_decoder_benchmark();
+    void test_ccitt_fax_encoder();
+    void test_font_cache_contention_benchmark();
+    void test_lcs();
+    void test_text_layout_benchmark();
+    void test_text_layout_storage_copy_and_move();
+    void test_object_storage_copy_on_write();
+    void test_object_reference_graph();
+    void test_color_transform_lut();
+    void test_image_recompression();
+    void test_decrypt_streams_on_demand();
+    void test_text_layout_sink();
+    void test_document_text_flow();
+    void test_diff_page_fingerprints();
+    void test_document_page_splitter();
+    void test_sanitizer_removes_popups();
 
 private:
     void scanWholeStream(const char* stream);
@@ -1102,6 +1148,1732 @@ void LexicalAnalyzerTest::test_jbig2_arithmetic_decoder()
     QVERIFY(decompressed == decompressedByAD);
 }
 
+void LexicalAnalyzerTest::test_jbig2_bitmap_paint()
+{
+    // Compare word-wise painting of packed bitmaps with pixel by pixel reference
+    QRandomGenerator generator(42);
+
+    auto randomPixel = [&generator]() -> uint8_t { return generator.bounded(2) ? 0xFF : 0x00; };
+
+    const pdf::PDFJBIG2BitOperation operations[] = { pdf::PDFJBIG2BitOperation::Or,
+                                                      pdf::PDFJBIG2BitOperation::And,
+                                                      pdf::PDFJBIG2BitOperation::Xor,
+                                                      pdf::PDFJBIG2BitOperation::NotXor,
+                                                      pdf::PDFJBIG2BitOperation::Replace };
+
+    for (int i = 0; i < 500; ++i)
+    {
+        const int targetWidth = generator.bounded(1, 200);
+        const int targetHeight = generator.bounded(1, 20);
+        const int sourceWidth = generator.bounded(1, 150);
+        const int sourceHeight = generator.bounded(1, 20);
+        const int offsetX = generator.bounded(-100, 200);
+        const int offsetY = generator.bounded(-10, 25);
+        const pdf::PDFJBIG2BitOperation operation = operations[generator.bounded(5)];
+
+        pdf::PDFJBIG2Bitmap target(targetWidth, targetHeight);
+        pdf::PDFJBIG2Bitmap source(sourceWidth, sourceHeight);
+        std::vector<uint8_t> reference(targetWidth * targetHeight, 0x00);
+
+        for (int y = 0; y < targetHeight; ++y)
+        {
+            for (int x = 0; x < targetWidth; ++x)
+            {
+                const uint8_t pixel = randomPixel();
+                target.setPixel(x, y, pixel);
+                reference[y * targetWidth + x] = pixel;
+            }
+        }
+
+        for (int y = 0; y < sourceHeight; ++y)
+        {
+            for (int x = 0; x < sourceWidth; ++x)
+            {
+                source.setPixel(x, y, randomPixel());
+            }
+        }
+
+        target.paint(source, offsetX, offsetY, operation, false, 0x00);
+
+        for (int y = 0; y < sourceHeight; ++y)
+        {
+            for (int x = 0; x < sourceWidth; ++x)
+            {
+                const int targetX = x + offsetX;
+                const int targetY = y + offsetY;
+
+                if (targetX < 0 || targetX >= targetWidth || targetY < 0 || targetY >= targetHeight)
+                {
+                    continue;
+                }
+
+                uint8_t& pixel = reference[targetY * targetWidth + targetX];
+                const uint8_t sourcePixel = source.getPixel(x, y);
+
+                switch (operation)
+                {
+                    case pdf::PDFJBIG2BitOperation::Or:
+                        pixel = pixel | sourcePixel;
+                        break;
+
+                    case pdf::PDFJBIG2BitOperation::And:
+                        pixel = pixel & sourcePixel;
+                        break;
+
+                    case pdf::PDFJBIG2BitOperation::Xor:
+                        pixel = pixel ^ sourcePixel;
+                        break;
+
+                    case pdf::PDFJBIG2BitOperation::NotXor:
+                        pixel = pixel ^ static_cast<uint8_t>(~sourcePixel);
+                        break;
+
+                    default:
+                        pixel = sourcePixel;
+                        break;
+                }
+            }
+        }
+
+        for (int y = 0; y < targetHeight; ++y)
+        {
+            for (int x = 0; x < targetWidth; ++x)
+            {
+                QCOMPARE(target.getPixel(x, y), reference[y * targetWidth + x]);
+            }
+        }
+
+        const int subOffsetX = generator.bounded(-50, 150);
+        const int subOffsetY = generator.bounded(-10, 20);
+        pdf::PDFJBIG2Bitmap subbitmap = target.getSubbitmap(subOffsetX, subOffsetY, sourceWidth, sourceHeight);
+
+        for (int y = 0; y < sourceHeight; ++y)
+        {
+            for (int x = 0; x < sourceWidth; ++x)
+            {
+                QCOMPARE(subbitmap.getPixel(x, y), target.getPixelSafe(x + subOffsetX, y + subOffsetY));
+            }
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_ccitt_fax_decoder()
+{
+    // Expected outputs were produced by the bit by bit decoder, table driven
+    // decoder must produce exactly the same data.
+    auto test = [](pdf::PDFInteger K, pdf::PDFInteger columns, pdf::PDFInteger rows, const char* encodedHex, const char* decodedHex)
+    {
+        QByteArray encoded = QByteArray::fromHex(encodedHex);
+
+        pdf::PDFCCITTFaxDecoderParameters parameters;
+        parameters.K = K;
+        parameters.columns = columns;
+        parameters.rows = rows;
+        parameters.hasEndOfBlock = false;
+        parameters.decode = { 0.0, 1.0 };
+
+        pdf::PDFCCITTFaxDecoder decoder(&encoded, parameters);
+        pdf::PDFImageData imageData = decoder.decode();
+
+        QCOMPARE(imageData.getWidth(), static_cast<unsigned int>(columns));
+        QCOMPARE(imageData.getHeight(), static_cast<unsigned int>(rows));
+        QCOMPARE(imageData.getData().toHex(), QByteArray(decodedHex));
+    };
+
+    // One dimensional encoding
+    test(0, 16, 5, "3512e35e18fd9ab1d8fba1cd71d0e31f1cd71d0e4f8e", "0078384f084d28092819");
+
+    // Two dimensional encoding (Group 4)
+    test(-1, 20, 3, "26a108fadb15", "0027e0001ff0ffffe0");
+    test(-1, 37, 5, "23a2e4472381814104288f86457d5608a741143f5ffc11b0444c3f06", "b0207c0000e0809f00c0e1819b0140e1019b01401f00001178");
+    test(-1, 44, 7, "239f206a914f1e204160ca0303963ce29083cba23ab424708223f25d40", "83fffffffff083fffffff7f007fffe3f03b000ffe0003ff008fbe00435f09f801ffffff09f801fffff70");
+
+    // Mixed encoding
+    test(3, 26, 5, "9a89a638f0a5d0c4d5861028e6b631d621f1d0ea162930", "007ffe40fc037fc00f0bffc01f0be9403ffc0200");
+}
+
+void LexicalAnalyzerTest::test_ccitt_fax_decoder_benchmark()
+{
+    // Synthetic one dimensional fax page, each line consists of 86 pairs
+    // of white/black runs of length 10, terminated by white run of length 8.
+    const pdf::PDFInteger columns = 1728;
+    const pdf::PDFInteger rows = 2200;
+
+    pdf::PDFBitWriter writer(1);
+    auto writeCode = [&writer](uint32_t code, int bits)
+    {
+        for (int i = bits - 1; i >= 0; --i)
+        {
+            writer.write((code >> i) & 1);
+        }
+    };
+
+    for (pdf::PDFInteger row = 0; row < rows; ++row)
+    {
+        for (int i = 0; i < 86; ++i)
+        {
+            writeCode(0b00111, 5);
+            writeCode(0b0000100, 7);
+        }
+        writeCode(0b10011, 5);
+    }
+    writer.finishLine();
+    QByteArray encoded = writer.takeByteArray();
+
+    pdf::PDFCCITTFaxDecoderParameters parameters;
+    parameters.K = 0;
+    parameters.columns = columns;
+    parameters.rows = rows;
+    parameters.hasEndOfBlock = false;
+    parameters.decode = { 0.0, 1.0 };
+
+    pdf::PDFImageData imageData;
+    QBENCHMARK
+    {
+        pdf::PDFCCITTFaxDecoder decoder(&encoded, parameters);
+        imageData = decoder.decode();
+    }
+
+    QCOMPARE(imageData.getHeight(), static_cast<unsigned int>(rows));
+    QCOMPARE(imageData.getData().size(), static_cast<qsizetype>((columns + 7) / 8 * rows));
+}
+
+void LexicalAnalyzerTest::test_ccitt_fax_encoder()
+{
+    // Encoded random images must be decoded to the same data
+    QRandomGenerator generator(42);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        const int columns = generator.bounded(1, (i % 10 == 0) ? 6000 : 300);
+        const int rows = generator.bounded(1, 40);
+        const int stride = (columns + 7) / 8;
+        const int runProbability = generator.bounded(1, 200);
+
+        QByteArray data(stride * rows, 0);
+        for (int row = 0; row < rows; ++row)
+        {
+            bool isWhite = generator.bounded(2);
+            for (int column = 0; column < columns; ++column)
+            {
+                if (generator.bounded(runProbability) == 0)
+                {
+                    isWhite = !isWhite;
+                }
+
+                if (isWhite)
+                {
+                    data[row * stride + column / 8] = data[row * stride + column / 8] | char(0x80 >> (column % 8));
+                }
+            }
+        }
+
+        QByteArray encoded = pdf::PDFCCITTFaxEncoder::encode(data, columns, rows, stride);
+
+        pdf::PDFCCITTFaxDecoderParameters parameters;
+        parameters.K = -1;
+        parameters.columns = columns;
+        parameters.rows = rows;
+        parameters.decode = { 0.0, 1.0 };
+
+        pdf::PDFCCITTFaxDecoder decoder(&encoded, parameters);
+        pdf::PDFImageData imageData = decoder.decode();
+
+        QCOMPARE(imageData.getWidth(), static_cast<unsigned int>(columns));
+        QCOMPARE(imageData.getHeight(), static_cast<unsigned int>(rows));
+        QCOMPARE(imageData.getData(), data);
+    }
+}
+
+void LexicalAnalyzerTest::test_font_cache_contention_benchmark()
+{
+    // Document with standard fonts only, so fonts can be created without
+    // any font files. Each rasterizer thread looks up all fonts repeatedly,
+    // together with realized fonts of several sizes.
+    const char* fontNames[] = { "Helvetica", "Helvetica-Bold", "Times-Roman", "Times-Bold", "Courier", "Courier-Bold", "Symbol", "ZapfDingbats" };
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+
+    std::vector<pdf::PDFObject> fontObjects;
+    for (const char* fontName : fontNames)
+    {
+        QByteArray data = QByteArray("<< /Type /Font /Subtype /Type1 /BaseFont /") + fontName + " >>";
+        pdf::PDFParser parser(data.constData(), data.constData() + data.size(), nullptr, pdf::PDFParser::None);
+        fontObjects.push_back(pdf::PDFObject::createReference(builder.addObject(parser.getObject())));
+    }
+
+    pdf::PDFDocument document = builder.build();
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, nullptr));
+
+    const int threadCount = qMax(QThread::idealThreadCount(), 16);
+    const int lookupsPerThread = 10000;
+    std::atomic<int> failures = 0;
+
+    // Last size differs only by rounding noise, so it must share the realized font with the previous size
+    const pdf::PDFReal sizes[] = { 8.0, 10.0, 12.0, 12.0 + 1e-9 };
+    const size_t sizeCount = std::size(sizes);
+    const size_t realizedFontCount = fontObjects.size() * sizeCount;
+    std::vector<std::vector<pdf::PDFRealizedFontPointer>> realizedFonts(threadCount, std::vector<pdf::PDFRealizedFontPointer>(realizedFontCount));
+
+    QBENCHMARK
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+
+        for (int i = 0; i < threadCount; ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                pdf::PDFRenderErrorReporterDummy reporter;
+                std::vector<pdf::PDFRealizedFontPointer>& threadRealizedFonts = realizedFonts[i];
+
+                for (int j = 0; j < lookupsPerThread; ++j)
+                {
+                    const size_t fontIndex = (i + j) % fontObjects.size();
+                    const size_t sizeIndex = (i + j / fontObjects.size()) % sizeCount;
+                    pdf::PDFFontPointer font = fontCache.getFont(fontObjects[fontIndex]);
+                    if (!font)
+                    {
+                        ++failures;
+                        continue;
+                    }
+
+                    pdf::PDFRealizedFontPointer realizedFont = fontCache.getRealizedFont(font, sizes[sizeIndex], &reporter);
+                    pdf::PDFRealizedFontPointer& threadRealizedFont = threadRealizedFonts[fontIndex * sizeCount + sizeIndex];
+                    if (!realizedFont || (threadRealizedFont && threadRealizedFont != realizedFont))
+                    {
+                        ++failures;
+                    }
+                    threadRealizedFont = realizedFont;
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    QCOMPARE(failures.load(), 0);
+
+    // All threads must share the same realized font instance for each font and size
+    for (size_t i = 0; i < realizedFontCount; ++i)
+    {
+        for (int j = 0; j < threadCount; ++j)
+        {
+            QVERIFY(realizedFonts[j][i]);
+            QVERIFY(realizedFonts[j][i] == realizedFonts[0][i]);
+        }
+    }
+
+    for (size_t i = 0; i < fontObjects.size(); ++i)
+    {
+        QVERIFY(realizedFonts[0][i * sizeCount + sizeCount - 1] == realizedFonts[0][i * sizeCount + sizeCount - 2]);
+    }
+
+    pdf::PDFFontCacheStatistics statistics = fontCache.getStatistics();
+    QVERIFY(statistics.fontMisses >= fontObjects.size());
+    QVERIFY(statistics.fontHits > 0);
+    QCOMPARE(statistics.fontEvictions, size_t(0));
+    QVERIFY(statistics.realizedFontMisses >= fontObjects.size() * (sizeCount - 1));
+    QVERIFY(statistics.realizedFontHits > 0);
+    QCOMPARE(statistics.realizedFontEvictions, size_t(0));
+}
+
+void LexicalAnalyzerTest::test_lcs()
+{
+    QRandomGenerator generator(42);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const int alphabetSize = generator.bounded(1, 6);
+        std::vector<int> left(generator.bounded(0, 60));
+        std::vector<int> right(generator.bounded(0, 60));
+
+        for (int& value : left)
+        {
+            value = generator.bounded(alphabetSize);
+        }
+
+        if (i % 2 == 0)
+        {
+            // Similar sequences - right sequence is a modified left sequence
+            right = left;
+            const int modifications = generator.bounded(0, 8);
+            for (int j = 0; j < modifications && !right.empty(); ++j)
+            {
+                const int index = generator.bounded(static_cast<int>(right.size()));
+                switch (generator.bounded(3))
+                {
+                    case 0:
+                        right.erase(right.begin() + index);
+                        break;
+
+                    case 1:
+                        right.insert(right.begin() + index, generator.bounded(alphabetSize));
+                        break;
+
+                    default:
+                        right[index] = generator.bounded(alphabetSize);
+                        break;
+                }
+            }
+        }
+        else
+        {
+            for (int& value : right)
+            {
+                value = generator.bounded(alphabetSize);
+            }
+        }
+
+        pdf::PDFAlgorithmLongestCommonSubsequence algorithm(left.cbegin(), left.cend(), right.cbegin(), right.cend(), std::equal_to<int>());
+        algorithm.perform();
+
+        // Sequence must contain all items of both sequences in order
+        size_t index1 = 0;
+        size_t index2 = 0;
+        size_t matchCount = 0;
+        for (const auto& item : algorithm.getSequence())
+        {
+            if (item.isLeftValid())
+            {
+                QCOMPARE(item.index1, index1++);
+            }
+
+            if (item.isRightValid())
+            {
+                QCOMPARE(item.index2, index2++);
+            }
+
+            if (item.isMatch())
+            {
+                QCOMPARE(left[item.index1], right[item.index2]);
+                ++matchCount;
+            }
+        }
+
+        QCOMPARE(index1, left.size());
+        QCOMPARE(index2, right.size());
+
+        // Compare length of the common subsequence with dynamic programming solution
+        std::vector<size_t> previousRow(right.size() + 1, 0);
+        std::vector<size_t> currentRow(right.size() + 1, 0);
+        for (size_t i1 = 1; i1 <= left.size(); ++i1)
+        {
+            for (size_t i2 = 1; i2 <= right.size(); ++i2)
+            {
+                currentRow[i2] = (left[i1 - 1] == right[i2 - 1]) ? previousRow[i2 - 1] + 1 : qMax(previousRow[i2], currentRow[i2 - 1]);
+            }
+            std::swap(previousRow, currentRow);
+        }
+
+        QCOMPARE(matchCount, previousRow.back());
+    }
+
+    // Large sequences are divided into subproblems solved in parallel, result must
+    // be valid and must have the same length as the result of sequential algorithm.
+    auto performLcs = [](const std::vector<int>& left, const std::vector<int>& right, pdf::PDFExecutionPolicy::Strategy strategy, size_t& matchCount)
+    {
+        pdf::PDFExecutionPolicy::setStrategy(strategy);
+        pdf::PDFAlgorithmLongestCommonSubsequence algorithm(left.cbegin(), left.cend(), right.cbegin(), right.cend(), std::equal_to<int>());
+        algorithm.perform();
+        pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+
+        size_t index1 = 0;
+        size_t index2 = 0;
+        bool isValid = true;
+        matchCount = 0;
+        for (const auto& item : algorithm.getSequence())
+        {
+            isValid = isValid && (!item.isLeftValid() || item.index1 == index1++);
+            isValid = isValid && (!item.isRightValid() || item.index2 == index2++);
+            if (item.isMatch())
+            {
+                isValid = isValid && left[item.index1] == right[item.index2];
+                ++matchCount;
+            }
+        }
+
+        return isValid && index1 == left.size() && index2 == right.size();
+    };
+
+    for (const int modifications : { 0, 50, 1000 })
+    {
+        std::vector<int> left(30000);
+        for (int& value : left)
+        {
+            value = generator.bounded(8);
+        }
+
+        std::vector<int> right = left;
+        for (int j = 0; j < modifications; ++j)
+        {
+            const int index = generator.bounded(static_cast<int>(right.size()));
+            switch (generator.bounded(3))
+            {
+                case 0:
+                    right.erase(right.begin() + index);
+                    break;
+
+                case 1:
+                    right.insert(right.begin() + index, generator.bounded(8));
+                    break;
+
+                default:
+                    right[index] = generator.bounded(8);
+                    break;
+            }
+        }
+
+        size_t parallelMatchCount = 0;
+        size_t sequentialMatchCount = 0;
+        QVERIFY(performLcs(left, right, pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded, parallelMatchCount));
+        QVERIFY(performLcs(left, right, pdf::PDFExecutionPolicy::Strategy::SingleThreaded, sequentialMatchCount));
+        QCOMPARE(parallelMatchCount, sequentialMatchCount);
+        QVERIFY(parallelMatchCount >= left.size() - modifications);
+    }
+}
+
+void LexicalAnalyzerTest::test_text_layout_benchmark()
+{
+    // Synthetic dense page, similar to the spreadsheet exported to pdf. Each
+    // cell forms a text line, each column should form a single text block.
+    const int rows = 1000;
+    const int columns = 6;
+    const pdf::PDFReal fontSize = 8.0;
+    const pdf::PDFReal advance = 5.0;
+    const pdf::PDFReal rowHeight = 10.0;
+    const pdf::PDFReal columnWidth = 80.0;
+    const QString cellText = QStringLiteral("1234.56");
+
+    pdf::PDFTextCharacterInfo info;
+    info.fontSize = 1.0;
+    info.advance = 1.0;
+    info.outline.addRect(QRectF(0.0, 0.0, 1.0, 1.0));
+
+    std::vector<pdf::PDFTextCharacterInfo> characters;
+    characters.reserve(rows * columns * cellText.size());
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            for (int i = 0; i < cellText.size(); ++i)
+            {
+                info.character = cellText[i];
+                info.matrix = QTransform(advance, 0.0, 0.0, fontSize, column * columnWidth + i * advance, row * rowHeight);
+                characters.push_back(info);
+            }
+        }
+    }
+
+    pdf::PDFTextLayout textLayout;
+    QBENCHMARK
+    {
+        textLayout = pdf::PDFTextLayout();
+        for (const pdf::PDFTextCharacterInfo& characterInfo : characters)
+        {
+            textLayout.addCharacter(characterInfo);
+        }
+        textLayout.perform();
+    }
+
+    const pdf::PDFTextBlocks& blocks = textLayout.getTextBlocks();
+    QCOMPARE(blocks.size(), size_t(columns));
+
+    // Blocks must be in reading order (columns from left to right), lines in each
+    // block must go from top to bottom (higher y first) and each line must contain
+    // exactly the characters of one cell, in order.
+    for (int column = 0; column < columns; ++column)
+    {
+        const pdf::PDFTextLines& lines = blocks[column].getLines();
+        QCOMPARE(lines.size(), size_t(rows));
+
+        for (int i = 0; i < rows; ++i)
+        {
+            const int row = rows - 1 - i;
+            const pdf::TextCharacters& lineCharacters = lines[i].getCharacters();
+            QCOMPARE(lineCharacters.size(), size_t(cellText.size()));
+
+            QString text;
+            for (size_t j = 0; j < lineCharacters.size(); ++j)
+            {
+                const pdf::TextCharacter& character = lineCharacters[j];
+                text += character.character;
+                QVERIFY(qAbs(character.position.x() - (column * columnWidth + j * advance)) < 1e-6);
+                QVERIFY(qAbs(character.position.y() - row * rowHeight) < 1e-6);
+            }
+            QCOMPARE(text, cellText);
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_text_layout_storage_copy_and_move()
+{
+    auto createTextLayout = [](const QString& text)
+    {
+        pdf::PDFTextCharacterInfo info;
+        info.fontSize = 1.0;
+        info.advance = 1.0;
+        info.outline.addRect(QRectF(0.0, 0.0, 1.0, 1.0));
+
+        pdf::PDFTextLayout textLayout;
+        for (int i = 0; i < text.size(); ++i)
+        {
+            info.character = text[i];
+            info.matrix = QTransform(5.0, 0.0, 0.0, 10.0, 100.0 + i * 5.0, 700.0);
+            textLayout.addCharacter(info);
+        }
+        textLayout.perform();
+        return textLayout;
+    };
+
+    auto getText = [](const pdf::PDFTextLayout& textLayout)
+    {
+        QString text;
+        for (const pdf::PDFTextBlock& block : textLayout.getTextBlocks())
+        {
+            for (const pdf::PDFTextLine& line : block.getLines())
+            {
+                for (const pdf::TextCharacter& character : line.getCharacters())
+                {
+                    text += character.character;
+                }
+            }
+        }
+        return text;
+    };
+
+    const QString first = QStringLiteral("First");
+    const QString second = QStringLiteral("Second");
+    const pdf::PDFTextFlow::FlowFlags flowFlags = pdf::PDFTextFlow::None;
+
+    pdf::PDFTextLayoutStorage storage(1);
+    storage.setTextLayout(0, createTextLayout(first), nullptr);
+    QCOMPARE(getText(storage.getTextLayout(0)), first);
+    QCOMPARE(storage.find(first, Qt::CaseSensitive, flowFlags).size(), size_t(1));
+
+    // Copy has its own cache, so changes of the copy are not visible in the original
+    pdf::PDFTextLayoutStorage copy = storage;
+    copy.setTextLayout(0, createTextLayout(second), nullptr);
+    QCOMPARE(getText(copy.getTextLayout(0)), second);
+    QCOMPARE(getText(storage.getTextLayout(0)), first);
+    QVERIFY(copy.find(first, Qt::CaseSensitive, flowFlags).empty());
+    QCOMPARE(storage.find(first, Qt::CaseSensitive, flowFlags).size(), size_t(1));
+
+    // Moved storage takes the layouts and the cache, moved-from
+    // storage is empty, but it can still be used.
+    pdf::PDFTextLayoutStorage moved = std::move(storage);
+    QCOMPARE(getText(moved.getTextLayout(0)), first);
+    QCOMPARE(storage.getCount(), size_t(0));
+    QVERIFY(storage.getTextLayout(0).getTextBlocks().empty());
+    QVERIFY(storage.find(first, Qt::CaseSensitive, flowFlags).empty());
+
+    storage = std::move(copy);
+    QCOMPARE(getText(storage.getTextLayout(0)), second);
+    QCOMPARE(copy.getCount(), size_t(0));
+    QVERIFY(copy.getTextLayout(0).getTextBlocks().empty());
+    QVERIFY(copy.find(second, Qt::CaseSensitive, flowFlags).empty());
+}
+
+void LexicalAnalyzerTest::test_object_storage_copy_on_write()
+{
+    pdf::PDFObjectStorage storage;
+    std::vector<pdf::PDFObjectReference> references;
+    for (pdf::PDFInteger i = 0; i < 1000; ++i)
+    {
+        references.push_back(storage.addObject(pdf::PDFObject::createInteger(i)));
+    }
+
+    std::shared_ptr<const pdf::PDFObjectReferenceGraph> graph = storage.getReferenceGraph();
+    QVERIFY(graph->getReferencedBy(references[10]).empty());
+
+    pdf::PDFObjectStorage copy = storage;
+    QVERIFY(storage == copy);
+    QVERIFY(copy.getReferenceGraph() == graph);
+
+    copy.setObject(references[500], pdf::PDFObject::createReference(references[10]));
+    pdf::PDFObjectReference addedReference = copy.addObject(pdf::PDFObject::createReference(references[10]));
+
+    QVERIFY(storage != copy);
+    QCOMPARE(storage.getObjects().size(), size_t(1000));
+    QCOMPARE(copy.getObjects().size(), size_t(1001));
+    QCOMPARE(storage.getObject(references[500]).getInteger(), pdf::PDFInteger(500));
+    QVERIFY(copy.getObject(references[500]).isReference());
+
+    // Unmodified chunks are shared, modified chunks are copied
+    QVERIFY(&storage.getObjects()[0] == &copy.getObjects()[0]);
+    QVERIFY(&storage.getObjects()[500] != &copy.getObjects()[500]);
+
+    // Graph of the original storage is not affected by changes of the copy
+    QVERIFY(storage.getReferenceGraph()->getReferencedBy(references[10]).empty());
+    std::vector<pdf::PDFObjectReference> referencedBy = { references[500], addedReference };
+    QVERIFY(copy.getReferenceGraph()->getReferencedBy(references[10]) == referencedBy);
+}
+
+void LexicalAnalyzerTest::test_object_reference_graph()
+{
+    using References = std::vector<pdf::PDFObjectReference>;
+
+    pdf::PDFObjectStorage storage;
+    References r;
+    for (int i = 0; i < 6; ++i)
+    {
+        r.push_back(storage.addObject(pdf::PDFObject()));
+    }
+
+    auto parseObject = [&r](QByteArray data)
+    {
+        for (int i = 0; i < int(r.size()); ++i)
+        {
+            data.replace(QByteArray("@") + QByteArray::number(i), QByteArray::number(r[i].objectNumber) + " " + QByteArray::number(r[i].generation) + " R");
+        }
+
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    auto getReferences = [](const pdf::PDFObjectReferenceGraph& graph, pdf::PDFObjectReference reference)
+    {
+        std::span<const pdf::PDFObjectReference> references = graph.getReferences(reference);
+        return References(references.begin(), references.end());
+    };
+
+    const pdf::PDFObjectReference missing(1000, 0);
+    storage.setObject(r[0], parseObject("<< /A @1 /B [ @2 @2 ] >>"));
+    storage.setObject(r[1], parseObject("[ @2 @3 ]"));
+    storage.setObject(r[2], pdf::PDFObject::createInteger(5));
+    storage.setObject(r[3], parseObject("<< /Back @0 >>"));
+    storage.setObject(r[4], parseObject("<< /Next @5 /Missing 1000 0 R >>"));
+    storage.setObject(r[5], pdf::PDFObject::createInteger(6));
+    storage.setTrailerDictionary(parseObject("<< /Root @0 >>"));
+
+    // Forward and reverse edges
+    std::shared_ptr<const pdf::PDFObjectReferenceGraph> graph = storage.getReferenceGraph();
+    QVERIFY(getReferences(*graph, r[0]) == References({ r[1], r[2] }));
+    QVERIFY(getReferences(*graph, r[1]) == References({ r[2], r[3] }));
+    QVERIFY(getReferences(*graph, r[2]).empty());
+    QVERIFY(getReferences(*graph, r[4]) == References({ r[5], missing }));
+    QVERIFY(graph->getReferencedBy(r[2]) == References({ r[0], r[1] }));
+    QVERIFY(graph->getReferencedBy(r[0]) == References({ r[3] }));
+    QVERIFY(graph->getReferencedBy(r[4]).empty());
+    QVERIFY(graph->getTrailerReferences() == References({ r[0] }));
+    QVERIFY(graph->isValid(r[5]));
+    QVERIFY(!graph->isValid(missing));
+
+    // Closure and reachability
+    QVERIFY(graph->getClosure({ r[3] }) == References({ r[0], r[1], r[2], r[3] }));
+    QVERIFY(graph->getClosure({ r[4], missing }) == References({ r[4], r[5] }));
+    QVERIFY(graph->getReachableObjects() == References({ r[0], r[1], r[2], r[3] }));
+    QVERIFY(graph->isReachable(r[3], r[2]));
+    QVERIFY(graph->isReachable(r[0], r[0]));
+    QVERIFY(graph->isReachable(r[4], r[5]));
+    QVERIFY(!graph->isReachable(r[2], r[0]));
+    QVERIFY(!graph->isReachable(r[0], r[4]));
+
+    // Graph is updated, when objects are changed or added, graph
+    // obtained before the change is not affected.
+    storage.setObject(r[2], parseObject("<< /Next @4 >>"));
+    const pdf::PDFObjectReference added = storage.addObject(parseObject("<< /Target @0 >>"));
+    std::shared_ptr<const pdf::PDFObjectReferenceGraph> updatedGraph = storage.getReferenceGraph();
+    QVERIFY(updatedGraph != graph);
+    QVERIFY(getReferences(*graph, r[2]).empty());
+    QVERIFY(!graph->isValid(added));
+    QVERIFY(getReferences(*updatedGraph, r[2]) == References({ r[4] }));
+    QVERIFY(updatedGraph->getReferencedBy(r[4]) == References({ r[2] }));
+    QVERIFY(updatedGraph->getReferencedBy(r[0]) == References({ r[3], added }));
+    QVERIFY(updatedGraph->isValid(added));
+    QVERIFY(updatedGraph->getReachableObjects() == References({ r[0], r[1], r[2], r[3], r[4], r[5] }));
+    QVERIFY(updatedGraph->isReachable(r[1], r[5]));
+
+    // Updated graph is the same as the graph built from scratch
+    const pdf::PDFObjectReferenceGraph rebuiltGraph(storage);
+    References allReferences = r;
+    allReferences.push_back(added);
+    allReferences.push_back(missing);
+    for (const pdf::PDFObjectReference& reference : allReferences)
+    {
+        QVERIFY(getReferences(*updatedGraph, reference) == getReferences(rebuiltGraph, reference));
+        QVERIFY(updatedGraph->getReferencedBy(reference) == rebuiltGraph.getReferencedBy(reference));
+        QCOMPARE(updatedGraph->isValid(reference), rebuiltGraph.isValid(reference));
+    }
+
+    // Copies of the storage share the graph, until one of them is changed
+    pdf::PDFObjectStorage copy = storage;
+    QVERIFY(copy.getReferenceGraph() == storage.getReferenceGraph());
+    copy.setObject(r[5], parseObject("<< /Back @4 >>"));
+    QVERIFY(copy.getReferenceGraph() != storage.getReferenceGraph());
+    QVERIFY(copy.getReferenceGraph()->getReferencedBy(r[4]) == References({ r[2], r[5] }));
+    QVERIFY(storage.getReferenceGraph()->getReferencedBy(r[4]) == References({ r[2] }));
+    QVERIFY(storage.getReferenceGraph() == updatedGraph);
+}
+
+void LexicalAnalyzerTest::test_color_transform_lut()
+{
+    // LUT is used only, when low accuracy is requested
+    QVERIFY(pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::Low, 3) > 0);
+    QVERIFY(pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::Low, 4) > 0);
+    QCOMPARE(pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::Medium, 3), 0);
+    QCOMPARE(pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::Medium, 4), 0);
+    QCOMPARE(pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::High, 3), 0);
+    QCOMPARE(pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::High, 4), 0);
+
+    struct Error
+    {
+        float maximal = 0.0f;
+        float mean = 0.0f;
+    };
+
+    // Computes error of the LUT against the direct (float) transform of LittleCMS
+    auto computeError = [](cmsHTRANSFORM transform, uint32_t channels, float inputScale)
+    {
+        auto sampler = [transform, channels, inputScale](const float* input, float* output, size_t count)
+        {
+            std::vector<float> scaledInput(input, input + count * channels);
+            for (float& value : scaledInput)
+            {
+                value *= inputScale;
+            }
+            cmsDoTransform(transform, scaledInput.data(), output, cmsUInt32Number(count));
+        };
+
+        Error error;
+        std::unique_ptr<pdf::PDFColorTransformLUT> lut = pdf::PDFColorTransformLUT::build(sampler, channels, pdf::PDFColorTransformLUT::getGridSize(pdf::PDFCMSSettings::Accuracy::Low, channels));
+        if (!lut)
+        {
+            error.maximal = 1.0f;
+            error.mean = 1.0f;
+            return error;
+        }
+
+        constexpr int sampleCount = 20000;
+        QRandomGenerator generator(42);
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            std::array<float, 4> input = { };
+            for (uint32_t j = 0; j < channels; ++j)
+            {
+                input[j] = float(generator.generateDouble());
+            }
+
+            std::array<float, 3> lutOutput = { };
+            std::array<float, 3> directOutput = { };
+            lut->transform(input.data(), lutOutput.data());
+            sampler(input.data(), directOutput.data(), 1);
+
+            float colorError = 0.0f;
+            for (size_t j = 0; j < lutOutput.size(); ++j)
+            {
+                colorError = qMax(colorError, qAbs(qBound(0.0f, lutOutput[j], 1.0f) - qBound(0.0f, directOutput[j], 1.0f)));
+            }
+
+            error.maximal = qMax(error.maximal, colorError);
+            error.mean += colorError / sampleCount;
+        }
+
+        return error;
+    };
+
+    // RGB: sRGB to Adobe RGB (1998)
+    cmsHPROFILE sRGBProfile = cmsCreate_sRGBProfile();
+    cmsCIExyY whitePoint = { };
+    cmsWhitePointFromTemp(&whitePoint, 6504);
+    cmsCIExyYTRIPLE primaries = { { 0.64, 0.33, 1.0 }, { 0.21, 0.71, 1.0 }, { 0.15, 0.06, 1.0 } };
+    cmsToneCurve* gamma = cmsBuildGamma(nullptr, 563.0 / 256.0);
+    cmsToneCurve* toneCurves[3] = { gamma, gamma, gamma };
+    cmsHPROFILE adobeRGBProfile = cmsCreateRGBProfile(&whitePoint, &primaries, toneCurves);
+    cmsFreeToneCurve(gamma);
+
+    cmsHTRANSFORM rgbTransform = cmsCreateTransform(sRGBProfile, TYPE_RGB_FLT, adobeRGBProfile, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOCACHE | cmsFLAGS_NOOPTIMIZE);
+    QVERIFY(rgbTransform);
+    Error rgbError = computeError(rgbTransform, 3, 1.0f);
+    cmsDeleteTransform(rgbTransform);
+
+    QVERIFY2(rgbError.maximal <= 6.0f / 255.0f, qPrintable(QString("RGB maximal error = %1").arg(rgbError.maximal * 255.0f)));
+    QVERIFY2(rgbError.mean <= 0.5f / 255.0f, qPrintable(QString("RGB mean error = %1").arg(rgbError.mean * 255.0f)));
+
+    // CMYK: printer-like profile, where inks absorb light of complementary colors
+    auto sampleCMYK = [](const cmsUInt16Number input[], cmsUInt16Number output[], void*) -> cmsInt32Number
+    {
+        const double c = input[0] / 65535.0;
+        const double m = input[1] / 65535.0;
+        const double y = input[2] / 65535.0;
+        const double k = input[3] / 65535.0;
+
+        const double r = (1.0 - c) * (1.0 - k);
+        const double g = (1.0 - m) * (1.0 - k);
+        const double b = (1.0 - y) * (1.0 - k);
+
+        cmsCIEXYZ xyz = { 0.4360 * r + 0.3851 * g + 0.1431 * b,
+                          0.2225 * r + 0.7169 * g + 0.0606 * b,
+                          0.0139 * r + 0.0971 * g + 0.7141 * b };
+        cmsCIELab lab = { };
+        cmsXYZ2Lab(nullptr, &lab, &xyz);
+        cmsFloat2LabEncoded(output, &lab);
+        return 1;
+    };
+
+    cmsHPROFILE cmykProfile = cmsCreateProfilePlaceholder(nullptr);
+    cmsSetProfileVersion(cmykProfile, 4.3);
+    cmsSetDeviceClass(cmykProfile, cmsSigOutputClass);
+    cmsSetColorSpace(cmykProfile, cmsSigCmykData);
+    cmsSetPCS(cmykProfile, cmsSigLabData);
+
+    cmsPipeline* pipeline = cmsPipelineAlloc(nullptr, 4, 3);
+    cmsStage* clut = cmsStageAllocCLut16bit(nullptr, 9, 4, 3, nullptr);
+    cmsStageSampleCLut16bit(clut, sampleCMYK, nullptr, 0);
+    cmsPipelineInsertStage(pipeline, cmsAT_BEGIN, clut);
+    cmsWriteTag(cmykProfile, cmsSigAToB0Tag, pipeline);
+    cmsPipelineFree(pipeline);
+
+    cmsHTRANSFORM cmykTransform = cmsCreateTransform(cmykProfile, TYPE_CMYK_FLT, sRGBProfile, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOCACHE | cmsFLAGS_NOOPTIMIZE);
+    QVERIFY(cmykTransform);
+    Error cmykError = computeError(cmykTransform, 4, 100.0f);
+    cmsDeleteTransform(cmykTransform);
+
+    cmsCloseProfile(cmykProfile);
+    cmsCloseProfile(adobeRGBProfile);
+    cmsCloseProfile(sRGBProfile);
+
+    // Jakub Melka: maximal error occurs near black and at the gamut boundary, where
+    // output changes steeply. It is similar to the error of precalculated 8-bit
+    // transform of LittleCMS for the same profiles.
+    QVERIFY2(cmykError.maximal <= 20.0f / 255.0f, qPrintable(QString("CMYK maximal error = %1").arg(cmykError.maximal * 255.0f)));
+    QVERIFY2(cmykError.mean <= 2.0f / 255.0f, qPrintable(QString("CMYK mean error = %1").arg(cmykError.mean * 255.0f)));
+}
+
+void LexicalAnalyzerTest::test_image_recompression()
+{
+    constexpr int size = 600;
+
+    auto toReferenceString = [](pdf::PDFObjectReference reference)
+    {
+        return QByteArray::number(reference.objectNumber) + " " + QByteArray::number(reference.generation) + " R";
+    };
+
+    auto parseObject = [](const QByteArray& data)
+    {
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    auto createStream = [&parseObject](const QByteArray& dictionaryData, QByteArray content)
+    {
+        pdf::PDFObject dictionaryObject = parseObject(dictionaryData);
+        pdf::PDFDictionary dictionary = *dictionaryObject.getDictionary();
+        dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createInteger(content.size()));
+        return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(content)));
+    };
+
+    auto createImage = [&createStream](const QByteArray& colorSpace, const QByteArray& entries, QByteArray content)
+    {
+        return createStream("<< /Type /XObject /Subtype /Image /Width 600 /Height 600 /BitsPerComponent 8 /ColorSpace /" + colorSpace + " " + entries + " >>", qMove(content));
+    };
+
+    QByteArray gradient(size * size, 0);
+    QByteArray bitonal(size * size, 0);
+    QByteArray opaque(size * size, char(0xFF));
+    QImage colorImage(size, size, QImage::Format_RGB888);
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            gradient[y * size + x] = char((x + y) * 255 / (2 * size));
+            bitonal[y * size + x] = ((x / 16 + y / 16) % 2) ? char(0xFF) : char(0x00);
+            colorImage.setPixel(x, y, qRgb(x * 255 / size, y * 255 / size, 128));
+        }
+    }
+
+    QByteArray jpegData;
+    QBuffer jpegBuffer(&jpegData);
+    jpegBuffer.open(QBuffer::WriteOnly);
+    QImageWriter jpegWriter(&jpegBuffer, "jpg");
+    jpegWriter.setQuality(95);
+    const bool isJpegSupported = jpegWriter.write(colorImage);
+    jpegBuffer.close();
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 72, 72));
+
+    // Images are painted on one inch square, so their resolution is 600 DPI
+    pdf::PDFObjectReference gradientImage = builder.addObject(createImage("DeviceGray", QByteArray(), gradient));
+    pdf::PDFObjectReference twiceImage = builder.addObject(createImage("DeviceGray", QByteArray(), gradient));
+    pdf::PDFObjectReference bitonalImage = builder.addObject(createImage("DeviceGray", QByteArray(), bitonal));
+    pdf::PDFObjectReference colorKeyImage = builder.addObject(createImage("DeviceGray", "/Mask [0 10]", gradient));
+    pdf::PDFObjectReference matteSoftMask = builder.addObject(createImage("DeviceGray", "/Matte [0]", gradient));
+    pdf::PDFObjectReference matteImage = builder.addObject(createImage("DeviceGray", "/SMask " + toReferenceString(matteSoftMask), gradient));
+    pdf::PDFObjectReference softMask = builder.addObject(createImage("DeviceGray", QByteArray(), gradient));
+    pdf::PDFObjectReference maskedImage = builder.addObject(createImage("DeviceGray", "/SMask " + toReferenceString(softMask), gradient));
+    pdf::PDFObjectReference opaqueSoftMask = builder.addObject(createImage("DeviceGray", QByteArray(), opaque));
+    pdf::PDFObjectReference opaqueMaskedImage = builder.addObject(createImage("DeviceGray", "/SMask " + toReferenceString(opaqueSoftMask), gradient));
+    pdf::PDFObjectReference patternImage = builder.addObject(createImage("DeviceGray", QByteArray(), gradient));
+    pdf::PDFObjectReference annotationImage = builder.addObject(createImage("DeviceGray", QByteArray(), gradient));
+    pdf::PDFObjectReference dctImage = builder.addObject(createImage("DeviceRGB", "/Filter /DCTDecode", jpegData));
+
+    const QByteArray paintImage = "q 72 0 0 72 0 0 cm /Im Do Q";
+    pdf::PDFObjectReference pattern = builder.addObject(createStream("<< /Type /Pattern /PatternType 1 /PaintType 1 /TilingType 1 /BBox [0 0 72 72] /XStep 72 /YStep 72 "
+                                                                     "/Resources << /XObject << /Im " + toReferenceString(patternImage) + " >> >> >>", paintImage));
+    pdf::PDFObjectReference appearance = builder.addObject(createStream("<< /Type /XObject /Subtype /Form /BBox [0 0 72 72] "
+                                                                        "/Resources << /XObject << /Im " + toReferenceString(annotationImage) + " >> >> >>", paintImage));
+    pdf::PDFObjectReference annotation = builder.addObject(parseObject("<< /Type /Annot /Subtype /Square /Rect [0 0 72 72] /AP << /N " + toReferenceString(appearance) + " >> >>"));
+
+    // Image painted twice has the resolution of its larger placement (150 DPI)
+    pdf::PDFObjectReference contents = builder.addObject(createStream("<< >>", "q 72 0 0 72 0 0 cm /Gradient Do /Twice Do /Bitonal Do /ColorKey Do /Matte Do /Masked Do "
+                                                                                "/Opaque Do /Pattern Do /Annotation Do /DCT Do Q q 288 0 0 288 0 0 cm /Twice Do Q"));
+
+    builder.mergeTo(page, parseObject("<< /Contents " + toReferenceString(contents) + " /Annots [" + toReferenceString(annotation) + "] "
+                                      "/Resources << /Pattern << /P " + toReferenceString(pattern) + " >> "
+                                      "/XObject << /Gradient " + toReferenceString(gradientImage) +
+                                      " /Twice " + toReferenceString(twiceImage) +
+                                      " /Bitonal " + toReferenceString(bitonalImage) +
+                                      " /ColorKey " + toReferenceString(colorKeyImage) +
+                                      " /Matte " + toReferenceString(matteImage) +
+                                      " /Masked " + toReferenceString(maskedImage) +
+                                      " /Opaque " + toReferenceString(opaqueMaskedImage) +
+                                      " /Pattern " + toReferenceString(patternImage) +
+                                      " /Annotation " + toReferenceString(annotationImage) +
+                                      " /DCT " + toReferenceString(dctImage) + " >> >> >>"));
+
+    pdf::PDFDocument document = builder.build();
+    pdf::PDFOptimizer optimizer(pdf::PDFOptimizer::RecompressImages, nullptr);
+    optimizer.setDocument(&document);
+    optimizer.optimize();
+    pdf::PDFDocument optimizedDocument = optimizer.takeOptimizedDocument();
+    pdf::PDFDocumentDataLoaderDecorator loader(&optimizedDocument);
+
+    auto getDictionary = [&optimizedDocument](pdf::PDFObjectReference reference)
+    {
+        return optimizedDocument.getObjectByReference(reference).getStream()->getDictionary();
+    };
+
+    auto getWidth = [&loader, &getDictionary](pdf::PDFObjectReference reference)
+    {
+        return loader.readIntegerFromDictionary(getDictionary(reference), "Width", 0);
+    };
+
+    auto getFilter = [&loader, &getDictionary](pdf::PDFObjectReference reference)
+    {
+        return loader.readNameFromDictionary(getDictionary(reference), "Filter");
+    };
+
+    // Downsampling to target resolution
+    QCOMPARE(getWidth(gradientImage), pdf::PDFInteger(150));
+    QCOMPARE(loader.readIntegerFromDictionary(getDictionary(gradientImage), "Height", 0), pdf::PDFInteger(150));
+    QCOMPARE(getFilter(gradientImage), QByteArray("FlateDecode"));
+    QCOMPARE(getWidth(twiceImage), pdf::PDFInteger(size));
+
+    // Bitonal images are downsampled to bitonal target resolution and packed to one bit
+    QCOMPARE(getWidth(bitonalImage), pdf::PDFInteger(300));
+    QCOMPARE(loader.readIntegerFromDictionary(getDictionary(bitonalImage), "BitsPerComponent", 0), pdf::PDFInteger(1));
+    QVERIFY(getFilter(bitonalImage) == "CCITTFaxDecode" || getFilter(bitonalImage) == "FlateDecode");
+
+    // DCT images are encoded by DCT again
+    if (isJpegSupported)
+    {
+        QCOMPARE(getWidth(dctImage), pdf::PDFInteger(150));
+        QCOMPARE(getFilter(dctImage), QByteArray("DCTDecode"));
+    }
+
+    // Images masked by color key, and premultiplied images with their soft masks are left unchanged
+    QVERIFY(optimizedDocument.getObjectByReference(colorKeyImage) == document.getObjectByReference(colorKeyImage));
+    QVERIFY(optimizedDocument.getObjectByReference(matteImage) == document.getObjectByReference(matteImage));
+    QVERIFY(optimizedDocument.getObjectByReference(matteSoftMask) == document.getObjectByReference(matteSoftMask));
+
+    // Soft mask is downsampled with its image, opaque soft mask is removed
+    QCOMPARE(getWidth(maskedImage), pdf::PDFInteger(150));
+    QCOMPARE(getWidth(softMask), pdf::PDFInteger(150));
+    QCOMPARE(getWidth(opaqueMaskedImage), pdf::PDFInteger(150));
+    QVERIFY(!getDictionary(opaqueMaskedImage)->hasKey("SMask"));
+    QVERIFY(getDictionary(maskedImage)->hasKey("SMask"));
+
+    // Images used by patterns and annotation appearances are not scanned, so they are kept
+    QCOMPARE(getWidth(patternImage), pdf::PDFInteger(size));
+    QCOMPARE(getWidth(annotationImage), pdf::PDFInteger(size));
+}
+
+void LexicalAnalyzerTest::test_decrypt_streams_on_demand()
+{
+    auto writeDocument = [](const pdf::PDFDocument& document)
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QBuffer::WriteOnly);
+        pdf::PDFDocumentWriter writer(nullptr);
+        const bool isWritten = static_cast<bool>(writer.write(&buffer, &document));
+        buffer.close();
+        return isWritten ? data : QByteArray();
+    };
+
+    auto readDocument = [](const QByteArray& data, bool decryptStreamsOnDemand)
+    {
+        auto getPassword = [](bool* ok)
+        {
+            *ok = true;
+            return QString("user");
+        };
+
+        pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+        reader.setDecryptStreamsOnDemand(decryptStreamsOnDemand);
+        return reader.readFromBuffer(data);
+    };
+
+    auto getStream = [](const pdf::PDFDocument& document, pdf::PDFObjectReference reference)
+    {
+        return document.getObjectByReference(reference).getStream();
+    };
+
+    const pdf::PDFSecurityHandlerFactory::Algorithm algorithms[] = { pdf::PDFSecurityHandlerFactory::RC4,
+                                                                      pdf::PDFSecurityHandlerFactory::AES_128,
+                                                                      pdf::PDFSecurityHandlerFactory::AES_256 };
+
+    for (const pdf::PDFSecurityHandlerFactory::Algorithm algorithm : algorithms)
+    {
+        QRandomGenerator generator(algorithm);
+
+        pdf::PDFDocumentBuilder builder;
+        builder.createDocument();
+        builder.appendPage(QRectF(0, 0, 612, 792));
+
+        std::vector<pdf::PDFObjectReference> references;
+        std::vector<QByteArray> contents;
+        for (int i = 0; i < 50; ++i)
+        {
+            QByteArray content(generator.bounded(0, 3000), 0);
+            for (char& value : content)
+            {
+                value = char(generator.bounded(256));
+            }
+
+            pdf::PDFDictionary dictionary;
+            dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createInteger(content.size()));
+            references.push_back(builder.addObject(pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), QByteArray(content)))));
+            contents.push_back(qMove(content));
+        }
+
+        pdf::PDFSecurityHandlerFactory::SecuritySettings settings;
+        settings.algorithm = algorithm;
+        settings.userPassword = "user";
+        settings.ownerPassword = "owner";
+        settings.permissions = 0xFFFFFFFF;
+        settings.id = "0123456789abcdef";
+        builder.setSecurityHandler(pdf::PDFSecurityHandlerFactory::createSecurityHandler(settings));
+
+        const QByteArray encryptedData = writeDocument(builder.build());
+        QVERIFY(!encryptedData.isEmpty());
+
+        // Eager and lazy decryption give the same streams, Length of lazily
+        // decrypted stream is the length of decrypted data before the decryption.
+        pdf::PDFDocument eagerDocument = readDocument(encryptedData, false);
+        pdf::PDFDocument lazyDocument = readDocument(encryptedData, true);
+        for (size_t i = 0; i < references.size(); ++i)
+        {
+            const pdf::PDFStream* eagerStream = getStream(eagerDocument, references[i]);
+            const pdf::PDFStream* lazyStream = getStream(lazyDocument, references[i]);
+            QVERIFY(eagerStream && lazyStream);
+            QVERIFY(!eagerStream->isEncrypted());
+            QVERIFY(lazyStream->isEncrypted());
+            QCOMPARE(lazyStream->getDictionary()->get(pdf::PDF_STREAM_DICT_LENGTH).getInteger(), pdf::PDFInteger(contents[i].size()));
+            QCOMPARE(*eagerStream->getContent(), contents[i]);
+            QCOMPARE(*lazyStream->getContent(), contents[i]);
+            QVERIFY(!lazyStream->isEncrypted());
+            QVERIFY(eagerDocument.getObjectByReference(references[i]) == lazyDocument.getObjectByReference(references[i]));
+        }
+
+        // Streams are decrypted from multiple threads at once
+        pdf::PDFDocument concurrentDocument = readDocument(encryptedData, true);
+        std::atomic_int errors = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                for (size_t j = 0; j < references.size(); ++j)
+                {
+                    const size_t index = (j + i) % references.size();
+                    if (*getStream(concurrentDocument, references[index])->getContent() != contents[index])
+                    {
+                        ++errors;
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        QCOMPARE(errors.load(), 0);
+
+        // Decrypted document written without encryption has correct stream lengths
+        pdf::PDFDocument decryptDocument = readDocument(encryptedData, true);
+        pdf::PDFDocumentBuilder decryptBuilder(&decryptDocument);
+        decryptBuilder.setSecurityHandler(pdf::PDFSecurityHandlerPointer(new pdf::PDFNoneSecurityHandler()));
+        const QByteArray decryptedData = writeDocument(decryptBuilder.build());
+        pdf::PDFDocument decryptedDocument = readDocument(decryptedData, true);
+        QVERIFY(decryptedDocument.getStorage().getSecurityHandler()->getMode() == pdf::EncryptionMode::None);
+        for (size_t i = 0; i < references.size(); ++i)
+        {
+            const pdf::PDFStream* stream = getStream(decryptedDocument, references[i]);
+            QVERIFY(stream);
+            QCOMPARE(*stream->getContent(), contents[i]);
+            QCOMPARE(stream->getDictionary()->get(pdf::PDF_STREAM_DICT_LENGTH).getInteger(), pdf::PDFInteger(contents[i].size()));
+        }
+    }
+
+    // Indirect Length of the stream is kept, when document is written
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 612, 792));
+    const QByteArray content = "0 0 m 100 100 l S";
+    pdf::PDFObjectReference lengthReference = builder.addObject(pdf::PDFObject::createInteger(content.size()));
+    pdf::PDFDictionary dictionary;
+    dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createReference(lengthReference));
+    pdf::PDFObjectReference streamReference = builder.addObject(pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), QByteArray(content))));
+
+    pdf::PDFDocument document = readDocument(writeDocument(builder.build()), false);
+    const pdf::PDFStream* stream = getStream(document, streamReference);
+    QVERIFY(stream);
+    QCOMPARE(*stream->getContent(), content);
+    QVERIFY(stream->getDictionary()->get(pdf::PDF_STREAM_DICT_LENGTH).isReference());
+    QVERIFY(stream->getDictionary()->get(pdf::PDF_STREAM_DICT_LENGTH).getReference() == lengthReference);
+}
+
+void LexicalAnalyzerTest::test_text_layout_sink()
+{
+    auto toReferenceString = [](pdf::PDFObjectReference reference)
+    {
+        return QByteArray::number(reference.objectNumber) + " " + QByteArray::number(reference.generation) + " R";
+    };
+
+    auto parseObject = [](const QByteArray& data)
+    {
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    auto createStream = [&parseObject](const QByteArray& dictionaryData, QByteArray content)
+    {
+        pdf::PDFObject dictionaryObject = parseObject(dictionaryData);
+        pdf::PDFDictionary dictionary = *dictionaryObject.getDictionary();
+        dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createInteger(content.size()));
+        return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(content)));
+    };
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+
+    pdf::PDFObjectReference font = builder.addObject(parseObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"));
+    const QByteArray fontResources = "/Font << /F1 " + toReferenceString(font) + " >>";
+    pdf::PDFObjectReference form = builder.addObject(createStream("<< /Type /XObject /Subtype /Form /BBox [0 0 200 200] /Resources << " + fontResources + " >> >>",
+                                                                  "BT /F1 10 Tf 10 10 Td (Text inside form) Tj ET"));
+    pdf::PDFObjectReference pattern = builder.addObject(createStream("<< /Type /Pattern /PatternType 1 /PaintType 1 /TilingType 1 /BBox [0 0 100 100] /XStep 100 /YStep 100 "
+                                                                     "/Resources << " + fontResources + " >> >>", "BT /F1 8 Tf 5 50 Td (Pattern) Tj ET"));
+
+    // Text is painted directly, in form, in tiling pattern, invisible, in marked content and rotated
+    const QByteArray pageContents[] =
+    {
+        "BT /F1 12 Tf 72 700 Td (Hello world) Tj 0 -14 Td (Second line of the paragraph) Tj ET 72 500 200 100 re f q 1 0 0 1 72 300 cm /Form Do Q",
+        "/Pattern cs /P scn 72 72 200 200 re f BT /F1 12 Tf 3 Tr 72 700 Td (Invisible text) Tj 0 Tr /Span << /ActualText (Span) >> BDC (Marked text) Tj EMC ET",
+        "BT /F1 20 Tf 0.7071 0.7071 -0.7071 0.7071 300 300 Tm (Rotated text) Tj ET"
+    };
+
+    for (const QByteArray& pageContent : pageContents)
+    {
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 612, 792));
+        pdf::PDFObjectReference contents = builder.addObject(createStream("<< >>", pageContent));
+        builder.mergeTo(page, parseObject("<< /Contents " + toReferenceString(contents) + " /Resources << " + fontResources +
+                                          " /Pattern << /P " + toReferenceString(pattern) + " >> /XObject << /Form " + toReferenceString(form) + " >> >> >>"));
+    }
+
+    pdf::PDFDocument document = builder.build();
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::View, nullptr);
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+    pdf::PDFCMSGeneric cms;
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+    constexpr pdf::PDFRenderer::Features features = pdf::PDFRenderer::IgnoreOptionalContent;
+    pdf::PDFRenderer renderer(&document, &fontCache, &cms, &optionalContentActivity, features, meshQualitySettings);
+
+    auto serialize = [](const pdf::PDFTextLayout& textLayout)
+    {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << textLayout;
+        return data;
+    };
+
+    auto getText = [](const pdf::PDFTextLayout& textLayout)
+    {
+        QString text;
+        for (const pdf::PDFTextBlock& block : textLayout.getTextBlocks())
+        {
+            for (const pdf::PDFTextLine& line : block.getLines())
+            {
+                for (const pdf::TextCharacter& character : line.getCharacters())
+                {
+                    text += character.character;
+                }
+            }
+        }
+        return text;
+    };
+
+    // Text layout collected by the sink during page compilation must be
+    // the same as text layout created by the text layout generator. Content
+    // of the tiling pattern is painted for each tile, but it is not text
+    // of the page, so it must not appear in the layout.
+    for (size_t pageIndex = 0; pageIndex < document.getCatalog()->getPageCount(); ++pageIndex)
+    {
+        const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
+        pdf::PDFTextLayoutGenerator generator(features, page, &document, &fontCache, &cms, &optionalContentActivity, QTransform(), meshQualitySettings);
+        generator.processContents();
+        pdf::PDFTextLayout generatorTextLayout = generator.createTextLayout();
+
+        pdf::PDFPrecompiledPage compiledPage;
+        pdf::PDFTextLayout compiledTextLayout;
+        renderer.compile(&compiledPage, pageIndex, &compiledTextLayout);
+
+        QVERIFY(!generatorTextLayout.getTextBlocks().empty());
+        QVERIFY(!getText(compiledTextLayout).contains(QLatin1String("Pattern")));
+        QCOMPARE(serialize(compiledTextLayout), serialize(generatorTextLayout));
+    }
+}
+
+void LexicalAnalyzerTest::test_document_text_flow()
+{
+    auto toReferenceString = [](pdf::PDFObjectReference reference)
+    {
+        return QByteArray::number(reference.objectNumber) + " " + QByteArray::number(reference.generation) + " R";
+    };
+
+    auto parseObject = [](const QByteArray& data)
+    {
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    auto createStream = [&parseObject](const QByteArray& dictionaryData, QByteArray content)
+    {
+        pdf::PDFObject dictionaryObject = parseObject(dictionaryData);
+        pdf::PDFDictionary dictionary = *dictionaryObject.getDictionary();
+        dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createInteger(content.size()));
+        return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(content)));
+    };
+
+    auto getText = [](const pdf::PDFDocumentTextFlow& textFlow)
+    {
+        QStringList texts;
+        for (const pdf::PDFDocumentTextFlow::Item& item : textFlow.getItems())
+        {
+            if (item.isText())
+            {
+                texts << item.text;
+            }
+        }
+        return texts;
+    };
+
+    // Pages are processed in parallel, but texts and errors (each page has MCID
+    // without structure tree item) must be in the page order.
+    {
+        constexpr int pageCount = 32;
+
+        pdf::PDFDocumentBuilder builder;
+        builder.createDocument();
+        pdf::PDFObjectReference font = builder.addObject(parseObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"));
+
+        QStringList expectedTexts;
+        QStringList expectedErrors;
+        std::vector<pdf::PDFInteger> pageIndices;
+        for (int i = 0; i < pageCount; ++i)
+        {
+            pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 612, 792));
+            pdf::PDFObjectReference contents = builder.addObject(createStream("<< >>", "/P << /MCID " + QByteArray::number(i) + " >> BDC BT /F1 12 Tf 72 700 Td (Page " + QByteArray::number(i) + ") Tj ET EMC"));
+            builder.mergeTo(page, parseObject("<< /Contents " + toReferenceString(contents) + " /Resources << /Font << /F1 " + toReferenceString(font) + " >> >> >>"));
+
+            expectedTexts << QString("Page %1").arg(i);
+            expectedErrors << QString("Structure tree item for MCID %1 not found.").arg(i);
+            pageIndices.push_back(i);
+        }
+
+        pdf::PDFDocument document = builder.build();
+
+        for (int i = 0; i < 4; ++i)
+        {
+            pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded);
+            pdf::PDFDocumentTextFlowFactory factory;
+            pdf::PDFDocumentTextFlow textFlow = factory.create(&document, pageIndices, pdf::PDFDocumentTextFlowFactory::Algorithm::Content);
+            pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+
+            // Font substitution warnings can be reported too, we skip them
+            QStringList errors;
+            for (const pdf::PDFRenderError& error : factory.getErrors())
+            {
+                if (error.message.contains("MCID"))
+                {
+                    errors << error.message;
+                }
+            }
+
+            QCOMPARE(getText(textFlow), expectedTexts);
+            QCOMPARE(errors, expectedErrors);
+        }
+    }
+
+    // Stored text layouts are reused by the layout algorithm only, if they
+    // were created ignoring optional content (document has optional content).
+    {
+        pdf::PDFDocumentBuilder builder;
+        builder.createDocument();
+        pdf::PDFObjectReference font = builder.addObject(parseObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"));
+        pdf::PDFObjectReference ocg = builder.addObject(parseObject("<< /Type /OCG /Name (Hidden) >>"));
+        builder.setCatalogOptionalContentProperties(builder.addObject(parseObject("<< /OCGs [" + toReferenceString(ocg) + "] /D << /OFF [" + toReferenceString(ocg) + "] >> >>")));
+
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 612, 792));
+        pdf::PDFObjectReference contents = builder.addObject(createStream("<< >>", "BT /F1 12 Tf 72 700 Td (Visible) Tj ET /OC /Hidden BDC BT /F1 12 Tf 72 600 Td (Hidden) Tj ET EMC"));
+        builder.mergeTo(page, parseObject("<< /Contents " + toReferenceString(contents) + " /Resources << /Font << /F1 " + toReferenceString(font) + " >> "
+                                          "/Properties << /Hidden " + toReferenceString(ocg) + " >> >> >>"));
+        pdf::PDFDocument document = builder.build();
+        QVERIFY(document.getCatalog()->getOptionalContentProperties()->isValid());
+
+        // Stored text layout is empty, so we can determine, whether it was used
+        pdf::PDFTextLayoutStorage textLayoutStorage(1);
+        textLayoutStorage.setTextLayout(0, pdf::PDFTextLayout(), nullptr);
+
+        pdf::PDFDocumentTextFlowFactory factory;
+        factory.setTextLayoutStorage(&textLayoutStorage, pdf::PDFRenderer::Features());
+        const QString text = getText(factory.create(&document, pdf::PDFDocumentTextFlowFactory::Algorithm::Layout)).join(' ');
+        QVERIFY(text.contains("Visible"));
+        QVERIFY(text.contains("Hidden"));
+
+        factory.setTextLayoutStorage(&textLayoutStorage, pdf::PDFRenderer::IgnoreOptionalContent);
+        QVERIFY(getText(factory.create(&document, pdf::PDFDocumentTextFlowFactory::Algorithm::Layout)).isEmpty());
+    }
+}
+
+void LexicalAnalyzerTest::test_diff_page_fingerprints()
+{
+    auto toReferenceString = [](pdf::PDFObjectReference reference)
+    {
+        return QByteArray::number(reference.objectNumber) + " " + QByteArray::number(reference.generation) + " R";
+    };
+
+    auto parseObject = [](const QByteArray& data)
+    {
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    auto createStream = [&parseObject](const QByteArray& dictionaryData, QByteArray content)
+    {
+        pdf::PDFObject dictionaryObject = parseObject(dictionaryData);
+        pdf::PDFDictionary dictionary = *dictionaryObject.getDictionary();
+        dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createInteger(content.size()));
+        return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(content)));
+    };
+
+    constexpr int pageCount = 3;
+
+    // Each page paints its own rectangle and a form shared by all pages
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    pdf::PDFObjectReference form = builder.addObject(createStream("<< /Type /XObject /Subtype /Form /BBox [0 0 612 792] >>", "300 300 100 100 re f"));
+
+    std::vector<pdf::PDFObjectReference> pages;
+    for (int i = 0; i < pageCount; ++i)
+    {
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 612, 792));
+        pdf::PDFObjectReference contents = builder.addObject(createStream("<< >>", "0 0 " + QByteArray::number((i + 1) * 50) + " 50 re f /Fm Do"));
+        builder.mergeTo(page, parseObject("<< /Contents " + toReferenceString(contents) + " /Resources << /XObject << /Fm " + toReferenceString(form) + " >> >> >>"));
+        pages.push_back(page);
+    }
+
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFClosedIntervalSet pageIndices;
+    pageIndices.addInterval(0, pageCount - 1);
+
+    auto performDiff = [&pageIndices](const pdf::PDFDocument* leftDocument, const pdf::PDFDocument* rightDocument)
+    {
+
+        pdf::PDFDiff diff(nullptr);
+        diff.setOption(pdf::PDFDiff::Asynchronous, false);
+        diff.setLeftDocument(leftDocument);
+        diff.setRightDocument(rightDocument);
+        diff.setPagesForLeftDocument(pageIndices);
+        diff.setPagesForRightDocument(pageIndices);
+        diff.start();
+        return diff.getResult();
+    };
+
+    // Identical pages are matched by their fingerprints, no content is extracted
+    {
+        pdf::PDFDocumentBuilder copyBuilder(&document);
+        pdf::PDFDocument copy = copyBuilder.build();
+
+        pdf::PDFDiffResult result = performDiff(&document, &copy);
+        QVERIFY(result.isSame());
+        QCOMPARE(result.getExtractedPageCount(), size_t(0));
+    }
+
+    // Only the modified page is extracted in both documents
+    {
+        pdf::PDFDocumentBuilder modifiedBuilder(&document);
+        pdf::PDFObjectReference contents = modifiedBuilder.addObject(createStream("<< >>", "0 0 100 100 re f /Fm Do"));
+        modifiedBuilder.mergeTo(pages[1], parseObject("<< /Contents " + toReferenceString(contents) + " >>"));
+        pdf::PDFDocument modifiedDocument = modifiedBuilder.build();
+
+        pdf::PDFDiffResult result = performDiff(&document, &modifiedDocument);
+        QVERIFY(result.isChanged());
+        QCOMPARE(result.getExtractedPageCount(), size_t(2));
+        QVERIFY(result.getChangedLeftPageIndices() == std::vector<pdf::PDFInteger>({ 1 }));
+        QVERIFY(result.getChangedRightPageIndices() == std::vector<pdf::PDFInteger>({ 1 }));
+    }
+
+    // Pages with the same content streams, but different resources, are not
+    // matched by their fingerprints, their content is extracted and compared.
+    {
+        pdf::PDFDocumentBuilder modifiedBuilder(&document);
+        modifiedBuilder.setObject(form, createStream("<< /Type /XObject /Subtype /Form /BBox [0 0 612 792] >>", "400 400 100 100 re f"));
+        pdf::PDFDocument modifiedDocument = modifiedBuilder.build();
+
+        pdf::PDFDiffResult result = performDiff(&document, &modifiedDocument);
+        QVERIFY(result.isChanged());
+        QCOMPARE(result.getExtractedPageCount(), size_t(2 * pageCount));
+        QVERIFY(result.getChangedLeftPageIndices() == std::vector<pdf::PDFInteger>({ 0, 1, 2 }));
+        QVERIFY(result.getChangedRightPageIndices() == std::vector<pdf::PDFInteger>({ 0, 1, 2 }));
+    }
+}
+
+void LexicalAnalyzerTest::test_document_page_splitter()
+{
+    auto toReferenceString = [](pdf::PDFObjectReference reference)
+    {
+        return QByteArray::number(reference.objectNumber) + " " + QByteArray::number(reference.generation) + " R";
+    };
+
+    auto parseObject = [](const QByteArray& data)
+    {
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    auto createStream = [&parseObject](const QByteArray& dictionaryData, QByteArray content)
+    {
+        pdf::PDFObject dictionaryObject = parseObject(dictionaryData);
+        pdf::PDFDictionary dictionary = *dictionaryObject.getDictionary();
+        dictionary.setEntry(pdf::PDFInplaceOrMemoryString(pdf::PDF_STREAM_DICT_LENGTH), pdf::PDFObject::createInteger(content.size()));
+        return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(content)));
+    };
+
+    constexpr int pageCount = 4;
+
+    // Pages share a form and a font, each page has its own content stream,
+    // odd pages have annotation referring back to the page. Unused object
+    // must not be present in any of the single page documents.
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    pdf::PDFObjectReference form = builder.addObject(createStream("<< /Type /XObject /Subtype /Form /BBox [0 0 612 792] >>", "300 300 100 100 re f"));
+    pdf::PDFObjectReference font = builder.addObject(parseObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"));
+    builder.addObject(parseObject("<< /Unused true >>"));
+
+    for (int i = 0; i < pageCount; ++i)
+    {
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 612, 792));
+        pdf::PDFObjectReference contents = builder.addObject(createStream("<< >>", "BT /F1 12 Tf 100 100 Td (Page " + QByteArray::number(i) + ") Tj ET /Fm Do"));
+        builder.mergeTo(page, parseObject("<< /Contents " + toReferenceString(contents) + " /Resources << /XObject << /Fm " + toReferenceString(form) + " >> /Font << /F1 " + toReferenceString(font) + " >> >> >>"));
+
+        if (i % 2 == 1)
+        {
+            pdf::PDFObjectReference annotation = builder.addObject(parseObject("<< /Type /Annot /Subtype /Square /Rect [10 10 50 50] /P " + toReferenceString(page) + " >>"));
+            builder.mergeTo(page, parseObject("<< /Annots [ " + toReferenceString(annotation) + " ] >>"));
+        }
+    }
+
+    pdf::PDFDocument document = builder.build();
+
+    // Create single page documents in parallel
+    pdf::PDFDocumentPageSplitter splitter(&document);
+    QCOMPARE(splitter.getPageCount(), size_t(pageCount));
+
+    std::vector<pdf::PDFDocument> pageDocuments(pageCount);
+    pdf::PDFIntegerRange<size_t> range(0, pageCount);
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded);
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), [&](size_t pageIndex) { pageDocuments[pageIndex] = splitter.createPageDocument(pageIndex); });
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+
+    auto getUsedObjectCount = [](const pdf::PDFObjectStorage& storage) -> size_t
+    {
+        const pdf::PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+        return std::count_if(objects.cbegin(), objects.cend(), [](const pdf::PDFObjectStorage::Entry& entry) { return !entry.object.isNull(); });
+    };
+
+    for (int pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+    {
+        // Previous implementation - build the document with a single page and optimize it
+        pdf::PDFDocumentBuilder documentBuilder(&document);
+        documentBuilder.flattenPageTree();
+        std::vector<pdf::PDFObjectReference> pageReferences = documentBuilder.getPages();
+        documentBuilder.setPages({ pageReferences[pageIndex] });
+        documentBuilder.removeOutline();
+        documentBuilder.removeThreads();
+        documentBuilder.removeDocumentActions();
+        documentBuilder.removeStructureTree();
+        pdf::PDFDocument expectedDocument = documentBuilder.build();
+
+        pdf::PDFOptimizer optimizer(pdf::PDFOptimizer::RemoveUnusedObjects | pdf::PDFOptimizer::ShrinkObjectStorage, nullptr);
+        optimizer.setDocument(&expectedDocument);
+        optimizer.optimize();
+        expectedDocument = optimizer.takeOptimizedDocument();
+
+        const pdf::PDFDocument& pageDocument = pageDocuments[pageIndex];
+        const pdf::PDFObjectStorage& expectedStorage = expectedDocument.getStorage();
+        const pdf::PDFObjectStorage& pageStorage = pageDocument.getStorage();
+
+        QCOMPARE(pageDocument.getCatalog()->getPageCount(), size_t(1));
+        QCOMPARE(getUsedObjectCount(pageStorage), getUsedObjectCount(expectedStorage));
+        QCOMPARE(getUsedObjectCount(pageStorage), pageStorage.getObjects().size() - 1);
+
+        // Object numbers may differ, so objects are compared by walking both
+        // documents from the trailer and mapping the references one to one.
+        std::map<pdf::PDFObjectReference, pdf::PDFObjectReference> referenceMapping;
+        std::function<bool(const pdf::PDFObject&, const pdf::PDFObject&)> isEquivalent;
+        auto isDictionaryEquivalent = [&isEquivalent](const pdf::PDFDictionary* expected, const pdf::PDFDictionary* actual, const char* ignoredKey)
+        {
+            if (expected->getCount() != actual->getCount())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < expected->getCount(); ++i)
+            {
+                if (expected->getKey(i) != actual->getKey(i))
+                {
+                    return false;
+                }
+
+                if ((!ignoredKey || expected->getKey(i) != ignoredKey) && !isEquivalent(expected->getValue(i), actual->getValue(i)))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+        isEquivalent = [&](const pdf::PDFObject& expected, const pdf::PDFObject& actual) -> bool
+        {
+            if (expected.getType() != actual.getType())
+            {
+                return false;
+            }
+
+            switch (expected.getType())
+            {
+                case pdf::PDFObject::Type::Reference:
+                {
+                    auto it = referenceMapping.find(expected.getReference());
+                    if (it != referenceMapping.cend())
+                    {
+                        return it->second == actual.getReference();
+                    }
+
+                    referenceMapping[expected.getReference()] = actual.getReference();
+                    return isEquivalent(expectedStorage.getObjectByReference(expected.getReference()), pageStorage.getObjectByReference(actual.getReference()));
+                }
+
+                case pdf::PDFObject::Type::Array:
+                {
+                    const pdf::PDFArray* expectedArray = expected.getArray();
+                    const pdf::PDFArray* actualArray = actual.getArray();
+                    if (expectedArray->getCount() != actualArray->getCount())
+                    {
+                        return false;
+                    }
+
+                    for (size_t i = 0; i < expectedArray->getCount(); ++i)
+                    {
+                        if (!isEquivalent(expectedArray->getItem(i), actualArray->getItem(i)))
+                        {
+                            return false;
+                        }
+                    }
+
+                    return true;
+                }
+
+                case pdf::PDFObject::Type::Dictionary:
+                    return isDictionaryEquivalent(expected.getDictionary(), actual.getDictionary(), nullptr);
+
+                case pdf::PDFObject::Type::Stream:
+                    return isDictionaryEquivalent(expected.getStream()->getDictionary(), actual.getStream()->getDictionary(), nullptr) &&
+                           *expected.getStream()->getContent() == *actual.getStream()->getContent();
+
+                default:
+                    return expected == actual;
+            }
+        };
+
+        // Optimizer doesn't update the /Size entry of the trailer dictionary
+        QVERIFY(isDictionaryEquivalent(expectedStorage.getTrailerDictionary().getDictionary(), pageStorage.getTrailerDictionary().getDictionary(), "Size"));
+
+        // Mapping must be one to one and must cover all objects of both documents
+        std::set<pdf::PDFObjectReference> mappedReferences;
+        for (const auto& item : referenceMapping)
+        {
+            mappedReferences.insert(item.second);
+        }
+        QCOMPARE(mappedReferences.size(), referenceMapping.size());
+        QCOMPARE(referenceMapping.size(), getUsedObjectCount(pageStorage));
+    }
+}
+
+void LexicalAnalyzerTest::test_sanitizer_removes_popups()
+{
+    auto toReferenceString = [](pdf::PDFObjectReference reference)
+    {
+        return QByteArray::number(reference.objectNumber) + " " + QByteArray::number(reference.generation) + " R";
+    };
+
+    auto parseObject = [](const QByteArray& data)
+    {
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return parser.getObject();
+    };
+
+    // Markup annotation on the first page has popup on the second page. Popup
+    // refers to its parent, but parent has no /Popup entry, so the popup can be
+    // found only using reverse edges of the reference graph.
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    pdf::PDFObjectReference firstPage = builder.appendPage(QRectF(0, 0, 612, 792));
+    pdf::PDFObjectReference secondPage = builder.appendPage(QRectF(0, 0, 612, 792));
+
+    pdf::PDFObjectReference text = builder.addObject(parseObject("<< /Type /Annot /Subtype /Text /Rect [10 10 30 30] /Contents (Note) /P " + toReferenceString(firstPage) + " >>"));
+    pdf::PDFObjectReference popup = builder.addObject(parseObject("<< /Type /Annot /Subtype /Popup /Rect [100 100 200 200] /Parent " + toReferenceString(text) + " /P " + toReferenceString(secondPage) + " >>"));
+    pdf::PDFObjectReference link = builder.addObject(parseObject("<< /Type /Annot /Subtype /Link /Rect [300 300 400 400] /P " + toReferenceString(secondPage) + " >>"));
+    builder.mergeTo(firstPage, parseObject("<< /Annots [ " + toReferenceString(text) + " ] >>"));
+    builder.mergeTo(secondPage, parseObject("<< /Annots [ " + toReferenceString(popup) + " " + toReferenceString(link) + " ] >>"));
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFDocumentSanitizer sanitizer(pdf::PDFDocumentSanitizer::MarkupAnnotations, nullptr);
+    sanitizer.setDocument(&document);
+    sanitizer.sanitize();
+    pdf::PDFDocument sanitizedDocument = sanitizer.takeSanitizedDocument();
+
+    const pdf::PDFCatalog* catalog = sanitizedDocument.getCatalog();
+    QCOMPARE(catalog->getPageCount(), size_t(2));
+    QVERIFY(catalog->getPage(0)->getAnnotations().empty());
+    QCOMPARE(catalog->getPage(1)->getAnnotations().size(), size_t(1));
+
+    const pdf::PDFDictionary* annotationDictionary = sanitizedDocument.getDictionaryFromObject(sanitizedDocument.getObjectByReference(catalog->getPage(1)->getAnnotations().front()));
+    QVERIFY(annotationDictionary);
+    QCOMPARE(annotationDictionary->get("Subtype").getString(), QByteArray("Link"));
+}
+
 void LexicalAnalyzerTest::scanWholeStream(const char* stream)
 {
     pdf::PDFLexicalAnalyzer analyzer(stream, stream + strlen(stream));